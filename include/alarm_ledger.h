@@ -0,0 +1,43 @@
+#ifndef GUI_CALENDAR_ALARM_LEDGER_H
+#define GUI_CALENDAR_ALARM_LEDGER_H
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <ds/vec.h>
+
+#include "datetime.h"
+
+/*
+ * Append-only record of the alarms that went off, so that the ones that
+ * were due while we did not run can be delivered at the next start. A
+ * record is the time and the hash of the key of an alarm, or a mark: all
+ * the alarms up to its time were delivered. Only the last mark and the
+ * alarms after it matter, the file is rewritten to them once it grows.
+ */
+struct alarm_ledger_rec {
+	int64_t t;
+	uint64_t hash; /* 0 for a mark */
+};
+struct alarm_ledger {
+	struct str path;
+	FILE *f;
+	int n; /* records in the file */
+	ts mark; /* -1 if there is none yet */
+	struct vec delivered; /* vec<struct alarm_ledger_rec>, after mark */
+};
+
+/* returns -1 if the ledger can't be opened */
+int alarm_ledger_open(struct alarm_ledger *l, const char *path);
+void alarm_ledger_close(struct alarm_ledger *l);
+/* $XDG_STATE_HOME/smuc/alarms */
+bool alarm_ledger_default_path(struct str *path);
+
+/* never 0 */
+uint64_t alarm_ledger_hash(const char *key);
+bool alarm_ledger_delivered(const struct alarm_ledger *l, uint64_t hash,
+	ts t);
+int alarm_ledger_append(struct alarm_ledger *l, uint64_t hash, ts t);
+/* also writes out the appended records */
+int alarm_ledger_mark(struct alarm_ledger *l, ts t);
+
+#endif
@@ -17,9 +17,12 @@ struct schedule_todo {
 
 void calendar_layout(struct layout_event *e, int N);
 
-/* Schedule todos into the free spaces between events.
- * arg n, E: n event ranges
- * arg k, T: k todos
+/* Schedule todos into the free spaces between events, from base on.
+ * arg n, E: n event ranges, in any order, possibly overlapping
+ * arg k, T: k todos in priority order, start is -1 if not set
+ * Free time is filled in order, each time with the first todo of T that
+ * has started and fits. Returns the k ranges, { -1, -1 } for todos
+ * without an estimated duration, NULL if k is 0.
  */
 struct ts_ran * todo_schedule(ts base, int n, struct ts_ran *E,
 		int k, struct schedule_todo *T);
@@ -9,6 +9,12 @@
 #include "views.h"
 #include "uexpr.h"
 #include "render.h"
+#include "rect_batch.h"
+#include "journal.h"
+#include "editor_session.h"
+#include "timer_wheel.h"
+#include "alarm_ledger.h"
+#include "freebusy.h"
 #include <platform_utils/event_loop.h>
 #include <mgu/text.h>
 
@@ -21,6 +27,15 @@ struct calendar_info {
 struct comp_display_settings {
 	bool fade, hide, vis;
 };
+/* cached layout of a row in the todo list, see render.c */
+struct todo_row {
+	int h; /* measured height, 0 if not measured yet */
+	int w; /* width it was measured for */
+	int day; /* the day side_text was formatted on, as yyyymmdd */
+	char *side_text; /* due date and estimated duration */
+	char *cats_text;
+	struct mgu_texture summary, desc;
+};
 struct proj_item {
 	struct comp_inst *ci;
 	int cal_index;
@@ -33,14 +48,22 @@ struct active_comp {
 	struct comp_display_settings settings;
 	char code[33];
 	struct mgu_texture tex, loc_tex;
+	struct todo_row row;
+	uint64_t todo_key; /* position in the todo list, smaller first */
+	struct ts_ran slot; /* in the todo schedule, tex is made for it */
 
 	struct interval_node node;
 	struct interval_node node_by_view;
+	/* in proj_active_events::in_view_by_end and in_view_by_start */
+	struct rb_integer_node by_end, by_start;
 };
+/* one trigger of an instance, kept across edits while it is pending */
 struct alarm_comp {
-	struct proj_item pi;
+	struct proj_item pi; /* only valid while gen is current */
 	struct comp_display_settings settings;
-	struct rb_integer_node node;
+	struct timer_wheel_node node;
+	struct str key; /* recurrence id, alarm, repetition and uid */
+	int gen; /* of the last add */
 };
 
 struct app;
@@ -77,6 +100,12 @@ struct proj {
 	void (*done)(void *self);
 	void (*clear)(void *self);
 	bool (*type)(void *self, enum comp_type type);
+	/* only the instances overlapping *ran are added, all of them if
+	 * this is NULL or returns false */
+	bool (*window)(void *self, enum comp_type type, struct ts_ran *ran);
+	/* depends only on the comp, the instances of the ones it rejects are
+	 * not added. NULL accepts all */
+	bool (*want)(void *self, const struct comp *c);
 };
 struct proj_active_events {
 	struct app *app;
@@ -87,18 +116,57 @@ struct proj_active_events {
 
 	/* items: struct active_comp::node_by_view */
 	struct rb_tree in_view, not_in_view;
+	/* in_view by end, and by start from the last. what leaves the view
+	 * is at their beginning, so a pan only visits what changes */
+	struct rb_tree in_view_by_end; /* items: active_comp::by_end */
+	struct rb_tree in_view_by_start; /* items: active_comp::by_start */
 };
 struct proj_active_todos {
 	struct app *app;
-	struct vec v; /* vec<struct active_comp> */
+	struct vec v; /* vec<struct active_comp>, by todo_key */
+	int sorted; /* v[sorted..] was added since the last done */
+	/* vec<struct active_comp>, by todo_key. a clear keeps the todos of
+	 * the calendars that did not change here, with ci == NULL, and an add
+	 * of the same instance binds them again. done drops the rest */
+	struct vec kept;
+	struct vec kept_keys; /* vec<struct str>, the key of kept[i] */
+	struct hashmap kept_map; /* hashmap<int>, index in kept, by key */
+	/* vec<ts>, min-heap of the starts after now. the keys of the todos
+	 * change when now passes them */
+	struct vec starts;
 };
 struct proj_alarm {
 	struct app *app;
-	/* items: struct alarm_comp::node */
-	struct rb_tree tree;
-	struct alarm_comp *next;
+	/* items: struct alarm_comp::node, only the pending ones */
+	struct timer_wheel wheel;
+	struct hashmap map; /* hashmap<struct alarm_comp *>, by key */
+	/* clear starts a new generation, done drops the alarms that were
+	 * not added again. so an edit only moves the alarms it changed */
+	int gen;
+	bool stale; /* cleared and not done yet */
+	/* the latest trigger of any event alarm, see proj_alarm_window.
+	 * found again after a clear */
+	ts late;
+	bool late_stale;
 	const char *shell_cmd;
 	int uexpr_filter;
+	struct subprocess_notifier notifier;
+	/* the wheel starts at its mark, the alarms missed since then go off
+	 * with the first done */
+	struct alarm_ledger ledger;
+	bool has_ledger;
+};
+/* the busy time of each calendar, from its confirmed events */
+struct proj_free_busy {
+	struct app *app;
+	struct vec lists; /* vec<struct busy_list>, by cal_index */
+	/* vec<struct vec<struct ts_ran>>, by cal_index, the instances added
+	 * since the last done, in order of start */
+	struct vec pending;
+	/* vec<ts>, by cal_index. a list kept over a clear has the instances
+	 * starting before this already */
+	struct vec kept_to;
+	ts expanded_to; /* at the last done */
 };
 
 struct color_scheme_configurable {
@@ -133,7 +201,9 @@ struct app {
 	struct proj_active_events active_events;
 	struct proj_active_todos active_todos;
 	struct proj_alarm alarm_comps;
+	struct proj_free_busy free_busy;
 	struct vec projs; /* vec<struct proj> */
+	bool projs_cleared; /* not done since */
 	struct vec cis; /* vec<struct comp_inst *> */
 
 	ts expand_to;
@@ -160,17 +230,36 @@ struct app {
 	/* calendar widgets and state in VIEW_CALENDAR mode */
 	struct ts_ran view;
 	struct slicing *slicing;
+	struct layout_pool layout_pool;
+
+	/* todos with an estimated duration placed into the free time between
+	 * confirmed events, see app_update_todo_schedule */
+	bool show_todo_schedule;
+	bool todo_schedule_dirty;
+	ts todo_schedule_base;
+	struct vec todo_schedule; /* vec<struct tobject>, sorted, disjoint */
 
-	/* editor subprocess info */
-	struct subprocess_handle *sp;
+	/* shaded in the calendar view, see app_free_busy */
+	enum freebusy_mode free_busy_overlay;
 
-	/* current time */
+	/* todo list state in VIEW_TODO mode, scroll offset in pixels */
+	int todo_scroll;
+
+	/* editor subprocesses */
+	struct editor_sessions editors;
+
+	/* current time, only set by the caller if fixed_now */
 	ts now;
+	bool fixed_now;
 
 	/* rendered view dirtiness handling */
 	int window_width, window_height;
 	bool dirty;
 
+	/* frame timing overlay, hud_frame spans the last rendered frame */
+	bool show_hud;
+	struct { uint64_t fr, to; } hud_frame;
+
 	/* config */
 	const char *requested_timezone;
 	struct cal_timezone *zone;
@@ -188,8 +277,15 @@ struct app {
 	struct mgu_win_surf *win;
 	struct mgu_out *out; // TODO: this is only used during rendering
 	struct sr *sr;
+	struct rect_batch rects;
+	bool has_rects;
 	struct event_loop *event_loop;
 	struct event_loop_timer alarm_timer;
+	/* edits reach storage through the journal, in batches */
+	struct journal journal;
+	bool has_journal;
+	struct event_loop_timer flush_timer;
+	bool flush_scheduled;
 	struct platform *plat;
 
 	struct mgu_text *text;
@@ -209,6 +305,12 @@ struct application_options {
 	char *editor;
 	char *terminal;
 	char *config_file;
+	/* added after the calendars of the config */
+	char **cals;
+	int cals_n;
+	/* no window and no journal. the config in the user's config dir is
+	 * not looked at, so the result only depends on the options */
+	bool headless;
 };
 
 void update_actual_fit();
@@ -232,15 +334,27 @@ struct cal_uexpr_env {
 };
 bool cal_uexpr_get(void *_env, const char *key, struct uexpr_value *v);
 bool cal_uexpr_set(void *env, const char *key, struct uexpr_value v);
+struct uexpr_value obj_cal_ref_create(int cal_idx);
 
 void app_init(struct app *app, struct application_options opts,
 	struct platform *plat, struct mgu_win_surf *win);
 void app_main(struct app *app);
 void app_finish(struct app *app);
+/* called when the GL context is created or is about to be destroyed. the
+ * window calls it, without one app->out must be set before */
+void context_cb(void *env, bool have_ctx);
+/* stops the clock at now and starts over from the week of now */
+void app_set_now(struct app *app, ts now);
 
 void app_use_view(struct app *app, struct ts_ran view);
 
 void app_update_projections(struct app *app);
+/* appends the time in ran of mode over all the calendars to out, a
+ * vec<struct ts_ran> */
+void app_free_busy(struct app *app, enum freebusy_mode mode,
+	struct ts_ran ran, struct vec *out);
+/* call after app_use_view, the todos are scheduled from about now on */
+void app_update_todo_schedule(struct app *app);
 void app_get_editor_template(struct app *app, struct comp_inst *ci, FILE *out);
 
 /* commands directly accessible for the user */
@@ -252,8 +366,14 @@ void app_cmd_reload(struct app *app);
 void app_cmd_activate_filter(struct app *app, int n);
 void app_cmd_view_today(struct app *app, int n);
 void app_cmd_toggle_show_private(struct app *app, int n);
+void app_cmd_toggle_hud(struct app *app, int n);
+void app_cmd_toggle_todo_schedule(struct app *app, int n);
+void app_cmd_show_free_busy(struct app *app, enum freebusy_mode mode);
+void app_cmd_dump_trace(struct app *app, int n);
+void app_cmd_dump_memory(struct app *app, int n);
 void app_cmd_switch_view(struct app *app, int n);
 void app_cmd_move_view_discrete(struct app *app, int n);
+void app_cmd_scroll_todos(struct app *app, int n);
 void app_cmd_set_color_scheme(struct app *app,
 	struct color_scheme_configurable col_c);
 
@@ -11,6 +11,8 @@
 
 #include "datetime.h"
 #include "props.h"
+#include "ics_index.h"
+#include "uexpr.h"
 
 struct recurrence;
 
@@ -33,10 +35,23 @@ struct comp_recur_inst {
 	ts recurrence_id;
 	struct props p;
 };
+/* a VALARM, each repetition is an alarm of its own */
+enum comp_alarm_related {
+	COMP_ALARM_ABSOLUTE,
+	COMP_ALARM_START,
+	COMP_ALARM_END, /* the due date of todos */
+};
+#define COMP_ALARM_MAX_REPEAT 100
+struct comp_alarm {
+	enum comp_alarm_related related;
+	ts trigger; /* the time if absolute, else seconds after related */
+	int repeat, duration; /* repeat more times, duration seconds apart */
+};
 struct comp {
 	struct str uid;
 	enum comp_type type;
 	struct props p;
+	struct vec alarms; /* vec<struct comp_alarm> */
 	struct vec recur_insts; /* vec<struct comp_recur_inst> */
 	struct recurrence *recur;
 	struct vec recur_cache; /* vec<struct recur_dep_props> */
@@ -46,6 +61,9 @@ void comp_init(struct comp *c, struct str uid, enum comp_type type);
 int comp_init_from_ics(struct comp *c, FILE *f);
 void comp_finish(struct comp *c);
 bool comp_equal(const struct comp *a, const struct comp *b);
+/* the time of the alarm of the instance with rdp, -1 if it has none */
+ts comp_alarm_time(const struct comp_alarm *a,
+	const struct recur_dep_props *rdp, int rep);
 bool comp_get_recur_point(struct comp *c, ts recurrence_id,
 		struct recur_dep_props *rdp_out, struct props **p_out);
 struct props *comp_get_or_create_recur_inst(struct comp *c, ts recurrence_id);
@@ -64,26 +82,73 @@ struct comp_inst {
 	/* valid if this is actually a recurrence instance, -1 otherwise */
 	ts recurrence_id;
 
+	/* the interval, the projections copy it into their trees */
 	struct interval_node node;
 };
 
+/*
+ * The expanded instances of one type, as parallel arrays sorted by start
+ * once built. max_end[i] is the largest end of the first i + 1, so the
+ * instances overlapping a range are between the first one whose max_end
+ * reaches into it and the first one starting after it, both found by
+ * binary search.
+ */
+struct inst_index {
+	int n, cap;
+	int sorted; /* [0, sorted) is in order and has max_end */
+	ts *start, *end, *max_end;
+	struct comp_inst **ci; /* owned */
+};
+void inst_index_init(struct inst_index *ix);
+void inst_index_finish(struct inst_index *ix);
+void inst_index_add(struct inst_index *ix, struct comp_inst *ci);
+/* sorts what was added since the last build */
+void inst_index_build(struct inst_index *ix);
+/* frees the instances */
+void inst_index_clear(struct inst_index *ix);
+/* calls cb for the instances overlapping ran, in order of start. needs a
+ * build after the last add */
+void inst_index_query(const struct inst_index *ix, struct ts_ran ran,
+	void (*cb)(void *cl, struct comp_inst *ci), void *cl);
+/* appends the instances to out, a vec<struct comp_inst *>, in order of
+ * start, and leaves ix empty. out owns them then */
+void inst_index_take(struct inst_index *ix, struct vec *out);
+size_t inst_index_footprint(const struct inst_index *ix);
+
 struct calendar {
 	struct vec comps_vec; /* vec<struct comp> */
 	struct hashmap comps_map; /* hashmap<int> */
 	struct vec comp_infos; /* vec<struct comp_info> */
 
-	struct rb_tree *cis; /* exactly COMP_TYPE_N long */
-	int cis_n[COMP_TYPE_N];
+	struct inst_index cis[COMP_TYPE_N];
+	int cis_n[COMP_TYPE_N]; /* expanded, also the ones taken since */
 	bool cis_dirty[COMP_TYPE_N];
+	ts cis_to[COMP_TYPE_N]; /* expanded up to, if not dirty */
 
 	struct str name;
 	struct str storage;
+	struct ics_index index; /* where the comps are in storage */
 	bool priv;
 	struct timespec loaded;
 };
 void calendar_init(struct calendar* cal);
 void calendar_finish(struct calendar *cal);
 
+/* heap bytes held by a calendar, by what holds them. the hashmaps are not
+ * counted */
+struct calendar_footprint {
+	int comps, insts, recur_native, recur_ical;
+	size_t comps_bytes; /* struct comp, uids, alarms, comp_infos */
+	size_t props_bytes; /* of the comps and their recurrence instances */
+	size_t recur_bytes; /* rules, RDATE/EXDATE sets, recurrence caches */
+	size_t clone_bytes; /* libical fallback trees, by serialized size */
+	size_t insts_bytes; /* expanded struct comp_inst */
+	size_t index_bytes;
+};
+void calendar_get_footprint(const struct calendar *cal,
+	struct calendar_footprint *fp);
+size_t calendar_footprint_total(const struct calendar_footprint *fp);
+
 /* returns -1 if uid already exists */
 int calendar_new_comp(struct calendar *cal, struct str uid,
 		enum comp_type type);
@@ -98,6 +163,10 @@ struct comp * calendar_get_comp(struct calendar *cal, int idx);
 
 void calendar_expand_instances_to(struct calendar *cal, enum comp_type type,
 	ts to);
+/* does calendar_expand_instances_to for each of cals, a vec<struct
+ * calendar>, on up to threads threads. the result is the same */
+void calendars_expand_instances_to(struct vec *cals, enum comp_type type,
+	ts to, int threads);
 
 void update_calendar_from_storage(struct calendar *cal,
 		struct cal_timezone *local_zone);
@@ -107,12 +176,22 @@ int libical_parse_ics(FILE *f, struct calendar *cal);
 const char * cal_status_str(enum prop_status v);
 const char * cal_class_str(enum prop_class v);
 bool cal_parse_status(const char *key, enum prop_status *status);
+/* the filter variables that come from the props of an instance, see
+ * Documentation/uexpr_cal.md. false if key is not one of them */
+bool cal_filter_get_prop(enum comp_type type, struct props *p,
+	const char *key, struct uexpr_value *v);
 
 /* struct recurrence */
 typedef void (*recur_cb)(void *cl, ts t);
 void recurrence_expand(struct recurrence *recur, ts to, recur_cb cb, void *cl);
 void recurrence_destroy(struct recurrence *recur);
 void recurrence_reset(struct recurrence *recur);
+/* whether recurrence_expand up to to can run off the main thread: the
+ * rule is native and its instances convert without libical */
+bool recurrence_thread_safe(const struct recurrence *recur, ts to);
+/* clone is set to the estimated size of the libical tree, 0 for native
+ * rules */
+size_t recurrence_footprint(const struct recurrence *recur, size_t *clone);
 
 /* struct props */
 bool props_valid_for_type(const struct props *p, enum comp_type type);
@@ -6,6 +6,24 @@
 void asrt(bool cond, const char *msg);
 void * malloc_check(size_t size);
 
+/*
+ * Allocation accounting. The objects of the subsystems below are counted
+ * while they live, they have to be freed with free_tagged. The rest is
+ * measured by walking its owner, see calendar_get_footprint.
+ */
+enum mem_tag {
+	MEM_TAG_RECUR, /* struct recurrence and its libical fallback */
+	MEM_TAG_INST, /* struct comp_inst */
+	MEM_TAG_ACTIVE, /* struct active_comp and struct alarm_comp */
+	MEM_TAG_N
+};
+struct mem_stat { long long n, bytes; };
+void *malloc_tagged(enum mem_tag tag, size_t size);
+void free_tagged(enum mem_tag tag, void *p, size_t size);
+/* live objects of tag */
+struct mem_stat mem_stat_tag(enum mem_tag tag);
+const char *mem_tag_name(enum mem_tag tag);
+
 int mini(int a, int b);
 int maxi(int a, int b);
 
@@ -25,8 +25,16 @@ struct simple_dur {
 /* struct cal_timezone */
 struct cal_timezone;
 struct cal_timezone *cal_timezone_new(const char *location);
+/* NULL if there is no zone of that name */
+struct cal_timezone *cal_timezone_try_new(const char *location);
 void cal_timezone_destroy(struct cal_timezone *zone);
 const char *cal_timezone_get_desc(const struct cal_timezone *zone);
+/*
+ * A builtin zone that is never destroyed, created on the first call with
+ * the location. Returns NULL if libical doesn't know the location. Not
+ * thread safe.
+ */
+struct cal_timezone *cal_timezone_get_shared(const char *location);
 
 void ts_adjust_days(ts *t, struct cal_timezone *zone, int n);
 ts ts_get_day_base(ts t, struct cal_timezone *zone, bool week);
@@ -37,7 +45,13 @@ bool simple_date_eq(struct simple_date a, struct simple_date b);
 struct simple_date simple_date_now(struct cal_timezone *zone);
 struct simple_date simple_date_from_ts(ts t, struct cal_timezone *zone);
 ts simple_date_to_ts(struct simple_date sd, struct cal_timezone *zone);
+/* simple_date_to_ts only falls back to libical, which is not thread safe,
+ * for wall clock times this is false for */
+bool simple_date_to_ts_native(ts wall);
 void simple_date_normalize(struct simple_date *sd);
+/* wall clock time as seconds since the epoch, as if the zone was UTC */
+ts simple_date_to_wall(struct simple_date sd);
+struct simple_date simple_date_from_wall(ts w);
 int simple_date_days_in_month(struct simple_date sd);
 const char * simple_date_day_of_week_name(struct simple_date sd);
 int simple_date_week_number(struct simple_date sd);
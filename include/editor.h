@@ -60,11 +60,45 @@ void print_new_event_template(FILE *f, struct cal_timezone *zone, int cal);
 void print_new_todo_template(FILE *f, struct cal_timezone *zone, int cal);
 int edit_spec_init_parse(struct edit_spec *es, FILE *f,
 	struct cal_timezone *zone, ts now);
+/* several specs, each starting with its header. specs is a
+ * vec<struct edit_spec>, only initialized on success */
+int edit_specs_init_parse(struct vec *specs, FILE *f,
+	struct cal_timezone *zone, ts now);
+void edit_specs_finish(struct vec *specs);
 
+/* the file in the calendar's storage that the edit is written to. -1 if
+ * there is none, eg. for creating or deleting in a single file calendar */
+int edit_spec_storage_path(const struct edit_spec *es,
+	struct calendar *cal, char path[static 1024]);
+bool edit_spec_can_apply_to_storage(const struct edit_spec *es,
+	struct calendar *cal);
 int edit_spec_apply_to_storage(struct edit_spec *es,
 		struct calendar *cal);
+/* all edits must go to the same file. runs of updates are written in one
+ * go. returns the number of failed edits, these are marked in failed */
+int edit_specs_apply_to_storage(struct edit_spec **es, int n,
+	struct calendar *cal, bool *failed);
+bool edit_spec_can_apply_to_memory(const struct edit_spec *es,
+	struct calendar *cal);
+void edit_spec_apply_to_memory(struct edit_spec *es, struct calendar *cal);
 int apply_edit_spec_to_calendar(struct edit_spec *es, struct calendar *cal);
 
+/* batches, es[i] goes to cals[i] */
+/* groups the edits by file and writes each file once. returns the number
+ * of failed edits, these are marked in failed */
+int edit_specs_apply_grouped(struct edit_spec **es, struct calendar **cals,
+	int n, bool *failed);
+/* every spec must be applicable, and touch a different component */
+bool edit_specs_can_apply_to_memory(struct edit_spec **es,
+	struct calendar **cals, int n);
+/* every spec must have a file in its calendar's storage */
+bool edit_specs_can_apply_to_storage(struct edit_spec **es,
+	struct calendar **cals, int n);
+/* nothing is applied if the batch is invalid. if storage fails for some
+ * edits, the rest is still applied and -1 is returned */
+int apply_edit_specs_to_calendars(struct edit_spec **es,
+	struct calendar **cals, int n);
+
 /* other utils */
 struct simple_date parse_date(const char *str);
 
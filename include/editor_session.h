@@ -0,0 +1,60 @@
+#ifndef GUI_CALENDAR_EDITOR_SESSION_H
+#define GUI_CALENDAR_EDITOR_SESSION_H
+#include <stdbool.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <ds/vec.h>
+#include <platform_utils/event_loop.h>
+
+#include "datetime.h"
+#include "editor.h"
+#include "util.h"
+
+/*
+ * Editor processes running at the same time. When one exits, its output
+ * is read on a worker thread, so the ui never waits for the editor's file.
+ * It is finished on the event loop: the date parser may fall back to
+ * libical, which is not thread safe.
+ */
+
+struct editor_session {
+	struct subprocess_handle *sp;
+	ts now; /* when the template was made, for the parser */
+
+	struct str text; /* filled in by the worker */
+	struct vec specs; /* vec<struct edit_spec>, only valid if res == 0 */
+	int res;
+};
+
+struct editor_sessions {
+	struct event_loop *el;
+	struct cal_timezone *zone; /* read only once created, shared */
+	void *env;
+	/* s and its contents are freed after the call */
+	void (*done)(void *env, struct editor_session *s);
+
+	struct vec running; /* vec<struct editor_session*> */
+
+	pthread_t worker;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	/* guarded by mutex */
+	struct vec queued; /* vec<struct editor_session*> */
+	struct vec finished; /* vec<struct editor_session*> */
+	bool quit;
+
+	int wake[2]; /* pipe, the worker wakes the event loop through it */
+};
+
+void editor_sessions_init(struct editor_sessions *m, struct event_loop *el,
+	struct cal_timezone *zone, void *env,
+	void (*done)(void *env, struct editor_session *s));
+/* editors that are still open are left running */
+void editor_sessions_finish(struct editor_sessions *m);
+
+/* returns -1 if the editor could not be started */
+int editor_sessions_launch(struct editor_sessions *m, ts now,
+	const char *file, const char *argv[],
+	void (*cb)(void*, FILE*), void *ud);
+
+#endif
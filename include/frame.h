@@ -0,0 +1,58 @@
+#ifndef GUI_CALENDAR_FRAME_H
+#define GUI_CALENDAR_FRAME_H
+#include <stdint.h>
+#include <mgu/sr.h>
+#include <ds/vec.h>
+#include "rect_batch.h"
+
+/*
+ * A frame description: the draw calls of a frame, recorded without touching
+ * GL, so that it can be built on any thread. frame_submit replays it into an
+ * sr on the GL thread.
+ */
+
+/* called during frame_submit, for work that needs the GL thread */
+typedef void (*frame_deferred_fn)(void *cl, void *env, const float p[4]);
+
+enum frame_op_type {
+	FRAME_OP_PUT,
+	FRAME_OP_CLIP_PUSH,
+	FRAME_OP_CLIP_POP,
+	FRAME_OP_PRESENT,
+	FRAME_OP_DEFERRED,
+};
+struct frame_op {
+	enum frame_op_type t;
+	struct sr_spec spec; /* FRAME_OP_PUT, text is owned by the frame */
+	float p[4]; /* FRAME_OP_CLIP_PUSH and FRAME_OP_DEFERRED */
+	frame_deferred_fn fn;
+	void *env;
+};
+
+struct frame {
+	struct vec ops; /* vec<struct frame_op> */
+};
+
+void frame_init(struct frame *f);
+void frame_finish(struct frame *f);
+void frame_clear(struct frame *f);
+
+void frame_put(struct frame *f, struct sr_spec spec);
+void frame_clip_push(struct frame *f, const float p[4]);
+void frame_clip_pop(struct frame *f);
+void frame_present(struct frame *f);
+void frame_defer(struct frame *f, frame_deferred_fn fn, void *env,
+	const float p[4]);
+
+/* moves the ops of src to the end of dst, src is left empty */
+void frame_append(struct frame *dst, struct frame *src);
+
+/*
+ * Replays the ops into sr and clears the frame. If rb is not NULL, SR_RECT
+ * puts are drawn with it, one draw call per layer: below everything else
+ * up to the FRAME_OP_PRESENT that ends the layer, above the layers before.
+ */
+void frame_submit(struct frame *f, struct sr *sr, struct rect_batch *rb,
+	uint32_t viewport[2], void *cl);
+
+#endif
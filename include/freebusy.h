@@ -0,0 +1,39 @@
+#ifndef GUI_CALENDAR_FREEBUSY_H
+#define GUI_CALENDAR_FREEBUSY_H
+#include <stdbool.h>
+#include <ds/vec.h>
+
+#include "datetime.h"
+
+/*
+ * The busy time of one calendar as sorted intervals that neither overlap
+ * nor touch. The intervals in a range are found by binary search and read
+ * in order, so a query is O(log n + k).
+ */
+struct busy_list {
+	struct vec v; /* vec<struct ts_ran> */
+};
+
+void busy_list_init(struct busy_list *bl);
+void busy_list_finish(struct busy_list *bl);
+void busy_list_clear(struct busy_list *bl);
+/* merges the n intervals of ivs, sorted by fr, possibly overlapping. empty
+ * ones are skipped */
+void busy_list_add(struct busy_list *bl, const struct ts_ran *ivs, int n);
+/* appends the busy time in ran to out, a vec<struct ts_ran>, clipped */
+void busy_list_range(const struct busy_list *bl, struct ts_ran ran,
+	struct vec *out);
+
+enum freebusy_mode {
+	FREEBUSY_NONE,
+	FREEBUSY_ANY, /* busy in any of the lists, the union */
+	FREEBUSY_ALL, /* busy in all of them, the intersection */
+	FREEBUSY_FREE, /* free in all of them, the complement of the union */
+};
+/* the time in ran of mode over the n lists, appended to out in the same
+ * form as a busy_list. each list is searched once, then what they have in
+ * ran is merged one list at a time */
+void freebusy_query(const struct busy_list *bls, int n,
+	enum freebusy_mode mode, struct ts_ran ran, struct vec *out);
+
+#endif
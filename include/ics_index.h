@@ -0,0 +1,71 @@
+#ifndef GUI_CALENDAR_ICS_INDEX_H
+#define GUI_CALENDAR_ICS_INDEX_H
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <time.h>
+#include <ds/vec.h>
+#include <ds/hashmap.h>
+
+#include "datetime.h"
+
+/*
+ * Byte ranges of the top level components of the .ics files of a
+ * calendar, recorded when they are loaded. An edit can then replace a
+ * single component without reparsing and reserializing the whole file.
+ */
+
+struct ics_span {
+	struct str uid; /* empty if the component has none, eg. VTIMEZONE */
+	ts recurrence_id; /* -1 for the base component */
+	long off, len;
+};
+
+struct ics_file {
+	struct str path;
+	bool valid;
+	/* the file is only spliced if it still looks like when indexed */
+	off_t size;
+	struct timespec mtime;
+	bool crlf; /* the lines end in \r\n, spliced data is written so too */
+	struct vec spans; /* vec<struct ics_span>, in file order */
+};
+
+struct ics_index {
+	struct vec files; /* vec<struct ics_file> */
+	struct hashmap files_map; /* hashmap<int> */
+};
+
+void ics_index_init(struct ics_index *ix);
+void ics_index_finish(struct ics_index *ix);
+/* heap bytes held by the index, without the map of the paths */
+size_t ics_index_footprint(const struct ics_index *ix);
+
+/* (re)indexes an open .ics file from its current position; recurrence
+ * ids are left at -1 for the caller to fill in. returns NULL if the
+ * layout of the file is not understood */
+struct ics_file *ics_index_scan(struct ics_index *ix, const char *path,
+	FILE *f);
+void ics_index_forget(struct ics_index *ix, const char *path);
+
+/* returns NULL if path is not indexed, or it was changed since */
+struct ics_file *ics_index_get(struct ics_index *ix, const char *path);
+
+/* returns -1 if not found */
+int ics_file_find(struct ics_file *file, const char *uid, ts recurrence_id);
+/* returns the bytes of span idx, NULL on error */
+char *ics_file_read_span(struct ics_file *file, int idx);
+
+/* replaces span idx with data, or inserts data after it */
+struct ics_splice {
+	int idx;
+	bool insert;
+	const char *data;
+	ts recurrence_id; /* of the inserted component */
+};
+/* applies the splices in a single atomic rewrite of the file and keeps
+ * the index up to date. at most one replacement per span. the line
+ * endings of the data are changed to the ones of the file. sorts sp */
+int ics_file_apply(struct ics_file *file, struct ics_splice *sp, int n);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef GUI_CALENDAR_JOURNAL_H
+#define GUI_CALENDAR_JOURNAL_H
+#include <stdio.h>
+#include <stdbool.h>
+#include <ds/vec.h>
+
+#include "calendar.h"
+#include "editor.h"
+
+/*
+ * Append-only log of the edits that are already applied in memory, but
+ * not yet written to storage. journal_flush writes them out with one
+ * atomic rewrite per file and empties the log. Whatever a crash leaves in
+ * it is replayed the next time it is flushed.
+ */
+struct journal {
+	struct str path;
+	FILE *f;
+};
+
+/* returns -1 if the journal can't be opened */
+int journal_open(struct journal *j, const char *path);
+void journal_close(struct journal *j);
+/* $XDG_STATE_HOME/smuc/<name>, creating the directories */
+bool state_file_path(struct str *path, const char *name);
+bool journal_default_path(struct str *path);
+
+int journal_append(struct journal *j, struct edit_spec *es,
+	struct calendar *cal);
+/* es[i] goes to cals[i]. the batch is replayed either as a whole, or not
+ * at all */
+int journal_append_batch(struct journal *j, struct edit_spec **es,
+	struct calendar **cals, int n);
+bool journal_empty(struct journal *j);
+
+/* writes the journaled edits to the calendars in cals, a
+ * vec<struct calendar>. with replay, they are first applied in memory,
+ * except the ones that storage already has. returns the number of edits
+ * that could not be written, these stay in the journal together with the
+ * rest of their batch */
+int journal_flush(struct journal *j, struct vec *cals, bool replay);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef GUI_CALENDAR_PNG_IMAGE_H
+#define GUI_CALENDAR_PNG_IMAGE_H
+#include <stdint.h>
+
+/*
+ * Minimal 8 bit RGBA png files, for frame dumps. The image data is stored
+ * without compression, and only such files can be read back.
+ */
+struct png_image {
+	int w, h;
+	uint8_t *rgba; /* w * h * 4 bytes, rows from the top */
+};
+
+int png_image_write(const struct png_image *img, const char *path);
+/* returns -1 if the file is missing or was not written by png_image_write */
+int png_image_read(struct png_image *img, const char *path);
+void png_image_finish(struct png_image *img);
+
+#endif
@@ -6,6 +6,7 @@
 #include <ds/vec.h>
 
 #include "datetime.h"
+#include "rstr.h"
 
 enum prop_status {
 	PROP_STATUS_TENTATIVE,
@@ -30,6 +31,16 @@ struct prop_related_to {
 	struct str uid;
 };
 
+/* immutable, shared between the props that hold it */
+struct props_list {
+	atomic_int ref;
+	int n;
+	struct props_list_item {
+		enum prop_reltype reltype; /* only for related_to */
+		struct rstr *s;
+	} items[];
+};
+
 struct props;
 
 /* Search for these comments in the code to get an idea of places you probably
@@ -51,10 +62,10 @@ struct props;
 	m(struct prop_related_to, related_to, RELATED_TO) \
 	m(struct str, categories, CATEGORIES)
 #define PROPS_LIST_STR(m) \
-	m(struct str, color, COLOR) \
-	m(struct str, summary, SUMMARY) \
-	m(struct str, location, LOCATION) \
-	m(struct str, desc, DESC)
+	m(struct rstr *, color, COLOR) \
+	m(struct rstr *, summary, SUMMARY) \
+	m(struct rstr *, location, LOCATION) \
+	m(struct rstr *, desc, DESC)
 #define PROPS_LIST_ALL(m) \
 	PROPS_LIST_BY_VAL(m) \
 	PROPS_LIST_VEC(m) \
@@ -66,10 +77,15 @@ struct props;
 PROPS_LIST_BY_VAL(DECL)
 #undef DECL
 
+/* number of items, the lists are read one item at a time */
 #define DECL(type, name, capname) \
-	const struct vec * props_get_##name(const struct props *p);
+	int props_get_##name##_n(const struct props *p);
 PROPS_LIST_VEC(DECL)
 #undef DECL
+const char *props_get_category(const struct props *p, int i);
+/* returns the uid of item i */
+const char *props_get_related_to_uid(const struct props *p, int i,
+	enum prop_reltype *reltype);
 
 #define DECL(type, name, capname) \
 	const char * props_get_##name(const struct props *p);
@@ -82,6 +98,7 @@ PROPS_LIST_STR(DECL)
 PROPS_LIST_BY_VAL(DECL)
 #undef DECL
 
+/* takes ownership of the vec<type> */
 #define DECL(type, name, capname) \
 	void props_set_##name(struct props *p, struct vec val);
 PROPS_LIST_VEC(DECL)
@@ -102,12 +119,12 @@ enum prop {
 
 /* struct props */
 #define FIELD(type, name, capname) type name;
-#define FIELD_VEC(type, name, capname) struct vec name;
+#define FIELD_VEC(type, name, capname) struct props_list *name;
 #define FIELD_HAS(type, name, capname) bool has_##name : 1;
 struct props {
 	PROPS_LIST_BY_VAL(FIELD)
-	PROPS_LIST_VEC(FIELD_VEC)
-	PROPS_LIST_STR(FIELD)
+	PROPS_LIST_VEC(FIELD_VEC) /* NULL if empty */
+	PROPS_LIST_STR(FIELD) /* NULL if not set */
 
 	uint32_t color_val;
 
@@ -141,13 +158,23 @@ void props_apply_mask(struct props *p, const struct props_mask *pm);
 /* Returns a mask representing the properties set in p. */
 struct props_mask props_get_mask(const struct props *p);
 
+/* strings and lists of rhs are shared, not copied */
 void props_union(struct props *p, const struct props *rhs);
 void props_finish(struct props *p);
+/* heap bytes held by the properties of p */
+size_t props_footprint(const struct props *p);
 
 /* exact equality on the set of properties pm */
 bool props_equal(const struct props *a, const struct props *b,
 	const struct props_mask *pm);
 
+/* counters of props_union, for benchmarks */
+struct props_stats {
+	long long unions;
+	long long shared_bytes; /* what deep copies would have allocated */
+};
+struct props_stats props_get_stats();
+
 /* calculated values */
 uint32_t props_get_color_val(struct props *p);
 
@@ -0,0 +1,27 @@
+#ifndef GUI_CALENDAR_RECT_BATCH_H
+#define GUI_CALENDAR_RECT_BATCH_H
+#include <stdint.h>
+#include <mgu/gl.h>
+#include <ds/vec.h>
+
+/*
+ * Solid rectangles of a whole frame in one vertex buffer, drawn with a
+ * single draw call. Rects are clipped on the CPU as they are put, so a
+ * clip does not break the batch.
+ */
+struct rect_batch {
+	GLuint prog, vbo;
+	GLint u_size;
+	struct vec verts; /* vec<struct rect_vert> */
+};
+
+int rect_batch_init(struct rect_batch *rb);
+void rect_batch_finish(struct rect_batch *rb);
+
+/* p and clip are { x, y, w, h } in pixels, clip can be NULL */
+void rect_batch_put(struct rect_batch *rb, const float p[4], uint32_t argb,
+	const float clip[4]);
+/* draws the rects put since the last draw, in order */
+void rect_batch_draw(struct rect_batch *rb, uint32_t viewport[2]);
+
+#endif
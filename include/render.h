@@ -2,9 +2,11 @@
 #define GUI_CALENDAR_RENDER_H
 #include <mgu/gl.h>
 #include <mgu/win.h>
+#include <pthread.h>
 #include <ds/vec.h>
 
 struct app;
+struct todo_row;
 
 struct w_sidebar {
 	struct vec cal_texts; /* vec<struct mgu_texture> */
@@ -17,6 +19,32 @@ struct w_sidebar {
 void w_sidebar_init(struct w_sidebar *w, struct app *app);
 void w_sidebar_finish(struct w_sidebar *w);
 
+void todo_row_finish(struct todo_row *row);
+
+/* upper bound on the threads laying out calendar slices, the render
+ * thread included */
+#define LAYOUT_MAX_THREADS 8
+
+/*
+ * Threads laying out calendar slices, started once with the app. They
+ * sleep until render_application posts the slices of a frame, which they
+ * then lay out together with the render thread.
+ */
+struct layout_pool {
+	pthread_t threads[LAYOUT_MAX_THREADS - 1];
+	int n;
+	pthread_mutex_t mutex;
+	pthread_cond_t posted; /* a job was posted, or quit */
+	pthread_cond_t done; /* busy dropped to 0 */
+	/* guarded by mutex */
+	void *job;
+	unsigned gen; /* bumped for each job */
+	int busy; /* workers still on the job */
+	bool quit;
+};
+void layout_pool_init(struct layout_pool *p);
+void layout_pool_finish(struct layout_pool *p);
+
 struct float4 {
 	union {
 		float a[4];
@@ -28,5 +56,8 @@ typedef struct {
 } box;
 
 bool render_application(void *env, struct mgu_win_surf *surf, uint64_t t);
+/* renders the app at size into the current GL framebuffer, app->out
+ * must be set */
+void render_frame(struct app *app, uint32_t size[2]);
 
 #endif
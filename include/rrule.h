@@ -0,0 +1,56 @@
+#ifndef GUI_CALENDAR_RRULE_H
+#define GUI_CALENDAR_RRULE_H
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "datetime.h"
+
+/*
+ * The common subset of RRULE: FREQ=DAILY/WEEKLY/MONTHLY/YEARLY with
+ * INTERVAL, COUNT, UNTIL, WKST, BYDAY (ordinals only for MONTHLY) and
+ * BYMONTHDAY (only for MONTHLY). Instances are generated on wall clock
+ * days and converted with the transition table of the zone, the way
+ * libical's iterator would produce them. Other rules are left to libical.
+ */
+
+#define RRULE_MAX_BYDAY_POS 8
+#define RRULE_MAX_BYMONTHDAY 31
+
+enum rrule_freq {
+	RRULE_DAILY,
+	RRULE_WEEKLY,
+	RRULE_MONTHLY,
+	RRULE_YEARLY
+};
+
+struct rrule {
+	enum rrule_freq freq;
+	int interval;
+	int count; /* 0 if unlimited */
+	ts until; /* -1 if unlimited, inclusive */
+	int wkst; /* 0 is sunday */
+	uint8_t byday; /* bit i is set for weekday i without ordinal */
+	uint8_t byday_pos_n, bymonthday_n;
+	struct rrule_byday_pos { int8_t pos, wday; }
+		byday_pos[RRULE_MAX_BYDAY_POS];
+	int8_t bymonthday[RRULE_MAX_BYMONTHDAY]; /* negative from the end */
+	struct simple_date start; /* wall clock time of DTSTART */
+	struct cal_timezone *zone; /* not owned */
+};
+
+struct rrule_iter {
+	const struct rrule *r;
+	int start_day, time; /* of r->start, days since the epoch */
+	int period; /* next period to fill, in units of the interval */
+	int days[31]; /* candidate days of the current period */
+	int n, i;
+	int empty; /* consecutive periods without candidates */
+	int emitted;
+	bool done;
+};
+
+void rrule_iter_init(struct rrule_iter *it, const struct rrule *r);
+/* next instance in increasing order, -1 after the last one */
+ts rrule_iter_next(struct rrule_iter *it);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef GUI_CALENDAR_RSTR_H
+#define GUI_CALENDAR_RSTR_H
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/*
+ * Immutable refcounted strings. A copy only takes a reference. Interned
+ * strings are also shared between owners that set them independently,
+ * which pays off for values that repeat a lot, like colors and
+ * categories. The functions are thread safe, NULL is a valid empty rstr.
+ */
+struct rstr {
+	atomic_int ref;
+	bool interned;
+	int len;
+	char s[];
+};
+
+struct rstr *rstr_new(const char *s);
+/* equal strings give the same rstr while it has owners */
+struct rstr *rstr_intern(const char *s);
+struct rstr *rstr_ref(struct rstr *r);
+void rstr_unref(struct rstr *r);
+/* "" for NULL */
+const char *rstr_cstr(const struct rstr *r);
+/* the bytes of r divided by its number of owners */
+size_t rstr_footprint(const struct rstr *r);
+
+#endif
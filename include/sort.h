@@ -0,0 +1,122 @@
+#ifndef GUI_CALENDAR_SORT_H
+#define GUI_CALENDAR_SORT_H
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.h"
+
+/*
+ * Sort routines specialized for one element type, so that elements are
+ * moved by assignment and the comparison can be inlined.
+ *
+ * SORT_DEFINE(name, type, lt) defines static void name(type *a, int n),
+ * an introsort that is not stable. SORT_DEFINE_STABLE defines the same
+ * as a merge sort that keeps the order of equal elements, and allocates
+ * n / 2 elements. lt(const type *a, const type *b) must be a strict weak
+ * ordering, usually a macro.
+ */
+
+/* runs up to this length are insertion sorted */
+#define SORT_INSERTION_MAX 16
+
+#define SORT_SWAP_(type, x, y) do { type t_ = (x); (x) = (y); (y) = t_; } \
+	while (0)
+
+#define SORT_INSERTION_(name, type, lt) \
+static void name##_insertion(type *a, int n) { \
+	for (int i = 1; i < n; ++i) { \
+		type x = a[i]; \
+		int j = i; \
+		for (; j > 0 && lt(&x, &a[j - 1]); --j) a[j] = a[j - 1]; \
+		a[j] = x; \
+	} \
+}
+
+#define SORT_DEFINE(name, type, lt) \
+SORT_INSERTION_(name, type, lt) \
+static void name##_sift(type *a, int root, int n) { \
+	for (;;) { \
+		int c = 2 * root + 1; \
+		if (c >= n) return; \
+		if (c + 1 < n && lt(&a[c], &a[c + 1])) ++c; \
+		if (!lt(&a[root], &a[c])) return; \
+		SORT_SWAP_(type, a[root], a[c]); \
+		root = c; \
+	} \
+} \
+static void name##_heap(type *a, int n) { \
+	for (int i = n / 2 - 1; i >= 0; --i) name##_sift(a, i, n); \
+	for (int i = n - 1; i > 0; --i) { \
+		SORT_SWAP_(type, a[0], a[i]); \
+		name##_sift(a, 0, i); \
+	} \
+} \
+static void name##_intro(type *a, int n, int depth) { \
+	while (n > SORT_INSERTION_MAX) { \
+		/* too many bad pivots, heapsort is O(n log n) */ \
+		if (depth-- == 0) { \
+			name##_heap(a, n); \
+			return; \
+		} \
+		int m = (n - 1) / 2; \
+		if (lt(&a[m], &a[0])) SORT_SWAP_(type, a[m], a[0]); \
+		if (lt(&a[n - 1], &a[m])) { \
+			SORT_SWAP_(type, a[n - 1], a[m]); \
+			if (lt(&a[m], &a[0])) SORT_SWAP_(type, a[m], a[0]); \
+		} \
+		type p = a[m]; \
+		int i = -1, j = n; \
+		for (;;) { \
+			do ++i; while (lt(&a[i], &p)); \
+			do --j; while (lt(&p, &a[j])); \
+			if (i >= j) break; \
+			SORT_SWAP_(type, a[i], a[j]); \
+		} \
+		/* loop on the larger half, so the stack stays small */ \
+		int l = j + 1; \
+		if (l < n - l) { \
+			name##_intro(a, l, depth); \
+			a += l, n -= l; \
+		} else { \
+			name##_intro(a + l, n - l, depth); \
+			n = l; \
+		} \
+	} \
+	name##_insertion(a, n); \
+} \
+static void name(type *a, int n) { \
+	int depth = 0; \
+	for (int k = n; k > 1; k /= 2) depth += 2; \
+	name##_intro(a, n, depth); \
+}
+
+#define SORT_DEFINE_STABLE(name, type, lt) \
+SORT_INSERTION_(name, type, lt) \
+static void name##_merge(type *a, int n, type *buf) { \
+	if (n <= SORT_INSERTION_MAX) { \
+		name##_insertion(a, n); \
+		return; \
+	} \
+	int h = n / 2; \
+	name##_merge(a, h, buf); \
+	name##_merge(a + h, n - h, buf); \
+	if (!lt(&a[h], &a[h - 1])) return; \
+	memcpy(buf, a, sizeof(type) * h); \
+	int i = 0, j = h, k = 0; \
+	while (i < h && j < n) { \
+		if (lt(&a[j], &buf[i])) a[k++] = a[j++]; \
+		else a[k++] = buf[i++]; \
+	} \
+	while (i < h) a[k++] = buf[i++]; \
+} \
+static void name(type *a, int n) { \
+	if (n <= SORT_INSERTION_MAX) { \
+		name##_insertion(a, n); \
+		return; \
+	} \
+	type *buf = malloc_check(sizeof(type) * (n / 2)); \
+	name##_merge(a, n, buf); \
+	free(buf); \
+}
+
+#endif
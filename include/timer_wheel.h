@@ -0,0 +1,50 @@
+#ifndef GUI_CALENDAR_TIMER_WHEEL_H
+#define GUI_CALENDAR_TIMER_WHEEL_H
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "datetime.h"
+
+/*
+ * Hierarchical timer wheel with a resolution of one second. Level l has
+ * 64 slots of 64^l seconds, a timer sits at the lowest level at which it
+ * is in the current turn of the wheel, and moves down as the wheel gets
+ * close to it. Adding and removing are O(1), advancing visits only the
+ * occupied slots.
+ */
+
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 7
+
+struct timer_wheel_node {
+	ts t;
+	struct timer_wheel_node *prev, *next;
+	int level, slot; /* level is -1 if not in a wheel */
+};
+
+struct timer_wheel {
+	ts now; /* the timers up to now have expired */
+	int n;
+	uint64_t occupied[TIMER_WHEEL_LEVELS]; /* bit s is set if slot s is */
+	struct timer_wheel_node *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+};
+
+typedef void (*timer_wheel_cb)(void *cl, struct timer_wheel_node *n);
+
+void timer_wheel_init(struct timer_wheel *w, ts now);
+/* false, and n is left out, if n->t is not after now or too far after */
+bool timer_wheel_add(struct timer_wheel *w, struct timer_wheel_node *n);
+void timer_wheel_remove(struct timer_wheel *w, struct timer_wheel_node *n);
+static inline bool timer_wheel_contains(const struct timer_wheel_node *n) {
+	return n->level >= 0;
+}
+/* removes the timers up to to and calls cb for them in order of time. cb
+ * may free the node, but must not change the wheel */
+void timer_wheel_advance(struct timer_wheel *w, ts to, timer_wheel_cb cb,
+	void *cl);
+/* no timer is before this, -1 if empty. may be early, advancing to it
+ * moves the timers down a level */
+ts timer_wheel_next(const struct timer_wheel *w);
+
+#endif
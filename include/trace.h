@@ -0,0 +1,31 @@
+#ifndef GUI_CALENDAR_TRACE_H
+#define GUI_CALENDAR_TRACE_H
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Always on scope tracing. Finished scopes go into a global ring buffer
+ * that keeps the last TRACE_RING_N of them, from any thread. Names must
+ * be string literals (or otherwise outlive the ring). Reading is safe
+ * while other threads trace, scopes being written are left out.
+ */
+#define TRACE_RING_N 16384
+
+struct trace_scope {
+	const char *name;
+	uint64_t fr;
+};
+
+/* monotonic clock in nanoseconds */
+uint64_t trace_now();
+
+struct trace_scope trace_begin(const char *name);
+void trace_end(struct trace_scope sc);
+
+/* total duration of the scopes called name that started in [fr, to) */
+uint64_t trace_sum(const char *name, uint64_t fr, uint64_t to);
+
+/* writes the ring in the chrome trace event format (chrome://tracing) */
+void trace_dump_chrome(FILE *f);
+
+#endif
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include <ds/vec.h>
 
 #include "algo.h"
@@ -11,24 +12,53 @@
 int os_create_anonymous_file(off_t size);
 char* create_tmpfile_template();
 int set_cloexec_or_close(int fd);
+
+/* replaces path atomically: write to f, then atomic_write_end renames the
+ * temporary file over path, or removes it if !ok or writing failed */
+struct atomic_write {
+	FILE *f;
+	char *tmp;
+};
+int atomic_write_begin(struct atomic_write *aw, const char *path);
+int atomic_write_end(struct atomic_write *aw, const char *path, bool ok);
 uint32_t lookup_color(const char *name, size_t len);
 char *str_dup(const char *s);
 void trim_end(char *s);
 void generate_uid(char buf[64]);
 const char * most_frequent(const struct vec *source, const char *(*cb)(void*));
 void vec_sort(struct vec *v, sort_lt lt, void *cl);
+/* heap bytes held by the buffer, not by what the items point to */
+size_t vec_footprint(const struct vec *v);
+size_t str_footprint(const struct str *s);
 struct str str_wordexp(const char *in);
 uint32_t hex2uint(const char *hex);
 
 /* subprocess stuff */
 void subprocess_shell(const char *cmd, const char *const argv[]);
+/* a shell that stays around and runs cmd in the background for every line
+ * it is sent, with the line as $1. saves forking the whole application */
+struct subprocess_notifier {
+	char *cmd; /* the one the shell runs, NULL if it is not running */
+	pid_t pid;
+	int fd; /* its stdin */
+};
+void subprocess_notifier_init(struct subprocess_notifier *n);
+/* (re)starts the shell if it exited or cmd changed. returns -1 if the
+ * lines could not be sent */
+int subprocess_notifier_send(struct subprocess_notifier *n, const char *cmd,
+	const char *const *lines, int n_lines);
+void subprocess_notifier_finish(struct subprocess_notifier *n);
 struct subprocess_handle {
 	int pidfd;
-	char *name;
+	char *name; /* the path the editor got */
 };
+/* {file} in argv is replaced by the path of the file cb writes */
 struct subprocess_handle* subprocess_new_input(const char *file,
 		const char *argv[], void (*cb)(void*, FILE*), void *ud);
+/* call once the process exited, frees the handle */
 FILE *subprocess_get_result(struct subprocess_handle **handle);
+/* frees the handle of a process that is left running */
+void subprocess_abandon(struct subprocess_handle **handle);
 
 #define container_of(ptr, type, member) \
     (type *)((char *)(ptr) - offsetof(type, member))
@@ -12,6 +12,8 @@ enum slicing_type {
 struct slicing;
 struct slicing *slicing_create(struct cal_timezone *zone);
 void slicing_destroy(struct slicing *s);
+/* heap bytes held by the cache of slices */
+size_t slicing_footprint(const struct slicing *s);
 void slicing_iter_items(struct slicing *s, void *env,
 	void (*f)(void *env, struct ts_ran ran, struct simple_date label),
 	enum slicing_type type, struct ts_ran ran);
@@ -0,0 +1,623 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include "application.h"
+#include "calendar.h"
+#include "datetime.h"
+#include "algo.h"
+#include "views.h"
+#include "editor.h"
+#include "uexpr.h"
+#include "trace.h"
+#include "core.h"
+#include "util.h"
+#include "sort.h"
+#include "timer_wheel.h"
+
+/*
+ * Times the stages between the calendar files and the screen on the given
+ * calendars, and writes one json object per stage and line. Each stage is
+ * run on the result of the previous one, every iteration from scratch.
+ */
+
+struct timing {
+	uint64_t min, max, sum;
+	int n;
+};
+static void timing_add(struct timing *t, uint64_t fr) {
+	uint64_t d = trace_now() - fr;
+	if (t->n == 0 || d < t->min) t->min = d;
+	if (d > t->max) t->max = d;
+	t->sum += d;
+	++t->n;
+}
+
+struct bench {
+	int iters;
+	struct ts_ran ran;
+	struct cal_timezone *zone;
+	const char *label;
+	FILE *out;
+
+	/* only the parts projections and filters look at are set up */
+	struct app app;
+	struct vec items; /* vec<struct proj_item>, what the projection got */
+};
+
+static void report(struct bench *b, const char *name, struct timing t,
+		long long items) {
+	fprintf(b->out, "{\"bench\":\"%s\",\"label\":\"%s\",\"iters\":%d,"
+		"\"items\":%lld,\"min_ns\":%" PRIu64 ",\"mean_ns\":%" PRIu64
+		",\"max_ns\":%" PRIu64 "}\n",
+		name, b->label, t.n, items, t.min, t.sum / (uint64_t)t.n,
+		t.max);
+	fflush(b->out);
+}
+
+static void items_add(void *self, struct proj_item pi) {
+	struct bench *b = self;
+	vec_append(&b->items, &pi);
+}
+static void items_clear(void *self) {
+	struct bench *b = self;
+	vec_clear(&b->items);
+}
+
+static void free_cis(struct app *app) {
+	for (int i = 0; i < app->cis.len; ++i) {
+		struct comp_inst **ci = vec_get(&app->cis, i);
+		free_tagged(MEM_TAG_INST, *ci, sizeof(struct comp_inst));
+	}
+	vec_clear(&app->cis);
+}
+static void set_dirty(struct app *app) {
+	for (int i = 0; i < app->cals.len; ++i) {
+		struct calendar *cal = vec_get(&app->cals, i);
+		for (int t = 0; t < COMP_TYPE_N; ++t) cal->cis_dirty[t] = true;
+	}
+}
+
+static void bench_ingest(struct bench *b, char **paths, int n) {
+	struct timing t = { 0 };
+	long long comps = 0;
+	for (int it = 0; it < b->iters; ++it) {
+		bool keep = it == b->iters - 1;
+		uint64_t fr = trace_now();
+		for (int i = 0; i < n; ++i) {
+			struct calendar cal;
+			calendar_init(&cal);
+			cal.storage = str_new_from_cstr(paths[i]);
+			update_calendar_from_storage(&cal, b->zone);
+			if (keep) {
+				comps += cal.comps_vec.len;
+				vec_append(&b->app.cals, &cal);
+			} else {
+				calendar_finish(&cal);
+			}
+		}
+		timing_add(&t, fr);
+	}
+	report(b, "ingest", t, comps);
+}
+
+static void bench_expand(struct bench *b) {
+	struct timing t = { 0 };
+	long long n = 0;
+	for (int it = 0; it < b->iters; ++it) {
+		set_dirty(&b->app);
+		uint64_t fr = trace_now();
+		for (int i = 0; i < b->app.cals.len; ++i) {
+			struct calendar *cal = vec_get(&b->app.cals, i);
+			for (int type = 0; type < COMP_TYPE_N; ++type) {
+				calendar_expand_instances_to(cal, type,
+					b->ran.to);
+			}
+		}
+		timing_add(&t, fr);
+	}
+	for (int i = 0; i < b->app.cals.len; ++i) {
+		struct calendar *cal = vec_get(&b->app.cals, i);
+		for (int type = 0; type < COMP_TYPE_N; ++type) {
+			n += cal->cis_n[type];
+		}
+	}
+	report(b, "expand", t, n);
+}
+
+/* includes expanding, as app_update_projections does that itself */
+static void bench_projections(struct bench *b) {
+	struct timing t = { 0 };
+	for (int it = 0; it < b->iters; ++it) {
+		set_dirty(&b->app);
+		free_cis(&b->app);
+		items_clear(b);
+		uint64_t fr = trace_now();
+		app_update_projections(&b->app);
+		timing_add(&t, fr);
+	}
+	report(b, "projections", t, b->items.len);
+}
+
+static int bench_filter(struct bench *b, const char *expr) {
+	struct uexpr e;
+	uexpr_init(&e);
+	FILE *f = fmemopen((void*)expr, strlen(expr), "r");
+	asrt(f, "");
+	int root = uexpr_parse(&e, f);
+	fclose(f);
+	if (root == -1) {
+		uexpr_finish(&e);
+		return -1;
+	}
+	struct uexpr_ctx *ctx = uexpr_ctx_create();
+
+	struct timing t = { 0 };
+	long long vis = 0;
+	for (int it = 0; it < b->iters; ++it) {
+		vis = 0;
+		uint64_t fr = trace_now();
+		for (int i = 0; i < b->items.len; ++i) {
+			struct proj_item *pi = vec_get(&b->items, i);
+			struct comp_display_settings settings = {
+				.fade = false, .hide = false, .vis = true };
+			struct cal_uexpr_env env = {
+				.app = &b->app,
+				.kind = CAL_UEXPR_FILTER,
+				.pi = pi,
+				.settings = &settings,
+				.set_props = props_empty,
+				.set_edit = false
+			};
+			uexpr_ctx_set_ops(ctx, (struct uexpr_ops){
+				.env = &env,
+				.try_get_var = cal_uexpr_get,
+				.try_set_var = cal_uexpr_set
+			});
+			uexpr_eval(&e, root, ctx, NULL);
+			if (settings.vis) ++vis;
+		}
+		timing_add(&t, fr);
+	}
+	report(b, "filter", t, vis);
+
+	uexpr_ctx_destroy(ctx);
+	uexpr_finish(&e);
+	return 0;
+}
+
+static void add_day(void *env, struct ts_ran ran, struct simple_date label) {
+	vec_append(env, &ran);
+}
+static void count_item(void *env, struct ts_ran ran,
+		struct simple_date label) {
+	++*(long long *)env;
+}
+
+/* the events of each day are laid out on their own, like the renderer
+ * does. collecting them is not timed */
+static void bench_layout(struct bench *b) {
+	struct vec days = vec_new_empty(sizeof(struct ts_ran));
+	slicing_iter_items(b->app.slicing, &days, add_day, SLICING_DAY, b->ran);
+
+	struct vec buckets = vec_new_empty(sizeof(struct vec));
+	for (int d = 0; d < days.len; ++d) {
+		struct ts_ran *day = vec_get(&days, d);
+		struct vec v = vec_new_empty(sizeof(struct layout_event));
+		for (int i = 0; i < b->items.len; ++i) {
+			struct proj_item *pi = vec_get(&b->items, i);
+			if (pi->ci->c->type != COMP_TYPE_EVENT) continue;
+			struct ts_ran r = pi->ci->rdp.se_ran;
+			if (!ts_ran_overlap(r, *day)) continue;
+			struct layout_event l = { .time = r, .idx = v.len };
+			vec_append(&v, &l);
+		}
+		vec_append(&buckets, &v);
+	}
+
+	struct timing t = { 0 };
+	struct vec la = vec_new_empty(sizeof(struct layout_event));
+	long long n = 0;
+	for (int it = 0; it < b->iters; ++it) {
+		n = 0;
+		uint64_t fr = trace_now();
+		for (int d = 0; d < buckets.len; ++d) {
+			struct vec *v = vec_get(&buckets, d);
+			vec_clear(&la);
+			for (int i = 0; i < v->len; ++i) {
+				vec_append(&la, vec_get(v, i));
+			}
+			calendar_layout(la.d, la.len);
+			n += la.len;
+		}
+		timing_add(&t, fr);
+	}
+	report(b, "layout", t, n);
+
+	vec_free(&la);
+	for (int d = 0; d < buckets.len; ++d) vec_free(vec_get(&buckets, d));
+	vec_free(&buckets);
+	vec_free(&days);
+}
+
+static void bench_todo_schedule(struct bench *b) {
+	struct vec E = vec_new_empty(sizeof(struct ts_ran));
+	struct vec T = vec_new_empty(sizeof(struct schedule_todo));
+	for (int i = 0; i < b->items.len; ++i) {
+		struct proj_item *pi = vec_get(&b->items, i);
+		struct comp_inst *ci = pi->ci;
+		if (ci->c->type == COMP_TYPE_EVENT) {
+			vec_append(&E, &ci->rdp.se_ran);
+			continue;
+		}
+		struct schedule_todo td = { .start = ci->rdp.start };
+		if (!props_get_estimated_duration(ci->p,
+				&td.estimated_duration)) continue;
+		vec_append(&T, &td);
+	}
+
+	struct timing t = { 0 };
+	for (int it = 0; it < b->iters; ++it) {
+		uint64_t fr = trace_now();
+		struct ts_ran *G = todo_schedule(b->ran.fr, E.len, E.d,
+			T.len, T.d);
+		timing_add(&t, fr);
+		free(G);
+	}
+	report(b, "todo_schedule", t, T.len);
+
+	vec_free(&E);
+	vec_free(&T);
+}
+
+/* 10k todos against a year of busy working days, independent of the
+ * calendars given */
+static void bench_todo_schedule_year(struct bench *b) {
+	const int days = 365, per_day = 6, k = 10000;
+	int n = days * per_day;
+	struct ts_ran *E = malloc_check(sizeof(struct ts_ran) * n);
+	struct schedule_todo *T = malloc_check(sizeof(*T) * k);
+	uint32_t seed = 1;
+	for (int d = 0; d < days; ++d) {
+		for (int i = 0; i < per_day; ++i) {
+			seed = seed * 1103515245 + 12345;
+			ts fr = b->ran.fr + d * 86400 + 8 * 3600 + i * 5400
+				+ (seed >> 16) % 1800;
+			E[d * per_day + i] = (struct ts_ran){
+				fr, fr + 1800 + (seed >> 8) % 3600 };
+		}
+	}
+	for (int i = 0; i < k; ++i) {
+		seed = seed * 1103515245 + 12345;
+		T[i] = (struct schedule_todo){
+			.start = (seed >> 16) % 4 ? -1
+				: b->ran.fr + (seed >> 4) % (days * 86400),
+			.estimated_duration = 900 + (seed >> 8) % 14400,
+		};
+	}
+
+	struct timing t = { 0 };
+	for (int it = 0; it < b->iters; ++it) {
+		uint64_t fr = trace_now();
+		struct ts_ran *G = todo_schedule(b->ran.fr, n, E, k, T);
+		timing_add(&t, fr);
+		free(G);
+	}
+	report(b, "todo_schedule_10k", t, k);
+
+	free(T);
+	free(E);
+}
+
+static void count_fired(void *cl, struct timer_wheel_node *n) {
+	++*(long long *)cl;
+}
+/* a year of alarms: add them, move a tenth of them like an edit does, then
+ * let the wheel go through the year an hour at a time */
+static void bench_alarm_wheel(struct bench *b) {
+	const int k = 10000;
+	struct timer_wheel *w = malloc_check(sizeof(struct timer_wheel));
+	struct timer_wheel_node *nodes =
+		malloc_check(sizeof(struct timer_wheel_node) * k);
+	struct timing add = { 0 }, move = { 0 }, drain = { 0 };
+	long long fired = 0;
+	for (int it = 0; it < b->iters; ++it) {
+		uint32_t seed = 1;
+		timer_wheel_init(w, b->ran.fr);
+		uint64_t fr = trace_now();
+		for (int i = 0; i < k; ++i) {
+			seed = seed * 1103515245 + 12345;
+			nodes[i].t = b->ran.fr + 1 + seed % (365 * 86400);
+			timer_wheel_add(w, &nodes[i]);
+		}
+		timing_add(&add, fr);
+
+		fr = trace_now();
+		for (int i = 0; i < k; i += 10) {
+			timer_wheel_remove(w, &nodes[i]);
+			nodes[i].t += 900;
+			timer_wheel_add(w, &nodes[i]);
+		}
+		timing_add(&move, fr);
+
+		fired = 0;
+		fr = trace_now();
+		for (ts t = b->ran.fr; w->n > 0; t += 3600) {
+			timer_wheel_advance(w, t, count_fired, &fired);
+		}
+		timing_add(&drain, fr);
+	}
+	report(b, "alarm_wheel_add", add, k);
+	report(b, "alarm_wheel_move", move, k / 10);
+	report(b, "alarm_wheel_drain", drain, fired);
+	free(nodes);
+	free(w);
+}
+
+#define TS_LT(a, b) (*(a) < *(b))
+#define TS_RAN_LT(a, b) ((a)->fr < (b)->fr)
+SORT_DEFINE(sort_ts, ts, TS_LT)
+SORT_DEFINE_STABLE(sort_ts_ran_stable, struct ts_ran, TS_RAN_LT)
+static bool ts_lt(void *a, void *b, void *cl) {
+	return *(ts *)a < *(ts *)b;
+}
+static int ts_cmp(const void *a, const void *b) {
+	ts x = *(const ts *)a, y = *(const ts *)b;
+	return x < y ? -1 : x > y;
+}
+static bool ts_ran_lt(void *a, void *b, void *cl) {
+	return ((struct ts_ran *)a)->fr < ((struct ts_ran *)b)->fr;
+}
+
+/* the specialized sorts against the generic heapsort and qsort, on the
+ * same random input each time */
+static void bench_sort(struct bench *b) {
+	const int n = 200000;
+	ts *src = malloc_check(sizeof(ts) * n);
+	ts *a = malloc_check(sizeof(ts) * n);
+	struct ts_ran *r = malloc_check(sizeof(struct ts_ran) * n);
+	uint32_t seed = 1;
+	for (int i = 0; i < n; ++i) {
+		seed = seed * 1103515245 + 12345;
+		src[i] = b->ran.fr + seed % (365 * 86400);
+	}
+
+	struct timing t[5] = { 0 };
+	for (int it = 0; it < b->iters; ++it) {
+		memcpy(a, src, sizeof(ts) * n);
+		uint64_t fr = trace_now();
+		heapsort(a, n, sizeof(ts), &ts_lt, NULL);
+		timing_add(&t[0], fr);
+
+		memcpy(a, src, sizeof(ts) * n);
+		fr = trace_now();
+		qsort(a, n, sizeof(ts), &ts_cmp);
+		timing_add(&t[1], fr);
+
+		memcpy(a, src, sizeof(ts) * n);
+		fr = trace_now();
+		sort_ts(a, n);
+		timing_add(&t[2], fr);
+
+		for (int i = 0; i < n; ++i) r[i] = (struct ts_ran){ src[i], i };
+		fr = trace_now();
+		heapsort(r, n, sizeof(struct ts_ran), &ts_ran_lt, NULL);
+		timing_add(&t[3], fr);
+
+		for (int i = 0; i < n; ++i) r[i] = (struct ts_ran){ src[i], i };
+		fr = trace_now();
+		sort_ts_ran_stable(r, n);
+		timing_add(&t[4], fr);
+	}
+	report(b, "sort_ts_heapsort", t[0], n);
+	report(b, "sort_ts_qsort", t[1], n);
+	report(b, "sort_ts", t[2], n);
+	report(b, "sort_ran_heapsort", t[3], n);
+	report(b, "sort_ran_stable", t[4], n);
+
+	free(r);
+	free(a);
+	free(src);
+}
+
+/* cold builds the slicing of the range hour by hour, cached iterates it
+ * again */
+static void bench_slicing(struct bench *b) {
+	struct timing cold = { 0 }, cached = { 0 };
+	long long n = 0;
+	for (int it = 0; it < b->iters; ++it) {
+		struct slicing *s = slicing_create(b->zone);
+		n = 0;
+		uint64_t fr = trace_now();
+		slicing_iter_items(s, &n, count_item, SLICING_HOUR, b->ran);
+		timing_add(&cold, fr);
+
+		fr = trace_now();
+		slicing_iter_items(s, &n, count_item, SLICING_HOUR, b->ran);
+		timing_add(&cached, fr);
+		slicing_destroy(s);
+	}
+	report(b, "slicing_cold", cold, n / 2);
+	report(b, "slicing_cached", cached, n / 2);
+}
+
+/* checks an update of the summary of every comp, the way the editor does
+ * before saving it */
+static void bench_edit_check(struct bench *b) {
+	struct timing t = { 0 };
+	long long edits = 0;
+	struct props_stats fr_stats = props_get_stats();
+	for (int it = 0; it < b->iters; ++it) {
+		uint64_t fr = trace_now();
+		for (int i = 0; i < b->app.cals.len; ++i) {
+			struct calendar *cal = vec_get(&b->app.cals, i);
+			for (int k = 0; k < cal->comps_vec.len; ++k) {
+				struct comp *c = vec_get(&cal->comps_vec, k);
+				struct edit_spec es;
+				edit_spec_init(&es);
+				es.method = EDIT_METHOD_UPDATE;
+				es.type = c->type;
+				es.uid = str_copy(&c->uid);
+				props_set_summary(&es.p, "edited");
+				if (!edit_spec_is_identity(&es, cal)) {
+					edit_spec_can_apply_to_memory(&es,
+						cal);
+				}
+				edit_spec_finish(&es);
+				++edits;
+			}
+		}
+		timing_add(&t, fr);
+	}
+	report(b, "edit_check", t, edits / b->iters);
+
+	struct props_stats st = props_get_stats();
+	long long unions = st.unions - fr_stats.unions;
+	long long shared = st.shared_bytes - fr_stats.shared_bytes;
+	fprintf(b->out, "{\"bench\":\"props_union\",\"label\":\"%s\","
+		"\"per_edit\":%.2f,\"shared_bytes_per_edit\":%.1f}\n",
+		b->label, edits ? (double)unions / edits : 0.0,
+		edits ? (double)shared / edits : 0.0);
+	fflush(b->out);
+}
+
+static void report_footprint(struct bench *b) {
+	struct calendar_footprint sum = { 0 };
+	for (int i = 0; i < b->app.cals.len; ++i) {
+		struct calendar_footprint fp;
+		calendar_get_footprint(vec_get(&b->app.cals, i), &fp);
+		sum.comps += fp.comps;
+		sum.comps_bytes += fp.comps_bytes;
+		sum.props_bytes += fp.props_bytes;
+		sum.recur_bytes += fp.recur_bytes;
+		sum.clone_bytes += fp.clone_bytes;
+		sum.insts_bytes += fp.insts_bytes;
+		sum.index_bytes += fp.index_bytes;
+	}
+	int n = sum.comps > 0 ? sum.comps : 1;
+	fprintf(b->out, "{\"bench\":\"footprint\",\"label\":\"%s\","
+		"\"comps\":%d,\"bytes_per_comp\":%zu,"
+		"\"props_bytes_per_comp\":%zu}\n",
+		b->label, sum.comps, calendar_footprint_total(&sum) / n,
+		sum.props_bytes / n);
+	fflush(b->out);
+}
+
+/* YYYY-MM-DD in zone */
+static bool parse_day(const char *s, struct cal_timezone *zone, ts *out) {
+	int y, mo, d;
+	if (sscanf(s, "%d-%d-%d", &y, &mo, &d) != 3) return false;
+	*out = simple_date_to_ts(make_simple_date(y, mo, d, 0, 0, 0), zone);
+	return *out != -1;
+}
+
+int main(int argc, char **argv) {
+	const char *help =
+		"usage: smuc-bench [options] calendar...\n"
+		"-h: show this help\n"
+		"-n N: iterations of each stage (default 5)\n"
+		"-s S: start of the range, YYYY-MM-DD (default 2024-01-01)\n"
+		"-d D: length of the range in days (default 365)\n"
+		"-z Z: time zone (default Europe/Budapest)\n"
+		"-x E: filter expression (default hides cancelled events)\n"
+		"-l L: label of the results, eg. the dataset or revision\n"
+		"-o F: append the results to F instead of stdout\n";
+	const char *start = "2024-01-01";
+	const char *zone_name = "Europe/Budapest";
+	const char *expr = "{ let($fade, $st = completed); "
+		"let($vis, ~($st = cancelled)) }";
+	const char *out = NULL;
+	int days = 365;
+	struct bench b = { .iters = 5, .label = "" };
+
+	int opt;
+	while ((opt = getopt(argc, argv, "hn:s:d:z:x:l:o:")) != -1) {
+		switch (opt) {
+		case 'n': b.iters = atoi(optarg); break;
+		case 's': start = optarg; break;
+		case 'd': days = atoi(optarg); break;
+		case 'z': zone_name = optarg; break;
+		case 'x': expr = optarg; break;
+		case 'l': b.label = optarg; break;
+		case 'o': out = optarg; break;
+		case 'h':
+			printf("%s", help);
+			return 0;
+		default:
+			fprintf(stderr, "%s", help);
+			return 1;
+		}
+	}
+	if (optind == argc || b.iters <= 0 || days <= 0) {
+		fprintf(stderr, "%s", help);
+		return 1;
+	}
+
+	b.zone = cal_timezone_new(zone_name);
+	if (!parse_day(start, b.zone, &b.ran.fr)) {
+		fprintf(stderr, "%s", help);
+		cal_timezone_destroy(b.zone);
+		return 1;
+	}
+	b.ran.to = b.ran.fr;
+	ts_adjust_days(&b.ran.to, b.zone, days);
+	b.out = out ? fopen(out, "a") : stdout;
+	if (!b.out) {
+		perror("smuc-bench: fopen");
+		cal_timezone_destroy(b.zone);
+		return 1;
+	}
+
+	b.items = vec_new_empty(sizeof(struct proj_item));
+	struct app *app = &b.app;
+	app->cals = vec_new_empty(sizeof(struct calendar));
+	app->cal_infos = vec_new_empty(sizeof(struct calendar_info));
+	app->projs = vec_new_empty(sizeof(struct proj));
+	app->cis = vec_new_empty(sizeof(struct comp_inst *));
+	app->expand_to = b.ran.to;
+	app->now = b.ran.fr;
+	app->zone = b.zone;
+	app->slicing = slicing_create(b.zone);
+	struct proj items_proj = {
+		.self = &b,
+		.add = items_add,
+		.clear = items_clear,
+	};
+	vec_append(&app->projs, &items_proj);
+
+	bench_ingest(&b, argv + optind, argc - optind);
+	for (int i = 0; i < app->cals.len; ++i) {
+		struct calendar_info info = {
+			.uexpr_tag = UEXPR_STRING(argv[optind + i]),
+		};
+		vec_append(&app->cal_infos, &info);
+	}
+	bench_expand(&b);
+	bench_projections(&b);
+	int res = bench_filter(&b, expr);
+	if (res < 0) fprintf(stderr, "smuc-bench: can't parse filter\n");
+	bench_layout(&b);
+	bench_todo_schedule(&b);
+	bench_todo_schedule_year(&b);
+	bench_alarm_wheel(&b);
+	bench_sort(&b);
+	bench_slicing(&b);
+	bench_edit_check(&b);
+	report_footprint(&b);
+
+	free_cis(app);
+	vec_free(&app->cis);
+	for (int i = 0; i < app->cals.len; ++i) {
+		calendar_finish(vec_get(&app->cals, i));
+	}
+	vec_free(&app->cals);
+	vec_free(&app->cal_infos);
+	vec_free(&app->projs);
+	slicing_destroy(app->slicing);
+	vec_free(&b.items);
+	if (out) fclose(b.out);
+	cal_timezone_destroy(b.zone);
+	return res < 0 ? 1 : 0;
+}
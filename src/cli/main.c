@@ -0,0 +1,408 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "calendar.h"
+#include "datetime.h"
+#include "uexpr.h"
+#include "core.h"
+#include "util.h"
+
+/*
+ * Headless queries: loads calendars, expands their instances over a range,
+ * filters them with a uexpr and streams the result to stdout. Instances are
+ * written as they are expanded, in storage order, not sorted by time.
+ */
+
+enum format {
+	FORMAT_TSV,
+	FORMAT_JSON,
+	FORMAT_ICS,
+};
+
+struct query {
+	struct cal_timezone *zone;
+	struct ts_ran ran;
+	bool types[COMP_TYPE_N];
+	enum format format;
+	ts now;
+
+	struct uexpr uexpr;
+	int filter; /* -1 if there is none */
+	struct uexpr_ctx *ctx;
+
+	/* the instance being filtered and written */
+	struct calendar *cal;
+	struct comp *c;
+	ts recurrence_id;
+	struct recur_dep_props rdp;
+	struct props *p;
+	bool vis;
+
+	long long n_out;
+};
+
+/* filter context, see Documentation/uexpr_cal.md */
+static bool query_get(void *env, const char *key, struct uexpr_value *v) {
+	struct query *q = env;
+	struct props *p = q->p;
+	if (cal_filter_get_prop(q->c->type, p, key, v)) return true;
+	if (strcmp(key, "cal") == 0)
+		return *v = UEXPR_STRING(str_cstr(&q->cal->storage)), true;
+	if (strcmp(key, "vis") == 0)
+		return *v = UEXPR_BOOLEAN(q->vis), true;
+	if (strcmp(key, "last_mod_today") == 0) {
+		ts last_modified;
+		ts day = ts_get_day_base(q->now, q->zone, false);
+		bool in_today = props_get_last_modified(p, &last_modified)
+			&& last_modified >= day
+			&& last_modified < day + 3600 * 24;
+		return *v = UEXPR_BOOLEAN(in_today), true;
+	}
+	return false;
+}
+static bool query_set(void *env, const char *key, struct uexpr_value v) {
+	struct query *q = env;
+	if (v.type != UEXPR_TYPE_BOOLEAN) return false;
+	/* fade and hide only make sense on screen */
+	if (strcmp(key, "vis") == 0) q->vis = v.boolean;
+	else if (strcmp(key, "fade") != 0 && strcmp(key, "hide") != 0)
+		return false;
+	uexpr_value_finish(v);
+	return true;
+}
+
+/* the instance is kept if $vis stays true and the filter does not
+ * evaluate to false */
+static bool query_filter(struct query *q) {
+	if (q->filter == -1) return true;
+	q->vis = true;
+	struct uexpr_value v;
+	uexpr_eval(&q->uexpr, q->filter, q->ctx, &v);
+	bool res = q->vis
+		&& !(v.type == UEXPR_TYPE_BOOLEAN && !v.boolean);
+	uexpr_value_finish(v);
+	return res;
+}
+
+static void put_time(FILE *f, struct query *q, ts t, bool utc) {
+	if (t == -1) return;
+	if (utc) {
+		time_t tt = t;
+		struct tm tm;
+		gmtime_r(&tt, &tm);
+		fprintf(f, "%04d%02d%02dT%02d%02d%02dZ", tm.tm_year + 1900,
+			tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min,
+			tm.tm_sec);
+	} else {
+		struct simple_date sd = simple_date_from_ts(t, q->zone);
+		fprintf(f, "%04d-%02d-%02d %02d:%02d", sd.year, sd.month,
+			sd.day, sd.hour, sd.minute);
+	}
+}
+
+static void put_tsv_str(FILE *f, const char *s) {
+	for (; s && *s; ++s) {
+		switch (*s) {
+		case '\t': fputs("\\t", f); break;
+		case '\n': fputs("\\n", f); break;
+		case '\\': fputs("\\\\", f); break;
+		default: putc(*s, f); break;
+		}
+	}
+}
+static void put_json_str(FILE *f, const char *s) {
+	putc('"', f);
+	for (; s && *s; ++s) {
+		unsigned char c = *s;
+		if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+		else if (c == '\n') fputs("\\n", f);
+		else if (c < 0x20) fprintf(f, "\\u%04x", c);
+		else putc(c, f);
+	}
+	putc('"', f);
+}
+/* content line with text escaping, folded at 75 octets */
+static void put_ics_line(FILE *f, const char *name, const char *s) {
+	int col = fprintf(f, "%s:", name);
+	for (; *s; ++s) {
+		char esc[3] = { *s, '\0', '\0' };
+		if (*s == '\\' || *s == ';' || *s == ',') {
+			esc[0] = '\\', esc[1] = *s;
+		} else if (*s == '\n') {
+			esc[0] = '\\', esc[1] = 'n';
+		}
+		int len = strlen(esc);
+		/* don't split utf-8 sequences */
+		bool cont = ((unsigned char)*s & 0xC0) == 0x80;
+		if (col + len > 75 && !cont) {
+			fputs("\r\n ", f);
+			col = 1;
+		}
+		fputs(esc, f);
+		col += len;
+	}
+	fputs("\r\n", f);
+}
+
+static const char *status_ics(enum prop_status st) {
+	switch (st) {
+	case PROP_STATUS_TENTATIVE: return "TENTATIVE";
+	case PROP_STATUS_CONFIRMED: return "CONFIRMED";
+	case PROP_STATUS_CANCELLED: return "CANCELLED";
+	case PROP_STATUS_COMPLETED: return "COMPLETED";
+	case PROP_STATUS_NEEDSACTION: return "NEEDS-ACTION";
+	case PROP_STATUS_INPROCESS: return "IN-PROCESS";
+	}
+	return "";
+}
+
+static void write_tsv(FILE *f, struct query *q) {
+	bool ev = q->c->type == COMP_TYPE_EVENT;
+	enum prop_status st;
+	put_tsv_str(f, str_cstr(&q->cal->storage));
+	fprintf(f, "\t%s\t", ev ? "event" : "todo");
+	put_tsv_str(f, str_cstr(&q->c->uid));
+	fprintf(f, "\t%lld\t", q->recurrence_id);
+	put_time(f, q, q->rdp.start, false);
+	putc('\t', f);
+	put_time(f, q, ev ? q->rdp.end : q->rdp.due, false);
+	putc('\t', f);
+	if (props_get_status(q->p, &st)) fputs(cal_status_str(st), f);
+	putc('\t', f);
+	put_tsv_str(f, props_get_summary(q->p));
+	putc('\t', f);
+	put_tsv_str(f, props_get_location(q->p));
+	putc('\t', f);
+	for (int i = 0; i < props_get_categories_n(q->p); ++i) {
+		if (i > 0) putc(',', f);
+		put_tsv_str(f, props_get_category(q->p, i));
+	}
+	putc('\n', f);
+}
+
+static void write_json(FILE *f, struct query *q) {
+	bool ev = q->c->type == COMP_TYPE_EVENT;
+	enum prop_status st;
+	fputs("{\"cal\":", f);
+	put_json_str(f, str_cstr(&q->cal->storage));
+	fprintf(f, ",\"type\":\"%s\",\"uid\":", ev ? "event" : "todo");
+	put_json_str(f, str_cstr(&q->c->uid));
+	fprintf(f, ",\"instance\":%lld", q->recurrence_id);
+	if (q->rdp.start != -1) fprintf(f, ",\"start\":%lld", q->rdp.start);
+	if (ev && q->rdp.end != -1) fprintf(f, ",\"end\":%lld", q->rdp.end);
+	if (!ev && q->rdp.due != -1) fprintf(f, ",\"due\":%lld", q->rdp.due);
+	if (props_get_status(q->p, &st)) {
+		fprintf(f, ",\"status\":\"%s\"", cal_status_str(st));
+	}
+	const char *s;
+	if ((s = props_get_summary(q->p))) {
+		fputs(",\"summary\":", f);
+		put_json_str(f, s);
+	}
+	if ((s = props_get_location(q->p))) {
+		fputs(",\"location\":", f);
+		put_json_str(f, s);
+	}
+	int n_cats = props_get_categories_n(q->p);
+	if (n_cats > 0) {
+		fputs(",\"categories\":[", f);
+		for (int i = 0; i < n_cats; ++i) {
+			if (i > 0) putc(',', f);
+			put_json_str(f, props_get_category(q->p, i));
+		}
+		putc(']', f);
+	}
+	fputs("}\n", f);
+}
+
+static void write_ics(FILE *f, struct query *q) {
+	bool ev = q->c->type == COMP_TYPE_EVENT;
+	const char *comp = ev ? "VEVENT" : "VTODO";
+	enum prop_status st;
+	fprintf(f, "BEGIN:%s\r\n", comp);
+	put_ics_line(f, "UID", str_cstr(&q->c->uid));
+	if (q->recurrence_id != -1) {
+		fputs("RECURRENCE-ID:", f);
+		put_time(f, q, q->recurrence_id, true);
+		fputs("\r\n", f);
+	}
+	ts times[] = { q->rdp.start, ev ? q->rdp.end : q->rdp.due };
+	const char *names[] = { "DTSTART:", ev ? "DTEND:" : "DUE:" };
+	for (int i = 0; i < 2; ++i) {
+		if (times[i] == -1) continue;
+		fputs(names[i], f);
+		put_time(f, q, times[i], true);
+		fputs("\r\n", f);
+	}
+	if (props_get_status(q->p, &st)) {
+		fprintf(f, "STATUS:%s\r\n", status_ics(st));
+	}
+	const char *s;
+	if ((s = props_get_summary(q->p))) put_ics_line(f, "SUMMARY", s);
+	if ((s = props_get_location(q->p))) put_ics_line(f, "LOCATION", s);
+	if ((s = props_get_desc(q->p))) put_ics_line(f, "DESCRIPTION", s);
+	for (int i = 0; i < props_get_categories_n(q->p); ++i) {
+		put_ics_line(f, "CATEGORIES", props_get_category(q->p, i));
+	}
+	fprintf(f, "END:%s\r\n", comp);
+}
+
+static bool in_range(struct query *q) {
+	struct recur_dep_props *r = &q->rdp;
+	if (q->c->type == COMP_TYPE_EVENT) {
+		return r->start < q->ran.to && r->end > q->ran.fr;
+	}
+	/* todos without dates are always relevant */
+	ts fr = r->start != -1 ? r->start : r->due;
+	ts to = r->due != -1 ? r->due : r->start;
+	return fr == -1 || (fr < q->ran.to && to >= q->ran.fr);
+}
+
+static void instance_cb(void *env, ts recurrence_id,
+		struct recur_dep_props rdp, struct props *p) {
+	struct query *q = env;
+	q->recurrence_id = recurrence_id;
+	q->rdp = rdp;
+	q->p = p;
+	if (!in_range(q) || !query_filter(q)) return;
+
+	switch (q->format) {
+	case FORMAT_TSV: write_tsv(stdout, q); break;
+	case FORMAT_JSON: write_json(stdout, q); break;
+	case FORMAT_ICS: write_ics(stdout, q); break;
+	}
+	++q->n_out;
+}
+
+static void query_calendar(struct query *q, struct calendar *cal) {
+	q->cal = cal;
+	for (int i = 0; i < cal->comps_vec.len; ++i) {
+		struct comp *c = vec_get(&cal->comps_vec, i);
+		if (!q->types[c->type]) continue;
+		q->c = c;
+		comp_recur_expand(c, q->ran.to, &instance_cb, q);
+	}
+}
+
+/* YYYY-MM-DD or YYYY-MM-DDTHH:MM in the query's zone */
+static bool parse_time(const char *s, struct cal_timezone *zone, ts *out) {
+	int y, mo, d, h = 0, mi = 0, n = 0;
+	if (sscanf(s, "%d-%d-%d%n", &y, &mo, &d, &n) != 3) return false;
+	if (s[n] != '\0' && (sscanf(s + n, "T%d:%d", &h, &mi) != 2))
+		return false;
+	*out = simple_date_to_ts(make_simple_date(y, mo, d, h, mi, 0), zone);
+	return *out != -1;
+}
+
+static int load_filter(struct query *q, const char *expr, const char *path) {
+	FILE *f = path ? fopen(path, "r")
+		: fmemopen((void*)expr, strlen(expr), "r");
+	if (!f) return -1;
+	q->filter = uexpr_parse(&q->uexpr, f);
+	fclose(f);
+	if (q->filter == -1) return -1;
+	q->ctx = uexpr_ctx_create();
+	uexpr_ctx_set_ops(q->ctx, (struct uexpr_ops){
+		.env = q,
+		.try_get_var = query_get,
+		.try_set_var = query_set,
+	});
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	const char *help =
+		"usage: smuc-query [options] calendar...\n"
+		"-h: show this help\n"
+		"-f F: output format, one of tsv, json, ics (default tsv)\n"
+		"-s S: start of the range, YYYY-MM-DD[THH:MM] (default today)\n"
+		"-e E: end of the range (default 7 days after the start)\n"
+		"-t T: only instances of type T, event or todo\n"
+		"-x X: filter expression, evaluated in a filter context\n"
+		"-X P: read the filter expression from file P\n"
+		"-z Z: timezone of the dates (default UTC)\n";
+	const char *opt_s = NULL, *opt_e = NULL, *opt_x = NULL, *opt_X = NULL;
+	const char *zone_name = "UTC";
+	struct query q = {
+		.types = { true, true },
+		.format = FORMAT_TSV,
+		.filter = -1,
+	};
+
+	int opt;
+	while ((opt = getopt(argc, argv, "hf:s:e:t:x:X:z:")) != -1) {
+		switch (opt) {
+		case 'h':
+			fprintf(stderr, "%s", help);
+			return EXIT_SUCCESS;
+		case 'f':
+			if (strcmp(optarg, "tsv") == 0) q.format = FORMAT_TSV;
+			else if (strcmp(optarg, "json") == 0)
+				q.format = FORMAT_JSON;
+			else if (strcmp(optarg, "ics") == 0)
+				q.format = FORMAT_ICS;
+			else goto usage;
+			break;
+		case 's': opt_s = optarg; break;
+		case 'e': opt_e = optarg; break;
+		case 't':
+			q.types[COMP_TYPE_EVENT] = strcmp(optarg, "event") == 0;
+			q.types[COMP_TYPE_TODO] = strcmp(optarg, "todo") == 0;
+			if (!q.types[COMP_TYPE_EVENT]
+					&& !q.types[COMP_TYPE_TODO]) goto usage;
+			break;
+		case 'x': opt_x = optarg; break;
+		case 'X': opt_X = optarg; break;
+		case 'z': zone_name = optarg; break;
+		default: goto usage;
+		}
+	}
+	if (optind >= argc) goto usage;
+
+	q.zone = cal_timezone_try_new(zone_name);
+	if (!q.zone) goto usage;
+	q.now = ts_now();
+	q.ran.fr = ts_get_day_base(q.now, q.zone, false);
+	if (opt_s && !parse_time(opt_s, q.zone, &q.ran.fr)) goto usage;
+	q.ran.to = q.ran.fr + 3600 * 24 * 7;
+	if (opt_e && !parse_time(opt_e, q.zone, &q.ran.to)) goto usage;
+
+	uexpr_init(&q.uexpr);
+	if ((opt_x || opt_X) && load_filter(&q, opt_x, opt_X) != 0) {
+		fprintf(stderr, "can't parse filter expression\n");
+		return EXIT_FAILURE;
+	}
+
+	/* output is written one instance at a time, keep the syscalls few */
+	static char buf[1 << 20];
+	setvbuf(stdout, buf, _IOFBF, sizeof(buf));
+
+	if (q.format == FORMAT_ICS) {
+		fputs("BEGIN:VCALENDAR\r\nVERSION:2.0\r\n"
+			"PRODID:-//smuc//smuc-query//EN\r\n", stdout);
+	}
+	/* one calendar in memory at a time */
+	for (int i = optind; i < argc; ++i) {
+		struct calendar cal;
+		calendar_init(&cal);
+		cal.storage = str_wordexp(argv[i]);
+		update_calendar_from_storage(&cal, q.zone);
+		query_calendar(&q, &cal);
+		calendar_finish(&cal);
+	}
+	if (q.format == FORMAT_ICS) fputs("END:VCALENDAR\r\n", stdout);
+	fflush(stdout);
+	fprintf(stderr, "%lld instances\n", q.n_out);
+
+	if (q.ctx) uexpr_ctx_destroy(q.ctx);
+	uexpr_finish(&q.uexpr);
+	cal_timezone_destroy(q.zone);
+	return EXIT_SUCCESS;
+
+usage:
+	fprintf(stderr, "%s", help);
+	return EXIT_FAILURE;
+}
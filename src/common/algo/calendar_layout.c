@@ -5,6 +5,7 @@
 
 #include "core.h"
 #include "algo.h"
+#include "sort.h"
 
 struct point {
 	ts val;
@@ -12,15 +13,11 @@ struct point {
 	int index;
 };
 
-static int cmp_point(const void *pa, const void *pb) {
-	const struct point *a = pa, *b = pb;
-	ts val = a->val - b->val;
-	if (val == 0) {
-		if (!a->start && b->start) return -1;
-		if (a->start && !b->start) return 1;
-	}
-	return val < 0 ? -1 : 1;
-}
+/* ends before starts at the same time. stable, so that events starting
+ * together get their columns in the order they were given in */
+#define POINT_LT(a, b) ((a)->val < (b)->val \
+	|| ((a)->val == (b)->val && !(a)->start && (b)->start))
+SORT_DEFINE_STABLE(sort_points, struct point, POINT_LT)
 
 static int first_free_bit(uint32_t n) {
 	for (int i = 0; i < 32; ++i) {
@@ -42,7 +39,7 @@ void calendar_layout(struct layout_event *e, int N) {
 		points[2*i+1] = (struct point){
 			.val = e[i].time.to, .start = false, .index = i };
 	}
-	qsort(points, N * 2, sizeof(struct point), &cmp_point);
+	sort_points(points, N * 2);
 
 	for (int i = 0; i < N; i++) e[i].col = e[i].max_n = -1;
 
@@ -1,11 +1,16 @@
+#include <string.h>
 
 #include "algo.h"
 
+/* through a buffer, in chunks for large elements */
 static void do_swap(unsigned char *a, unsigned char *b, size_t s) {
-	for (size_t i = 0; i < s; ++i) {
-		unsigned char tmp = a[i];
-		a[i] = b[i];
-		b[i] = tmp;
+	unsigned char tmp[64];
+	while (s > 0) {
+		size_t n = s < sizeof(tmp) ? s : sizeof(tmp);
+		memcpy(tmp, a, n);
+		memcpy(a, b, n);
+		memcpy(b, tmp, n);
+		a += n, b += n, s -= n;
 	}
 }
 
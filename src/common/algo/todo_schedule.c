@@ -1,85 +1,126 @@
 #include <stdlib.h>
+#include <limits.h>
 
 #include "algo.h"
 #include "core.h"
+#include "sort.h"
 
 typedef struct ts_ran ran;
-typedef struct { ts v; bool s; int i; } point;
 
-static int cmp_point(const void *pa, const void *pb) {
-	const point *a = pa, *b = pb;
-	ts v = a->v - b->v;
-	if (v == 0) {
-		if (!a->s && b->s) return -1;
-		if (a->s && !b->s) return 1;
+/* a todo becomes schedulable at its start, but not before base */
+typedef struct { ts r; int i; } release;
+
+/* marks empty leaves of the tree, and the length of unbounded slots */
+#define NONE LLONG_MAX
+#define UNBOUNDED (LLONG_MAX - 1)
+
+#define RAN_LT(a, b) ((a)->fr < (b)->fr)
+#define RELEASE_LT(a, b) ((a)->r < (b)->r \
+	|| ((a)->r == (b)->r && (a)->i < (b)->i))
+SORT_DEFINE(sort_ran, ran, RAN_LT)
+SORT_DEFINE(sort_release, release, RELEASE_LT)
+
+/*
+ * The free time from base in the union of the n events, as sorted,
+ * disjoint intervals into F, which has room for n + 1. The last one has
+ * no end, that is F[m - 1].to == -1. Returns m.
+ */
+static int free_list(ts base, int n, const ran *E, ran *F) {
+	ran *S = malloc_check(sizeof(ran) * (n + 1));
+	for (int i = 0; i < n; ++i) S[i] = E[i];
+	sort_ran(S, n);
+	int m = 0;
+	ts a = base;
+	for (int i = 0; i < n; ++i) {
+		if (S[i].to <= a || S[i].to <= S[i].fr) continue;
+		if (S[i].fr > a) F[m++] = (ran){ a, S[i].fr };
+		a = S[i].to;
 	}
-	return v < 0 ? -1 : 1;
+	F[m++] = (ran){ a, -1 };
+	free(S);
+	return m;
 }
 
-/* b == -1 means infinity */
-static struct schedule_todo *next_todo(int *j, int k,
-		struct schedule_todo *T, ran *G, ts a, ts b) {
-	for (; *j < k; ++*j) {
-		if (G[*j].fr != -1) continue; // skip if already scheduled
-		struct schedule_todo *td = &T[*j];
-		if (td->estimated_duration <= 0) continue; // skip if no est
-		// we can schedule anything with infinite space
-		if (b == -1) return td;
-		ts l = b - max_ts(a, (ts)td->start);
-		if (td->estimated_duration > l) continue;
-		return td;
+/*
+ * Priority queue of the released todos: a tournament tree over the
+ * indices of T, each node holds the smallest estimate below it. The first
+ * todo that fits into some length is found by walking down from the root.
+ */
+struct queue {
+	int size; /* number of leaves, a power of two */
+	ts *t; /* t[1] is the root, leaf i is t[size + i] */
+};
+static void queue_set(struct queue *q, int i, ts v) {
+	int x = q->size + i;
+	q->t[x] = v;
+	for (x /= 2; x > 0; x /= 2) {
+		ts l = q->t[2 * x], r = q->t[2 * x + 1];
+		q->t[x] = l < r ? l : r;
 	}
-	return NULL;
 }
-
-/* b == -1 means infinity */
-static void schedule_slot(ts a, ts b, int k,
-		struct schedule_todo *T, ran *G, int *f) {
-	struct schedule_todo *td;
-	int j = 0; // index of todo returned by next_todo
-	while (td = next_todo(&j, k, T, G, a, b)) {
-		if (!td) break;
-		a = max_ts(a, (ts)td->start);
-		G[j] = (ran){ a, a + td->estimated_duration };
-		if (++*f == k) return;
-		a += td->estimated_duration;
+/* the smallest index with an estimate of at most len, or -1 */
+static int queue_first_fit(const struct queue *q, ts len) {
+	if (q->t[1] == NONE || q->t[1] > len) return -1;
+	int x = 1;
+	while (x < q->size) {
+		x *= 2;
+		if (q->t[x] == NONE || q->t[x] > len) ++x;
 	}
+	return x - q->size;
 }
 
 struct ts_ran * todo_schedule(ts base, int n, struct ts_ran *E,
 		int k, struct schedule_todo *T) {
 	asrt(k >= 0, "k negative");
+	asrt(n >= 0, "n negative");
 	if (k == 0) return NULL;
-	point *p = malloc_check(sizeof(point) * 2 * n);
 	ran *G = malloc_check(sizeof(ran) * k);
-	int f = 0; // number of todos scheduled
-	for (int i = 0; i < k; ++i) G[i] = (ran){ -1, -1 };
-	for (int i = 0; i < n; ++i) {
-		p[2 * i] = (point){ .v = E[i].fr, .s = true,  .i = i };
-		p[2*i+1] = (point){ .v = E[i].to, .s = false, .i = i };
+	ran *F = malloc_check(sizeof(ran) * (n + 1));
+	release *R = malloc_check(sizeof(release) * k);
+	struct queue q = { .size = 1 };
+	while (q.size < k) q.size *= 2;
+	q.t = malloc_check(sizeof(ts) * 2 * q.size);
+	for (int i = 0; i < 2 * q.size; ++i) q.t[i] = NONE;
+
+	int m = free_list(base, n, E, F);
+	int r_n = 0; // number of todos to schedule
+	for (int i = 0; i < k; ++i) {
+		G[i] = (ran){ -1, -1 };
+		if (T[i].estimated_duration <= 0) continue; // skip if no est
+		R[r_n++] = (release){ max_ts(base, T[i].start), i };
 	}
-	qsort(p, n * 2, sizeof(point), &cmp_point);
+	sort_release(R, r_n);
 
-	int d = 0; // number of current overlapping events
-	asrt(p[0].s, "p[0] start");
-	if (base < p[0].v) schedule_slot(base, p[0].v, k, T, G, &f);
-	for (int i = 0; i < 2 * n - 1; ++i) {
-		point c = p[i], cc = p[i + 1];
-		d += c.s ? 1 : -1;
-		asrt(d >= 0, "d negative");
-		if (d == 0) {
-			asrt(!c.s, "how did d become zero?");
-			asrt(cc.s, "d would become negative");
-			// here we are in a slot [c.v, cc.v)
-			ts a = max_ts(c.v, base), b = cc.v;
-			if (a > b) continue;
-			schedule_slot(a, b, k, T, G, &f);
-			if (f == k) break;
+	int f = 0; // number of todos scheduled
+	int r = 0; // number of todos released
+	for (int s = 0; s < m && f < r_n; ++s) {
+		ts a = F[s].fr, b = F[s].to;
+		for (;;) {
+			for (; r < r_n && R[r].r <= a; ++r) {
+				int i = R[r].i;
+				queue_set(&q, i, T[i].estimated_duration);
+			}
+			ts len = b == -1 ? UNBOUNDED : b - a;
+			int j = queue_first_fit(&q, len);
+			if (j != -1) {
+				G[j] = (ran){ a, a + T[j].estimated_duration };
+				a = G[j].to;
+				queue_set(&q, j, NONE);
+				++f;
+				continue;
+			}
+			// nothing fits, wait for the next release in this slot
+			if (r < r_n && (b == -1 || R[r].r < b)) {
+				a = R[r].r;
+				continue;
+			}
+			break;
 		}
 	}
-	if (f != k) schedule_slot(p[2 * n - 1].v, -1, k, T, G, &f);
-
-	free(p);
+	asrt(f == r_n, "todos left unscheduled");
 
+	free(q.t);
+	free(R);
+	free(F);
 	return G;
 }
@@ -4,10 +4,13 @@
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
 
 #include "calendar.h"
 #include "core.h"
 #include "util.h"
+#include "sort.h"
 
 void recur_dep_props_set_props(struct props *p,
 		const struct recur_dep_props *rdp) {
@@ -25,6 +28,7 @@ void comp_init(struct comp *c, struct str uid, enum comp_type type) {
 	c->uid = uid;
 	c->type = type;
 	c->p = props_empty;
+	c->alarms = vec_new_empty(sizeof(struct comp_alarm));
 	c->recur_insts = vec_new_empty(sizeof(struct comp_recur_inst));
 	c->recur = NULL;
 	c->recur_cache = vec_new_empty(sizeof(struct recur_dep_props));
@@ -33,6 +37,7 @@ void comp_init(struct comp *c, struct str uid, enum comp_type type) {
 void comp_finish(struct comp *c) {
 	str_free(&c->uid);
 	props_finish(&c->p);
+	vec_free(&c->alarms);
 	for (int i = 0; i < c->recur_insts.len; ++i) {
 		struct comp_recur_inst *cri = vec_get(&c->recur_insts, i);
 		props_finish(&cri->p);
@@ -48,8 +53,34 @@ bool comp_equal(const struct comp *a, const struct comp *b) {
 	struct props_mask pm_full = props_mask_empty;
 	pm_full._mask = ~pm_full._mask;
 	if (!props_equal(&a->p, &b->p, &pm_full)) return false;
+
+	if (a->alarms.len != b->alarms.len) return false;
+	for (int i = 0; i < a->alarms.len; ++i) {
+		const struct comp_alarm *x = vec_get_c(&a->alarms, i);
+		const struct comp_alarm *y = vec_get_c(&b->alarms, i);
+		if (x->related != y->related || x->trigger != y->trigger
+				|| x->repeat != y->repeat
+				|| x->duration != y->duration) return false;
+	}
 	return true;
 }
+ts comp_alarm_time(const struct comp_alarm *a,
+		const struct recur_dep_props *rdp, int rep) {
+	ts base = 0;
+	switch (a->related) {
+	case COMP_ALARM_ABSOLUTE:
+		break;
+	case COMP_ALARM_END:
+		base = rdp->end != -1 ? rdp->end : rdp->due;
+		if (base != -1) break;
+		/* fall through */
+	case COMP_ALARM_START:
+		base = rdp->start;
+		if (base == -1) return -1;
+		break;
+	}
+	return base + a->trigger + (ts)rep * a->duration;
+}
 bool comp_get_recur_point(struct comp *c, ts recurrence_id,
 		struct recur_dep_props *rdp_out, struct props **p_out) {
 	for (int i = 0; i < c->recur_insts.len; ++i) {
@@ -170,28 +201,168 @@ void calendar_init(struct calendar *cal) {
 	hashmap_init(&cal->comps_map, sizeof(int));
 	cal->comp_infos = vec_new_empty(sizeof(struct comp_info));
 
-	cal->cis = malloc_check(sizeof(struct rb_tree) * COMP_TYPE_N);
 	for (int i = 0; i < COMP_TYPE_N; ++i) {
-		rb_tree_init(&cal->cis[i], &interval_ops);
+		inst_index_init(&cal->cis[i]);
 		cal->cis_n[i] = 0;
 		cal->cis_dirty[i] = false;
+		cal->cis_to[i] = -1;
 	}
 
 	cal->name = str_empty;
 	cal->storage = str_empty;
+	ics_index_init(&cal->index);
 	cal->priv = false;
 	cal->loaded.tv_sec = 0; // should work...
 }
-static void cis_tree_free(struct rb_tree *T) {
-	struct rb_iter iter = rb_iter(T, RB_ITER_ORDER_POST);
-	struct rb_node *x;
-	while (rb_iter_next(&iter, &x)) {
-		struct interval_node *nx = container_of(x,
-			struct interval_node, node);
-		struct comp_inst *ci = container_of(nx,
-			struct comp_inst, node);
-		free(ci);
+void calendar_get_footprint(const struct calendar *cal,
+		struct calendar_footprint *fp) {
+	*fp = (struct calendar_footprint){ .comps = cal->comps_vec.len };
+	fp->comps_bytes = vec_footprint(&cal->comps_vec)
+		+ vec_footprint(&cal->comp_infos)
+		+ str_footprint(&cal->name) + str_footprint(&cal->storage);
+	for (int i = 0; i < cal->comps_vec.len; ++i) {
+		const struct comp *c = vec_get_c(&cal->comps_vec, i);
+		fp->comps_bytes += str_footprint(&c->uid)
+			+ vec_footprint(&c->alarms);
+		fp->props_bytes += props_footprint(&c->p)
+			+ vec_footprint(&c->recur_insts);
+		for (int j = 0; j < c->recur_insts.len; ++j) {
+			const struct comp_recur_inst *cri =
+				vec_get_c(&c->recur_insts, j);
+			fp->props_bytes += props_footprint(&cri->p);
+		}
+		fp->recur_bytes += vec_footprint(&c->recur_cache);
+		if (c->recur) {
+			size_t clone;
+			fp->recur_bytes +=
+				recurrence_footprint(c->recur, &clone);
+			fp->clone_bytes += clone;
+			if (clone) ++fp->recur_ical;
+			else ++fp->recur_native;
+		}
+	}
+	/* instances handed to the projections still count here */
+	for (int i = 0; i < COMP_TYPE_N; ++i) fp->insts += cal->cis_n[i];
+	fp->insts_bytes = fp->insts * sizeof(struct comp_inst);
+	for (int i = 0; i < COMP_TYPE_N; ++i) {
+		fp->insts_bytes += inst_index_footprint(&cal->cis[i]);
+	}
+	fp->index_bytes = ics_index_footprint(&cal->index);
+}
+size_t calendar_footprint_total(const struct calendar_footprint *fp) {
+	return fp->comps_bytes + fp->props_bytes + fp->recur_bytes
+		+ fp->clone_bytes + fp->insts_bytes + fp->index_bytes;
+}
+/* struct inst_index */
+typedef struct { ts start; int i; } inst_order;
+#define INST_ORDER_LT(a, b) ((a)->start < (b)->start \
+	|| ((a)->start == (b)->start && (a)->i < (b)->i))
+SORT_DEFINE(sort_inst_order, inst_order, INST_ORDER_LT)
+
+void inst_index_init(struct inst_index *ix) {
+	*ix = (struct inst_index){ 0 };
+}
+void inst_index_finish(struct inst_index *ix) {
+	inst_index_clear(ix);
+	free(ix->start);
+	free(ix->end);
+	free(ix->max_end);
+	free(ix->ci);
+	inst_index_init(ix);
+}
+/* new arrays of cap, with the first n of the old ones in the order of o,
+ * or as they are without o */
+static void inst_index_realloc(struct inst_index *ix, int cap,
+		const inst_order *o) {
+	ts *start = malloc_check(sizeof(ts) * cap);
+	ts *end = malloc_check(sizeof(ts) * cap);
+	ts *max_end = malloc_check(sizeof(ts) * cap);
+	struct comp_inst **ci = malloc_check(sizeof(struct comp_inst *) * cap);
+	for (int k = 0; k < ix->n; ++k) {
+		int i = o ? o[k].i : k;
+		start[k] = ix->start[i];
+		end[k] = ix->end[i];
+		ci[k] = ix->ci[i];
+		if (!o && k < ix->sorted) max_end[k] = ix->max_end[k];
+	}
+	free(ix->start);
+	free(ix->end);
+	free(ix->max_end);
+	free(ix->ci);
+	ix->start = start;
+	ix->end = end;
+	ix->max_end = max_end;
+	ix->ci = ci;
+	ix->cap = cap;
+}
+void inst_index_add(struct inst_index *ix, struct comp_inst *ci) {
+	if (ix->n == ix->cap) {
+		inst_index_realloc(ix, ix->cap ? ix->cap * 2 : 64, NULL);
 	}
+	ix->start[ix->n] = ci->rdp.start;
+	ix->end[ix->n] = ci->rdp.end;
+	ix->ci[ix->n] = ci;
+	++ix->n;
+}
+void inst_index_build(struct inst_index *ix) {
+	int n = ix->n, m = ix->sorted;
+	if (m == n) return;
+	/* the tail is sorted, then merged with the sorted head */
+	inst_order *o = malloc_check(sizeof(inst_order) * n * 2);
+	inst_order *merged = o + n;
+	for (int i = 0; i < n; ++i) o[i] = (inst_order){ ix->start[i], i };
+	sort_inst_order(o + m, n - m);
+	int a = 0, b = m, k = 0;
+	while (a < m && b < n) {
+		if (INST_ORDER_LT(&o[b], &o[a])) merged[k++] = o[b++];
+		else merged[k++] = o[a++];
+	}
+	while (a < m) merged[k++] = o[a++];
+	while (b < n) merged[k++] = o[b++];
+	inst_index_realloc(ix, ix->cap, merged);
+	free(o);
+
+	for (int i = 0; i < n; ++i) {
+		ts prev = i > 0 ? ix->max_end[i - 1] : ix->end[i];
+		ix->max_end[i] = ix->end[i] > prev ? ix->end[i] : prev;
+	}
+	ix->sorted = n;
+}
+void inst_index_clear(struct inst_index *ix) {
+	for (int i = 0; i < ix->n; ++i) {
+		free_tagged(MEM_TAG_INST, ix->ci[i], sizeof(struct comp_inst));
+	}
+	ix->n = ix->sorted = 0;
+}
+void inst_index_query(const struct inst_index *ix, struct ts_ran ran,
+		void (*cb)(void *cl, struct comp_inst *ci), void *cl) {
+	asrt(ix->sorted == ix->n, "inst index not built");
+	/* the first that starts at or after the end of ran */
+	int lo = 0, hi = ix->n;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (ix->start[mid] < ran.to) lo = mid + 1;
+		else hi = mid;
+	}
+	int to = lo;
+	/* the first that, or one before which, ends after ran starts */
+	lo = 0, hi = to;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (ix->max_end[mid] > ran.fr) hi = mid;
+		else lo = mid + 1;
+	}
+	for (int i = lo; i < to; ++i) {
+		if (ix->end[i] > ran.fr) cb(cl, ix->ci[i]);
+	}
+}
+void inst_index_take(struct inst_index *ix, struct vec *out) {
+	inst_index_build(ix);
+	for (int i = 0; i < ix->n; ++i) vec_append(out, &ix->ci[i]);
+	ix->n = ix->sorted = 0;
+}
+size_t inst_index_footprint(const struct inst_index *ix) {
+	return (size_t)ix->cap * (3 * sizeof(ts) + sizeof(struct comp_inst *));
 }
 void calendar_finish(struct calendar *cal) {
 	for (int i = 0; i < cal->comps_vec.len; ++i) {
@@ -203,12 +374,12 @@ void calendar_finish(struct calendar *cal) {
 	vec_free(&cal->comp_infos);
 
 	for (int i = 0; i < COMP_TYPE_N; ++i) {
-		cis_tree_free(&cal->cis[i]);
+		inst_index_finish(&cal->cis[i]);
 	}
-	free(cal->cis);
 
 	str_free(&cal->name);
 	str_free(&cal->storage);
+	ics_index_finish(&cal->index);
 }
 int calendar_new_comp(struct calendar *cal, struct str uid,
 		enum comp_type type) {
@@ -247,11 +418,13 @@ struct comp_recur_cb_env {
 	struct calendar *cal;
 	struct comp *c;
 	int comp_idx;
+	struct vec *buf; /* vec<struct comp_inst *>, NULL for the index */
 };
 static void comp_recur_cb_fn(void *_env, ts recurrence_id,
 		struct recur_dep_props rdp, struct props *p) {
 	struct comp_recur_cb_env *env = _env;
-	struct comp_inst *ci = malloc_check(sizeof(struct comp_inst));
+	struct comp_inst *ci =
+		malloc_tagged(MEM_TAG_INST, sizeof(struct comp_inst));
 	*ci = (struct comp_inst){
 		.c = env->c,
 		.comp_idx = env->comp_idx,
@@ -263,37 +436,176 @@ static void comp_recur_cb_fn(void *_env, ts recurrence_id,
 	enum comp_type type = env->c->type;
 	ci->node.lo = rdp.start;
 	ci->node.max_hi = ci->node.hi = rdp.end;
-	rb_insert(&env->cal->cis[type], &ci->node.node);
+	if (env->buf) {
+		vec_append(env->buf, &ci);
+		return;
+	}
+	inst_index_add(&env->cal->cis[type], ci);
 	++env->cal->cis_n[type];
 }
+/* starts over if comps were changed */
+static void calendar_expand_reset(struct calendar *cal, enum comp_type type) {
+	if (!cal->cis_dirty[type]) return;
+
+	inst_index_clear(&cal->cis[type]);
+	cal->cis_n[type] = 0;
+
+	for (int i = 0; i < cal->comps_vec.len; ++i) {
+		struct comp *c = vec_get(&cal->comps_vec, i);
+		if (c->type != type) continue;
+		if (c->recur) recurrence_reset(c->recur);
+		vec_clear(&c->recur_cache);
+		c->all_expanded = false;
+	}
+	cal->cis_dirty[type] = false;
+}
+static void calendar_expand_comp(struct calendar *cal, enum comp_type type,
+		ts to, int i, struct vec *buf) {
+	struct comp *c = vec_get(&cal->comps_vec, i);
+	if (c->type != type) return;
+	struct comp_info *info = vec_get(&cal->comp_infos, i);
+	if (info->deleted) return;
+
+	struct comp_recur_cb_env env = {
+		.cal = cal, .c = c, .comp_idx = i, .buf = buf };
+	comp_recur_expand(c, to, &comp_recur_cb_fn, &env);
+}
+static bool calendar_expanded_to(struct calendar *cal, enum comp_type type,
+		ts to) {
+	return !cal->cis_dirty[type] && to <= cal->cis_to[type];
+}
 void calendar_expand_instances_to(struct calendar *cal, enum comp_type type,
 		ts to) {
-	if (cal->cis_dirty[type]) {
-
-		/* this clears the tree */
-		cis_tree_free(&cal->cis[type]);
-		rb_tree_init(&cal->cis[type], &interval_ops);
-		cal->cis_n[type] = 0;
-
-		for (int i = 0; i < cal->comps_vec.len; ++i) {
-			struct comp *c = vec_get(&cal->comps_vec, i);
-			if (c->type != type) continue;
-			if (c->recur) recurrence_reset(c->recur);
-			vec_clear(&c->recur_cache);
-			c->all_expanded = false;
+	if (calendar_expanded_to(cal, type, to)) return;
+	calendar_expand_reset(cal, type);
+	for (int i = 0; i < cal->comps_vec.len; ++i) {
+		calendar_expand_comp(cal, type, to, i, NULL);
+	}
+	inst_index_build(&cal->cis[type]);
+	cal->cis_to[type] = to;
+}
+
+/* comps per unit of work of the parallel expansion */
+#define EXPAND_CHUNK 16
+#define EXPAND_MAX_THREADS 16
+/* below this many comps, starting threads costs more than it saves */
+#define EXPAND_PARALLEL_MIN 512
+
+struct expand_chunk {
+	struct calendar *cal;
+	int fr, to; /* comps */
+	bool main; /* a comp needs libical, expand it on the calling thread */
+	struct vec cis; /* vec<struct comp_inst *> */
+};
+struct expand_job {
+	struct vec chunks; /* vec<struct expand_chunk> */
+	enum comp_type type;
+	ts to;
+	atomic_int next;
+};
+static void expand_chunk(struct expand_job *job, struct expand_chunk *ch) {
+	for (int i = ch->fr; i < ch->to; ++i) {
+		calendar_expand_comp(ch->cal, job->type, job->to, i, &ch->cis);
+	}
+}
+static void *expand_worker(void *env) {
+	struct expand_job *job = env;
+	int k;
+	while ((k = atomic_fetch_add(&job->next, 1)) < job->chunks.len) {
+		struct expand_chunk *ch = vec_get(&job->chunks, k);
+		if (!ch->main) expand_chunk(job, ch);
+	}
+	return NULL;
+}
+static bool comp_expand_thread_safe(struct comp *c, ts to) {
+	return !c->recur || recurrence_thread_safe(c->recur, to);
+}
+/*
+ * Calendars already expanded far enough are skipped, and a little work is
+ * done on the calling thread alone. Each comp only touches itself while
+ * expanding, so the comps are split into chunks that the threads take in
+ * turn. libical is not thread safe, so the chunks with a comp that falls
+ * back to it are expanded on the calling thread, before it helps with the
+ * rest. The instances of a chunk are added to the index after all of them
+ * are done, in the order of the chunks, which is the order a sequential
+ * expansion adds them in.
+ */
+void calendars_expand_instances_to(struct vec *cals, enum comp_type type,
+		ts to, int threads) {
+	int n_comps = 0;
+	for (int j = 0; j < cals->len; ++j) {
+		struct calendar *cal = vec_get(cals, j);
+		if (calendar_expanded_to(cal, type, to)) continue;
+		n_comps += cal->comps_vec.len;
+	}
+	if (n_comps < EXPAND_PARALLEL_MIN || threads <= 1) {
+		for (int j = 0; j < cals->len; ++j) {
+			struct calendar *cal = vec_get(cals, j);
+			calendar_expand_instances_to(cal, type, to);
 		}
-		cal->cis_dirty[type] = false;
+		return;
 	}
 
-	for (int i = 0; i < cal->comps_vec.len; ++i) {
-		struct comp *c = vec_get(&cal->comps_vec, i);
-		if (c->type != type) continue;
-		struct comp_info *info = vec_get(&cal->comp_infos, i);
-		if (info->deleted) continue;
+	struct expand_job job = {
+		.chunks = vec_new_empty(sizeof(struct expand_chunk)),
+		.type = type,
+		.to = to,
+	};
+	atomic_init(&job.next, 0);
+	for (int j = 0; j < cals->len; ++j) {
+		struct calendar *cal = vec_get(cals, j);
+		if (calendar_expanded_to(cal, type, to)) continue;
+		calendar_expand_reset(cal, type);
+		cal->cis_to[type] = to;
+		int len = cal->comps_vec.len;
+		for (int i = 0; i < len; i += EXPAND_CHUNK) {
+			struct expand_chunk ch = {
+				.cal = cal,
+				.fr = i,
+				.to = mini(i + EXPAND_CHUNK, len),
+				.main = false,
+			};
+			for (int k = ch.fr; !ch.main && k < ch.to; ++k) {
+				struct comp *c = vec_get(&cal->comps_vec, k);
+				ch.main = c->type == type
+					&& !comp_expand_thread_safe(c, to);
+			}
+			ch.cis = vec_new_empty(sizeof(struct comp_inst *));
+			vec_append(&job.chunks, &ch);
+		}
+	}
 
-		struct comp_recur_cb_env env = {
-			.cal = cal, .c = c, .comp_idx = i };
-		comp_recur_expand(c, to, &comp_recur_cb_fn, &env);
+	int n = mini(job.chunks.len, mini(threads, EXPAND_MAX_THREADS));
+	pthread_t tids[EXPAND_MAX_THREADS];
+	int started = 0;
+	for (int i = 1; i < n; ++i) {
+		if (pthread_create(&tids[started], NULL,
+				expand_worker, &job) != 0) {
+			break;
+		}
+		++started;
+	}
+	for (int k = 0; k < job.chunks.len; ++k) {
+		struct expand_chunk *ch = vec_get(&job.chunks, k);
+		if (ch->main) expand_chunk(&job, ch);
+	}
+	expand_worker(&job);
+	for (int i = 0; i < started; ++i) pthread_join(tids[i], NULL);
+
+	for (int k = 0; k < job.chunks.len; ++k) {
+		struct expand_chunk *ch = vec_get(&job.chunks, k);
+		struct inst_index *ix = &ch->cal->cis[type];
+		for (int i = 0; i < ch->cis.len; ++i) {
+			inst_index_add(ix, *(struct comp_inst **)
+				vec_get(&ch->cis, i));
+		}
+		ch->cal->cis_n[type] += ch->cis.len;
+		vec_free(&ch->cis);
+	}
+	vec_free(&job.chunks);
+	for (int j = 0; j < cals->len; ++j) {
+		struct calendar *cal = vec_get(cals, j);
+		inst_index_build(&cal->cis[type]);
 	}
 }
 
@@ -347,3 +659,61 @@ bool props_valid_for_type(const struct props *p, enum comp_type type) {
 
 	return true;
 }
+
+const char * cal_status_str(enum prop_status v) {
+	switch (v) {
+	case PROP_STATUS_TENTATIVE: return "tentative";
+	case PROP_STATUS_CONFIRMED: return "confirmed";
+	case PROP_STATUS_CANCELLED: return "cancelled";
+	case PROP_STATUS_COMPLETED: return "completed";
+	case PROP_STATUS_NEEDSACTION: return "needsaction";
+	case PROP_STATUS_INPROCESS: return "inprocess";
+	default: return "";
+	}
+}
+const char * cal_class_str(enum prop_class v) {
+	switch (v) {
+	case PROP_CLASS_PRIVATE: return "private";
+	case PROP_CLASS_PUBLIC: return "public";
+	default: return "";
+	}
+}
+
+bool cal_filter_get_prop(enum comp_type type, struct props *p,
+		const char *key, struct uexpr_value *v) {
+	if (strcmp(key, "ev") == 0)
+		return *v = UEXPR_BOOLEAN(type == COMP_TYPE_EVENT), true;
+	if (strcmp(key, "sum") == 0)
+		return *v = UEXPR_STRING(props_get_summary(p)), true;
+	if (strcmp(key, "color") == 0)
+		return *v = UEXPR_STRING(props_get_color(p)), true;
+	if (strcmp(key, "loc") == 0)
+		return *v = UEXPR_STRING(props_get_location(p)), true;
+	if (strcmp(key, "desc") == 0)
+		return *v = UEXPR_STRING(props_get_desc(p)), true;
+	if (strcmp(key, "st") == 0) {
+		enum prop_status status;
+		bool has_status = props_get_status(p, &status);
+		*v = UEXPR_STRING(has_status ? cal_status_str(status) : "");
+		return true;
+	}
+	if (strcmp(key, "clas") == 0) {
+		enum prop_class class;
+		bool has_class = props_get_class(p, &class);
+		*v = UEXPR_STRING(has_class ? cal_class_str(class) : "");
+		return true;
+	}
+	if (strcmp(key, "cats") == 0) {
+		*v = (struct uexpr_value){
+			.type = UEXPR_TYPE_LIST,
+			.list = vec_new_empty(sizeof(struct uexpr_value))
+		};
+		for (int i = 0; i < props_get_categories_n(p); ++i) {
+			const char *s = props_get_category(p, i);
+			struct uexpr_value vi = UEXPR_STRING(s);
+			vec_append(&v->list, &vi);
+		}
+		return true;
+	}
+	return false;
+}
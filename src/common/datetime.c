@@ -3,20 +3,165 @@
 #include <string.h>
 
 #include <libical/ical.h>
+#include <ds/vec.h>
 
 #include "datetime.h"
 #include "core.h"
 #include "calendar.h"
 
+/* civil date arithmetic, proleptic gregorian, days relative to 1970-01-01 */
+static ts floor_div(ts a, ts b) {
+	return a / b - (a % b < 0);
+}
+static ts days_from_civil(ts y, int m, int d) {
+	y -= m <= 2;
+	ts era = floor_div(y, 400);
+	int yoe = (int)(y - era * 400);
+	int doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+	int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
+}
+static void civil_from_days(ts z, int *y, int *m, int *d) {
+	z += 719468;
+	ts era = floor_div(z, 146097);
+	int doe = (int)(z - era * 146097);
+	int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	int mp = (5 * doy + 2) / 153;
+	*d = doy - (153 * mp + 2) / 5 + 1;
+	*m = mp < 10 ? mp + 3 : mp - 9;
+	*y = (int)(yoe + era * 400) + (*m <= 2);
+}
+
+/*
+ * Out of range fields are carried over the same way icaltime_normalize
+ * does it.
+ */
+ts simple_date_to_wall(struct simple_date sd) {
+	ts carry = floor_div(sd.month - 1, 12);
+	int month = sd.month - 1 - carry * 12 + 1;
+	ts days = days_from_civil(sd.year + carry, month, 1) + sd.day - 1;
+	return days * 86400 + sd.hour * 3600LL + sd.minute * 60LL + sd.second;
+}
+struct simple_date simple_date_from_wall(ts w) {
+	ts days = floor_div(w, 86400);
+	int secs = (int)(w - days * 86400);
+	struct simple_date sd;
+	civil_from_days(days, &sd.year, &sd.month, &sd.day);
+	sd.hour = secs / 3600;
+	sd.minute = secs / 60 % 60;
+	sd.second = secs % 60;
+	return sd;
+}
+
 /* struct cal_timezone */
+
+/*
+ * The UTC offsets of the zone are sampled from libical once, in
+ * [TZ_TABLE_FR, TZ_TABLE_TO), and every conversion in this range is done
+ * with the table. Transitions are searched for with a TZ_TABLE_STEP stride,
+ * so two transitions closer than that to each other would be missed.
+ */
+#define TZ_TABLE_FR 0LL /* 1970-01-01 */
+#define TZ_TABLE_TO 4102444800LL /* 2100-01-01 */
+#define TZ_TABLE_STEP (14LL * 24 * 3600)
+
+struct tz_trans {
+	ts at; /* first UTC instant with this offset */
+	int off;
+	int is_daylight;
+};
 struct cal_timezone {
 	icaltimezone *impl;
 	char *desc;
+	struct vec trans; /* vec<struct tz_trans>, trans[0].at == TZ_TABLE_FR */
 };
-struct cal_timezone *cal_timezone_new(const char *location) {
+static struct tz_trans tz_sample(icaltimezone *impl, ts t) {
+	struct simple_date sd = simple_date_from_wall(t);
+	struct icaltimetype tt = {
+		.year = sd.year,
+		.month = sd.month,
+		.day = sd.day,
+		.hour = sd.hour,
+		.minute = sd.minute,
+		.second = sd.second
+	};
+	struct tz_trans tr = { .at = t };
+	tr.off = icaltimezone_get_utc_offset_of_utc_time(impl, &tt,
+		&tr.is_daylight);
+	return tr;
+}
+static bool tz_trans_same(struct tz_trans a, struct tz_trans b) {
+	return a.off == b.off && a.is_daylight == b.is_daylight;
+}
+static void cal_timezone_build_table(struct cal_timezone *zone) {
+	zone->trans = vec_new_empty(sizeof(struct tz_trans));
+	struct tz_trans cur = tz_sample(zone->impl, TZ_TABLE_FR);
+	vec_append(&zone->trans, &cur);
+	ts t = TZ_TABLE_FR;
+	while (t < TZ_TABLE_TO) {
+		ts next = min_ts(t + TZ_TABLE_STEP, TZ_TABLE_TO);
+		if (tz_trans_same(cur, tz_sample(zone->impl, next))) {
+			t = next;
+			continue;
+		}
+		/* bisect for the first instant of the new offset */
+		ts lo = t, hi = next;
+		while (hi - lo > 1) {
+			ts mid = lo + (hi - lo) / 2;
+			if (tz_trans_same(cur, tz_sample(zone->impl, mid))) {
+				lo = mid;
+			} else {
+				hi = mid;
+			}
+		}
+		cur = tz_sample(zone->impl, hi);
+		vec_append(&zone->trans, &cur);
+		t = hi;
+	}
+}
+static bool cal_timezone_covers(ts t) {
+	return TZ_TABLE_FR <= t && t < TZ_TABLE_TO;
+}
+static int cal_timezone_offset_at(const struct cal_timezone *zone, ts t) {
+	const struct tz_trans *tr = zone->trans.d;
+	int lo = 0, hi = zone->trans.len;
+	while (hi - lo > 1) {
+		int mid = lo + (hi - lo) / 2;
+		if (tr[mid].at <= t) lo = mid;
+		else hi = mid;
+	}
+	return tr[lo].off;
+}
+/*
+ * Resolves wall clock time the same way icaltimezone_get_utc_offset does
+ * for a time with is_daylight = 0: times in a gap get the new offset, and
+ * in the repeated hour the standard time offset is preferred.
+ */
+static ts cal_timezone_wall_to_utc(const struct cal_timezone *zone, ts w) {
+	const struct tz_trans *tr = zone->trans.d;
+	int lo = 0, hi = zone->trans.len;
+	while (hi - lo > 1) {
+		int mid = lo + (hi - lo) / 2;
+		if (tr[mid].at + mini(tr[mid].off, tr[mid - 1].off) <= w) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	int off = tr[lo].off;
+	if (lo > 0 && tr[lo].off < tr[lo - 1].off &&
+			w < tr[lo].at + tr[lo - 1].off &&
+			tr[lo].is_daylight && !tr[lo - 1].is_daylight) {
+		off = tr[lo - 1].off;
+	}
+	return w - off;
+}
+
+static struct cal_timezone *cal_timezone_from_impl(icaltimezone *impl,
+		const char *location) {
 	struct cal_timezone *zone = malloc(sizeof(struct cal_timezone));
-	zone->impl = icaltimezone_get_builtin_timezone(location);
-	asrt(zone->impl, "icaltimezone_get_builtin_timezone failed\n");
+	zone->impl = impl;
 
 	const char *tznames = icaltimezone_get_tznames(zone->impl);
 	if (!tznames) tznames = "?";
@@ -25,9 +170,43 @@ struct cal_timezone *cal_timezone_new(const char *location) {
 	snprintf(buf, l, "%s (%s)", location, tznames);
 	zone->desc = buf;
 
+	cal_timezone_build_table(zone);
+
+	return zone;
+}
+struct cal_timezone *cal_timezone_new(const char *location) {
+	icaltimezone *impl = icaltimezone_get_builtin_timezone(location);
+	asrt(impl, "icaltimezone_get_builtin_timezone failed\n");
+	return cal_timezone_from_impl(impl, location);
+}
+struct cal_timezone *cal_timezone_try_new(const char *location) {
+	icaltimezone *impl = icaltimezone_get_builtin_timezone(location);
+	return impl ? cal_timezone_from_impl(impl, location) : NULL;
+}
+
+/* vec<struct cal_timezone*>, kept until the process exits */
+static struct vec shared_zones;
+static bool shared_zones_init = false;
+struct cal_timezone *cal_timezone_get_shared(const char *location) {
+	if (!shared_zones_init) {
+		shared_zones = vec_new_empty(sizeof(struct cal_timezone*));
+		shared_zones_init = true;
+	}
+	for (int i = 0; i < shared_zones.len; ++i) {
+		struct cal_timezone **zone = vec_get(&shared_zones, i);
+		if (strcmp(icaltimezone_get_location((*zone)->impl),
+				location) == 0) {
+			return *zone;
+		}
+	}
+	icaltimezone *impl = icaltimezone_get_builtin_timezone(location);
+	if (!impl) return NULL;
+	struct cal_timezone *zone = cal_timezone_from_impl(impl, location);
+	vec_append(&shared_zones, &zone);
 	return zone;
 }
 void cal_timezone_destroy(struct cal_timezone *zone) {
+	vec_free(&zone->trans);
 	free(zone->desc);
 	free(zone);
 }
@@ -75,9 +254,10 @@ static icaltimetype simple_date_to_icaltime(struct simple_date sd) {
 	tt = icaltime_normalize(tt);
 	return tt;
 }
+/* 1 is sunday, like icaltime_day_of_week */
 static int simple_date_day_of_week(struct simple_date sd) {
-	icaltimetype t = simple_date_to_icaltime(sd);
-	return icaltime_day_of_week(t);
+	ts days = floor_div(simple_date_to_wall(sd), 86400);
+	return (int)(days + 4 - floor_div(days + 4, 7) * 7) + 1;
 }
 
 struct simple_date make_simple_date(int y, int mo, int d, int h, int m, int s) {
@@ -102,6 +282,13 @@ bool simple_date_eq(struct simple_date a, struct simple_date b) {
 }
 
 void ts_adjust_days(ts *t, struct cal_timezone *zone, int n) {
+	if (cal_timezone_covers(*t)) {
+		ts w = *t + cal_timezone_offset_at(zone, *t) + n * 86400LL;
+		if (cal_timezone_covers(w)) {
+			*t = cal_timezone_wall_to_utc(zone, w);
+			return;
+		}
+	}
 	icaltimetype tt =
 		icaltime_from_timet_with_zone((time_t)*t, false, zone->impl);
 	icaltime_adjust(&tt, n, 0, 0, 0);
@@ -109,19 +296,18 @@ void ts_adjust_days(ts *t, struct cal_timezone *zone, int n) {
 }
 
 ts ts_get_day_base(ts t, struct cal_timezone *zone, bool week) {
-	struct icaltimetype now = icaltime_current_time_with_zone(zone->impl);
+	struct simple_date now = simple_date_now(zone);
 	now.hour = now.minute = now.second = 0;
 	if (week) {
-		int dow = icaltime_day_of_week(now);
-		int adjust = -((dow - 2 + 7) % 7);
-		icaltime_adjust(&now, adjust, 0, 0, 0);
+		int dow = simple_date_day_of_week(now);
+		now.day -= (dow - 2 + 7) % 7;
+		simple_date_normalize(&now);
 	}
-	return icaltime_as_timet_with_zone(now, zone->impl);
+	return simple_date_to_ts(now, zone);
 }
 
 struct simple_date simple_date_now(struct cal_timezone *zone) {
-	struct icaltimetype tt = icaltime_current_time_with_zone(zone->impl);
-	return simple_date_from_icaltime(tt);
+	return simple_date_from_ts(ts_now(), zone);
 }
 ts ts_now() {
 	return (ts)time(NULL);
@@ -131,6 +317,10 @@ struct simple_date simple_date_from_ts(ts t, struct cal_timezone *zone) {
 	if (t == -1) {
 		return make_simple_date(-1, -1, -1, -1, -1, -1);
 	}
+	if (cal_timezone_covers(t)) {
+		ts w = t + cal_timezone_offset_at(zone, t);
+		return simple_date_from_wall(w);
+	}
 	icaltimetype tt = ts_to_icaltime(t, zone);
 	return simple_date_from_icaltime(tt);
 }
@@ -148,25 +338,22 @@ int simple_dur_to_int(struct simple_dur sdu) {
 	return sdu.d * 3600 * 24 + sdu.h * 3600 + sdu.m * 60 + sdu.s;
 }
 
+bool simple_date_to_ts_native(ts wall) {
+	/* offsets are below a day, so w - off stays in the table */
+	return TZ_TABLE_FR + 86400 <= wall && wall < TZ_TABLE_TO - 86400;
+}
 ts simple_date_to_ts(struct simple_date sd, struct cal_timezone *zone) {
 	if (!valid_simple_date(sd)) return -1;
+	ts w = simple_date_to_wall(sd);
+	if (simple_date_to_ts_native(w)) {
+		return cal_timezone_wall_to_utc(zone, w);
+	}
 	icaltimetype tt = simple_date_to_icaltime(sd);
 	return (ts)icaltime_as_timet_with_zone(tt, zone->impl);
 }
 
 void simple_date_normalize(struct simple_date *sd) {
-	struct icaltimetype tt = {
-		.year = sd->year,
-		.month = sd->month,
-		.day = sd->day,
-		.hour = sd->hour,
-		.minute = sd->minute,
-		.second = sd->second,
-		.is_date = 0,
-		.is_daylight = 0, // is this ok like this?
-	};
-	tt = icaltime_normalize(tt);
-	*sd = simple_date_from_icaltime(tt);
+	*sd = simple_date_from_wall(simple_date_to_wall(*sd));
 }
 
 int simple_date_days_in_month(struct simple_date sd) {
@@ -0,0 +1,124 @@
+#include "freebusy.h"
+#include "core.h"
+
+typedef struct ts_ran ran;
+
+void busy_list_init(struct busy_list *bl) {
+	bl->v = vec_new_empty(sizeof(ran));
+}
+void busy_list_finish(struct busy_list *bl) {
+	vec_free(&bl->v);
+}
+void busy_list_clear(struct busy_list *bl) {
+	vec_clear(&bl->v);
+}
+
+/* appends x, which starts no earlier than the last one, joined to the last
+ * one if they overlap or touch */
+static void put(struct vec *out, ran x) {
+	if (x.to <= x.fr) return;
+	if (out->len > 0) {
+		ran *last = vec_get(out, out->len - 1);
+		if (x.fr <= last->to) {
+			if (x.to > last->to) last->to = x.to;
+			return;
+		}
+	}
+	vec_append(out, &x);
+}
+
+void busy_list_add(struct busy_list *bl, const ran *ivs, int n) {
+	if (n == 0) return;
+	const ran *a = bl->v.d;
+	int na = bl->v.len;
+	struct vec out = vec_new_empty(sizeof(ran));
+	int i = 0, j = 0;
+	while (i < na || j < n) {
+		if (j == n || (i < na && a[i].fr <= ivs[j].fr)) {
+			put(&out, a[i++]);
+		} else {
+			asrt(j == 0 || ivs[j - 1].fr <= ivs[j].fr,
+				"busy intervals not sorted");
+			put(&out, ivs[j++]);
+		}
+	}
+	vec_free(&bl->v);
+	bl->v = out;
+}
+
+void busy_list_range(const struct busy_list *bl, ran r, struct vec *out) {
+	/* the first that ends after r starts */
+	int lo = 0, hi = bl->v.len;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		const ran *x = vec_get_c(&bl->v, mid);
+		if (x->to <= r.fr) lo = mid + 1;
+		else hi = mid;
+	}
+	for (int i = lo; i < bl->v.len; ++i) {
+		const ran *x = vec_get_c(&bl->v, i);
+		if (x->fr >= r.to) break;
+		put(out, (ran){ max_ts(x->fr, r.fr), min_ts(x->to, r.to) });
+	}
+}
+
+/* the union, or the intersection if all, of two lists in busy_list form */
+static void merge(const struct vec *va, const struct vec *vb, bool all,
+		struct vec *out) {
+	const ran *a = va->d, *b = vb->d;
+	int na = va->len, nb = vb->len;
+	int i = 0, j = 0;
+	if (all) {
+		while (i < na && j < nb) {
+			put(out, (ran){ max_ts(a[i].fr, b[j].fr),
+				min_ts(a[i].to, b[j].to) });
+			if (a[i].to < b[j].to) ++i;
+			else ++j;
+		}
+		return;
+	}
+	while (i < na || j < nb) {
+		if (j == nb || (i < na && a[i].fr <= b[j].fr)) put(out, a[i++]);
+		else put(out, b[j++]);
+	}
+}
+
+void freebusy_query(const struct busy_list *bls, int n,
+		enum freebusy_mode mode, ran r, struct vec *out) {
+	if (mode == FREEBUSY_NONE) return;
+	bool all = mode == FREEBUSY_ALL;
+	struct vec acc = vec_new_empty(sizeof(ran));
+	struct vec part = vec_new_empty(sizeof(ran));
+	struct vec next = vec_new_empty(sizeof(ran));
+	for (int k = 0; k < n; ++k) {
+		if (k == 0) {
+			busy_list_range(&bls[k], r, &acc);
+			continue;
+		}
+		if (all && acc.len == 0) break;
+		vec_clear(&part);
+		busy_list_range(&bls[k], r, &part);
+		vec_clear(&next);
+		merge(&acc, &part, all, &next);
+		struct vec t = acc;
+		acc = next;
+		next = t;
+	}
+
+	if (mode == FREEBUSY_FREE) {
+		ts a = r.fr;
+		for (int i = 0; i < acc.len; ++i) {
+			const ran *x = vec_get_c(&acc, i);
+			put(out, (ran){ a, x->fr });
+			a = x->to;
+		}
+		put(out, (ran){ a, r.to });
+	} else {
+		for (int i = 0; i < acc.len; ++i) {
+			put(out, *(const ran *)vec_get_c(&acc, i));
+		}
+	}
+	vec_free(&next);
+	vec_free(&part);
+	vec_free(&acc);
+}
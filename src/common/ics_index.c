@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+#include "ics_index.h"
+#include "core.h"
+#include "util.h"
+
+static void ics_file_clear(struct ics_file *file) {
+	for (int i = 0; i < file->spans.len; ++i) {
+		struct ics_span *span = vec_get(&file->spans, i);
+		str_free(&span->uid);
+	}
+	vec_clear(&file->spans);
+	file->valid = false;
+}
+
+void ics_index_init(struct ics_index *ix) {
+	ix->files = vec_new_empty(sizeof(struct ics_file));
+	hashmap_init(&ix->files_map, sizeof(int));
+}
+void ics_index_finish(struct ics_index *ix) {
+	for (int i = 0; i < ix->files.len; ++i) {
+		struct ics_file *file = vec_get(&ix->files, i);
+		ics_file_clear(file);
+		vec_free(&file->spans);
+		str_free(&file->path);
+	}
+	vec_free(&ix->files);
+	hashmap_finish(&ix->files_map);
+}
+size_t ics_index_footprint(const struct ics_index *ix) {
+	size_t n = vec_footprint(&ix->files);
+	for (int i = 0; i < ix->files.len; ++i) {
+		const struct ics_file *file = vec_get_c(&ix->files, i);
+		n += str_footprint(&file->path) + vec_footprint(&file->spans);
+		for (int j = 0; j < file->spans.len; ++j) {
+			const struct ics_span *span =
+				vec_get_c(&file->spans, j);
+			n += str_footprint(&span->uid);
+		}
+	}
+	return n;
+}
+
+static struct ics_file *ics_index_lookup(struct ics_index *ix,
+		const char *path) {
+	int *idx;
+	if (hashmap_get_cstr(&ix->files_map, path, (void**)&idx) != MAP_OK)
+		return NULL;
+	return vec_get(&ix->files, *idx);
+}
+
+/* property name of a content line, ending in ':' or ';' */
+static bool line_is_prop(const char *line, const char *name) {
+	int l = strlen(name);
+	return strncasecmp(line, name, l) == 0
+		&& (line[l] == ':' || line[l] == ';');
+}
+
+/* crlf is set from the first line */
+static bool scan_spans(FILE *f, struct vec *spans, bool *crlf) {
+	char *line = NULL;
+	size_t cap = 0;
+	ssize_t n;
+	long off = 0;
+	int depth = 0, cals = 0;
+	bool ok = true, in_uid = false;
+	struct ics_span span = { .recurrence_id = -1 };
+
+	*crlf = false;
+	while (ok && (n = getline(&line, &cap, f)) > 0) {
+		long at = off;
+		if (at == 0) *crlf = n >= 2 && line[n-2] == '\r';
+		off += n;
+		while (n > 0 && (line[n-1] == '\n' || line[n-1] == '\r'))
+			--n;
+		line[n] = '\0';
+
+		/* folded continuation of the uid */
+		if (in_uid && (line[0] == ' ' || line[0] == '\t')) {
+			str_append(&span.uid, line + 1, n - 1);
+			continue;
+		}
+		in_uid = false;
+
+		if (line_is_prop(line, "BEGIN")) {
+			++depth;
+			if (depth == 1 && ++cals > 1) ok = false;
+			if (depth == 2) {
+				span = (struct ics_span){
+					.uid = str_new_empty(),
+					.recurrence_id = -1,
+					.off = at,
+				};
+			}
+		} else if (line_is_prop(line, "END")) {
+			if (depth == 2) {
+				span.len = off - span.off;
+				vec_append(spans, &span);
+			}
+			if (--depth < 0) ok = false;
+		} else if (depth == 2 && line_is_prop(line, "UID")) {
+			const char *v = strchr(line, ':');
+			if (!v || str_any(&span.uid)) ok = false;
+			else str_append(&span.uid, v + 1, strlen(v + 1));
+			in_uid = true;
+		}
+	}
+	free(line);
+
+	if (depth >= 2) str_free(&span.uid);
+	return ok && depth == 0 && cals == 1;
+}
+
+struct ics_file *ics_index_scan(struct ics_index *ix, const char *path,
+		FILE *f) {
+	struct ics_file *file = ics_index_lookup(ix, path);
+	if (!file) {
+		struct ics_file nf = {
+			.path = str_new_from_cstr(path),
+			.valid = false,
+			.spans = vec_new_empty(sizeof(struct ics_span)),
+		};
+		int idx = vec_append(&ix->files, &nf);
+		file = vec_get(&ix->files, idx);
+		asrt(hashmap_put_cstr(&ix->files_map, str_cstr(&file->path),
+			&idx) == MAP_OK, "");
+	}
+	ics_file_clear(file);
+
+	struct stat sb;
+	if (fstat(fileno(f), &sb) != 0) return NULL;
+	long start = ftell(f);
+	if (!scan_spans(f, &file->spans, &file->crlf)) {
+		ics_file_clear(file);
+		fseek(f, start, SEEK_SET);
+		return NULL;
+	}
+	fseek(f, start, SEEK_SET);
+
+	file->size = sb.st_size;
+	file->mtime = sb.st_mtim;
+	file->valid = true;
+	return file;
+}
+void ics_index_forget(struct ics_index *ix, const char *path) {
+	struct ics_file *file = ics_index_lookup(ix, path);
+	if (file) ics_file_clear(file);
+}
+
+struct ics_file *ics_index_get(struct ics_index *ix, const char *path) {
+	struct ics_file *file = ics_index_lookup(ix, path);
+	if (!file || !file->valid) return NULL;
+
+	struct stat sb;
+	if (stat(path, &sb) != 0 || sb.st_size != file->size
+			|| sb.st_mtim.tv_sec != file->mtime.tv_sec
+			|| sb.st_mtim.tv_nsec != file->mtime.tv_nsec) {
+		ics_file_clear(file);
+		return NULL;
+	}
+	return file;
+}
+
+int ics_file_find(struct ics_file *file, const char *uid, ts recurrence_id) {
+	for (int i = 0; i < file->spans.len; ++i) {
+		struct ics_span *span = vec_get(&file->spans, i);
+		if (span->recurrence_id == recurrence_id
+				&& strcmp(str_cstr(&span->uid), uid) == 0)
+			return i;
+	}
+	return -1;
+}
+
+char *ics_file_read_span(struct ics_file *file, int idx) {
+	struct ics_span *span = vec_get(&file->spans, idx);
+	FILE *f = fopen(str_cstr(&file->path), "rb");
+	if (!f) return NULL;
+	char *res = malloc_check(span->len + 1);
+	if (fseek(f, span->off, SEEK_SET) != 0
+			|| fread(res, 1, span->len, f) != (size_t)span->len) {
+		free(res);
+		res = NULL;
+	} else {
+		res[span->len] = '\0';
+	}
+	fclose(f);
+	return res;
+}
+
+static bool copy_bytes(FILE *to, FILE *fr, long n) {
+	char buf[65536];
+	while (n != 0) {
+		size_t want = n < 0 || n > (long)sizeof(buf) ? sizeof(buf) : n;
+		size_t got = fread(buf, 1, want, fr);
+		if (fwrite(buf, 1, got, to) != got) return false;
+		if (n > 0) n -= got;
+		if (got < want) return n <= 0 && !ferror(fr);
+	}
+	return true;
+}
+
+/* writes data with its line endings made \r\n, or \n if not crlf */
+static bool write_lines(FILE *to, const char *data, bool crlf) {
+	for (const char *p = data; *p; ) {
+		size_t n = strcspn(p, "\r\n");
+		if (fwrite(p, 1, n, to) != n) return false;
+		p += n;
+		if (!*p) break;
+		if (*p == '\r') ++p;
+		if (*p == '\n') ++p;
+		if (fputs(crlf ? "\r\n" : "\n", to) < 0) return false;
+	}
+	return true;
+}
+
+static long splice_off(struct ics_file *file, const struct ics_splice *sp) {
+	const struct ics_span *span = vec_get(&file->spans, sp->idx);
+	return sp->insert ? span->off + span->len : span->off;
+}
+/* by offset, insertions first. stable, so insertions after the same
+ * span keep their order */
+static void sort_splices(struct ics_file *file, struct ics_splice *sp,
+		int n) {
+	for (int i = 1; i < n; ++i) {
+		struct ics_splice t = sp[i];
+		long ot = splice_off(file, &t);
+		int j = i;
+		for (; j > 0; --j) {
+			long oj = splice_off(file, &sp[j - 1]);
+			if (oj < ot || (oj == ot && (sp[j - 1].insert
+					|| !t.insert))) break;
+			sp[j] = sp[j - 1];
+		}
+		sp[j] = t;
+	}
+}
+
+/* the spans the file should have after the splices, in order */
+static void spliced_spans(struct ics_file *file, struct ics_splice *sp,
+		int n, struct vec *res) {
+	int j = 0;
+	for (int i = 0; i < file->spans.len; ++i) {
+		struct ics_span *span = vec_get(&file->spans, i);
+		vec_append(res, span);
+		for (; j < n && sp[j].idx <= i; ++j) {
+			if (!sp[j].insert) continue;
+			struct ics_span ins = {
+				.uid = span->uid,
+				.recurrence_id = sp[j].recurrence_id,
+			};
+			vec_append(res, &ins);
+		}
+	}
+}
+
+int ics_file_apply(struct ics_file *file, struct ics_splice *sp, int n) {
+	const char *path = str_cstr(&file->path);
+	for (int i = 0; i < n; ++i) {
+		asrt(sp[i].idx >= 0 && sp[i].idx < file->spans.len,
+			"ics splice position");
+	}
+	sort_splices(file, sp, n);
+
+	FILE *f = fopen(path, "rb");
+	if (!f) return -1;
+	struct atomic_write aw;
+	if (atomic_write_begin(&aw, path) != 0) {
+		fclose(f);
+		return -1;
+	}
+
+	/* one pass over the file, copying the bytes between the splices */
+	long pos = 0;
+	bool ok = true;
+	for (int i = 0; ok && i < n; ++i) {
+		const struct ics_span *span = vec_get(&file->spans, sp[i].idx);
+		long off = splice_off(file, &sp[i]);
+		long len = sp[i].insert ? 0 : span->len;
+		ok = off >= pos
+			&& copy_bytes(aw.f, f, off - pos)
+			&& write_lines(aw.f, sp[i].data, file->crlf)
+			&& fseek(f, off + len, SEEK_SET) == 0;
+		pos = off + len;
+	}
+	ok = ok && copy_bytes(aw.f, f, -1);
+	fclose(f);
+	if (atomic_write_end(&aw, path, ok) != 0) return -1;
+
+	/* rescan what was written, the recurrence ids come from the old
+	 * index as they can't be recovered without parsing */
+	struct vec exp = vec_new_empty(sizeof(struct ics_span));
+	spliced_spans(file, sp, n, &exp);
+	struct vec spans = vec_new_empty(sizeof(struct ics_span));
+	struct stat sb = { 0 };
+	f = fopen(path, "rb");
+	ok = f && fstat(fileno(f), &sb) == 0
+		&& scan_spans(f, &spans, &file->crlf) && spans.len == exp.len;
+	if (f) fclose(f);
+	for (int i = 0; ok && i < spans.len; ++i) {
+		struct ics_span *a = vec_get(&spans, i), *b = vec_get(&exp, i);
+		ok = strcmp(str_cstr(&a->uid), str_cstr(&b->uid)) == 0;
+		a->recurrence_id = b->recurrence_id;
+	}
+	vec_free(&exp);
+
+	ics_file_clear(file);
+	vec_free(&file->spans);
+	file->spans = spans;
+	if (ok) {
+		file->size = sb.st_size;
+		file->mtime = sb.st_mtim;
+		file->valid = true;
+	} else {
+		/* the write went through, only the index is lost */
+		ics_file_clear(file);
+	}
+	return 0;
+}
@@ -13,6 +13,8 @@
 #include "util.h"
 #include "calendar.h"
 #include "editor.h"
+#include "ics_index.h"
+#include "rrule.h"
 
 static ts ts_from_icaltime(icaltimetype tt) {
 	if (icaltime_is_null_time(tt)) return -1;
@@ -28,12 +30,20 @@ static icalcomponent *ical_comp_clone(icalcomponent *c) {
 }
 
 /* struct recurrence */
-struct recurrence {
+
+/* libical's iterator, for the rules that are not expanded natively */
+struct recurrence_ical {
 	icalcomponent *comp;
-	struct vec rdate, exdate; /* vec<ts> */
 	struct icalrecurrencetype rrule;
 	icalrecur_iterator *ritr;
 	struct icaltimetype dtstart;
+};
+struct recurrence {
+	struct vec rdate, exdate; /* vec<ts> */
+	struct rrule rule;
+	struct rrule_iter itr; /* set up by the first recurrence_expand */
+	struct recurrence_ical *ical; /* NULL if the rule is native */
+	bool started;
 	ts last;
 };
 static bool recurrence_exdate(struct recurrence *recur, ts t) {
@@ -55,16 +65,103 @@ static void ical_get_dtperiod_set(struct vec *res /* vec<ts> */,
 		vec_append(res, &t);
 	}
 }
-static bool recurrence_init(struct recurrence *recur, icalcomponent *ic) {
-	/* this function is partly based on libical's
-	 * icalcomponent_foreach_recurrence */
 
-	/* get recurrence related properties */
-	icalproperty *rrule =
-		icalcomponent_get_first_property(ic, ICAL_RRULE_PROPERTY);
+/* the builtin zone with the same name as the zone of tt */
+static struct cal_timezone *ical_shared_zone(icaltimetype tt) {
+	icaltimezone *z = (icaltimezone*)icaltime_get_timezone(tt);
+	if (!z || z == icaltimezone_get_utc_timezone()) {
+		return cal_timezone_get_shared("UTC");
+	}
+	const char *names[] = {
+		icaltimezone_get_location(z),
+		icaltimezone_get_tzid(z)
+	};
+	for (int i = 0; i < 2; ++i) {
+		if (!names[i]) continue;
+		struct cal_timezone *zone = cal_timezone_get_shared(names[i]);
+		if (zone) return zone;
+	}
+	return NULL;
+}
+static bool ical_by_empty(const short *by) {
+	return by[0] == ICAL_RECURRENCE_ARRAY_MAX;
+}
+static bool rrule_from_ical(struct rrule *r,
+		const struct icalrecurrencetype *rt, icaltimetype dtstart) {
+	if (icaltime_is_null_time(dtstart)) return false;
+	switch (rt->freq) {
+	case ICAL_DAILY_RECURRENCE: r->freq = RRULE_DAILY; break;
+	case ICAL_WEEKLY_RECURRENCE: r->freq = RRULE_WEEKLY; break;
+	case ICAL_MONTHLY_RECURRENCE: r->freq = RRULE_MONTHLY; break;
+	case ICAL_YEARLY_RECURRENCE: r->freq = RRULE_YEARLY; break;
+	default: return false;
+	}
+	if (rt->rscale || rt->interval < 1 || rt->count < 0) return false;
+	if (!ical_by_empty(rt->by_second) || !ical_by_empty(rt->by_minute)
+			|| !ical_by_empty(rt->by_hour)
+			|| !ical_by_empty(rt->by_year_day)
+			|| !ical_by_empty(rt->by_week_no)
+			|| !ical_by_empty(rt->by_month)
+			|| !ical_by_empty(rt->by_set_pos)) {
+		return false;
+	}
+	r->interval = rt->interval;
+	r->count = rt->count;
+	r->until = -1;
+	if (!icaltime_is_null_time(rt->until)) {
+		if (rt->until.is_date != dtstart.is_date) return false;
+		r->until = ts_from_icaltime(rt->until);
+	}
+	r->wkst = rt->week_start == ICAL_NO_WEEKDAY ? 1 : rt->week_start - 1;
 
-	if (!rrule) return false;
+	r->byday = 0;
+	r->byday_pos_n = 0;
+	for (int i = 0; i < ICAL_BY_DAY_SIZE &&
+			rt->by_day[i] != ICAL_RECURRENCE_ARRAY_MAX; ++i) {
+		short v = rt->by_day[i];
+		int wday = icalrecurrencetype_day_day_of_week(v) - 1;
+		int pos = icalrecurrencetype_day_position(v);
+		if (wday < 0 || wday > 6) return false;
+		if (pos == 0) {
+			r->byday |= 1 << wday;
+			continue;
+		}
+		if (r->freq != RRULE_MONTHLY || pos < -5 || pos > 5
+				|| r->byday_pos_n == RRULE_MAX_BYDAY_POS) {
+			return false;
+		}
+		r->byday_pos[r->byday_pos_n++] =
+			(struct rrule_byday_pos){ .pos = pos, .wday = wday };
+	}
+	if (r->byday && r->freq == RRULE_YEARLY) return false;
+
+	r->bymonthday_n = 0;
+	for (int i = 0; i < ICAL_BY_MONTHDAY_SIZE &&
+			rt->by_month_day[i] != ICAL_RECURRENCE_ARRAY_MAX; ++i) {
+		int d = rt->by_month_day[i];
+		if (r->freq != RRULE_MONTHLY || d == 0 || d < -31 || d > 31
+				|| r->bymonthday_n == RRULE_MAX_BYMONTHDAY) {
+			return false;
+		}
+		r->bymonthday[r->bymonthday_n++] = d;
+	}
 
+	r->start = make_simple_date(dtstart.year, dtstart.month, dtstart.day,
+		dtstart.hour, dtstart.minute, dtstart.second);
+	r->zone = ical_shared_zone(dtstart);
+	if (!r->zone) return false;
+
+	/*
+	 * dtstart has to be the first instance, which also catches a file
+	 * that defines its own zone under a builtin name differently
+	 */
+	struct rrule_iter it;
+	rrule_iter_init(&it, r);
+	return rrule_iter_next(&it) == ts_from_icaltime(dtstart);
+}
+
+static struct recurrence_ical *recurrence_ical_new(icalcomponent *ic,
+		struct icalrecurrencetype rrule) {
 	icalcomponent *root = icalcomponent_get_parent(ic);
 	root = ical_comp_clone(root);
 	const char *ic_uid = icalcomponent_get_uid(ic);
@@ -80,14 +177,40 @@ static bool recurrence_init(struct recurrence *recur, icalcomponent *ic) {
 		i = icalcomponent_get_next_component(root, ICAL_ANY_COMPONENT);
 	}
 	asrt(false, "clone failed");
-cloned:
-	recur->comp = root;
+cloned: ;
+	struct recurrence_ical *ical = malloc_tagged(MEM_TAG_RECUR,
+		sizeof(struct recurrence_ical));
+	ical->comp = root;
+	ical->rrule = rrule;
+	ical->ritr = NULL;
+	/* this is why we clone */
+	ical->dtstart = icalcomponent_get_dtstart(ic);
+	return ical;
+}
+static void recurrence_ical_destroy(struct recurrence_ical *ical) {
+	if (ical->ritr) icalrecur_iterator_free(ical->ritr);
+	icalcomponent_free(ical->comp);
+	free_tagged(MEM_TAG_RECUR, ical, sizeof(struct recurrence_ical));
+}
+static bool recurrence_init(struct recurrence *recur, icalcomponent *ic) {
+	/* this function is partly based on libical's
+	 * icalcomponent_foreach_recurrence */
+
+	/* get recurrence related properties */
+	icalproperty *rrule =
+		icalcomponent_get_first_property(ic, ICAL_RRULE_PROPERTY);
+
+	if (!rrule) return false;
+
+	struct icalrecurrencetype rt = icalproperty_get_rrule(rrule);
+	recur->ical = NULL;
+	if (!rrule_from_ical(&recur->rule, &rt,
+			icalcomponent_get_dtstart(ic))) {
+		recur->ical = recurrence_ical_new(ic, rt);
+	}
 	recur->rdate = vec_new_empty(sizeof(ts));
 	recur->exdate = vec_new_empty(sizeof(ts));
-	recur->rrule = icalproperty_get_rrule(rrule);
-	recur->ritr = NULL;
-	/* this is why we clone */
-	recur->dtstart = icalcomponent_get_dtstart(ic);
+	recur->started = false;
 	recur->last = -1;
 
 	ical_get_dtperiod_set(&recur->rdate, ic, ICAL_RDATE_PROPERTY);
@@ -98,28 +221,49 @@ void recurrence_destroy(struct recurrence *recur) {
 	if (recur) {
 		vec_free(&recur->rdate);
 		vec_free(&recur->exdate);
-		if (recur->ritr) icalrecur_iterator_free(recur->ritr);
-		icalcomponent_free(recur->comp);
+		if (recur->ical) recurrence_ical_destroy(recur->ical);
 
-		free(recur);
+		free_tagged(MEM_TAG_RECUR, recur, sizeof(struct recurrence));
 	}
 }
 void recurrence_reset(struct recurrence *recur) {
-	if (recur->ritr) {
-		icalrecur_iterator_free(recur->ritr);
-		recur->ritr = NULL;
+	if (recur->ical && recur->ical->ritr) {
+		icalrecur_iterator_free(recur->ical->ritr);
+		recur->ical->ritr = NULL;
 	}
+	recur->started = false;
 	recur->last = -1;
 }
+size_t recurrence_footprint(const struct recurrence *recur, size_t *clone) {
+	size_t n = sizeof(struct recurrence)
+		+ vec_footprint(&recur->rdate) + vec_footprint(&recur->exdate);
+	*clone = 0;
+	if (recur->ical) {
+		n += sizeof(struct recurrence_ical);
+		*clone = strlen(
+			icalcomponent_as_ical_string(recur->ical->comp));
+	}
+	return n;
+}
+static ts recurrence_next(struct recurrence *recur) {
+	if (!recur->ical) return rrule_iter_next(&recur->itr);
+	return ts_from_icaltime(icalrecur_iterator_next(recur->ical->ritr));
+}
 void recurrence_expand(struct recurrence *recur, ts to, recur_cb cb, void *cl) {
-	if (!recur->ritr) {
+	if (!recur->started) {
 		for (int i = 0; i < recur->rdate.len; ++i) {
 			ts *ti = vec_get(&recur->rdate, i);
 			if (recurrence_exdate(recur, *ti)) continue;
 			cb(cl, *ti);
 		}
-		recur->ritr =
-			icalrecur_iterator_new(recur->rrule, recur->dtstart);
+		/* not in recurrence_init, recur is moved after that */
+		if (recur->ical) {
+			recur->ical->ritr = icalrecur_iterator_new(
+				recur->ical->rrule, recur->ical->dtstart);
+		} else {
+			rrule_iter_init(&recur->itr, &recur->rule);
+		}
+		recur->started = true;
 	}
 
 	if (recur->last != -1) {
@@ -128,10 +272,8 @@ void recurrence_expand(struct recurrence *recur, ts to, recur_cb cb, void *cl) {
 		recur->last = -1;
 	}
 
-	for (struct icaltimetype tt = icalrecur_iterator_next(recur->ritr);
-			!icaltime_is_null_time(tt);
-			tt = icalrecur_iterator_next(recur->ritr)) {
-		ts t = ts_from_icaltime(tt);
+	for (ts t = recurrence_next(recur); t != -1;
+			t = recurrence_next(recur)) {
 		if (t > to) {
 			recur->last = t;
 			break;
@@ -140,6 +282,15 @@ void recurrence_expand(struct recurrence *recur, ts to, recur_cb cb, void *cl) {
 	}
 }
 
+/* the instance after to is made too, a leap day may be 8 years later */
+#define RECURRENCE_LOOKAHEAD (8LL * 366 * 86400)
+bool recurrence_thread_safe(const struct recurrence *recur, ts to) {
+	return !recur->ical
+		&& simple_date_to_ts_native(
+			simple_date_to_wall(recur->rule.start))
+		&& simple_date_to_ts_native(to + RECURRENCE_LOOKAHEAD);
+}
+
 static enum icalproperty_class icalcomponent_get_class(icalcomponent *c) {
 	icalproperty *p =
 		icalcomponent_get_first_property(c, ICAL_CLASS_PROPERTY);
@@ -323,17 +474,18 @@ static void comp_assign_ts(icalcomponent *c, enum icalproperty_kind kind,
 	}
 }
 static void comp_assign_categories(icalcomponent *ic,
-		const struct vec *src, bool rem) {
-	if (rem || src->len > 0) {
+		const struct props *src, bool rem) {
+	int n = props_get_categories_n(src);
+	if (rem || n > 0) {
 		icalcomponent_remove_properties(ic, ICAL_CATEGORIES_PROPERTY);
 	}
 	if (!rem) {
-		if (src->len > 0) {
+		if (n > 0) {
 			struct str cats_str = str_empty;
-			for (int i = 0; i < src->len; ++i) {
-				const struct str *s = vec_get_c(src, i);
-				str_append(&cats_str, str_cstr(s), s->v.len);
-				if (i < src->len - 1)
+			for (int i = 0; i < n; ++i) {
+				const char *s = props_get_category(src, i);
+				str_append(&cats_str, s, strlen(s));
+				if (i < n - 1)
 					str_append_char(&cats_str, ',');
 			}
 			icalproperty *p = icalproperty_new_categories(
@@ -344,17 +496,19 @@ static void comp_assign_categories(icalcomponent *ic,
 	}
 }
 static void comp_assign_related_to(icalcomponent *ic,
-		const struct vec *src, bool rem) {
-	if (rem || src->len > 0) {
+		const struct props *src, bool rem) {
+	int n = props_get_related_to_n(src);
+	if (rem || n > 0) {
 		icalcomponent_remove_properties(ic, ICAL_RELATEDTO_PROPERTY);
 	}
 	if (!rem) {
-		for (int i = 0; i < src->len; ++i) {
-			const struct prop_related_to *rel = vec_get_c(src, i);
-			icalproperty *p = icalproperty_new_relatedto(
-				str_cstr(&rel->uid));
+		for (int i = 0; i < n; ++i) {
+			enum prop_reltype reltype;
+			const char *uid =
+				props_get_related_to_uid(src, i, &reltype);
+			icalproperty *p = icalproperty_new_relatedto(uid);
 			icalparameter *param =
-				prop_reltype_to_ical_reltype(rel->reltype);
+				prop_reltype_to_ical_reltype(reltype);
 			icalproperty_add_parameter(p, param);
 			icalcomponent_add_property(ic, p);
 		}
@@ -371,9 +525,9 @@ static void apply_props_to_icalcomponent(icalcomponent *ic,
 		props_mask_get(rem, PROP_LOCATION));
 	comp_assign_text(ic, ICAL_DESCRIPTION_PROPERTY, props_get_desc(p),
 		props_mask_get(rem, PROP_DESC));
-	comp_assign_categories(ic, props_get_categories(p),
+	comp_assign_categories(ic, p,
 		props_mask_get(rem, PROP_CATEGORIES));
-	comp_assign_related_to(ic, props_get_related_to(p),
+	comp_assign_related_to(ic, p,
 		props_mask_get(rem, PROP_RELATED_TO));
 
 	bool has;
@@ -513,6 +667,44 @@ static void props_init_from_ical(struct props *p, icalcomponent *ic) {
 	}
 	props_set_related_to(p, rels);
 }
+static void alarms_from_ical(struct vec *alarms, icalcomponent *ic) {
+	icalcomponent *va =
+		icalcomponent_get_first_component(ic, ICAL_VALARM_COMPONENT);
+	for (; va; va = icalcomponent_get_next_component(ic,
+			ICAL_VALARM_COMPONENT)) {
+		icalproperty *ip = icalcomponent_get_first_property(va,
+			ICAL_TRIGGER_PROPERTY);
+		if (!ip) continue;
+		struct icaltriggertype tr = icalproperty_get_trigger(ip);
+		struct comp_alarm a = { 0 };
+		if (!icaltime_is_null_time(tr.time)) {
+			a.related = COMP_ALARM_ABSOLUTE;
+			a.trigger = ts_from_icaltime(tr.time);
+		} else {
+			icalparameter *param = icalproperty_get_first_parameter(
+				ip, ICAL_RELATED_PARAMETER);
+			a.related = param && icalparameter_get_related(param)
+				== ICAL_RELATED_END
+				? COMP_ALARM_END : COMP_ALARM_START;
+			a.trigger = icaldurationtype_as_int(tr.duration);
+		}
+
+		/* REPEAT only counts together with DURATION */
+		icalproperty *rep = icalcomponent_get_first_property(va,
+			ICAL_REPEAT_PROPERTY);
+		icalproperty *dur = icalcomponent_get_first_property(va,
+			ICAL_DURATION_PROPERTY);
+		if (rep && dur) {
+			a.repeat = icalproperty_get_repeat(rep);
+			a.duration = icaldurationtype_as_int(
+				icalproperty_get_duration(dur));
+			if (a.repeat > COMP_ALARM_MAX_REPEAT)
+				a.repeat = COMP_ALARM_MAX_REPEAT;
+			if (a.repeat < 0 || a.duration <= 0) a.repeat = 0;
+		}
+		vec_append(alarms, &a);
+	}
+}
 static bool comp_init_from_ical(struct comp *c, icalcomponent *ic) {
 	enum comp_type type;
 	if (icalcomponent_isa(ic) == ICAL_VEVENT_COMPONENT) {
@@ -536,19 +728,42 @@ static bool comp_init_from_ical(struct comp *c, icalcomponent *ic) {
 		comp_finish(c);
 		return false;
 	}
+	alarms_from_ical(&c->alarms, ic);
 
 	struct recurrence recur;
 	if (recurrence_init(&recur, ic)) {
-		c->recur = malloc_check(sizeof(struct recurrence));
+		c->recur = malloc_tagged(MEM_TAG_RECUR,
+			sizeof(struct recurrence));
 		memcpy(c->recur, &recur, sizeof(struct recurrence));
 	}
 
 	return true;
 }
 
-int libical_parse_ics(FILE *f, struct calendar *cal) {
+/* matches the i-th top level component against the byte range index,
+ * the recurrence ids are only known after libical parsed the file */
+static bool index_match(struct ics_file *file, int i, const char *uid,
+		icalproperty *recurrenceid) {
+	if (i >= file->spans.len) return false;
+	struct ics_span *span = vec_get(&file->spans, i);
+	if (strcmp(str_cstr(&span->uid), uid ? uid : "") != 0) return false;
+	if (recurrenceid) {
+		span->recurrence_id = ts_from_icaltime(
+			icalproperty_get_recurrenceid(recurrenceid));
+	}
+	return true;
+}
+
+static int parse_ics(FILE *f, struct calendar *cal, const char *path) {
+	struct ics_file *file = NULL;
+	if (path) file = ics_index_scan(&cal->index, path, f);
+
 	icalcomponent *root = libical_component_from_file(f);
-	if (!root) return -1;
+	if (!root) {
+		if (file) ics_index_forget(&cal->index, path);
+		return -1;
+	}
+	int i = 0;
 	icalcomponent *ic = icalcomponent_get_first_component(
 		root, ICAL_ANY_COMPONENT);
 	while (ic) {
@@ -557,6 +772,10 @@ int libical_parse_ics(FILE *f, struct calendar *cal) {
 		icalproperty *recurrenceid =
 			icalcomponent_get_first_property(ic,
 			ICAL_RECURRENCEID_PROPERTY);
+		if (file && !index_match(file, i++, uid, recurrenceid)) {
+			ics_index_forget(&cal->index, path);
+			file = NULL;
+		}
 		if ((kind == ICAL_VEVENT_COMPONENT
 				|| kind == ICAL_VTODO_COMPONENT)
 				&& uid && recurrenceid) {
@@ -586,10 +805,15 @@ int libical_parse_ics(FILE *f, struct calendar *cal) {
 		}
 		ic = icalcomponent_get_next_component(root, ICAL_ANY_COMPONENT);
 	}
+	if (file && i != file->spans.len) ics_index_forget(&cal->index, path);
 	icalcomponent_free(root);
 	return 0;
 }
 
+int libical_parse_ics(FILE *f, struct calendar *cal) {
+	return parse_ics(f, cal, NULL);
+}
+
 int comp_init_from_ics(struct comp *c, FILE *f) {
 	icalcomponent *root = libical_component_from_file(f);
 	if (!root) return -1;
@@ -619,7 +843,7 @@ void update_calendar_from_storage(struct calendar *cal,
 	clock_gettime(CLOCK_REALTIME, &cal->loaded);
 	if (S_ISREG(sb.st_mode)) { // file
 		FILE *f = fopen(path, "rb");
-		if (libical_parse_ics(f, cal) < 0) {
+		if (parse_ics(f, cal, path) < 0) {
 			pu_log_info("warning: could not parse %s\n", path);
 		}
 		fclose(f);
@@ -661,7 +885,7 @@ void update_calendar_from_storage(struct calendar *cal,
 				cal->name = str_empty;
 				str_append(&cal->name, buf, cnt);
 			} else {
-				if (libical_parse_ics(f, cal) < 0) {
+				if (parse_ics(f, cal, buf) < 0) {
 					pu_log_info(
 						"warning: could not parse %s\n",
 						buf);
@@ -673,25 +897,177 @@ void update_calendar_from_storage(struct calendar *cal,
 	}
 }
 
-int edit_spec_apply_to_storage(struct edit_spec *es,
-		struct calendar *cal) {
-	/* check if storage is directory */
+static enum icalcomponent_kind comp_type_to_ical(enum comp_type type) {
+	switch (type) {
+	case COMP_TYPE_EVENT: return ICAL_VEVENT_COMPONENT;
+	case COMP_TYPE_TODO: return ICAL_VTODO_COMPONENT;
+	default: asrt(false, "");
+	}
+	return ICAL_NO_COMPONENT;
+}
+
+/* creates the special instance of a recurring component */
+static icalcomponent *new_recur_inst(struct edit_spec *es,
+		struct calendar *cal, enum icalcomponent_kind type) {
+	int idx = calendar_find_comp(cal, str_cstr(&es->uid));
+	struct comp *memory_comp = calendar_get_comp(cal, idx);
+
+	icalcomponent *c = icalcomponent_new(type);
+	icalcomponent_set_uid(c, str_cstr(&es->uid));
+	comp_assign_ts(c, ICAL_RECURRENCEID_PROPERTY,
+		true, es->recurrence_id, false);
+	apply_props_to_icalcomponent(c, &memory_comp->p, &props_mask_empty);
+	apply_props_to_icalcomponent(c, &es->p, &es->rem);
+	return c;
+}
+
+/* a component of the file being edited */
+struct splice_comp {
+	const char *uid;
+	ts recurrence_id;
+	icalcomponent *c;
+	struct ics_splice sp;
+	char *data;
+};
+
+/* updates only the bytes of the edited components of one file, using the
+ * index built when it was loaded. returns -1 if the index can't be used,
+ * nothing is written in that case */
+static int updates_spliced(struct edit_spec **es, int n,
+		struct calendar *cal, const char *path) {
+	struct ics_file *file = ics_index_get(&cal->index, path);
+	if (!file) return -1;
+
+	int res = -1;
+	struct vec comps = vec_new_empty(sizeof(struct splice_comp));
+	for (int i = 0; i < n; ++i) {
+		enum icalcomponent_kind type = comp_type_to_ical(es[i]->type);
+		const char *uid = str_cstr(&es[i]->uid);
+		ts rid = es[i]->recurrence_id;
+
+		/* later edits of the same component build on earlier ones */
+		struct splice_comp *sc = NULL;
+		for (int j = 0; j < comps.len && !sc; ++j) {
+			sc = vec_get(&comps, j);
+			if (sc->recurrence_id != rid
+					|| strcmp(sc->uid, uid) != 0) sc = NULL;
+		}
+		if (sc) {
+			if (icalcomponent_isa(sc->c) != type) goto out;
+			apply_props_to_icalcomponent(sc->c,
+				&es[i]->p, &es[i]->rem);
+			continue;
+		}
+
+		struct splice_comp nsc = { .uid = uid, .recurrence_id = rid };
+		int idx = ics_file_find(file, uid, rid);
+		int base = ics_file_find(file, uid, -1);
+		if (idx != -1) {
+			char *text = ics_file_read_span(file, idx);
+			nsc.c = text ? icalparser_parse_string(text) : NULL;
+			free(text);
+			nsc.sp = (struct ics_splice){ .idx = idx };
+		} else if (rid != -1 && base != -1) {
+			nsc.c = new_recur_inst(es[i], cal, type);
+			nsc.sp = (struct ics_splice){
+				.idx = base,
+				.insert = true,
+				.recurrence_id = rid,
+			};
+		}
+		if (!nsc.c) goto out;
+		vec_append(&comps, &nsc);
+		if (icalcomponent_isa(nsc.c) != type) goto out;
+		if (!nsc.sp.insert) {
+			apply_props_to_icalcomponent(nsc.c,
+				&es[i]->p, &es[i]->rem);
+		}
+	}
+
+	struct ics_splice *sp =
+		malloc_check(sizeof(struct ics_splice) * comps.len);
+	for (int j = 0; j < comps.len; ++j) {
+		struct splice_comp *sc = vec_get(&comps, j);
+		sc->data = icalcomponent_as_ical_string_r(sc->c);
+		sp[j] = sc->sp;
+		sp[j].data = sc->data;
+	}
+	res = ics_file_apply(file, sp, comps.len);
+	free(sp);
+
+out:
+	for (int j = 0; j < comps.len; ++j) {
+		struct splice_comp *sc = vec_get(&comps, j);
+		icalcomponent_free(sc->c);
+		free(sc->data);
+	}
+	vec_free(&comps);
+	return res;
+}
+
+static int write_ics(const char *path, const char *data) {
+	struct atomic_write aw;
+	if (atomic_write_begin(&aw, path) != 0) return -1;
+	bool ok = fputs(data, aw.f) >= 0;
+	return atomic_write_end(&aw, path, ok);
+}
+
+int edit_spec_storage_path(const struct edit_spec *es,
+		struct calendar *cal, char path[static 1024]) {
 	struct stat sb;
-	FILE *f;
-	char *result;
 	const char *path_base = str_cstr(&cal->storage);
-	asrt(stat(path_base, &sb) == 0, "stat");
-	asrt(S_ISDIR(sb.st_mode), "saving to non-dir calendar not supported");
+	if (stat(path_base, &sb) != 0 || !str_any(&es->uid)) return -1;
 
 	/* construct the path to the specific .ics file */
+	if (S_ISDIR(sb.st_mode)) {
+		snprintf(path, 1024, "%s/%s.ics", path_base,
+			str_cstr(&es->uid));
+	} else {
+		/* only updates are supported on non-dir calendars */
+		if (es->method != EDIT_METHOD_UPDATE) return -1;
+		snprintf(path, 1024, "%s", path_base);
+	}
+	return 0;
+}
+
+int edit_specs_apply_to_storage(struct edit_spec **es, int n,
+		struct calendar *cal, bool *failed) {
+	int n_failed = 0;
 	char path[1024];
-	asrt(str_any(&es->uid), "uid sanity check");
-	snprintf(path, 1024, "%s/%s.ics", path_base, str_cstr(&es->uid));
+	for (int i = 0; i < n; ) {
+		/* a run of updates to the same file is written at once */
+		int j = i;
+		bool upd = es[i]->method == EDIT_METHOD_UPDATE;
+		if (upd && edit_spec_storage_path(es[i], cal, path) == 0) {
+			while (j < n && es[j]->method == EDIT_METHOD_UPDATE)
+				++j;
+		}
+		int run = j - i;
+		if (run > 1 && updates_spliced(es + i, run, cal, path) == 0) {
+			fprintf(stderr, "[editor storage] "
+				"updated %d comps of %s in place\n",
+				run, path);
+			for (; i < j; ++i) failed[i] = false;
+			continue;
+		}
+		failed[i] = edit_spec_apply_to_storage(es[i], cal) != 0;
+		if (failed[i]) ++n_failed;
+		++i;
+	}
+	return n_failed;
+}
 
-	enum icalcomponent_kind type;
-	if (es->type == COMP_TYPE_EVENT) type = ICAL_VEVENT_COMPONENT;
-	else if (es->type == COMP_TYPE_TODO) type = ICAL_VTODO_COMPONENT;
-	else asrt(false, "");
+int edit_spec_apply_to_storage(struct edit_spec *es,
+		struct calendar *cal) {
+	FILE *f;
+	char *result;
+	char path[1024];
+	if (edit_spec_storage_path(es, cal, path) != 0) {
+		fprintf(stderr, "[editor storage] can't write this "
+			"edit to %s\n", str_cstr(&cal->storage));
+		return -1;
+	}
+	enum icalcomponent_kind type = comp_type_to_ical(es->type);
 
 	switch(es->method) {
 	case EDIT_METHOD_DELETE:
@@ -699,6 +1075,7 @@ int edit_spec_apply_to_storage(struct edit_spec *es,
 			fprintf(stderr, "[editor storage] deletion failed\n");
 			return -1;
 		}
+		ics_index_forget(&cal->index, path);
 		fprintf(stderr, "[editor storage] deleted %s\n", path);
 		return 0;
 		break;
@@ -709,6 +1086,12 @@ int edit_spec_apply_to_storage(struct edit_spec *es,
 			return -1;
 		}
 
+		if (updates_spliced(&es, 1, cal, path) == 0) {
+			fprintf(stderr, "[editor storage] "
+				"updated %s in place\n", path);
+			return 0;
+		}
+
 		/* load and parse the file */
 		f = fopen(path, "r");
 		icalcomponent *root = libical_component_from_file(f);
@@ -740,27 +1123,17 @@ cont:
 		asrt(base_c, "no base comp");
 		asrt(es->recurrence_id != -1, "");
 
-		int idx = calendar_find_comp(cal, str_cstr(&es->uid));
-		struct comp *memory_comp = calendar_get_comp(cal, idx);
-
-		base_c = icalcomponent_new(type);
-		icalcomponent_set_uid(base_c, str_cstr(&es->uid));
-		comp_assign_ts(base_c, ICAL_RECURRENCEID_PROPERTY,
-			true, es->recurrence_id, false);
-		apply_props_to_icalcomponent(base_c, &memory_comp->p,
-			&props_mask_empty);
-		apply_props_to_icalcomponent(base_c, &es->p, &es->rem);
-		icalcomponent_add_component(root, base_c);
+		icalcomponent_add_component(root,
+			new_recur_inst(es, cal, type));
 applied:
 		/* serialize and write back the component */
 		result = icalcomponent_as_ical_string(root);
 		fprintf(stderr, "[editor storage] writing existing %s\n", path);
-		f = fopen(path, "w");
-		fputs(result, f);
-		fclose(f);
+		int res = write_ics(path, result);
 		icalcomponent_free(root);
+		ics_index_forget(&cal->index, path);
 
-		return 0;
+		return res;
 		break;
 	case EDIT_METHOD_CREATE:
 		;
@@ -779,11 +1152,18 @@ applied:
 		);
 		result = icalcomponent_as_ical_string(calendar);
 		fprintf(stderr, "[editor storage] writing new %s\n", path);
-		f = fopen(path, "w");
-		fputs(result, f);
-		fclose(f);
+		if (write_ics(path, result) != 0) {
+			icalcomponent_free(calendar);
+			return -1;
+		}
 		icalcomponent_free(calendar);
 
+		/* a fresh file has only the base component, index it */
+		if (f = fopen(path, "rb")) {
+			ics_index_scan(&cal->index, path, f);
+			fclose(f);
+		}
+
 		return 0;
 	default:
 		asrt(false, "");
@@ -792,4 +1172,3 @@ applied:
 	asrt(false, "");
 	return 0;
 }
-
@@ -1,96 +1,120 @@
 #include <string.h>
+#include <stdlib.h>
+#include <stdatomic.h>
 
 #include "props.h"
 #include "util.h"
+#include "core.h"
 
 #define EMPTY_VAL(type, name, capname) .has_##name = false,
-#define EMPTY_STR(type, name, capname) .name = { .v = VEC_EMPTY(sizeof(char)) },
-#define EMPTY_VEC(type, name, capname) .name = VEC_EMPTY(sizeof(type)),
+#define EMPTY_PTR(type, name, capname) .name = NULL,
 const struct props props_empty = {
 	PROPS_LIST_BY_VAL(EMPTY_VAL)
-	PROPS_LIST_VEC(EMPTY_VEC)
-	PROPS_LIST_STR(EMPTY_STR)
+	PROPS_LIST_VEC(EMPTY_PTR)
+	PROPS_LIST_STR(EMPTY_PTR)
 	.dirty = true
 };
 const struct props_mask props_mask_empty = { ._mask = 0U };
 #undef EMPTY_VAL
-#undef EMPTY_STR
-#undef EMPTY_VEC
+#undef EMPTY_PTR
 
-static void free_vec_default(struct vec *v) {
-	vec_free(v);
-	*v = vec_new_empty(sizeof(struct str));
-}
-static void free_vec_str(struct vec *v) {
-	for (int i = 0; i < v->len; ++i) {
-		struct str *s = vec_get(v, i);
-		str_free(s);
-	}
-	free_vec_default(v);
-}
-static void copy_vec_default(struct vec *dst, const struct vec *src) {
-	*dst = vec_copy(src);
+static atomic_llong stats_unions, stats_shared_bytes;
+
+static bool str_prop_equal(const struct rstr *a, const struct rstr *b) {
+	return a == b || strcmp(rstr_cstr(a), rstr_cstr(b)) == 0;
 }
-static void free_vec_related_to(struct vec *v) {
-	for (int i = 0; i < v->len; ++i) {
-		struct prop_related_to *rel = vec_get(v, i);
-		str_free(&rel->uid);
-	}
-	free_vec_default(v);
+
+static struct props_list *list_new(int n) {
+	struct props_list *l = malloc_check(sizeof(struct props_list)
+		+ n * sizeof(struct props_list_item));
+	atomic_init(&l->ref, 1);
+	l->n = n;
+	return l;
 }
-static void copy_vec_str(struct vec *dst, const struct vec *src) {
-	for (int i = 0; i < src->len; ++i) {
-		const struct str *s = vec_get_c(src, i);
-		struct str copy = str_copy(s);
-		vec_append(dst, &copy);
-	}
+static struct props_list *list_ref(struct props_list *l) {
+	if (l) atomic_fetch_add_explicit(&l->ref, 1, memory_order_relaxed);
+	return l;
 }
-static void copy_vec_related_to(struct vec *dst, const struct vec *src) {
-	for (int i = 0; i < src->len; ++i) {
-		const struct prop_related_to *rel = vec_get_c(src, i);
-		struct prop_related_to copy = *rel;
-		copy.uid = str_copy(&rel->uid);
-		vec_append(dst, &copy);
-	}
+static void list_unref(struct props_list *l) {
+	if (!l) return;
+	if (atomic_fetch_sub_explicit(&l->ref, 1, memory_order_acq_rel) != 1)
+		return;
+	for (int i = 0; i < l->n; ++i) rstr_unref(l->items[i].s);
+	free(l);
 }
-static bool eq_str(const void *pa, const void *pb) {
-	const struct str *a = pa, *b = pb;
-	return strcmp(str_cstr(a), str_cstr(b)) == 0;
+static size_t list_size(const struct props_list *l) {
+	if (!l) return 0;
+	size_t n = sizeof(struct props_list)
+		+ l->n * sizeof(struct props_list_item);
+	for (int i = 0; i < l->n; ++i) n += l->items[i].s->len + 1;
+	return n;
 }
-static bool eq_prop_related_to(const void *pa, const void *pb) {
-	const struct prop_related_to *a = pa, *b = pb;
-	if (a->reltype != b->reltype) return false;
-	if (strcmp(str_cstr(&a->uid), str_cstr(&b->uid)) != 0) return false;
-	return true;
+static size_t list_footprint(const struct props_list *l) {
+	if (!l) return 0;
+	size_t n = sizeof(struct props_list)
+		+ l->n * sizeof(struct props_list_item);
+	for (int i = 0; i < l->n; ++i) n += rstr_footprint(l->items[i].s);
+	int ref = atomic_load_explicit(&((struct props_list *)l)->ref,
+		memory_order_relaxed);
+	return n / (ref > 0 ? ref : 1);
 }
-static bool eq_vec(const struct vec *a, const struct vec *b,
-		bool (*eq)(const void *a, const void *b)) {
-	if (a->len != b->len) return false;
-	for (int i = 0; i < a->len; ++i) {
-		const void *pa = vec_get_c(a, i);
-		const void *pb = vec_get_c(b, i);
-		if (!eq(pa, pb)) return false;
+static bool list_equal(const struct props_list *a,
+		const struct props_list *b) {
+	if (a == b) return true;
+	if (!a || !b || a->n != b->n) return false;
+	for (int i = 0; i < a->n; ++i) {
+		if (a->items[i].reltype != b->items[i].reltype) return false;
+		if (!str_prop_equal(a->items[i].s, b->items[i].s)) return false;
 	}
 	return true;
 }
 
-
-#define FREE_VEC(type, v) \
+/* categories repeat a lot between comps, so they are interned */
+static struct props_list *list_from_vec_str(struct vec *v) {
+	struct props_list *l = NULL;
+	if (v->len > 0) {
+		l = list_new(v->len);
+		for (int i = 0; i < v->len; ++i) {
+			const struct str *s = vec_get_c(v, i);
+			l->items[i] = (struct props_list_item){
+				.s = rstr_intern(str_cstr(s))
+			};
+		}
+	}
+	for (int i = 0; i < v->len; ++i) str_free(vec_get(v, i));
+	vec_free(v);
+	return l;
+}
+static struct props_list *list_from_vec_related_to(struct vec *v) {
+	struct props_list *l = NULL;
+	if (v->len > 0) {
+		l = list_new(v->len);
+		for (int i = 0; i < v->len; ++i) {
+			const struct prop_related_to *rel = vec_get_c(v, i);
+			l->items[i] = (struct props_list_item){
+				.reltype = rel->reltype,
+				.s = rstr_new(str_cstr(&rel->uid))
+			};
+		}
+	}
+	for (int i = 0; i < v->len; ++i) {
+		struct prop_related_to *rel = vec_get(v, i);
+		str_free(&rel->uid);
+	}
+	vec_free(v);
+	return l;
+}
+#define LIST_FROM_VEC(type, v) \
 	_Generic(*(type *)0, \
-		struct str: free_vec_str, \
-		struct prop_related_to: free_vec_related_to \
+		struct str: list_from_vec_str, \
+		struct prop_related_to: list_from_vec_related_to \
 	)(v)
-#define COPY_VEC(type, dst, src) \
-	_Generic(*(type *)0, \
-		struct str: copy_vec_str, \
-		struct prop_related_to: copy_vec_related_to, \
-		default: copy_vec_default \
-	)(dst, src)
-#define EQ_VEC(type, a, b) eq_vec(a, b, \
-	_Generic(*(type *)0, \
-		struct str: eq_str, \
-		struct prop_related_to: eq_prop_related_to \
-	))
+
+/* colors repeat a lot between comps, so they are interned */
+static struct rstr *str_prop_new(enum prop pr, const char *val) {
+	if (!val || !val[0]) return NULL;
+	return pr == PROP_COLOR ? rstr_intern(val) : rstr_new(val);
+}
 
 /* struct props getters */
 #define GETTER_VAL(type, name, capname) \
@@ -100,12 +124,11 @@ static bool eq_vec(const struct vec *a, const struct vec *b,
 		return true; \
 	}
 #define GETTER_VEC(type, name, capname) \
-	const struct vec * props_get_##name(const struct props *p) { \
-		return &p->name; }
+	int props_get_##name##_n(const struct props *p) { \
+		return p->name ? p->name->n : 0; }
 #define GETTER_STR(type, name, capname) \
 	const char * props_get_##name(const struct props *p) { \
-		if (!str_any(&p->name)) return NULL; \
-		return str_cstr(&p->name); \
+		return p->name ? p->name->s : NULL; \
 	}
 PROPS_LIST_BY_VAL(GETTER_VAL)
 PROPS_LIST_VEC(GETTER_VEC)
@@ -114,6 +137,17 @@ PROPS_LIST_STR(GETTER_STR)
 #undef GETTER_VEC
 #undef GETTER_STR
 
+const char *props_get_category(const struct props *p, int i) {
+	asrt(i >= 0 && i < props_get_categories_n(p), "category index");
+	return p->categories->items[i].s->s;
+}
+const char *props_get_related_to_uid(const struct props *p, int i,
+		enum prop_reltype *reltype) {
+	asrt(i >= 0 && i < props_get_related_to_n(p), "related_to index");
+	*reltype = p->related_to->items[i].reltype;
+	return p->related_to->items[i].s->s;
+}
+
 /* struct props setters */
 #define SETTER_VAL(type, name, capname) \
 	void props_set_##name(struct props *p, type val) { \
@@ -123,14 +157,14 @@ PROPS_LIST_STR(GETTER_STR)
 	}
 #define SETTER_VEC(type, name, capname) \
 	void props_set_##name(struct props *p, struct vec val) { \
-		FREE_VEC(type, &p->name); \
-		p->name = val; \
+		list_unref(p->name); \
+		p->name = LIST_FROM_VEC(type, &val); \
 		p->dirty = true; \
 	}
 #define SETTER_STR(type, name, capname) \
 	void props_set_##name(struct props *p, const char *val) { \
-		str_free(&p->name); \
-		p->name = str_new_from_cstr(val); \
+		rstr_unref(p->name); \
+		p->name = str_prop_new(PROP_##capname, val); \
 		p->dirty = true; \
 	}
 PROPS_LIST_BY_VAL(SETTER_VAL)
@@ -157,12 +191,13 @@ bool props_mask_any(const struct props_mask *pm) {
 	if (pm->_mask & (1U << PROP_##capname)) p->has_##name = false;
 #define APPLY_MASK_VEC(type, name, capname) \
 	if (pm->_mask & (1U << PROP_##capname)) { \
-		FREE_VEC(type, &p->name); \
+		list_unref(p->name); \
+		p->name = NULL; \
 	}
 #define APPLY_MASK_STR(type, name, capname) \
 	if (pm->_mask & (1U << PROP_##capname)) { \
-		str_free(&p->name); \
-		p->name = str_empty; \
+		rstr_unref(p->name); \
+		p->name = NULL; \
 	}
 void props_apply_mask(struct props *p, const struct props_mask *pm) {
 	PROPS_LIST_BY_VAL(APPLY_MASK_VAL)
@@ -176,17 +211,17 @@ void props_apply_mask(struct props *p, const struct props_mask *pm) {
 
 #define GET_MASK_VAL(type, name, capname) \
 	if (p->has_##name) pm._mask |= (1U << PROP_##capname);
-#define GET_MASK_VEC(type, name, capname) \
-	if (p->name.len) pm._mask |= (1U << PROP_##capname);
-#define GET_MASK_STR(type, name, capname) \
-	if (str_any(&p->name)) pm._mask |= (1U << PROP_##capname);
+#define GET_MASK_PTR(type, name, capname) \
+	if (p->name) pm._mask |= (1U << PROP_##capname);
 struct props_mask props_get_mask(const struct props *p) {
 	struct props_mask pm = props_mask_empty;
 	PROPS_LIST_BY_VAL(GET_MASK_VAL)
-	PROPS_LIST_VEC(GET_MASK_VEC)
-	PROPS_LIST_STR(GET_MASK_STR)
+	PROPS_LIST_VEC(GET_MASK_PTR)
+	PROPS_LIST_STR(GET_MASK_PTR)
 	return pm;
 }
+#undef GET_MASK_VAL
+#undef GET_MASK_PTR
 
 #define UNION_VAL(type, name, capname) \
 	if (rhs->has_##name) { \
@@ -194,28 +229,34 @@ struct props_mask props_get_mask(const struct props *p) {
 		p->has_##name = true; \
 	}
 #define UNION_VEC(type, name, capname) \
-	if (rhs->name.len) { \
-		FREE_VEC(type, &p->name); \
-		COPY_VEC(type, &p->name, &rhs->name); \
+	if (rhs->name) { \
+		list_unref(p->name); \
+		p->name = list_ref(rhs->name); \
+		shared += list_size(rhs->name); \
 	}
 #define UNION_STR(type, name, capname) \
-	if (str_any(&rhs->name)) { \
-		str_free(&p->name); \
-		p->name = str_copy(&rhs->name); \
+	if (rhs->name) { \
+		rstr_unref(p->name); \
+		p->name = rstr_ref(rhs->name); \
+		shared += rhs->name->len + 1; \
 	}
 void props_union(struct props *p, const struct props *rhs) {
+	long long shared = 0;
 	PROPS_LIST_BY_VAL(UNION_VAL)
 	PROPS_LIST_VEC(UNION_VEC)
 	PROPS_LIST_STR(UNION_STR)
 	p->dirty = true;
+	atomic_fetch_add_explicit(&stats_unions, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&stats_shared_bytes, shared,
+		memory_order_relaxed);
 }
 #undef UNION_VAL
 #undef UNION_VEC
 #undef UNION_STR
 
 #define FINISH_VAL(type, name, capname)
-#define FINISH_VEC(type, name, capname) FREE_VEC(type, &p->name);
-#define FINISH_STR(type, name, capname) str_free(&p->name);
+#define FINISH_VEC(type, name, capname) list_unref(p->name);
+#define FINISH_STR(type, name, capname) rstr_unref(p->name);
 void props_finish(struct props *p) {
 	PROPS_LIST_BY_VAL(FINISH_VAL)
 	PROPS_LIST_VEC(FINISH_VEC)
@@ -225,6 +266,20 @@ void props_finish(struct props *p) {
 #undef FINISH_VEC
 #undef FINISH_STR
 
+#define FOOTPRINT_VAL(type, name, capname)
+#define FOOTPRINT_VEC(type, name, capname) n += list_footprint(p->name);
+#define FOOTPRINT_STR(type, name, capname) n += rstr_footprint(p->name);
+size_t props_footprint(const struct props *p) {
+	size_t n = 0;
+	PROPS_LIST_BY_VAL(FOOTPRINT_VAL)
+	PROPS_LIST_VEC(FOOTPRINT_VEC)
+	PROPS_LIST_STR(FOOTPRINT_STR)
+	return n;
+}
+#undef FOOTPRINT_VAL
+#undef FOOTPRINT_VEC
+#undef FOOTPRINT_STR
+
 #define EQUAL_VAL(type, name, capname) \
 	if (props_mask_get(pm, PROP_##capname)) { \
 		if (a->has_##name != b->has_##name) return false; \
@@ -232,11 +287,10 @@ void props_finish(struct props *p) {
 	}
 #define EQUAL_VEC(type, name, capname) \
 	if (props_mask_get(pm, PROP_##capname)) \
-		if (!EQ_VEC(type, &a->name, &b->name)) return false;
+		if (!list_equal(a->name, b->name)) return false;
 #define EQUAL_STR(type, name, capname) \
 	if (props_mask_get(pm, PROP_##capname)) \
-		if (strcmp(str_cstr(&a->name), str_cstr(&b->name)) != 0) \
-			return false;
+		if (!str_prop_equal(a->name, b->name)) return false;
 bool props_equal(const struct props *a, const struct props *b,
 		const struct props_mask *pm) {
 	PROPS_LIST_BY_VAL(EQUAL_VAL)
@@ -250,8 +304,8 @@ bool props_equal(const struct props *a, const struct props *b,
 
 static void props_recalc(struct props *p) {
 	if (p->dirty) {
-		p->color_val =
-			lookup_color(str_cstr(&p->color), p->color.v.len);
+		p->color_val = lookup_color(rstr_cstr(p->color),
+			p->color ? p->color->len : 0);
 		p->dirty = false;
 	}
 }
@@ -260,3 +314,10 @@ uint32_t props_get_color_val(struct props *p) {
 	props_recalc(p);
 	return p->color_val;
 }
+
+struct props_stats props_get_stats() {
+	return (struct props_stats){
+		.unions = atomic_load(&stats_unions),
+		.shared_bytes = atomic_load(&stats_shared_bytes),
+	};
+}
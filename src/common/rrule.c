@@ -0,0 +1,124 @@
+#include "rrule.h"
+#include "core.h"
+
+/* a rule with this many empty periods in a row has no more instances */
+#define RRULE_MAX_EMPTY 1000
+
+static int floor_div(int a, int b) {
+	return a / b - (a % b < 0);
+}
+/* 0 is sunday */
+static int weekday(int day) {
+	return day + 4 - floor_div(day + 4, 7) * 7;
+}
+static int day_of(int year, int month, int day) {
+	struct simple_date sd = make_simple_date(year, month, day, 0, 0, 0);
+	return (int)(simple_date_to_wall(sd) / 86400);
+}
+
+static bool rrule_month_day(const struct rrule *r, int d, int wday,
+		int dim) {
+	if (r->bymonthday_n > 0) {
+		bool in = false;
+		for (int i = 0; i < r->bymonthday_n; ++i) {
+			int v = r->bymonthday[i];
+			if (v == d || v == d - dim - 1) in = true;
+		}
+		if (!in) return false;
+	}
+	if (!r->byday && r->byday_pos_n == 0) {
+		return r->bymonthday_n > 0 || d == r->start.day;
+	}
+	if (r->byday & 1 << wday) return true;
+	for (int i = 0; i < r->byday_pos_n; ++i) {
+		const struct rrule_byday_pos *bp = &r->byday_pos[i];
+		if (bp->wday != wday) continue;
+		int nth = bp->pos > 0 ? (d - 1) / 7 + 1 : -((dim - d) / 7 + 1);
+		if (nth == bp->pos) return true;
+	}
+	return false;
+}
+
+static void rrule_iter_fill(struct rrule_iter *it) {
+	const struct rrule *r = it->r;
+	int k = it->period++ * r->interval;
+	it->n = it->i = 0;
+	switch (r->freq) {
+	case RRULE_DAILY: ;
+		int d = it->start_day + k;
+		if (!r->byday || r->byday & 1 << weekday(d)) {
+			it->days[it->n++] = d;
+		}
+		break;
+	case RRULE_WEEKLY: ;
+		int mask = r->byday ? r->byday : 1 << weekday(it->start_day);
+		int w = it->start_day + k * 7
+			- (weekday(it->start_day) - r->wkst + 7) % 7;
+		for (int i = 0; i < 7; ++i) {
+			if (mask & 1 << weekday(w + i)) {
+				it->days[it->n++] = w + i;
+			}
+		}
+		break;
+	case RRULE_MONTHLY: ;
+		int m = r->start.year * 12 + r->start.month - 1 + k;
+		int year = floor_div(m, 12), month = m - year * 12 + 1;
+		int first = day_of(year, month, 1);
+		int dim = day_of(year, month + 1, 1) - first;
+		for (int i = 0; i < dim; ++i) {
+			int wday = weekday(first + i);
+			if (rrule_month_day(r, i + 1, wday, dim)) {
+				it->days[it->n++] = first + i;
+			}
+		}
+		break;
+	case RRULE_YEARLY: ;
+		int y = r->start.year + k;
+		int fr = day_of(y, r->start.month, 1);
+		/* feb 29 is skipped in common years */
+		if (r->start.day <= day_of(y, r->start.month + 1, 1) - fr) {
+			it->days[it->n++] = fr + r->start.day - 1;
+		}
+		break;
+	}
+}
+
+void rrule_iter_init(struct rrule_iter *it, const struct rrule *r) {
+	ts wall = simple_date_to_wall(r->start);
+	*it = (struct rrule_iter){
+		.r = r,
+		.start_day = (int)(wall / 86400 - (wall % 86400 < 0)),
+	};
+	it->time = (int)(wall - (ts)it->start_day * 86400);
+}
+
+ts rrule_iter_next(struct rrule_iter *it) {
+	const struct rrule *r = it->r;
+	while (!it->done) {
+		if (it->i == it->n) {
+			if (it->empty > RRULE_MAX_EMPTY) {
+				it->done = true;
+				break;
+			}
+			rrule_iter_fill(it);
+			it->empty = it->n > 0 ? 0 : it->empty + 1;
+			continue;
+		}
+		int day = it->days[it->i++];
+		if (day < it->start_day) continue;
+		if (r->count > 0 && it->emitted == r->count) {
+			it->done = true;
+			break;
+		}
+		struct simple_date sd =
+			simple_date_from_wall((ts)day * 86400 + it->time);
+		ts t = simple_date_to_ts(sd, r->zone);
+		if (r->until != -1 && t > r->until) {
+			it->done = true;
+			break;
+		}
+		++it->emitted;
+		return t;
+	}
+	return -1;
+}
@@ -0,0 +1,71 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <ds/hashmap.h>
+
+#include "rstr.h"
+#include "core.h"
+
+struct rstr *rstr_new(const char *s) {
+	int len = strlen(s);
+	struct rstr *r = malloc_check(sizeof(struct rstr) + len + 1);
+	atomic_init(&r->ref, 1);
+	r->interned = false;
+	r->len = len;
+	memcpy(r->s, s, len + 1);
+	return r;
+}
+
+/* hashmap<struct rstr *>, keyed by the strings themselves. the pool holds
+ * no reference, a string leaves it when its last owner lets it go */
+static struct hashmap pool;
+static bool pool_init = false;
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+struct rstr *rstr_intern(const char *s) {
+	pthread_mutex_lock(&pool_mutex);
+	if (!pool_init) {
+		hashmap_init(&pool, sizeof(struct rstr *));
+		pool_init = true;
+	}
+	struct rstr **found, *r;
+	if (hashmap_get_cstr(&pool, s, (void **)&found) == MAP_OK) {
+		r = rstr_ref(*found);
+	} else {
+		r = rstr_new(s);
+		r->interned = true;
+		asrt(hashmap_put_cstr(&pool, r->s, &r) == MAP_OK, "");
+	}
+	pthread_mutex_unlock(&pool_mutex);
+	return r;
+}
+
+struct rstr *rstr_ref(struct rstr *r) {
+	if (r) atomic_fetch_add_explicit(&r->ref, 1, memory_order_relaxed);
+	return r;
+}
+void rstr_unref(struct rstr *r) {
+	if (!r) return;
+	if (!r->interned) {
+		if (atomic_fetch_sub_explicit(&r->ref, 1,
+				memory_order_acq_rel) == 1) free(r);
+		return;
+	}
+	/* under the lock, so rstr_intern can't find it as it goes */
+	pthread_mutex_lock(&pool_mutex);
+	if (atomic_fetch_sub_explicit(&r->ref, 1,
+			memory_order_acq_rel) == 1) {
+		hashmap_del_cstr(&pool, r->s);
+		free(r);
+	}
+	pthread_mutex_unlock(&pool_mutex);
+}
+const char *rstr_cstr(const struct rstr *r) {
+	return r ? r->s : "";
+}
+size_t rstr_footprint(const struct rstr *r) {
+	if (!r) return 0;
+	int ref = atomic_load_explicit(&((struct rstr *)r)->ref,
+		memory_order_relaxed);
+	return (sizeof(struct rstr) + r->len + 1) / (ref > 0 ? ref : 1);
+}
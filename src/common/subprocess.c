@@ -1,12 +1,17 @@
 #define _GNU_SOURCE
 #include "calendar.h"
 #include "util.h"
+#include "core.h"
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <fcntl.h>
 #include <sched.h>
 #include <unistd.h>
 #include <signal.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/wait.h>
 #include <platform_utils/sys.h>
 
 void subprocess_shell(const char *cmd, const char *const argv[]) {
@@ -24,11 +29,121 @@ void subprocess_shell(const char *cmd, const char *const argv[]) {
 	}
 }
 
+/* $0 is the name, $1 the command */
+static const char notifier_script[] =
+	"cmd=$1; while IFS= read -r line; do "
+	"(set -- \"$line\"; eval \"$cmd\") & done";
+
+void subprocess_notifier_init(struct subprocess_notifier *n) {
+	*n = (struct subprocess_notifier){ .cmd = NULL, .pid = -1, .fd = -1 };
+}
+static int notifier_start(struct subprocess_notifier *n, const char *cmd) {
+	int p[2];
+	if (pipe2(p, O_CLOEXEC) != 0) return -1;
+	pid_t pid = fork();
+	if (pid == 0) {
+		dup2(p[0], 0);
+		execl("/bin/sh", "sh", "-c", notifier_script, "smuc-notify",
+			cmd, (char *)NULL);
+		_exit(1);
+	}
+	close(p[0]);
+	if (pid < 0) {
+		close(p[1]);
+		return -1;
+	}
+	/* a stuck command must not block us */
+	fcntl(p[1], F_SETFL, O_NONBLOCK);
+	n->cmd = strdup(cmd);
+	n->pid = pid;
+	n->fd = p[1];
+	return 0;
+}
+/* reaped is true if waitpid already returned the shell */
+static void notifier_stop(struct subprocess_notifier *n, bool reaped) {
+	if (!n->cmd) return;
+	/* the shell exits at the end of its input */
+	close(n->fd);
+	if (!reaped) waitpid(n->pid, NULL, 0);
+	free(n->cmd);
+	subprocess_notifier_init(n);
+}
+/* -1 with errno EPIPE if the shell is gone, instead of SIGPIPE */
+static ssize_t write_nosigpipe(int fd, const char *buf, size_t len) {
+	sigset_t set, old;
+	sigemptyset(&set);
+	sigaddset(&set, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &set, &old);
+	ssize_t res = write(fd, buf, len);
+	if (res < 0 && errno == EPIPE) {
+		int err = errno;
+		struct timespec zero = { 0 };
+		sigtimedwait(&set, NULL, &zero);
+		errno = err;
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	return res;
+}
+int subprocess_notifier_send(struct subprocess_notifier *n, const char *cmd,
+		const char *const *lines, int n_lines) {
+	if (n->cmd) {
+		pid_t w = waitpid(n->pid, NULL, WNOHANG);
+		if (w != 0) notifier_stop(n, true);
+		else if (strcmp(n->cmd, cmd) != 0) notifier_stop(n, false);
+	}
+
+	/* one line each, so newlines in them become spaces */
+	size_t len = 0;
+	for (int i = 0; i < n_lines; ++i) len += strlen(lines[i]) + 1;
+	char *buf = malloc_check(len + 1);
+	char *b = buf;
+	for (int i = 0; i < n_lines; ++i) {
+		for (const char *c = lines[i]; *c; ++c) {
+			*b++ = *c == '\n' ? ' ' : *c;
+		}
+		*b++ = '\n';
+	}
+
+	int res = -1;
+	size_t off = 0;
+	for (int tries = 0; tries < 2; ++tries) {
+		if (!n->cmd && notifier_start(n, cmd) != 0) break;
+		ssize_t k = 0;
+		while (off < len) {
+			k = write_nosigpipe(n->fd, buf + off, len - off);
+			if (k < 0 && errno == EINTR) continue;
+			if (k <= 0) break;
+			off += k;
+		}
+		if (off == len) {
+			res = 0;
+			break;
+		}
+		/* start it again if it died before it got anything */
+		if (off > 0 || k >= 0 || errno != EPIPE) break;
+		notifier_stop(n, false);
+	}
+	free(buf);
+	return res;
+}
+void subprocess_notifier_finish(struct subprocess_notifier *n) {
+	notifier_stop(n, false);
+}
+
+/* the template is a named file in $XDG_RUNTIME_DIR. the result is read
+ * back by name, so an editor that saves by renaming a new file over it
+ * works too */
+static int new_input_file(char **name) {
+	*name = create_tmpfile_template();
+	if (!*name) return -1;
+	return set_cloexec_or_close(mkstemp(*name));
+}
+
 struct subprocess_handle* subprocess_new_input(const char *file,
 		const char *argv[], void (*cb)(void*, FILE*), void *ud) {
 #if PU_SYS_HAS_CLONE3
-	char *name = create_tmpfile_template();
-	int fd = set_cloexec_or_close(mkstemp(name));
+	char *name;
+	int fd = new_input_file(&name);
 	struct subprocess_handle *res = NULL;
 
 	if (fd < 0) goto cleanup;
@@ -55,7 +170,7 @@ struct subprocess_handle* subprocess_new_input(const char *file,
 	if (pid > 0) {
 		// parent
 		fprintf(stderr, "new subprocess pidfd: %d\n", pidfd);
-		res = malloc(sizeof(struct subprocess_handle));
+		res = malloc_check(sizeof(struct subprocess_handle));
 		res->pidfd = pidfd;
 		res->name = name;
 		name = NULL;
@@ -74,6 +189,7 @@ struct subprocess_handle* subprocess_new_input(const char *file,
 	}
 
 cleanup:
+	if (name && !res) unlink(name);
 	free(name);
 	return res;
 #else
@@ -82,16 +198,21 @@ cleanup:
 }
 
 FILE *subprocess_get_result(struct subprocess_handle **handle) {
-	close((*handle)->pidfd);
+	struct subprocess_handle *h = *handle;
+	close(h->pidfd);
 
-	char *name = (*handle)->name;
-	int fd = open(name, O_RDONLY);
-	FILE *res = fdopen(fd, "r");
+	int fd = open(h->name, O_RDONLY | O_CLOEXEC);
+	FILE *res = fd < 0 ? NULL : fdopen(fd, "r");
+	if (!res && fd >= 0) close(fd);
+	unlink(h->name);
 
-	unlink(name);
-	free(name);
-	free(*handle);
+	free(h->name);
+	free(h);
 	*handle = NULL;
 	return res;
 }
 
+void subprocess_abandon(struct subprocess_handle **handle) {
+	FILE *f = subprocess_get_result(handle);
+	if (f) fclose(f);
+}
@@ -0,0 +1,104 @@
+#include <string.h>
+
+#include "timer_wheel.h"
+#include "core.h"
+
+/*
+ * Every occupied slot is ahead of now at its level, the timers in it
+ * share the higher digits with now. So the lowest occupied level holds
+ * the earliest timers, in its lowest occupied slot.
+ */
+
+static bool wheel_place(struct timer_wheel *w, struct timer_wheel_node *n) {
+	uint64_t t = n->t, now = w->now;
+	for (int l = 0; l < TIMER_WHEEL_LEVELS; ++l) {
+		int shift = TIMER_WHEEL_BITS * (l + 1);
+		if (t >> shift != now >> shift) continue;
+		int s = t >> (TIMER_WHEEL_BITS * l) & (TIMER_WHEEL_SLOTS - 1);
+		n->level = l;
+		n->slot = s;
+		n->prev = NULL;
+		n->next = w->slots[l][s];
+		if (n->next) n->next->prev = n;
+		w->slots[l][s] = n;
+		w->occupied[l] |= (uint64_t)1 << s;
+		return true;
+	}
+	n->level = -1;
+	return false;
+}
+
+static bool wheel_first(const struct timer_wheel *w, int *l, int *s) {
+	for (int i = 0; i < TIMER_WHEEL_LEVELS; ++i) {
+		if (!w->occupied[i]) continue;
+		*l = i;
+		*s = __builtin_ctzll(w->occupied[i]);
+		return true;
+	}
+	return false;
+}
+
+/* start of slot s at level l in the current turn */
+static ts wheel_slot_start(const struct timer_wheel *w, int l, int s) {
+	int shift = TIMER_WHEEL_BITS * (l + 1);
+	uint64_t base = (uint64_t)w->now >> shift << shift;
+	return base | (uint64_t)s << (TIMER_WHEEL_BITS * l);
+}
+
+void timer_wheel_init(struct timer_wheel *w, ts now) {
+	memset(w, 0, sizeof(*w));
+	w->now = now;
+}
+
+bool timer_wheel_add(struct timer_wheel *w, struct timer_wheel_node *n) {
+	if (n->t <= w->now) {
+		n->level = -1;
+		return false;
+	}
+	if (!wheel_place(w, n)) return false;
+	++w->n;
+	return true;
+}
+
+void timer_wheel_remove(struct timer_wheel *w, struct timer_wheel_node *n) {
+	if (n->level < 0) return;
+	if (n->prev) n->prev->next = n->next;
+	else w->slots[n->level][n->slot] = n->next;
+	if (n->next) n->next->prev = n->prev;
+	if (!w->slots[n->level][n->slot]) {
+		w->occupied[n->level] &= ~((uint64_t)1 << n->slot);
+	}
+	n->level = -1;
+	--w->n;
+}
+
+void timer_wheel_advance(struct timer_wheel *w, ts to, timer_wheel_cb cb,
+		void *cl) {
+	int l, s;
+	while (wheel_first(w, &l, &s)) {
+		ts r = wheel_slot_start(w, l, s);
+		if (r > to) break;
+		w->now = r;
+		struct timer_wheel_node *x = w->slots[l][s];
+		w->slots[l][s] = NULL;
+		w->occupied[l] &= ~((uint64_t)1 << s);
+		while (x) {
+			struct timer_wheel_node *next = x->next;
+			if (x->t <= w->now) {
+				x->level = -1;
+				--w->n;
+				cb(cl, x);
+			} else {
+				asrt(wheel_place(w, x), "timer wheel cascade");
+			}
+			x = next;
+		}
+	}
+	if (to > w->now) w->now = to;
+}
+
+ts timer_wheel_next(const struct timer_wheel *w) {
+	int l, s;
+	if (!wheel_first(w, &l, &s)) return -1;
+	return wheel_slot_start(w, l, s);
+}
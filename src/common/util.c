@@ -5,9 +5,11 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <sys/stat.h>
 #include <ds/vec.h>
 #include <ds/hashmap.h>
 #include <platform_utils/sys.h>
+#include <platform_utils/log.h>
 
 #include "core.h"
 #include "util.h"
@@ -89,6 +91,56 @@ os_create_anonymous_file(off_t size)
 
 /* end weston section */
 
+int atomic_write_begin(struct atomic_write *aw, const char *path) {
+	static const char suffix[] = ".tmp-XXXXXX";
+	aw->tmp = malloc_check(strlen(path) + sizeof(suffix));
+	strcpy(aw->tmp, path);
+	strcat(aw->tmp, suffix);
+
+	int fd = mkstemp(aw->tmp);
+	if (fd < 0) goto err;
+	/* keep the permissions of the file being replaced */
+	struct stat sb;
+	fchmod(fd, stat(path, &sb) == 0 ? sb.st_mode & 07777 : 0644);
+	aw->f = fdopen(fd, "w");
+	if (!aw->f) {
+		close(fd);
+		unlink(aw->tmp);
+		goto err;
+	}
+	return 0;
+err:
+	free(aw->tmp);
+	aw->tmp = NULL;
+	return -1;
+}
+/* makes a rename in the directory of path durable */
+static int fsync_parent_dir(const char *path) {
+	const char *slash = strrchr(path, '/');
+	char *dir = slash ? strndup(path, slash == path ? 1 : slash - path)
+		: strdup(".");
+	asrt(dir, "strdup");
+	int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	free(dir);
+	if (fd < 0) return -1;
+	int ret = fsync(fd);
+	close(fd);
+	return ret;
+}
+int atomic_write_end(struct atomic_write *aw, const char *path, bool ok) {
+	ok = ok && fflush(aw->f) == 0 && fsync(fileno(aw->f)) == 0;
+	ok = fclose(aw->f) == 0 && ok;
+	ok = ok && rename(aw->tmp, path) == 0;
+	/* the new file is in place either way, only durability is at stake */
+	if (ok && fsync_parent_dir(path) != 0) {
+		pu_log_info("warning: can't sync the directory of %s\n", path);
+	}
+	if (!ok) unlink(aw->tmp);
+	free(aw->tmp);
+	aw->tmp = NULL;
+	return ok ? 0 : -1;
+}
+
 /* string handling stuff */
 
 char *str_dup(const char *s) {
@@ -161,6 +213,13 @@ void vec_sort(struct vec *v, sort_lt lt, void *cl) {
 	heapsort(v->d, v->len, v->itemsize, lt, cl);
 }
 
+size_t vec_footprint(const struct vec *v) {
+	return (size_t)v->cap * v->itemsize;
+}
+size_t str_footprint(const struct str *s) {
+	return vec_footprint(&s->v);
+}
+
 struct str str_wordexp(const char *in) {
 #if PU_SYS_HAS_WORDEXP
 	struct str s = str_empty;
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
+#include <stdatomic.h>
 
 #include "core.h"
 
@@ -11,11 +12,40 @@ void asrt(bool b, const char *msg) {
 	}
 }
 
+static atomic_llong tag_n[MEM_TAG_N], tag_bytes[MEM_TAG_N];
+
 void * malloc_check(size_t size) {
 	void *p = malloc(size);
 	asrt(p, "oom");
 	return p;
 }
+void *malloc_tagged(enum mem_tag tag, size_t size) {
+	atomic_fetch_add_explicit(&tag_n[tag], 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&tag_bytes[tag], size,
+		memory_order_relaxed);
+	return malloc_check(size);
+}
+void free_tagged(enum mem_tag tag, void *p, size_t size) {
+	if (!p) return;
+	atomic_fetch_sub_explicit(&tag_n[tag], 1, memory_order_relaxed);
+	atomic_fetch_sub_explicit(&tag_bytes[tag], size,
+		memory_order_relaxed);
+	free(p);
+}
+struct mem_stat mem_stat_tag(enum mem_tag tag) {
+	return (struct mem_stat){
+		.n = atomic_load(&tag_n[tag]),
+		.bytes = atomic_load(&tag_bytes[tag]),
+	};
+}
+const char *mem_tag_name(enum mem_tag tag) {
+	switch (tag) {
+	case MEM_TAG_RECUR: return "recur";
+	case MEM_TAG_INST: return "inst";
+	case MEM_TAG_ACTIVE: return "active";
+	default: return "?";
+	}
+}
 
 int mini(int a, int b) { return a < b ? a : b; }
 int maxi(int a, int b) { return a < b ? b : a; }
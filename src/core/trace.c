@@ -0,0 +1,101 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "trace.h"
+
+struct trace_event {
+	const char *name;
+	uint64_t fr, dur;
+	int tid;
+};
+/*
+ * A slot is a seqlock: seq is the index it holds plus one once written,
+ * 0 while it is being written. Readers copy the fields and keep the copy
+ * only if seq was the index they wanted before and after, so a slot that
+ * is overwritten after the ring wraps is skipped instead of read torn.
+ */
+struct trace_slot {
+	atomic_uint_fast64_t seq;
+	_Atomic(const char *) name;
+	atomic_uint_fast64_t fr, dur;
+	atomic_int tid;
+};
+
+static struct trace_slot ring[TRACE_RING_N];
+static atomic_uint_fast64_t ring_head;
+static atomic_int next_tid;
+static _Thread_local int tid;
+
+uint64_t trace_now() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+struct trace_scope trace_begin(const char *name) {
+	return (struct trace_scope){ .name = name, .fr = trace_now() };
+}
+void trace_end(struct trace_scope sc) {
+	uint64_t to = trace_now();
+	if (!tid) tid = atomic_fetch_add(&next_tid, 1) + 1;
+	uint64_t i = atomic_fetch_add(&ring_head, 1);
+	struct trace_slot *s = &ring[i % TRACE_RING_N];
+	atomic_store_explicit(&s->seq, 0, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	atomic_store_explicit(&s->name, sc.name, memory_order_relaxed);
+	atomic_store_explicit(&s->fr, sc.fr, memory_order_relaxed);
+	atomic_store_explicit(&s->dur, to - sc.fr, memory_order_relaxed);
+	atomic_store_explicit(&s->tid, tid, memory_order_relaxed);
+	atomic_store_explicit(&s->seq, i + 1, memory_order_release);
+}
+
+/* false if slot i is not written yet, or was overwritten meanwhile */
+static bool ring_read(uint64_t i, struct trace_event *ev) {
+	struct trace_slot *s = &ring[i % TRACE_RING_N];
+	if (atomic_load_explicit(&s->seq, memory_order_acquire) != i + 1)
+		return false;
+	ev->name = atomic_load_explicit(&s->name, memory_order_relaxed);
+	ev->fr = atomic_load_explicit(&s->fr, memory_order_relaxed);
+	ev->dur = atomic_load_explicit(&s->dur, memory_order_relaxed);
+	ev->tid = atomic_load_explicit(&s->tid, memory_order_relaxed);
+	atomic_thread_fence(memory_order_acquire);
+	return atomic_load_explicit(&s->seq, memory_order_relaxed) == i + 1;
+}
+
+/* the filled part of the ring, oldest first */
+static void ring_bounds(uint64_t *fr, uint64_t *to) {
+	*to = atomic_load(&ring_head);
+	*fr = *to > TRACE_RING_N ? *to - TRACE_RING_N : 0;
+}
+
+uint64_t trace_sum(const char *name, uint64_t fr, uint64_t to) {
+	uint64_t a, b, sum = 0;
+	ring_bounds(&a, &b);
+	for (uint64_t i = a; i < b; ++i) {
+		struct trace_event ev;
+		if (!ring_read(i, &ev)) continue;
+		if (ev.fr < fr || ev.fr >= to) continue;
+		if (ev.name != name && strcmp(ev.name, name) != 0) continue;
+		sum += ev.dur;
+	}
+	return sum;
+}
+
+void trace_dump_chrome(FILE *f) {
+	uint64_t a, b;
+	ring_bounds(&a, &b);
+	bool first = true;
+	fprintf(f, "{\"traceEvents\":[\n");
+	for (uint64_t i = a; i < b; ++i) {
+		struct trace_event ev;
+		if (!ring_read(i, &ev)) continue;
+		fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+			"\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}\n",
+			first ? "" : ",", ev.name, ev.tid,
+			ev.fr / 1e3, ev.dur / 1e3);
+		first = false;
+	}
+	fprintf(f, "],\"displayTimeUnit\":\"ms\"}\n");
+}
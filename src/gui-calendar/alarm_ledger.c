@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <platform_utils/log.h>
+
+#include "alarm_ledger.h"
+#include "journal.h"
+#include "core.h"
+#include "util.h"
+
+/* rewritten once it has this many records */
+#define ALARM_LEDGER_MAX 4096
+
+static void ledger_add(struct alarm_ledger *l, struct alarm_ledger_rec r) {
+	if (r.hash == 0) {
+		if (r.t > l->mark) l->mark = r.t;
+	} else if (r.t > l->mark) {
+		vec_append(&l->delivered, &r);
+	}
+}
+/* drops the alarms the mark covers */
+static void ledger_prune(struct alarm_ledger *l) {
+	int k = 0;
+	for (int i = 0; i < l->delivered.len; ++i) {
+		struct alarm_ledger_rec *r = vec_get(&l->delivered, i);
+		if (r->t <= l->mark) continue;
+		*(struct alarm_ledger_rec *)vec_get(&l->delivered, k++) = *r;
+	}
+	l->delivered.len = k;
+}
+
+static bool put_rec(FILE *f, ts t, uint64_t hash) {
+	struct alarm_ledger_rec r = { .t = t, .hash = hash };
+	return fwrite(&r, sizeof(r), 1, f) == 1;
+}
+
+/* replaces the file with the last mark and what came after it */
+static int ledger_rewrite(struct alarm_ledger *l) {
+	const char *path = str_cstr(&l->path);
+	struct atomic_write aw;
+	if (atomic_write_begin(&aw, path) != 0) return -1;
+	bool ok = l->mark == -1 || put_rec(aw.f, l->mark, 0);
+	for (int i = 0; ok && i < l->delivered.len; ++i) {
+		struct alarm_ledger_rec *r = vec_get(&l->delivered, i);
+		ok = put_rec(aw.f, r->t, r->hash);
+	}
+	if (atomic_write_end(&aw, path, ok) != 0) return -1;
+	fclose(l->f);
+	l->f = fopen(path, "ab");
+	asrt(l->f, "alarm ledger reopen");
+	l->n = (l->mark != -1) + l->delivered.len;
+	return 0;
+}
+
+int alarm_ledger_open(struct alarm_ledger *l, const char *path) {
+	l->n = 0;
+	l->mark = -1;
+	l->delivered = vec_new_empty(sizeof(struct alarm_ledger_rec));
+	bool torn = false;
+	FILE *f = fopen(path, "rb");
+	if (f) {
+		struct alarm_ledger_rec r;
+		while (fread(&r, sizeof(r), 1, f) == 1) {
+			ledger_add(l, r);
+			++l->n;
+		}
+		/* a record cut short by a crash would shift the next ones */
+		torn = ftell(f) % (long)sizeof(r) != 0;
+		fclose(f);
+	}
+	ledger_prune(l);
+
+	l->f = fopen(path, "ab");
+	if (!l->f) {
+		vec_free(&l->delivered);
+		return -1;
+	}
+	l->path = str_new_from_cstr(path);
+	if ((torn || l->n > ALARM_LEDGER_MAX) && ledger_rewrite(l) != 0) {
+		pu_log_info("[alarm] warning: can't rewrite the ledger\n");
+	}
+	return 0;
+}
+void alarm_ledger_close(struct alarm_ledger *l) {
+	fclose(l->f);
+	str_free(&l->path);
+	vec_free(&l->delivered);
+}
+bool alarm_ledger_default_path(struct str *path) {
+	return state_file_path(path, "alarms");
+}
+
+uint64_t alarm_ledger_hash(const char *key) {
+	/* fnv-1a */
+	uint64_t h = 0xcbf29ce484222325u;
+	for (; *key; ++key) h = (h ^ (uint8_t)*key) * 0x100000001b3u;
+	return h ? h : 1;
+}
+bool alarm_ledger_delivered(const struct alarm_ledger *l, uint64_t hash,
+		ts t) {
+	if (t <= l->mark) return true;
+	for (int i = 0; i < l->delivered.len; ++i) {
+		const struct alarm_ledger_rec *r = vec_get_c(&l->delivered, i);
+		if (r->hash == hash && r->t == t) return true;
+	}
+	return false;
+}
+int alarm_ledger_append(struct alarm_ledger *l, uint64_t hash, ts t) {
+	if (!put_rec(l->f, t, hash)) return -1;
+	++l->n;
+	ledger_add(l, (struct alarm_ledger_rec){ .t = t, .hash = hash });
+	return 0;
+}
+int alarm_ledger_mark(struct alarm_ledger *l, ts t) {
+	if (t > l->mark) {
+		if (!put_rec(l->f, t, 0)) return -1;
+		++l->n;
+		l->mark = t;
+		ledger_prune(l);
+	}
+	if (fflush(l->f) != 0) return -1;
+	if (l->n > ALARM_LEDGER_MAX) return ledger_rewrite(l);
+	return 0;
+}
@@ -4,6 +4,8 @@
 #include <limits.h>
 #include <stdio.h>
 #include <sys/types.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include <errno.h>
 #include <platform_utils/log.h>
 #include <platform_utils/assets.h>
@@ -12,54 +14,79 @@
 #include "core.h"
 #include "util.h"
 #include "algo.h"
+#include "trace.h"
 #include "keyboard.h"
 #include "editor.h"
+#include "sort.h"
 
 pu_assets_declare(default_uexpr)
 
-/* provides a total ordering over todos; implements the a < b comparison */
-static bool todo_priority_cmp(
-		struct app *app,
-		const struct comp_inst *a,
-		const struct comp_inst *b,
-		bool consider_started
-	) {
-	bool a_started = a->rdp.start == -1 || a->rdp.start <= app->now;
-	bool b_started = b->rdp.start == -1 || b->rdp.start <= app->now;
-
+/* todo_key bits, from the most significant one */
+#define TODO_KEY_NOT_INPROCESS (1ULL << 63)
+#define TODO_KEY_NOT_STARTED (1ULL << 62)
+#define TODO_KEY_NOT_SHORT (1ULL << 61)
+#define TODO_KEY_NO_DUE (1ULL << 60)
+#define TODO_KEY_DUE_BIAS (1LL << 59)
+
+/*
+ * The order of the todo list packed into an integer, smaller keys come
+ * first: in process, started, short, then the earlier due date. Todos
+ * with equal keys stay in the order they were added in.
+ */
+static uint64_t todo_key(const struct app *app, const struct comp_inst *ci) {
+	uint64_t key = 0;
 	enum prop_status status;
-	bool a_inprocess = false, b_inprocess = false;
-	if (props_get_status(a->p, &status))
-		a_inprocess = status == PROP_STATUS_INPROCESS;
-	if (props_get_status(b->p, &status))
-		b_inprocess = status == PROP_STATUS_INPROCESS;
-
+	if (!props_get_status(ci->p, &status)
+			|| status != PROP_STATUS_INPROCESS) {
+		key |= TODO_KEY_NOT_INPROCESS;
+	}
+	if (ci->rdp.start != -1 && ci->rdp.start > app->now) {
+		key |= TODO_KEY_NOT_STARTED;
+	}
 	int ed;
 	const int sh = 60 * 10; // 10m
-	bool a_short = false, b_short = false;
-	if (props_get_estimated_duration(a->p, &ed)) a_short = ed <= sh;
-	if (props_get_estimated_duration(b->p, &ed)) b_short = ed <= sh;
-
-	ts a_due = a->rdp.due;
-	ts b_due = b->rdp.due;
-	bool a_has_due = a_due != -1;
-	bool b_has_due = b_due != -1;
-
-	if (a_inprocess != b_inprocess) {
-		if (a_inprocess) return true;
-		else return false;
-	} else if (consider_started && a_started != b_started) {
-		if (a_started) return true;
-		else return false;
-	} else if (a_short != b_short) {
-		if (a_short) return true;
-		else return false;
-	} else if (a_has_due || b_has_due) {
-		if (!a_has_due) return false;
-		else if (!b_has_due) return true;
-		return a_due < b_due;
+	if (!props_get_estimated_duration(ci->p, &ed) || ed > sh) {
+		key |= TODO_KEY_NOT_SHORT;
+	}
+	if (ci->rdp.due == -1) {
+		key |= TODO_KEY_NO_DUE;
+	} else {
+		ts due = max_ts(-TODO_KEY_DUE_BIAS,
+			min_ts(ci->rdp.due, TODO_KEY_DUE_BIAS - 1));
+		key |= (uint64_t)(due + TODO_KEY_DUE_BIAS);
+	}
+	return key;
+}
+
+/* for tests: the todo_key of ci, at now */
+uint64_t active_todos_test_key(ts now, const struct comp_inst *ci) {
+	struct app app = { .now = now };
+	return todo_key(&app, ci);
+}
+
+/* min-heap of ts */
+static void ts_heap_push(struct vec *h, ts v) {
+	int i = vec_append(h, &v);
+	ts *d = h->d;
+	for (; i > 0 && d[(i - 1) / 2] > d[i]; i = (i - 1) / 2) {
+		ts t = d[i];
+		d[i] = d[(i - 1) / 2];
+		d[(i - 1) / 2] = t;
+	}
+}
+static void ts_heap_pop(struct vec *h) {
+	ts *d = h->d;
+	d[0] = d[--h->len];
+	for (int i = 0;;) {
+		int m = i, l = 2 * i + 1, r = l + 1;
+		if (l < h->len && d[l] < d[m]) m = l;
+		if (r < h->len && d[r] < d[m]) m = r;
+		if (m == i) break;
+		ts t = d[i];
+		d[i] = d[m];
+		d[m] = t;
+		i = m;
 	}
-	return false;
 }
 
 struct print_template_env {
@@ -103,43 +130,26 @@ static const char ** new_editor_args(struct app *app) {
 	args[len - 1] = NULL;
 	return args;
 }
-static void application_handle_child(struct app *app, int pidfd);
-static void subprocess_pidfd_cb(void *env, struct pollfd pfd) {
-	struct app *app = env;
-	if (pfd.revents & POLLIN) {
-		event_loop_remove_fd(app->event_loop, pfd.fd);
-		application_handle_child(app, pfd.fd);
+/* the result of the editor is handled in app_editor_done */
+static void app_launch_editor(struct app *app, void (*cb)(void*, FILE*),
+		void *ud) {
+	const char **args = new_editor_args(app);
+	struct str *s = vec_get(&app->editor_args, 0);
+	if (editor_sessions_launch(&app->editors, app->now, str_cstr(s),
+			args, cb, ud) != 0) {
+		fprintf(stderr, "[editor] error: could not launch editor\n");
 	}
+	free(args);
 }
 void app_cmd_launch_editor(struct app *app, struct proj_item *pi) {
-	if (!app->sp) {
-		struct print_template_env env = {
-			.app = app,
-			.pi = pi,
-		};
-		const char **args = new_editor_args(app);
-		struct str *s = vec_get(&app->editor_args, 0);
-		app->sp = subprocess_new_input(str_cstr(s),
-			args, &print_template_callback, &env);
-		if (app->sp) {
-			event_loop_add_fd(app->event_loop, app->sp->pidfd,
-				POLLIN, app, subprocess_pidfd_cb);
-		}
-		free(args);
-	}
+	struct print_template_env env = {
+		.app = app,
+		.pi = pi,
+	};
+	app_launch_editor(app, &print_template_callback, &env);
 }
 static void app_launch_editor_str(struct app *app, const struct str *str) {
-	if (!app->sp) {
-		const char **args = new_editor_args(app);
-		struct str *s = vec_get(&app->editor_args, 0);
-		app->sp = subprocess_new_input(str_cstr(s),
-			args, &print_str_callback, (void*)str);
-		if (app->sp) {
-			event_loop_add_fd(app->event_loop, app->sp->pidfd,
-				POLLIN, app, subprocess_pidfd_cb);
-		}
-		free(args);
-	}
+	app_launch_editor(app, &print_str_callback, (void*)str);
 }
 void app_cmd_launch_editor_new(struct app *app, enum comp_type t) {
 	void (*cb)(void*, FILE*);
@@ -150,17 +160,7 @@ void app_cmd_launch_editor_new(struct app *app, enum comp_type t) {
 	} else {
 		return;
 	}
-
-	if (!app->sp) {
-		const char **args = new_editor_args(app);
-		struct str *s = vec_get(&app->editor_args, 0);
-		app->sp = subprocess_new_input(str_cstr(s), args, cb, app);
-		if (app->sp) {
-			event_loop_add_fd(app->event_loop, app->sp->pidfd,
-				POLLIN, app, subprocess_pidfd_cb);
-		}
-		free(args);
-	}
+	app_launch_editor(app, cb, app);
 }
 
 struct ac_iter_assign_code_env {
@@ -219,57 +219,6 @@ static void app_switch_mode_select(struct app *app) {
 	}
 }
 
-// static void schedule_active_todos(struct app *app) {
-//	 struct vec E = vec_new_empty(sizeof(struct ts_ran));
-//	 for (int i = 0; i < app->cals.len; ++i) {
-//		 struct calendar *cal = vec_get(&app->cals, i);
-//		 for (int j = 0; j < cal->cis.len; ++j) {
-//			 struct comp_inst *ci = vec_get(&cal->cis, j);
-//			 enum prop_status status;
-//			 bool has_status = props_get_status(ci->p, &status);
-//			 if (has_status && status == PROP_STATUS_CONFIRMED) {
-//				 vec_append(&E, &ci->time);
-//			 }
-//		 }
-//	 }
-// 
-//	 struct vec T = vec_new_empty(sizeof(struct schedule_todo));
-//	 struct vec acs = vec_new_empty(sizeof(struct active_comp *));
-//	 for (int i = 0; i < app->active_todos.len; ++i) {
-//		 struct active_comp *ac = vec_get(&app->active_todos, i);
-// 
-//		 ts start;
-//		 bool has_start = props_get_start(ac->ci->p, &start);
-//		 int est;
-//		 bool has_est = props_get_estimated_duration(ac->ci->p, &est);
-//		 if (has_est) {
-//			 struct schedule_todo st = {
-//				 .start = has_start ? start : -1,
-//				 .estimated_duration = est };
-//			 vec_append(&T, &st);
-//			 vec_append(&acs, &ac);
-//		 }
-//	 }
-// 
-//	 struct ts_ran *G = todo_schedule(app->now, E.len, E.d, T.len, T.d);
-// 
-//	 vec_free(&E);
-//	 vec_free(&T);
-// 
-//	 for (int i = 0; i < acs.len; ++i) {
-//		 struct active_comp **acp = vec_get(&acs, i);
-//		 struct tobject obj = (struct tobject){
-//			 .time = G[i],
-//			 .type = TOBJECT_TODO,
-//			 .ac = *acp
-//		 };
-//		 tslice_try_put(&app->slice_main, obj);
-//	 }
-// 
-//	 vec_free(&acs);
-//	 free(G);
-// }
-
 static void execute_filter(struct app *app, int fn, struct proj_item *pi,
 		struct comp_display_settings *settings) {
 	struct cal_uexpr_env env = {
@@ -299,24 +248,18 @@ static void execute_current_filter(struct app *app, struct proj_item *pi,
 	}
 }
 
-static bool active_comp_todo_cmp(void *pa, void *pb, void *cl) {
-	struct app *app = cl;
-	const struct active_comp *a = pa, *b = pb;
-	return todo_priority_cmp(app, a->ci, b->ci, true);
-}
-
 static void app_expand(struct app *app, enum comp_type type, ts expand_to) {
-	for (int i = 0; i < app->cals.len; ++i) {
-		struct calendar *cal = vec_get(&app->cals, i);
-		calendar_expand_instances_to(cal, type, expand_to);
-	}
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	calendars_expand_instances_to(&app->cals, type, expand_to,
+		maxi(ncpu, 1));
 }
 
 static void proj_active_events_add(void *_self, struct proj_item pi) {
 	struct proj_active_events *self = _self;
 	asrt(pi.ci->c->type == COMP_TYPE_EVENT, "");
 
-	struct active_comp *ac = malloc_check(sizeof(struct active_comp));
+	struct active_comp *ac =
+		malloc_tagged(MEM_TAG_ACTIVE, sizeof(struct active_comp));
 	*ac = (struct active_comp){
 		.ci = pi.ci,
 		.cal_index = pi.cal_index,
@@ -340,7 +283,7 @@ static void proj_active_events_clear(void *_self) {
 			struct interval_node, node);
 		struct active_comp *ac = container_of(nx,
 			struct active_comp, node);
-		free(ac);
+		free_tagged(MEM_TAG_ACTIVE, ac, sizeof(struct active_comp));
 	}
 
 	for (int i = 0; i < self->processed.len; ++i) {
@@ -348,13 +291,15 @@ static void proj_active_events_clear(void *_self) {
 			*(struct active_comp**)vec_get(&self->processed, i);
 		mgu_texture_destroy(&ac->tex);
 		mgu_texture_destroy(&ac->loc_tex);
-		free(ac);
+		free_tagged(MEM_TAG_ACTIVE, ac, sizeof(struct active_comp));
 	}
 	vec_clear(&self->processed);
 	rb_tree_init(&self->unprocessed, &interval_ops);
 	rb_tree_init(&self->processed_not_hidden, &interval_ops);
 	rb_tree_init(&self->in_view, &interval_ops);
 	rb_tree_init(&self->not_in_view, &interval_ops);
+	rb_tree_init(&self->in_view_by_end, &rb_integer_ops);
+	rb_tree_init(&self->in_view_by_start, &rb_integer_ops);
 }
 static bool proj_active_events_type(void *_self, enum comp_type t) {
 	return t == COMP_TYPE_EVENT;
@@ -367,6 +312,8 @@ static struct proj proj_active_events_init(struct proj_active_events *self,
 	rb_tree_init(&self->processed_not_hidden, &interval_ops);
 	rb_tree_init(&self->in_view, &interval_ops);
 	rb_tree_init(&self->not_in_view, &interval_ops);
+	rb_tree_init(&self->in_view_by_end, &rb_integer_ops);
+	rb_tree_init(&self->in_view_by_start, &rb_integer_ops);
 	return (struct proj){
 		.self = self,
 		.add = proj_active_events_add,
@@ -397,59 +344,125 @@ static void in_view_destroy_texs(struct app *app) {
 		mgu_texture_destroy(&ac->loc_tex);
 	}
 }
-static void proj_active_events_process(struct proj_active_events *self,
-		struct ts_ran ran) {
+static void in_view_insert(struct proj_active_events *self,
+		struct active_comp *ac) {
+	rb_insert(&self->in_view, &ac->node_by_view.node);
+	ac->by_end.val = ac->node_by_view.ran[1];
+	ac->by_start.val = -ac->node_by_view.ran[0];
+	rb_insert(&self->in_view_by_end, &ac->by_end.node);
+	rb_insert(&self->in_view_by_start, &ac->by_start.node);
+}
+static void in_view_delete(struct proj_active_events *self,
+		struct active_comp *ac) {
+	rb_delete(&self->in_view, &ac->node_by_view.node);
+	rb_delete(&self->in_view_by_end, &ac->by_end.node);
+	rb_delete(&self->in_view_by_start, &ac->by_start.node);
+}
+/* the events at the beginning of T, while the key is at most lim, that
+ * no longer overlap ran_in. the boundary is checked with the overlap
+ * test of the interval tree */
+static void in_view_leaving(struct vec *move, struct rb_tree *T, ts lim,
+		bool by_end, long long int ran_in[2]) {
+	struct rb_iter iter = rb_iter(T, RB_ITER_ORDER_IN);
+	struct rb_node *x;
+	while (rb_iter_next(&iter, &x)) {
+		struct rb_integer_node *nx =
+			container_of(x, struct rb_integer_node, node);
+		if (nx->val > lim) break;
+		struct active_comp *ac = by_end
+			? container_of(nx, struct active_comp, by_end)
+			: container_of(nx, struct active_comp, by_start);
+		if (!interval_overlap(ac->node_by_view.ran, ran_in)) {
+			vec_append(move, &ac);
+		}
+	}
+}
+/* fixes up in_view and not_in_view for the new view ran */
+static void in_view_move(struct proj_active_events *self, struct ts_ran ran) {
 	struct interval_iter i_iter;
 	struct interval_node *nx;
-
-	/* first of all, fix up in_view and not_in_view for this new ran */
-	long long int ran_left[] = { LLONG_MIN, ran.fr };
 	long long int ran_in[] = { ran.fr, ran.to };
-	long long int ran_right[] = { ran.to, LLONG_MAX };
-	struct vec move = vec_new_empty(sizeof(struct rb_node *));
-	i_iter = interval_iter(&self->not_in_view, ran_in);
-	while (interval_iter_next(&i_iter, &nx)) {
-		struct rb_node *x = &nx->node;
-		vec_append(&move, &x);
-	}
+	struct vec move = vec_new_empty(sizeof(struct active_comp *));
+	/* ending before the view, then starting after it */
+	in_view_leaving(&move, &self->in_view_by_end, ran.fr, true, ran_in);
+	int left = move.len;
+	in_view_leaving(&move, &self->in_view_by_start, -ran.to, false,
+		ran_in);
 	for (int i = 0; i < move.len; ++i) {
-		struct rb_node *x = *(struct rb_node **)vec_get(&move, i);
-		struct interval_node *nx =
-			container_of(x, struct interval_node, node);
 		struct active_comp *ac =
-			container_of(nx, struct active_comp, node_by_view);
-		in_view_changed(self->app, ac, true);
-		rb_delete(&self->not_in_view, x);
-		rb_insert(&self->in_view, x);
+			*(struct active_comp **)vec_get(&move, i);
+		/* a zero length event can be on both sides */
+		if (i >= left && ac->node_by_view.ran[1] <= ran.fr) continue;
+		in_view_changed(self->app, ac, false);
+		in_view_delete(self, ac);
+		rb_insert(&self->not_in_view, &ac->node_by_view.node);
 	}
 	vec_clear(&move);
-	// TODO: there is no "not in range" query, so this is the best we can do
-	i_iter = interval_iter(&self->in_view, ran_left);
-	while (interval_iter_next(&i_iter, &nx)) {
-		struct rb_node *x = &nx->node;
-		if (!interval_overlap(nx->ran, ran_in)) {
-			vec_append(&move, &x);
-		}
-	}
-	i_iter = interval_iter(&self->in_view, ran_right);
+
+	i_iter = interval_iter(&self->not_in_view, ran_in);
 	while (interval_iter_next(&i_iter, &nx)) {
-		struct rb_node *x = &nx->node;
-		if (!interval_overlap(nx->ran, ran_in)
-				&& !interval_overlap(nx->ran, ran_left)) {
-			vec_append(&move, &x);
-		}
+		struct active_comp *ac =
+			container_of(nx, struct active_comp, node_by_view);
+		vec_append(&move, &ac);
 	}
 	for (int i = 0; i < move.len; ++i) {
-		struct rb_node *x = *(struct rb_node **)vec_get(&move, i);
-		struct interval_node *nx =
-			container_of(x, struct interval_node, node);
 		struct active_comp *ac =
-			container_of(nx, struct active_comp, node_by_view);
-		in_view_changed(self->app, ac, false);
-		rb_delete(&self->in_view, x);
-		rb_insert(&self->not_in_view, x);
+			*(struct active_comp **)vec_get(&move, i);
+		in_view_changed(self->app, ac, true);
+		rb_delete(&self->not_in_view, &ac->node_by_view.node);
+		in_view_insert(self, ac);
 	}
 	vec_free(&move);
+}
+
+/* for tests: the n events of evs are panned over by the m views. after
+ * view j, in_view[j * n + i] is set if event i is in view */
+void active_events_test_pan(const struct ts_ran *evs, int n,
+		const struct ts_ran *views, int m, bool *in_view) {
+	struct proj_active_events self;
+	proj_active_events_init(&self, NULL);
+	struct active_comp *acs = malloc_check(sizeof(*acs) * (n + 1));
+	for (int i = 0; i < n; ++i) {
+		acs[i] = (struct active_comp){ .cal_index = i };
+		acs[i].node_by_view.ran[0] = evs[i].fr;
+		acs[i].node_by_view.ran[1] = evs[i].to;
+		rb_insert(&self.not_in_view, &acs[i].node_by_view.node);
+	}
+	for (int j = 0; j < m; ++j) {
+		in_view_move(&self, views[j]);
+		bool *res = in_view + j * n;
+		for (int i = 0; i < n; ++i) res[i] = false;
+		int k = 0;
+		struct rb_iter iter = rb_iter(&self.in_view, RB_ITER_ORDER_IN);
+		struct rb_node *x;
+		while (rb_iter_next(&iter, &x)) {
+			struct active_comp *ac = container_of(x,
+				struct active_comp, node_by_view.node);
+			res[ac->cal_index] = true;
+			++k;
+		}
+		/* the edge trees hold the same events */
+		struct rb_tree *edges[] = {
+			&self.in_view_by_end, &self.in_view_by_start };
+		for (int e = 0; e < 2; ++e) {
+			int k_e = 0;
+			iter = rb_iter(edges[e], RB_ITER_ORDER_IN);
+			while (rb_iter_next(&iter, &x)) ++k_e;
+			asrt(k_e == k, "edge tree out of sync");
+		}
+	}
+	vec_free(&self.processed);
+	free(acs);
+}
+
+static void proj_active_events_process(struct proj_active_events *self,
+		struct ts_ran ran) {
+	struct interval_iter i_iter;
+	struct interval_node *nx;
+	long long int ran_in[] = { ran.fr, ran.to };
+
+	/* first of all, fix up in_view and not_in_view for this new ran */
+	in_view_move(self, ran);
 
 	int from = self->processed.len;
 	i_iter = interval_iter(&self->unprocessed, ran_in);
@@ -464,6 +477,8 @@ static void proj_active_events_process(struct proj_active_events *self,
 		execute_current_filter(self->app, &pi, &ac->settings);
 		vec_append(&self->processed, &ac);
 	}
+	/* hidden events no longer count as busy */
+	if (from < self->processed.len) self->app->todo_schedule_dirty = true;
 	for (int i = from; i < self->processed.len; ++i) {
 		struct active_comp *ac =
 			*(struct active_comp**)vec_get(&self->processed, i);
@@ -472,8 +487,7 @@ static void proj_active_events_process(struct proj_active_events *self,
 			rb_insert(&self->processed_not_hidden, &ac->node.node);
 			if (interval_overlap(ran_in, ac->node.ran)) {
 				in_view_changed(self->app, ac, true);
-				rb_insert(&self->in_view,
-					&ac->node_by_view.node);
+				in_view_insert(self, ac);
 			} else {
 				rb_insert(&self->not_in_view,
 					&ac->node_by_view.node);
@@ -481,6 +495,36 @@ static void proj_active_events_process(struct proj_active_events *self,
 		}
 	}
 }
+/* identifies an instance across a clear, in a calendar that did not
+ * change */
+static struct str todo_kept_key(int cal_index, const struct comp_inst *ci) {
+	char buf[64];
+	snprintf(buf, sizeof(buf), "%d %d %lld",
+		cal_index, ci->comp_idx, ci->recurrence_id);
+	return str_new_from_cstr(buf);
+}
+/* binds the kept todo of ac's instance to it, unless it looks different */
+static bool proj_active_todos_rebind(struct proj_active_todos *self,
+		const struct active_comp *ac) {
+	struct str key = todo_kept_key(ac->cal_index, ac->ci);
+	int *idx;
+	bool found = hashmap_get_cstr(&self->kept_map, str_cstr(&key),
+		(void**)&idx) == MAP_OK;
+	str_free(&key);
+	if (!found) return false;
+	struct active_comp *k = vec_get(&self->kept, *idx);
+	if (k->ci || k->todo_key != ac->todo_key
+			|| k->settings.fade != ac->settings.fade
+			|| k->settings.hide != ac->settings.hide) {
+		return false;
+	}
+	k->ci = ac->ci;
+	return true;
+}
+static void active_todo_free(struct active_comp *ac) {
+	todo_row_finish(&ac->row);
+	mgu_texture_destroy(&ac->tex);
+}
 static void proj_active_todos_add(void *_self, struct proj_item pi) {
 	struct proj_active_todos *self = _self;
 	asrt(pi.ci->c->type == COMP_TYPE_TODO, "");
@@ -496,6 +540,7 @@ static void proj_active_todos_add(void *_self, struct proj_item pi) {
 		.cal_index = pi.cal_index,
 		.cal = pi.cal,
 		.settings = { .fade = false, .hide = false, .vis = true },
+		.slot = { -1, -1 },
 	};
 
 	if (has_status && (status == PROP_STATUS_COMPLETED
@@ -507,15 +552,156 @@ static void proj_active_todos_add(void *_self, struct proj_item pi) {
 	execute_current_filter(self->app, &pi, &ac.settings);
 	if (!ac.settings.vis) return;
 
+	ac.todo_key = todo_key(self->app, pi.ci);
+	if (ac.todo_key & TODO_KEY_NOT_STARTED) {
+		ts_heap_push(&self->starts, pi.ci->rdp.start);
+	}
+	if (self->kept.len > 0 && proj_active_todos_rebind(self, &ac)) return;
 	vec_append(&self->v, &ac);
 }
+struct todo_order {
+	uint64_t key;
+	int i;
+};
+#define TODO_ORDER_LT(a, b) ((a)->key < (b)->key \
+	|| ((a)->key == (b)->key && (a)->i < (b)->i))
+SORT_DEFINE(sort_todo_order, struct todo_order, TODO_ORDER_LT)
+/* sorts v[sorted..] by key and merges it into v[..sorted] */
+static void proj_active_todos_merge(struct proj_active_todos *self) {
+	int n = self->v.len, m = n - self->sorted;
+	if (m == 0) return;
+	struct todo_order *o = malloc_check(sizeof(struct todo_order) * m);
+	for (int i = 0; i < m; ++i) {
+		const struct active_comp *ac =
+			vec_get(&self->v, self->sorted + i);
+		o[i] = (struct todo_order){ ac->todo_key, self->sorted + i };
+	}
+	sort_todo_order(o, m);
+
+	struct vec out = vec_new_empty(sizeof(struct active_comp));
+	const struct active_comp *d = self->v.d;
+	int a = 0, b = 0;
+	while (a < self->sorted || b < m) {
+		if (b == m || (a < self->sorted
+				&& d[a].todo_key <= o[b].key)) {
+			vec_append(&out, &d[a++]);
+		} else {
+			vec_append(&out, &d[o[b++].i]);
+		}
+	}
+	free(o);
+	vec_free(&self->v);
+	self->v = out;
+	self->sorted = n;
+}
+/* moves the kept todos that were bound again to the front of v, they
+ * are in order already */
+static void proj_active_todos_unkeep(struct proj_active_todos *self) {
+	struct vec out = vec_new_empty(sizeof(struct active_comp));
+	for (int i = 0; i < self->kept.len; ++i) {
+		struct active_comp *ac = vec_get(&self->kept, i);
+		if (ac->ci) vec_append(&out, ac);
+		else active_todo_free(ac);
+		str_free(vec_get(&self->kept_keys, i));
+	}
+	vec_clear(&self->kept);
+	vec_clear(&self->kept_keys);
+	hashmap_finish(&self->kept_map);
+	hashmap_init(&self->kept_map, sizeof(int));
+
+	asrt(self->sorted == 0, "active todos not cleared");
+	self->sorted = out.len;
+	for (int i = 0; i < self->v.len; ++i) {
+		vec_append(&out, vec_get(&self->v, i));
+	}
+	vec_free(&self->v);
+	self->v = out;
+}
 static void proj_active_todos_done(void *_self) {
 	struct proj_active_todos *self = _self;
-	vec_sort(&self->v, &active_comp_todo_cmp, self->app);
-}
+	if (self->kept.len > 0) proj_active_todos_unkeep(self);
+	proj_active_todos_merge(self);
+	/* the schedule points into v */
+	self->app->todo_schedule_dirty = true;
+}
+/* rekeys the todos that started since the last call */
+static void proj_active_todos_update_now(struct proj_active_todos *self) {
+	ts now = self->app->now;
+	if (self->starts.len == 0 || *(ts *)vec_get(&self->starts, 0) > now)
+		return;
+	while (self->starts.len > 0
+			&& *(ts *)vec_get(&self->starts, 0) <= now) {
+		ts_heap_pop(&self->starts);
+	}
+
+	/* move the rekeyed ones behind the rest, then merge them back */
+	asrt(self->sorted == self->v.len, "active todos not merged");
+	struct vec moved = vec_new_empty(sizeof(struct active_comp));
+	int k = 0;
+	for (int i = 0; i < self->v.len; ++i) {
+		struct active_comp *ac = vec_get(&self->v, i);
+		if ((ac->todo_key & TODO_KEY_NOT_STARTED)
+				&& ac->ci->rdp.start <= now) {
+			ac->todo_key &= ~TODO_KEY_NOT_STARTED;
+			vec_append(&moved, ac);
+		} else {
+			*(struct active_comp *)vec_get(&self->v, k++) = *ac;
+		}
+	}
+	self->v.len = k;
+	self->sorted = k;
+	for (int i = 0; i < moved.len; ++i) {
+		vec_append(&self->v, vec_get(&moved, i));
+	}
+	vec_free(&moved);
+	proj_active_todos_done(self);
+}
+/*
+ * Keeps the todos of the calendars that did not change, so an edit only
+ * sorts in the todos of its calendar again. Runs before the calendars are
+ * all marked dirty for the expansion.
+ */
 static void proj_active_todos_clear(void *_self) {
 	struct proj_active_todos *self = _self;
+	/* what an earlier clear kept, if there was no done since */
+	int k = 0;
+	for (int i = 0; i < self->kept.len; ++i) {
+		struct active_comp *ac = vec_get(&self->kept, i);
+		struct str *key = vec_get(&self->kept_keys, i);
+		if (ac->cal->cis_dirty[COMP_TYPE_TODO]) {
+			active_todo_free(ac);
+			str_free(key);
+			continue;
+		}
+		*(struct active_comp *)vec_get(&self->kept, k) = *ac;
+		*(struct str *)vec_get(&self->kept_keys, k++) = *key;
+	}
+	self->kept.len = k;
+	self->kept_keys.len = k;
+	for (int i = 0; i < self->v.len; ++i) {
+		struct active_comp *ac = vec_get(&self->v, i);
+		if (i >= self->sorted || ac->cal->cis_dirty[COMP_TYPE_TODO]) {
+			active_todo_free(ac);
+			continue;
+		}
+		struct str key = todo_kept_key(ac->cal_index, ac->ci);
+		/* the instances are freed after the clear */
+		ac->ci = NULL;
+		vec_append(&self->kept, ac);
+		vec_append(&self->kept_keys, &key);
+	}
+	hashmap_finish(&self->kept_map);
+	hashmap_init(&self->kept_map, sizeof(int));
+	for (int i = 0; i < self->kept_keys.len; ++i) {
+		const struct str *key = vec_get(&self->kept_keys, i);
+		hashmap_put_cstr(&self->kept_map, str_cstr(key), &i);
+	}
+
 	vec_clear(&self->v);
+	vec_clear(&self->starts);
+	self->sorted = 0;
+	vec_clear(&self->app->todo_schedule);
+	self->app->todo_schedule_dirty = true;
 }
 static bool proj_active_todos_type(void *_self, enum comp_type t) {
 	return t == COMP_TYPE_TODO;
@@ -524,6 +710,11 @@ static struct proj proj_active_todos_init(struct proj_active_todos *self,
 		struct app *app) {
 	self->app = app;
 	self->v = vec_new_empty(sizeof(struct active_comp));
+	self->sorted = 0;
+	self->kept = vec_new_empty(sizeof(struct active_comp));
+	self->kept_keys = vec_new_empty(sizeof(struct str));
+	hashmap_init(&self->kept_map, sizeof(int));
+	self->starts = vec_new_empty(sizeof(ts));
 	return (struct proj){
 		.self = self,
 		.add = proj_active_todos_add,
@@ -532,157 +723,551 @@ static struct proj proj_active_todos_init(struct proj_active_todos *self,
 		.type = proj_active_todos_type,
 	};
 }
+static void proj_active_todos_finish(struct proj_active_todos *self) {
+	for (int i = 0; i < self->v.len; ++i) {
+		active_todo_free(vec_get(&self->v, i));
+	}
+	for (int i = 0; i < self->kept.len; ++i) {
+		active_todo_free(vec_get(&self->kept, i));
+		str_free(vec_get(&self->kept_keys, i));
+	}
+	vec_free(&self->v);
+	vec_free(&self->kept);
+	vec_free(&self->kept_keys);
+	hashmap_finish(&self->kept_map);
+	vec_free(&self->starts);
+}
+static void alarm_comp_free(struct proj_alarm *self,
+		struct alarm_comp *alc) {
+	timer_wheel_remove(&self->wheel, &alc->node);
+	hashmap_del_cstr(&self->map, str_cstr(&alc->key));
+	str_free(&alc->key);
+	free_tagged(MEM_TAG_ACTIVE, alc, sizeof(struct alarm_comp));
+}
+/* schedules the alarm at t, or moves it there. takes key */
+static void proj_alarm_put(struct proj_alarm *self, struct proj_item *pi,
+		struct comp_display_settings *settings, struct str key,
+		ts t, ts now) {
+	struct alarm_comp **p, *alc;
+	if (hashmap_get_cstr(&self->map, str_cstr(&key), (void**)&p)
+			== MAP_OK) {
+		alc = *p;
+		str_free(&key);
+		/* one that is due but not delivered yet stays */
+		if (alc->node.t != t) {
+			timer_wheel_remove(&self->wheel, &alc->node);
+			alc->node.t = t;
+			if (!timer_wheel_add(&self->wheel, &alc->node)) {
+				alarm_comp_free(self, alc);
+				return;
+			}
+		}
+	} else {
+		/* the ones between the mark and now were missed, unless the
+		 * ledger says they went off before a crash */
+		if (t <= self->wheel.now || (t <= now && self->has_ledger
+				&& alarm_ledger_delivered(&self->ledger,
+				alarm_ledger_hash(str_cstr(&key)), t))) {
+			str_free(&key);
+			return;
+		}
+		alc = malloc_tagged(MEM_TAG_ACTIVE, sizeof(struct alarm_comp));
+		alc->node.t = t;
+		alc->key = key;
+		asrt(timer_wheel_add(&self->wheel, &alc->node), "alarm add");
+		hashmap_put_cstr(&self->map, str_cstr(&alc->key), &alc);
+	}
+	alc->pi = *pi;
+	alc->settings = *settings;
+	alc->gen = self->gen;
+}
 static void proj_alarm_add(void *_self, struct proj_item pi) {
 	struct proj_alarm *self = _self;
-
-	ts due = 0, start = 0;
-	bool has_due = props_get_due(pi.ci->p, &due);
-	bool has_start = props_get_start(pi.ci->p, &start);
-	(void)has_start;
-	struct alarm_comp alc = {
-		.pi = pi,
-		.node.val = has_due ? due : start
+	struct comp_display_settings settings = { 0 };
+	execute_filter(self->app, self->uexpr_filter, &pi, &settings);
+	if (!settings.vis) return;
+
+	/* without a VALARM, at the due date of todos and the start of
+	 * events */
+	const struct comp *c = pi.ci->c;
+	struct comp_alarm def = {
+		.related = c->type == COMP_TYPE_TODO
+			? COMP_ALARM_END : COMP_ALARM_START,
 	};
-	execute_filter(self->app, self->uexpr_filter, &alc.pi, &alc.settings);
-	if (alc.settings.vis) {
-		struct alarm_comp *alc_p =
-			malloc_check(sizeof(struct alarm_comp));
-		*alc_p = alc;
-		rb_insert(&self->tree, &alc_p->node.node);
+	const struct comp_alarm *alarms = &def;
+	int n = 1;
+	if (c->alarms.len > 0) {
+		alarms = vec_get_c(&c->alarms, 0);
+		n = c->alarms.len;
+	}
+
+	ts now = self->app->now;
+	const char *uid = str_cstr(&c->uid);
+	for (int i = 0; i < n; ++i) {
+		const struct comp_alarm *a = &alarms[i];
+		/* an absolute trigger is the same for every instance */
+		ts rid = a->related == COMP_ALARM_ABSOLUTE
+			? -1 : pi.ci->recurrence_id;
+		for (int r = 0; r <= a->repeat; ++r) {
+			ts t = comp_alarm_time(a, &pi.ci->rdp, r);
+			if (t == -1) continue;
+			char buf[64];
+			snprintf(buf, sizeof(buf), "%d %lld %d %d ",
+				pi.cal_index, rid, i, r);
+			struct str key = str_new_from_cstr(buf);
+			str_append(&key, uid, strlen(uid));
+			proj_alarm_put(self, &pi, &settings, key, t, now);
+		}
+	}
+}
+/* frees the alarms that were not added since the last clear */
+static void proj_alarm_sweep(struct proj_alarm *self) {
+	struct vec old = vec_new_empty(sizeof(struct alarm_comp *));
+	struct hashmap_iter iter = hashmap_iter(&self->map);
+	struct alarm_comp **p;
+	while (hashmap_iter_next(&iter, (void**)&p)) {
+		if ((*p)->gen != self->gen) vec_append(&old, p);
+	}
+	for (int i = 0; i < old.len; ++i) {
+		struct alarm_comp **alc = vec_get(&old, i);
+		alarm_comp_free(self, *alc);
+	}
+	vec_free(&old);
+	self->stale = false;
+}
+static void proj_alarm_arm(struct proj_alarm *self) {
+	ts next = timer_wheel_next(&self->wheel);
+	if (next == -1) {
+		pu_log_info("[alarm] none pending\n");
+		return;
+	}
+	pu_log_info("[alarm] %d pending, next check at %lld\n",
+		self->wheel.n, next);
+	struct timespec ts = { .tv_sec = next };
+	event_loop_timer_set_abs(&self->app->alarm_timer, ts);
+}
+static void alarm_fired(void *cl, struct timer_wheel_node *n) {
+	struct alarm_comp *alc = container_of(n, struct alarm_comp, node);
+	vec_append(cl, &alc);
+}
+/* everything that is due goes to the notifier as one batch, the missed
+ * ones too */
+static void proj_alarm_deliver(struct proj_alarm *self) {
+	ts now = self->app->now;
+	struct vec fired = vec_new_empty(sizeof(struct alarm_comp *));
+	timer_wheel_advance(&self->wheel, now, alarm_fired, &fired);
+	if (fired.len > 0) {
+		const char **lines = malloc_check(sizeof(char *) * fired.len);
+		for (int i = 0; i < fired.len; ++i) {
+			struct alarm_comp *alc =
+				*(struct alarm_comp **)vec_get(&fired, i);
+			const char *summary = props_get_summary(alc->pi.ci->p);
+			lines[i] = summary ? summary : "";
+			pu_log_info("[alarm] ALARM for %s%s\n", lines[i],
+				alc->node.t < now - 60 ? " (missed)" : "");
+		}
+		if (subprocess_notifier_send(&self->notifier, self->shell_cmd,
+				lines, fired.len) != 0) {
+			pu_log_info("[alarm] could not notify\n");
+		}
+		free(lines);
+	}
+	for (int i = 0; i < fired.len; ++i) {
+		struct alarm_comp **alc = vec_get(&fired, i);
+		if (self->has_ledger) {
+			alarm_ledger_append(&self->ledger,
+				alarm_ledger_hash(str_cstr(&(*alc)->key)),
+				(*alc)->node.t);
+		}
+		alarm_comp_free(self, *alc);
+	}
+	vec_free(&fired);
+	if (self->has_ledger && alarm_ledger_mark(&self->ledger,
+			self->wheel.now) != 0) {
+		pu_log_info("[alarm] warning: can't write the ledger\n");
 	}
 }
 static void proj_alarm_done(void *_self) {
 	struct proj_alarm *self = _self;
-
-	struct timespec now;
-	asrt(clock_gettime(CLOCK_REALTIME, &now) == 0, "");
-	struct rb_integer_node *n =
-		rb_integer_min_greater(&self->tree, now.tv_sec);
-
-	self->next = NULL;
-	if (n) {
-		struct alarm_comp *alc =
-			container_of(n, struct alarm_comp, node);
-		self->next = alc;
-		pu_log_info("[alarm] next at: %lld [now: %ld], %s\n",
-			n->val, now.tv_sec, props_get_summary(alc->pi.ci->p));
-		struct timespec ts = { .tv_sec = n->val };
-		event_loop_timer_set_abs(&self->app->alarm_timer, ts);
-	} else {
-		pu_log_info("[alarm] no next [now: %ld]\n", now.tv_sec);
-	}
+	proj_alarm_sweep(self);
+	proj_alarm_deliver(self);
+	proj_alarm_arm(self);
 }
 static void alarm_cb(void *env) {
 	struct app *app = env;
-	struct alarm_comp *alc = app->alarm_comps.next;
-	asrt(alc, "alarm next");
-	const char *summary = props_get_summary(alc->pi.ci->p);
-	pu_log_info("[alarm] ALARM for %s\n", summary);
-	const char *argv[] = { "-", summary, NULL };
-	subprocess_shell(app->alarm_comps.shell_cmd, argv);
-	proj_alarm_done(&app->alarm_comps);
+	struct proj_alarm *self = &app->alarm_comps;
+	/* now moves with the frames, and there may be none drawn */
+	ts now = ts_now();
+	if (!app->fixed_now && app->now != now) {
+		app->now = now;
+		app->dirty = true;
+	}
+	/* an edit freed the instances the alarms point to */
+	if (self->stale) app_update_projections(app);
+	proj_alarm_deliver(self);
+	proj_alarm_arm(self);
+}
+/* cancelled comps and completed todos have nothing left to remind of,
+ * unless an instance of theirs has a status of its own */
+static bool proj_alarm_want(void *_self, const struct comp *c) {
+	enum prop_status status;
+	if (c->recur_insts.len > 0 || !props_get_status(&c->p, &status))
+		return true;
+	if (status == PROP_STATUS_CANCELLED) return false;
+	return c->type != COMP_TYPE_TODO || status != PROP_STATUS_COMPLETED;
 }
-static void proj_alarm_clear(void *_self) {
+/* for tests */
+bool alarm_comps_test_want(const struct comp *c) {
+	return proj_alarm_want(NULL, c);
+}
+/* without a command to notify with, no alarms are kept at all */
+static bool proj_alarm_type(void *_self, enum comp_type type) {
 	struct proj_alarm *self = _self;
-
-	struct rb_iter iter = rb_iter(&self->tree, RB_ITER_ORDER_POST);
-	struct rb_node *x;
-	while (rb_iter_next(&iter, &x)) {
-		struct rb_integer_node *nx =
-			container_of(x, struct rb_integer_node, node);
-		struct alarm_comp *alc =
-			container_of(nx, struct alarm_comp, node);
-		free(alc);
+	return self->shell_cmd != NULL;
+}
+/* the latest any alarm of an event goes off after its start or end, or
+ * LLONG_MAX if one is absolute, the same for every instance */
+static ts alarms_late(struct app *app) {
+	ts late = 0;
+	for (int j = 0; j < app->cals.len; ++j) {
+		struct calendar *cal = vec_get(&app->cals, j);
+		for (int i = 0; i < cal->comps_vec.len; ++i) {
+			struct comp *c = calendar_get_comp(cal, i);
+			if (c->type != COMP_TYPE_EVENT) continue;
+			for (int k = 0; k < c->alarms.len; ++k) {
+				const struct comp_alarm *a =
+					vec_get_c(&c->alarms, k);
+				if (a->related == COMP_ALARM_ABSOLUTE)
+					return LLONG_MAX;
+				ts l = a->trigger + (ts)a->repeat * a->duration;
+				if (l > late) late = l;
+			}
+		}
 	}
-
-	rb_tree_init(&self->tree, &rb_integer_ops);
+	return late;
+}
+/*
+ * An event that ended before the wheel by more than the latest of its
+ * alarms comes after the end or start has nothing left to go off. Todos
+ * are not in the index by their due date, so all of them are added.
+ */
+static bool proj_alarm_window(void *_self, enum comp_type type,
+		struct ts_ran *ran) {
+	struct proj_alarm *self = _self;
+	if (type != COMP_TYPE_EVENT) return false;
+	/* comps only change with a clear */
+	if (self->late_stale) {
+		self->late = alarms_late(self->app);
+		self->late_stale = false;
+	}
+	if (self->late == LLONG_MAX) return false;
+	*ran = (struct ts_ran){ self->wheel.now - self->late, LLONG_MAX };
+	return true;
+}
+static void proj_alarm_clear(void *_self) {
+	struct proj_alarm *self = _self;
+	++self->gen;
+	self->stale = true;
+	self->late_stale = true;
 }
 static struct proj proj_alarm_init(struct proj_alarm *self, struct app *app) {
 	self->app = app;
-	self->next = NULL;
-	rb_tree_init(&self->tree, &rb_integer_ops);
+	timer_wheel_init(&self->wheel, ts_now());
+	hashmap_init(&self->map, sizeof(struct alarm_comp *));
+	self->gen = 0;
+	self->stale = false;
+	self->late_stale = true;
+	self->shell_cmd = NULL;
 	self->uexpr_filter = -1;
+	subprocess_notifier_init(&self->notifier);
+	self->has_ledger = false;
 	return (struct proj){
 		.self = self,
 		.add = proj_alarm_add,
 		.done = proj_alarm_done,
 		.clear = proj_alarm_clear,
-		.type = NULL,
+		.type = proj_alarm_type,
+		.window = proj_alarm_window,
+		.want = proj_alarm_want,
+	};
+}
+static void proj_alarm_finish(struct proj_alarm *self) {
+	proj_alarm_clear(self);
+	proj_alarm_sweep(self);
+	hashmap_finish(&self->map);
+	subprocess_notifier_finish(&self->notifier);
+	if (self->has_ledger) alarm_ledger_close(&self->ledger);
+}
+/* alarms are caught up for at most this long */
+#define ALARM_CATCH_UP_MAX (3600 * 24 * 7)
+static void proj_alarm_open_ledger(struct proj_alarm *self,
+		const char *path) {
+	asrt(self->wheel.n == 0, "alarms before the ledger");
+	self->has_ledger = alarm_ledger_open(&self->ledger, path) == 0;
+	if (!self->has_ledger) {
+		pu_log_info("[alarm] warning: no ledger, "
+			"missed alarms are not delivered\n");
+		return;
+	}
+	ts from = ts_now() - ALARM_CATCH_UP_MAX;
+	if (self->ledger.mark > from) from = self->ledger.mark;
+	if (self->ledger.mark != -1) timer_wheel_init(&self->wheel, from);
+}
+
+static void proj_free_busy_add(void *_self, struct proj_item pi) {
+	struct proj_free_busy *self = _self;
+	enum prop_status status;
+	if (!props_get_status(pi.ci->p, &status)
+		|| status != PROP_STATUS_CONFIRMED) return;
+	while (self->pending.len <= pi.cal_index) {
+		struct vec v = vec_new_empty(sizeof(struct ts_ran));
+		vec_append(&self->pending, &v);
+		vec_append(&self->kept_to, &(ts){ LLONG_MIN });
+	}
+	/* already in a list kept over the last clear */
+	if (pi.ci->rdp.start < *(ts *)vec_get(&self->kept_to, pi.cal_index))
+		return;
+	vec_append(vec_get(&self->pending, pi.cal_index), &pi.ci->rdp.se_ran);
+}
+/* the instances come in order of start from each calendar, so they are
+ * merged into the lists in one pass */
+static void proj_free_busy_done(void *_self) {
+	struct proj_free_busy *self = _self;
+	while (self->lists.len < self->app->cals.len) {
+		struct busy_list bl;
+		busy_list_init(&bl);
+		vec_append(&self->lists, &bl);
+	}
+	for (int i = 0; i < self->pending.len; ++i) {
+		struct vec *v = vec_get(&self->pending, i);
+		busy_list_add(vec_get(&self->lists, i), v->d, v->len);
+		vec_clear(v);
+	}
+	self->expanded_to = self->app->expand_to;
+}
+/* only the lists of calendars with changed events are made again, the
+ * others only take the instances past what they have */
+static void proj_free_busy_clear(void *_self) {
+	struct proj_free_busy *self = _self;
+	for (int i = 0; i < self->pending.len; ++i) {
+		vec_clear(vec_get(&self->pending, i));
+		struct calendar *cal = vec_get(&self->app->cals, i);
+		bool keep = i < self->lists.len
+			&& !cal->cis_dirty[COMP_TYPE_EVENT];
+		*(ts *)vec_get(&self->kept_to, i) =
+			keep ? self->expanded_to : LLONG_MIN;
+		if (!keep && i < self->lists.len)
+			busy_list_clear(vec_get(&self->lists, i));
+	}
+}
+static bool proj_free_busy_type(void *_self, enum comp_type type) {
+	return type == COMP_TYPE_EVENT;
+}
+static struct proj proj_free_busy_init(struct proj_free_busy *self,
+		struct app *app) {
+	self->app = app;
+	self->lists = vec_new_empty(sizeof(struct busy_list));
+	self->pending = vec_new_empty(sizeof(struct vec));
+	self->kept_to = vec_new_empty(sizeof(ts));
+	self->expanded_to = LLONG_MIN;
+	return (struct proj){
+		.self = self,
+		.add = proj_free_busy_add,
+		.done = proj_free_busy_done,
+		.clear = proj_free_busy_clear,
+		.type = proj_free_busy_type,
 	};
 }
+static void proj_free_busy_finish(struct proj_free_busy *self) {
+	for (int i = 0; i < self->lists.len; ++i) {
+		busy_list_finish(vec_get(&self->lists, i));
+	}
+	for (int i = 0; i < self->pending.len; ++i) {
+		vec_free(vec_get(&self->pending, i));
+	}
+	vec_free(&self->lists);
+	vec_free(&self->pending);
+	vec_free(&self->kept_to);
+}
+void app_free_busy(struct app *app, enum freebusy_mode mode,
+		struct ts_ran ran, struct vec *out) {
+	struct proj_free_busy *self = &app->free_busy;
+	freebusy_query(self->lists.d, self->lists.len, mode, ran, out);
+}
+
+struct proj_dispatch_env {
+	struct proj *p;
+	int cal_index;
+	struct calendar *cal;
+};
+static void proj_dispatch_cb(void *cl, struct comp_inst *ci) {
+	struct proj_dispatch_env *env = cl;
+	struct proj *p = env->p;
+	if (p->want && !p->want(p->self, ci->c)) return;
+	p->add(p->self, (struct proj_item){
+		.ci = ci,
+		.cal_index = env->cal_index,
+		.cal = env->cal
+	});
+}
+static void proj_dispatch(struct proj *p, struct inst_index *ix,
+		enum comp_type type, int cal_index, struct calendar *cal) {
+	if (ix->n == 0) return;
+	struct proj_dispatch_env env = {
+		.p = p, .cal_index = cal_index, .cal = cal };
+	struct ts_ran ran;
+	if (p->window && p->window(p->self, type, &ran)) {
+		inst_index_query(ix, ran, proj_dispatch_cb, &env);
+		return;
+	}
+	for (int k = 0; k < ix->n; ++k) proj_dispatch_cb(&env, ix->ci[k]);
+}
 
 void app_update_projections(struct app *app) {
+	struct trace_scope sc = trace_begin("projections");
 	app_expand(app, COMP_TYPE_EVENT, app->expand_to);
 	app_expand(app, COMP_TYPE_TODO, app->expand_to);
 
-	// push all expanded comp_insts to projs
+	// push the expanded comp_insts to the projs that want them
 	bool any = false;
-	struct vec remove = vec_new_empty(sizeof(struct interval_node *));
 	for (int t = 0; t < COMP_TYPE_N; ++t) {
 		for (int j = 0; j < app->cals.len; ++j) {
 			struct calendar *cal = vec_get(&app->cals, j);
 			enum comp_type type = t;
-
-			struct rb_iter iter =
-				rb_iter(&cal->cis[type], RB_ITER_ORDER_IN);
-			struct rb_node *x;
-			while (rb_iter_next(&iter, &x)) {
-				struct interval_node *nx = container_of(x,
-					struct interval_node, node);
-				struct comp_inst *ci = container_of(nx,
-					struct comp_inst, node);
-				for (int i = 0; i < app->projs.len; ++i) {
-					struct proj *p =
-						vec_get(&app->projs, i);
-					if (p->type && !p->type(p->self, type))
-						continue;
-					if (p->add) p->add(p->self,
-							(struct proj_item){
-						.ci = ci,
-						.cal_index = j,
-						.cal = cal
-					});
-				}
-				vec_append(&remove, &nx);
-
+			struct inst_index *ix = &cal->cis[type];
+			inst_index_build(ix);
+
+			for (int i = 0; i < app->projs.len; ++i) {
+				struct proj *p = vec_get(&app->projs, i);
+				if (!p->add) continue;
+				if (p->type && !p->type(p->self, type))
+					continue;
+				proj_dispatch(p, ix, type, j, cal);
 			}
 
-			if (remove.len > 0) any = true;
-			for (int k = 0; k < remove.len; ++k) {
-				struct interval_node **ni = vec_get(&remove, k);
-				rb_delete(&cal->cis[type], &(*ni)->node);
-				struct comp_inst *ci = container_of(*ni,
-					struct comp_inst, node);
-				vec_append(&app->cis, &ci);
-			}
-			vec_clear(&remove);
+			if (ix->n > 0) any = true;
+			inst_index_take(ix, &app->cis);
 		}
 	}
-	vec_free(&remove);
-	if (any) {
+	/* after a clear, the projections drop what was not added again,
+	 * even if nothing was */
+	if (any || app->projs_cleared) {
 		for (int i = 0; i < app->projs.len; ++i) {
 			struct proj *p = vec_get(&app->projs, i);
 			if (p->done) p->done(p->self);
 		}
+		app->projs_cleared = false;
 	}
+	proj_active_todos_update_now(&app->active_todos);
+	trace_end(sc);
+}
+
+/* the schedule is only redone when now crosses a step, so it doesn't move
+ * with every tick of the clock */
+#define TODO_SCHEDULE_STEP (60 * 5)
+
+static void add_confirmed_events(struct vec *E, struct rb_tree *T,
+		struct ts_ran ran) {
+	struct interval_iter i_iter = interval_iter(T,
+		(long long int[]){ ran.fr, ran.to });
+	struct interval_node *nx;
+	while (interval_iter_next(&i_iter, &nx)) {
+		struct active_comp *ac =
+			container_of(nx, struct active_comp, node);
+		enum prop_status status;
+		if (props_get_status(ac->ci->p, &status)
+				&& status == PROP_STATUS_CONFIRMED) {
+			vec_append(E, &ac->ci->rdp.se_ran);
+		}
+	}
+}
+#define TOBJECT_START_LT(a, b) ((a)->time.fr < (b)->time.fr)
+SORT_DEFINE(sort_tobjects, struct tobject, TOBJECT_START_LT)
+/* the label is made for the slot, only a new slot needs a new one */
+static void todo_set_slot(struct active_comp *ac, struct ts_ran slot) {
+	if (ac->slot.fr == slot.fr && ac->slot.to == slot.to) return;
+	mgu_texture_destroy(&ac->tex);
+	ac->slot = slot;
+}
+void app_update_todo_schedule(struct app *app) {
+	ts base = app->now + TODO_SCHEDULE_STEP - 1;
+	base -= base % TODO_SCHEDULE_STEP;
+	if (!app->todo_schedule_dirty && app->todo_schedule_base == base)
+		return;
+	struct trace_scope sc = trace_begin("todo_schedule");
+	vec_clear(&app->todo_schedule);
+	app->todo_schedule_base = base;
+	app->todo_schedule_dirty = false;
+	if (!app->show_todo_schedule) {
+		for (int i = 0; i < app->active_todos.v.len; ++i) {
+			todo_set_slot(vec_get(&app->active_todos.v, i),
+				(struct ts_ran){ -1, -1 });
+		}
+		trace_end(sc);
+		return;
+	}
+
+	/* events not looked at yet by the filter count as well */
+	struct vec E = vec_new_empty(sizeof(struct ts_ran));
+	struct ts_ran ran = { base, app->expand_to };
+	add_confirmed_events(&E, &app->active_events.unprocessed, ran);
+	add_confirmed_events(&E,
+		&app->active_events.processed_not_hidden, ran);
+
+	/* active_todos is sorted by todo_key */
+	struct vec T = vec_new_empty(sizeof(struct schedule_todo));
+	struct vec acs = vec_new_empty(sizeof(struct active_comp *));
+	for (int i = 0; i < app->active_todos.v.len; ++i) {
+		struct active_comp *ac = vec_get(&app->active_todos.v, i);
+		struct schedule_todo st = { .start = ac->ci->rdp.start };
+		if (!props_get_estimated_duration(ac->ci->p,
+				&st.estimated_duration)) {
+			todo_set_slot(ac, (struct ts_ran){ -1, -1 });
+			continue;
+		}
+		vec_append(&T, &st);
+		vec_append(&acs, &ac);
+	}
+
+	struct ts_ran *G = todo_schedule(base, E.len, E.d, T.len, T.d);
+	for (int i = 0; i < acs.len; ++i) {
+		struct active_comp *ac =
+			*(struct active_comp **)vec_get(&acs, i);
+		todo_set_slot(ac, G[i]);
+		if (G[i].fr == -1) continue;
+		struct tobject obj = {
+			.time = G[i],
+			.type = TOBJECT_TODO,
+			.ac = ac,
+		};
+		vec_append(&app->todo_schedule, &obj);
+	}
+	sort_tobjects(app->todo_schedule.d, app->todo_schedule.len);
+
+	free(G);
+	vec_free(&acs);
+	vec_free(&T);
+	vec_free(&E);
+	trace_end(sc);
 }
 
 static void app_invalidate_calendars(struct app *app) {
+	/* the projections see which calendars were changed */
+	for (int i = 0; i < app->projs.len; ++i) {
+		struct proj *p = vec_get(&app->projs, i);
+		p->clear(p->self);
+	}
+	app->projs_cleared = true;
 	for (int i = 0; i < app->cals.len; ++i) {
 		struct calendar *cal = vec_get(&app->cals, i);
 		cal->cis_dirty[COMP_TYPE_EVENT] = true;
 		cal->cis_dirty[COMP_TYPE_TODO] = true;
 	}
-
 	app->expand_to = app->now + 3600 * 24 * 365;
-	for (int i = 0; i < app->projs.len; ++i) {
-		struct proj *p = vec_get(&app->projs, i);
-		p->clear(p->self);
-	}
 
 	for (int i = 0; i < app->cis.len; ++i) {
 		struct comp_inst **ci = vec_get(&app->cis, i);
-		free(*ci);
+		free_tagged(MEM_TAG_INST, *ci, sizeof(struct comp_inst));
 	}
 	vec_clear(&app->cis);
 }
@@ -693,36 +1278,99 @@ static void app_reload_calendars(struct app *app) {
 	}
 	app_invalidate_calendars(app);
 }
+void app_set_now(struct app *app, ts now) {
+	app->fixed_now = true;
+	app->now = now;
+	app->view.fr = ts_get_day_base(now, app->zone, true);
+	app->view.to = app->view.fr + 3600 * 24 * 7;
+	app_invalidate_calendars(app);
+	app->dirty = true;
+}
 void app_use_view(struct app *app, struct ts_ran view) {
 	proj_active_events_process(&app->active_events, view);
 }
 
 static void app_mark_dirty(struct app *app) {
 	app->dirty = true;
-	mgu_win_surf_mark_dirty(app->win);
+	if (app->win) mgu_win_surf_mark_dirty(app->win);
 }
 
-static bool apply_edit_spec_with_mod_time(struct app *app,
-		struct edit_spec *es, struct calendar *cal) {
-	/* check if there are actually any changes */
-	if (edit_spec_is_identity(es, cal)) {
-		fprintf(stderr, "[editor] identity edit, no changes\n");
-		return true;
+static void app_flush_journal(struct app *app) {
+	app->flush_scheduled = false;
+	if (!app->has_journal) return;
+	int n = journal_flush(&app->journal, &app->cals, false);
+	if (n > 0) {
+		pu_log_info("[journal] error: %d edits could not be saved, "
+			"keeping them for the next flush\n", n);
 	}
+}
+static void flush_cb(void *env) {
+	app_flush_journal(env);
+}
 
-	/* set LAST-MODIFIED */
-	props_set_last_modified(&es->p, ts_now());
+/* applies the edits in memory right away, the journal makes them durable
+ * and storage is written once for all edits made within the flush delay */
+static int app_apply_edit_specs(struct app *app, struct edit_spec **es,
+		struct calendar **cals, int n) {
+	if (!app->has_journal) {
+		return apply_edit_specs_to_calendars(es, cals, n);
+	}
 
-	/* apply edit */
-	if (apply_edit_spec_to_calendar(es, cal) == 0) {
-		app_invalidate_calendars(app);
-		app_mark_dirty(app);
-	} else {
-		fprintf(stderr, "[editor] error: could not save edit\n");
+	if (!edit_specs_can_apply_to_memory(es, cals, n)) return -1;
+	/* a journaled edit that storage can't take would fail every flush */
+	if (!edit_specs_can_apply_to_storage(es, cals, n)) return -1;
+	if (journal_append_batch(&app->journal, es, cals, n) != 0) return -1;
+	for (int i = 0; i < n; ++i) edit_spec_apply_to_memory(es[i], cals[i]);
+
+	if (!app->flush_scheduled) {
+		struct timespec t;
+		clock_gettime(CLOCK_REALTIME, &t);
+		t.tv_nsec += 400 * 1000 * 1000;
+		if (t.tv_nsec >= 1000 * 1000 * 1000) {
+			t.tv_nsec -= 1000 * 1000 * 1000;
+			++t.tv_sec;
+		}
+		event_loop_timer_set_abs(&app->flush_timer, t);
+		app->flush_scheduled = true;
+	}
+	return 0;
+}
+
+/* applies es[i] to cals[i] as one batch, with a single refresh of the
+ * projections afterwards */
+static bool apply_edit_specs_with_mod_time(struct app *app,
+		struct edit_spec **es, struct calendar **cals, int n) {
+	if (!edit_specs_can_apply_to_memory(es, cals, n)) {
+		fprintf(stderr, "[editor] error: invalid edit\n");
 		return false;
 	}
 
-	return true;
+	/* check if there are actually any changes */
+	int m = 0;
+	ts now = ts_now();
+	for (int i = 0; i < n; ++i) {
+		if (edit_spec_is_identity(es[i], cals[i])) continue;
+		/* set LAST-MODIFIED */
+		props_set_last_modified(&es[i]->p, now);
+		es[m] = es[i];
+		cals[m++] = cals[i];
+	}
+	if (m == 0) {
+		fprintf(stderr, "[editor] identity edit, no changes\n");
+		return true;
+	}
+
+	/* apply edits */
+	bool ok = app_apply_edit_specs(app, es, cals, m) == 0;
+	if (!ok) fprintf(stderr, "[editor] error: could not save edit\n");
+	/* a failed batch may still be partly applied without the journal */
+	app_invalidate_calendars(app);
+	app_mark_dirty(app);
+	return ok;
+}
+static bool apply_edit_spec_with_mod_time(struct app *app,
+		struct edit_spec *es, struct calendar *cal) {
+	return apply_edit_specs_with_mod_time(app, &es, &cal, 1);
 }
 
 static void app_mode_select_finish(struct app *app) {
@@ -832,6 +1480,60 @@ void app_cmd_move_view_discrete(struct app *app, int n) {
 
 	app_mark_dirty(app);
 }
+void app_cmd_scroll_todos(struct app *app, int n) {
+	/* half a window per step, clamped during layout */
+	app->todo_scroll += n * app->window_height / 2;
+	app_mark_dirty(app);
+}
+/* applies a parsed edit template, in_s is the template itself. res is the
+ * result of parsing it into specs, a vec<struct edit_spec> */
+static void app_editor_result(struct app *app, const struct str *in_s,
+		struct vec *specs, int res) {
+	if (res != 0) {
+		fprintf(stderr, "[editor] can't parse edit template.\n");
+		app_launch_editor_str(app, in_s); /* relaunch editor */
+		return;
+	}
+
+	int n = specs->len;
+	struct edit_spec **es = malloc_check(sizeof(void*) * (n + 1));
+	struct calendar **cals = malloc_check(sizeof(void*) * (n + 1));
+	bool ok = true;
+	for (int i = 0; ok && i < n; ++i) {
+		es[i] = vec_get(specs, i);
+
+		/* generate uid */
+		if (es[i]->method == EDIT_METHOD_CREATE
+				&& !str_any(&es[i]->uid)) {
+			char uid_buf[64];
+			generate_uid(uid_buf);
+			str_append(&es[i]->uid, uid_buf, strlen(uid_buf));
+		}
+
+		/* determine calendar */
+		int num = es[i]->calendar_num;
+		cals[i] = NULL;
+		if (num >= 1 && num <= app->cals.len) {
+			cals[i] = vec_get(&app->cals, num - 1);
+		}
+		if (!cals[i]) {
+			fprintf(stderr, "[editor] calendar not specified.\n");
+			ok = false;
+		}
+	}
+
+	/* the whole document is applied, or sent back to the editor */
+	if (!ok || !apply_edit_specs_with_mod_time(app, es, cals, n)) {
+		app_launch_editor_str(app, in_s); /* relaunch editor */
+	}
+	free(es);
+	free(cals);
+}
+static void app_editor_done(void *env, struct editor_session *s) {
+	struct app *app = env;
+	if (!str_any(&s->text)) return;
+	app_editor_result(app, &s->text, &s->specs, s->res);
+}
 void app_cmd_editor(struct app *app, FILE *in) {
 	struct str in_s = str_empty;
 	int c;
@@ -843,45 +1545,16 @@ void app_cmd_editor(struct app *app, FILE *in) {
 	FILE *f = fmemopen((void*)in_s.v.d, in_s.v.len, "r");
 	asrt(f, "");
 
-	struct edit_spec es;
-	int res = edit_spec_init_parse(&es, f, app->zone, app->now);
+	struct vec specs;
+	int res = edit_specs_init_parse(&specs, f, app->zone, app->now);
 	fclose(f);
-	if (res != 0) {
-		fprintf(stderr, "[editor] can't parse edit template.\n");
-		app_launch_editor_str(app, &in_s); /* relaunch editor */
-		goto cleanup;
-	}
-
-	/* generate uid */
-	if (es.method == EDIT_METHOD_CREATE && !str_any(&es.uid)) {
-		char uid_buf[64];
-		generate_uid(uid_buf);
-		str_append(&es.uid, uid_buf, strlen(uid_buf));
-	}
-
-	/* determine calendar */
-	struct calendar *cal = NULL;
-	if (es.calendar_num > 0) {
-		if (es.calendar_num >= 1 && es.calendar_num <= app->cals.len) {
-			cal = vec_get(&app->cals, es.calendar_num - 1);
-		}
-	}
-	if (!cal) {
-		fprintf(stderr, "[editor] calendar not specified.\n");
-		app_launch_editor_str(app, &in_s); /* relaunch editor */
-		goto cleanup_es;
-	}
-
-	if (!apply_edit_spec_with_mod_time(app, &es, cal)) {
-		app_launch_editor_str(app, &in_s); /* relaunch editor */
-	}
-
-cleanup_es:
-	edit_spec_finish(&es);
-cleanup:
+	app_editor_result(app, &in_s, &specs, res);
+	if (res == 0) edit_specs_finish(&specs);
 	str_free(&in_s);
 }
 void app_cmd_reload(struct app *app) {
+	/* storage has to have the pending edits before it is read back */
+	app_flush_journal(app);
 	app_reload_calendars(app);
 }
 void app_cmd_activate_filter(struct app *app, int n) {
@@ -895,6 +1568,129 @@ void app_cmd_activate_filter(struct app *app, int n) {
 		app_mark_dirty(app);
 	}
 }
+void app_cmd_toggle_hud(struct app *app, int n) {
+	app->show_hud = !app->show_hud;
+	app_mark_dirty(app);
+}
+void app_cmd_toggle_todo_schedule(struct app *app, int n) {
+	app->show_todo_schedule = !app->show_todo_schedule;
+	app->todo_schedule_dirty = true;
+	app_mark_dirty(app);
+}
+void app_cmd_show_free_busy(struct app *app, enum freebusy_mode mode) {
+	app->free_busy_overlay = mode;
+	app_mark_dirty(app);
+}
+/*
+ * Opens a debug dump in $XDG_RUNTIME_DIR, or next to the journal if it is
+ * not set, rather than in /tmp where the name could be taken by anyone.
+ * Does not follow a symlink in its place.
+ */
+static FILE *dump_file_open(struct str *path, const char *name) {
+	char file[64];
+	snprintf(file, sizeof(file), "smuc-%d-%s", (int)getpid(), name);
+	const char *run = getenv("XDG_RUNTIME_DIR");
+	if (run && run[0]) {
+		*path = str_new_from_cstr(run);
+		str_append_char(path, '/');
+		str_append(path, file, strlen(file));
+	} else if (!state_file_path(path, file)) {
+		*path = str_new_from_cstr(file);
+		return NULL;
+	}
+	int fd = open(str_cstr(path),
+		O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0600);
+	if (fd < 0) return NULL;
+	FILE *f = fdopen(fd, "w");
+	if (!f) close(fd);
+	return f;
+}
+void app_cmd_dump_trace(struct app *app, int n) {
+	struct str path;
+	FILE *f = dump_file_open(&path, "trace.json");
+	if (!f) {
+		fprintf(stderr, "WARNING: could not open %s\n",
+			str_cstr(&path));
+		str_free(&path);
+		return;
+	}
+	trace_dump_chrome(f);
+	fclose(f);
+	pu_log_info("trace written to %s\n", str_cstr(&path));
+	str_free(&path);
+}
+static size_t texture_footprint(const struct mgu_texture *tex) {
+	return (size_t)tex->s[0] * tex->s[1] * 4;
+}
+static size_t active_comp_footprint(const struct active_comp *ac) {
+	size_t n = texture_footprint(&ac->tex)
+		+ texture_footprint(&ac->loc_tex)
+		+ texture_footprint(&ac->row.summary)
+		+ texture_footprint(&ac->row.desc);
+	if (ac->row.side_text) n += strlen(ac->row.side_text) + 1;
+	if (ac->row.cats_text) n += strlen(ac->row.cats_text) + 1;
+	return n;
+}
+static void app_print_memory(struct app *app, FILE *f) {
+	/* textures of the active comps, by calendar */
+	size_t *tex = calloc(app->cals.len + 1, sizeof(size_t));
+	asrt(tex, "oom");
+	const struct vec *ev = &app->active_events.processed;
+	for (int i = 0; i < ev->len; ++i) {
+		const struct active_comp *ac =
+			*(struct active_comp **)vec_get_c(ev, i);
+		tex[ac->cal_index] += active_comp_footprint(ac);
+	}
+	const struct vec *todos = &app->active_todos.v;
+	for (int i = 0; i < todos->len; ++i) {
+		const struct active_comp *ac = vec_get_c(todos, i);
+		tex[ac->cal_index] += active_comp_footprint(ac);
+	}
+
+	size_t total = 0;
+	for (int i = 0; i < app->cals.len; ++i) {
+		struct calendar *cal = vec_get(&app->cals, i);
+		struct calendar_footprint fp;
+		calendar_get_footprint(cal, &fp);
+		size_t sum = calendar_footprint_total(&fp) + tex[i];
+		total += sum;
+		fprintf(f, "calendar %s: %d comps, %d instances, "
+			"%d native rules, %d libical rules\n",
+			str_cstr(str_any(&cal->name) ? &cal->name
+				: &cal->storage),
+			fp.comps, fp.insts, fp.recur_native, fp.recur_ical);
+		fprintf(f, "\tcomps %zu\n\tprops %zu\n\trecur %zu\n"
+			"\tclones %zu\n\tinsts %zu\n\tindex %zu\n"
+			"\ttextures %zu\n\ttotal %zu\n",
+			fp.comps_bytes, fp.props_bytes, fp.recur_bytes,
+			fp.clone_bytes, fp.insts_bytes, fp.index_bytes,
+			tex[i], sum);
+	}
+	free(tex);
+	size_t slicing = slicing_footprint(app->slicing);
+	fprintf(f, "slicing %zu\n", slicing);
+	fprintf(f, "total %zu\n", total + slicing);
+
+	for (int i = 0; i < MEM_TAG_N; ++i) {
+		struct mem_stat st = mem_stat_tag(i);
+		fprintf(f, "live %s: %lld objects, %lld bytes\n",
+			mem_tag_name(i), st.n, st.bytes);
+	}
+}
+void app_cmd_dump_memory(struct app *app, int n) {
+	struct str path;
+	FILE *f = dump_file_open(&path, "mem.txt");
+	if (!f) {
+		fprintf(stderr, "WARNING: could not open %s\n",
+			str_cstr(&path));
+		str_free(&path);
+		return;
+	}
+	app_print_memory(app, f);
+	fclose(f);
+	pu_log_info("memory report written to %s\n", str_cstr(&path));
+	str_free(&path);
+}
 void app_cmd_view_today(struct app *app, int n) {
 	app->view.fr = ts_get_day_base(app->now, app->zone, true);
 	app->view.to = app->view.fr + 3600 * 24 * 7;
@@ -1014,14 +1810,6 @@ static void handle_key(struct app *app, uint32_t key) {
 	}
 }
 
-static void application_handle_child(struct app *app, int pidfd) {
-	if (app->sp->pidfd == pidfd) {
-		FILE *f = subprocess_get_result(&app->sp);
-		if (!f) return;
-		app_cmd_editor(app, f);
-	}
-}
-
 static void application_handle_input(void *ud, struct mgu_win_surf *surf,
 		struct mgu_input_event_args ev) {
 	struct app *app = ud;
@@ -1100,14 +1888,34 @@ void context_cb(void *env, bool have_ctx) {
 	struct app *app = env;
 	if (have_ctx) {
 		app->sr = sr_create_opengl(app->plat);
+		app->has_rects = rect_batch_init(&app->rects) == 0;
+		if (!app->has_rects) {
+			fprintf(stderr, "WARNING: could not set up rect "
+				"batching, drawing rects with sr.\n");
+		}
 
-		app->out = mgu_disp_get_default_output(app->win->disp);
+		if (app->win) {
+			app->out = mgu_disp_get_default_output(
+				app->win->disp);
+		}
 		asrt(app->out, "app->out NULL");
 
 		w_sidebar_init(&app->w_sidebar, app);
 	} else {
 		sr_destroy(app->sr);
+		if (app->has_rects) rect_batch_finish(&app->rects);
+		app->has_rects = false;
 		in_view_destroy_texs(app);
+		for (int i = 0; i < app->active_todos.v.len; ++i) {
+			struct active_comp *ac =
+				vec_get(&app->active_todos.v, i);
+			todo_row_finish(&ac->row);
+		}
+		for (int i = 0; i < app->active_todos.kept.len; ++i) {
+			struct active_comp *ac =
+				vec_get(&app->active_todos.kept, i);
+			todo_row_finish(&ac->row);
+		}
 		w_sidebar_finish(&app->w_sidebar);
 	}
 }
@@ -1125,6 +1933,10 @@ void app_init(struct app *app, struct application_options opts,
 		.keystate = KEYSTATE_BASE,
 		.show_private_events = opts.show_private_events,
 		.tap_areas = VEC_EMPTY(sizeof(struct tap_area)),
+		.show_todo_schedule = true,
+		.todo_schedule_dirty = true,
+		.todo_schedule = VEC_EMPTY(sizeof(struct tobject)),
+		.free_busy_overlay = FREEBUSY_NONE,
 		.window_width = -1, .window_height = -1,
 		.requested_timezone = "UTC",
 		.editor_args = VEC_EMPTY(sizeof(struct str)),
@@ -1158,6 +1970,8 @@ void app_init(struct app *app, struct application_options opts,
 	vec_append(&app->projs, &p);
 	p = proj_alarm_init(&app->alarm_comps, app);
 	vec_append(&app->projs, &p);
+	p = proj_free_busy_init(&app->free_busy, app);
+	vec_append(&app->projs, &p);
 
 	/* load all uexpr stuff */
 	uexpr_init(&app->uexpr);
@@ -1182,7 +1996,7 @@ void app_init(struct app *app, struct application_options opts,
 	}
 
 	// try to find config file in platform specific config dir
-	const char *config_dir = pu_get_config_dir();
+	const char *config_dir = opts.headless ? NULL : pu_get_config_dir();
 	if (config_dir) {
 		struct str config_path = str_new_from_cstr(config_dir);
 		const char *config_fname = "/config.uexpr";
@@ -1211,6 +2025,11 @@ void app_init(struct app *app, struct application_options opts,
 		goto config_found;
 	}
 config_found: ;
+	for (int i = 0; i < opts.cals_n; ++i) {
+		int idx = app_add_cal(app, opts.cals[i]);
+		struct calendar_info *info = vec_get(&app->cal_infos, idx);
+		info->uexpr_tag = obj_cal_ref_create(idx);
+	}
 
 	// TODO: state.view_days = opts.view_days;
 
@@ -1243,6 +2062,31 @@ config_found: ;
 	app_expand(app, COMP_TYPE_EVENT, app->expand_to);
 	app_expand(app, COMP_TYPE_TODO, app->expand_to);
 
+	struct str journal_path;
+	app->has_journal = false;
+	app->flush_scheduled = false;
+	if (!opts.headless && journal_default_path(&journal_path)) {
+		app->has_journal = journal_open(&app->journal,
+			str_cstr(&journal_path)) == 0;
+		str_free(&journal_path);
+	}
+	struct str ledger_path;
+	if (!opts.headless && alarm_ledger_default_path(&ledger_path)) {
+		proj_alarm_open_ledger(&app->alarm_comps,
+			str_cstr(&ledger_path));
+		str_free(&ledger_path);
+	}
+
+	if (!app->has_journal) {
+		pu_log_info("[init] warning: no journal, "
+			"edits are written to storage directly\n");
+	} else if (!journal_empty(&app->journal)) {
+		/* edits from a previous run that did not reach storage */
+		pu_log_info("[init] replaying journal\n");
+		journal_flush(&app->journal, &app->cals, true);
+		app_invalidate_calendars(app);
+	}
+
 	app->touch_surf = libtouch_surface_create();
 	memcpy(app->touch_aabb, &(float[]) { 120, 0, 5000, 5000 },
 		sizeof(float) * 4);
@@ -1259,22 +2103,27 @@ config_found: ;
 	app->text = mgu_text_create(app->plat);
 
 	app->slicing = slicing_create(app->zone);
-
-	app->win->disp->seat.cb = (struct mgu_seat_cb){
-		.env = app, .f = application_handle_input };
-	app->win->disp->render_cb = (struct mgu_render_cb){
-		.env = app, .f = render_application };
+	layout_pool_init(&app->layout_pool);
 
 	app->init_done = true;
-
-	mgu_disp_set_context_cb(app->win->disp, (struct mgu_context_cb){
-		.env = app, .f = context_cb });
-
 	app->event_loop = event_loop_create(plat);
-	mgu_disp_add_to_event_loop(app->win->disp, app->event_loop);
+
+	if (app->win) {
+		app->win->disp->seat.cb = (struct mgu_seat_cb){
+			.env = app, .f = application_handle_input };
+		app->win->disp->render_cb = (struct mgu_render_cb){
+			.env = app, .f = render_application };
+		mgu_disp_set_context_cb(app->win->disp,
+			(struct mgu_context_cb){ .env = app, .f = context_cb });
+		mgu_disp_add_to_event_loop(app->win->disp, app->event_loop);
+	}
 
 	event_loop_timer_init(&app->alarm_timer, app->event_loop,
 		app, alarm_cb);
+	event_loop_timer_init(&app->flush_timer, app->event_loop,
+		app, flush_cb);
+	editor_sessions_init(&app->editors, app->event_loop, app->zone,
+		app, app_editor_done);
 
 	app_mark_dirty(app);
 	sw_end_print(sw, "initialization");
@@ -1285,7 +2134,11 @@ void app_main(struct app *app) {
 }
 
 void app_finish(struct app *app) {
+	app_flush_journal(app);
+	if (app->has_journal) journal_close(&app->journal);
+	event_loop_timer_finish(&app->flush_timer);
 	event_loop_timer_finish(&app->alarm_timer);
+	editor_sessions_finish(&app->editors);
 
 	event_loop_destroy(app->event_loop);
 
@@ -1323,10 +2176,13 @@ void app_finish(struct app *app) {
 
 	vec_free(&app->projs);
 	proj_active_events_clear(&app->active_events);
-	vec_free(&app->active_todos.v);
+	proj_active_todos_finish(&app->active_todos);
+	proj_alarm_finish(&app->alarm_comps);
+	proj_free_busy_finish(&app->free_busy);
+	vec_free(&app->todo_schedule);
 	for (int i = 0; i < app->cis.len; ++i) {
 		struct comp_inst **ci = vec_get(&app->cis, i);
-		free(*ci);
+		free_tagged(MEM_TAG_INST, *ci, sizeof(struct comp_inst));
 	}
 	vec_free(&app->cis);
 
@@ -1337,6 +2193,7 @@ void app_finish(struct app *app) {
 	if (app->uexpr_ctx) uexpr_ctx_destroy(app->uexpr_ctx);
 	uexpr_finish(&app->uexpr);
 
+	layout_pool_finish(&app->layout_pool);
 	slicing_destroy(app->slicing);
 	vec_free(&app->tap_areas);
 }
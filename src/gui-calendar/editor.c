@@ -4,30 +4,13 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <stdlib.h>
+#include <ds/hashmap.h>
 
 #include "calendar.h"
 #include "editor.h"
 #include "core.h"
 #include "util.h"
 
-const char * cal_status_str(enum prop_status v) {
-	switch (v) {
-	case PROP_STATUS_TENTATIVE: return "tentative";
-	case PROP_STATUS_CONFIRMED: return "confirmed";
-	case PROP_STATUS_CANCELLED: return "cancelled";
-	case PROP_STATUS_COMPLETED: return "completed";
-	case PROP_STATUS_NEEDSACTION: return "needsaction";
-	case PROP_STATUS_INPROCESS: return "inprocess";
-	default: return "";
-	}
-}
-const char * cal_class_str(enum prop_class v) {
-	switch (v) {
-	case PROP_CLASS_PRIVATE: return "private";
-	case PROP_CLASS_PUBLIC: return "public";
-	default: return "";
-	}
-}
 const char * cal_reltype_str(enum prop_reltype v) {
 	switch (v) {
 	case PROP_RELTYPE_PARENT: return "parent";
@@ -45,11 +28,11 @@ static void print_literal(FILE *f, const char *key, const char *val) {
 	}
 }
 
-static void print_vec_str(FILE *f, const struct vec *cats) {
-	for (int i = 0; i < cats->len; ++i) {
-		const struct str *s = vec_get_c(cats, i);
-		fprintf(f, "%s", str_cstr(s));
-		if (i < cats->len - 1) fprintf(f, ",");
+static void print_categories(FILE *f, const struct props *p) {
+	int n = props_get_categories_n(p);
+	for (int i = 0; i < n; ++i) {
+		fprintf(f, "%s", props_get_category(p, i));
+		if (i < n - 1) fprintf(f, ",");
 	}
 }
 
@@ -85,8 +68,8 @@ void print_template(FILE *f, struct comp_inst *ci,
 	bool has_est = props_get_estimated_duration(p, &est);
 	bool has_perc = props_get_percent_complete(p, &perc);
 
-	const struct vec *cats = props_get_categories(p);
-	const struct vec *rels = props_get_related_to(p);
+	int n_cats = props_get_categories_n(p);
+	int n_rels = props_get_related_to_n(p);
 
 	if (is_event) fprintf(f, "update event\n");
 	if (is_todo) fprintf(f, "update todo\n");
@@ -123,20 +106,20 @@ void print_template(FILE *f, struct comp_inst *ci,
 	print_literal(f, "desc", props_get_desc(p));
 	print_literal(f, "color", props_get_color(p));
 
-	if (cats->len > 0) {
+	if (n_cats > 0) {
 		fprintf(f, "cats `");
-		print_vec_str(f, cats);
+		print_categories(f, p);
 		fprintf(f, "`\n");
 	}
 
-	if (rels->len > 0) {
+	if (n_rels > 0) {
 		fprintf(f, "rel `");
-		for (int i = 0; i < rels->len; ++i) {
-			const struct prop_related_to *rel = vec_get_c(rels, i);
-			fprintf(f, "%s:%s",
-				cal_reltype_str(rel->reltype),
-				str_cstr(&rel->uid));
-			if (i < rels->len - 1) fprintf(f, ",");
+		for (int i = 0; i < n_rels; ++i) {
+			enum prop_reltype reltype;
+			const char *uid =
+				props_get_related_to_uid(p, i, &reltype);
+			fprintf(f, "%s:%s", cal_reltype_str(reltype), uid);
+			if (i < n_rels - 1) fprintf(f, ",");
 		}
 		fprintf(f, "`\n");
 	}
@@ -269,7 +252,7 @@ static void assign_props(struct props *p, const struct props *rhs,
 	props_union(p, rhs);
 	props_apply_mask(p, rem);
 }
-static bool can_apply_to_memory(const struct edit_spec *es,
+bool edit_spec_can_apply_to_memory(const struct edit_spec *es,
 		struct calendar *cal) {
 	int idx;
 	struct comp *c;
@@ -301,7 +284,7 @@ static bool can_apply_to_memory(const struct edit_spec *es,
 	return res;
 }
 
-static void apply_to_memory(struct edit_spec *es, struct calendar *cal) {
+void edit_spec_apply_to_memory(struct edit_spec *es, struct calendar *cal) {
 	int idx;
 	struct comp *c;
 	switch (es->method) {
@@ -339,10 +322,107 @@ static void apply_to_memory(struct edit_spec *es, struct calendar *cal) {
 	cal->cis_dirty[es->type] = true;
 }
 
+bool edit_spec_can_apply_to_storage(const struct edit_spec *es,
+		struct calendar *cal) {
+	char path[1024];
+	return edit_spec_storage_path(es, cal, path) == 0;
+}
+
 int apply_edit_spec_to_calendar(struct edit_spec *es, struct calendar *cal) {
-	if (!can_apply_to_memory(es, cal)) return -1;
+	if (!edit_spec_can_apply_to_memory(es, cal)) return -1;
+	if (!edit_spec_can_apply_to_storage(es, cal)) return -1;
 	fprintf(stderr, "[editor] saving %s\n", str_cstr(&es->uid));
 	if (edit_spec_apply_to_storage(es, cal) != 0) return -1;
-	apply_to_memory(es, cal);
+	edit_spec_apply_to_memory(es, cal);
 	return 0;
 }
+
+int edit_specs_apply_grouped(struct edit_spec **es, struct calendar **cals,
+		int n, bool *failed) {
+	bool *done = malloc_check(sizeof(bool) * (n + 1));
+	struct edit_spec **group = malloc_check(sizeof(void*) * (n + 1));
+	int *group_idx = malloc_check(sizeof(int) * (n + 1));
+	bool *group_failed = malloc_check(sizeof(bool) * (n + 1));
+	char path[1024], path_k[1024];
+	int n_failed = 0;
+
+	for (int i = 0; i < n; ++i) done[i] = false;
+	for (int i = 0; i < n; ++i) {
+		if (done[i]) continue;
+		if (edit_spec_storage_path(es[i], cals[i], path) != 0) {
+			failed[i] = done[i] = true;
+			++n_failed;
+			continue;
+		}
+		int m = 0;
+		for (int k = i; k < n; ++k) {
+			if (done[k] || cals[k] != cals[i]) continue;
+			if (edit_spec_storage_path(es[k], cals[k], path_k) != 0
+					|| strcmp(path, path_k) != 0) continue;
+			group[m] = es[k];
+			group_idx[m++] = k;
+			done[k] = true;
+		}
+		n_failed += edit_specs_apply_to_storage(group, m, cals[i],
+			group_failed);
+		for (int k = 0; k < m; ++k) {
+			failed[group_idx[k]] = group_failed[k];
+		}
+	}
+
+	free(done);
+	free(group);
+	free(group_idx);
+	free(group_failed);
+	return n_failed;
+}
+
+bool edit_specs_can_apply_to_memory(struct edit_spec **es,
+		struct calendar **cals, int n) {
+	struct hashmap seen;
+	hashmap_init(&seen, sizeof(int));
+	struct str *keys = malloc_check(sizeof(struct str) * (n + 1));
+	bool res = true;
+	int i;
+	for (i = 0; res && i < n; ++i) {
+		char buf[64];
+		snprintf(buf, sizeof(buf), "%p %lld ",
+			(void*)cals[i], es[i]->recurrence_id);
+		keys[i] = str_new_from_cstr(buf);
+		str_append(&keys[i], str_cstr(&es[i]->uid), es[i]->uid.v.len);
+
+		void *prev;
+		res = edit_spec_can_apply_to_memory(es[i], cals[i])
+			&& hashmap_get_cstr(&seen, str_cstr(&keys[i]), &prev)
+				!= MAP_OK
+			&& hashmap_put_cstr(&seen, str_cstr(&keys[i]), &i)
+				== MAP_OK;
+	}
+	hashmap_finish(&seen);
+	while (i-- > 0) str_free(&keys[i]);
+	free(keys);
+	return res;
+}
+
+bool edit_specs_can_apply_to_storage(struct edit_spec **es,
+		struct calendar **cals, int n) {
+	int i = 0;
+	while (i < n && edit_spec_can_apply_to_storage(es[i], cals[i])) ++i;
+	return i == n;
+}
+
+int apply_edit_specs_to_calendars(struct edit_spec **es,
+		struct calendar **cals, int n) {
+	if (!edit_specs_can_apply_to_memory(es, cals, n)) return -1;
+	if (!edit_specs_can_apply_to_storage(es, cals, n)) return -1;
+	fprintf(stderr, "[editor] saving %d edits\n", n);
+
+	bool *failed = malloc_check(sizeof(bool) * (n + 1));
+	int n_failed = edit_specs_apply_grouped(es, cals, n, failed);
+	/* memory follows storage, even if only part of it was written */
+	for (int i = 0; i < n; ++i) {
+		if (!failed[i]) edit_spec_apply_to_memory(es[i], cals[i]);
+	}
+	free(failed);
+	return n_failed == 0 ? 0 : -1;
+}
@@ -58,11 +58,15 @@ prop = uprop | remprop
 comment = "#", { char - "\n" } ;
 grammar = header, { newline, ( prop | comment ) } ;
 
+(* function `edit_specs_init_parse` *)
+document = grammar, { newline, grammar } ;
+
 */
 
 struct parser_state {
 	FILE *f;
 	struct simple_date start, end, due;
+	bool multi; /* a header ends the current spec */
 };
 
 typedef struct parser_state *st;
@@ -409,12 +413,23 @@ static res prop(st s, struct edit_spec *es) {
 	return OK;
 }
 
+/* the next line starts another spec */
+static bool at_header(st s) {
+	long pos = ftell(s->f);
+	enum edit_method method;
+	enum comp_type type;
+	bool res = pos >= 0 && header(s, &method, &type) == OK;
+	fseek(s->f, pos, SEEK_SET);
+	return res;
+}
+
 static res grammar(st s, struct edit_spec *es) {
 	int c;
 	if (header(s, &es->method, &es->type) != OK) return ERROR;
 	while (1) {
 		while ((c = peek(s)) == '\n') asrt(get(s) == '\n', "");
 		if (c == EOF) break;
+		if (s->multi && at_header(s)) break;
 		if (c == '#') {
 			while ((c = peek(s)) != '\n') get(s);
 		} else {
@@ -430,34 +445,33 @@ static void sd_default_date(struct simple_date *sd, struct simple_date now) {
 	if (sd->year == -1) sd->year = now.year;
 }
 
-int edit_spec_init_parse(struct edit_spec *es, FILE *f,
+static int parse_spec(st s, struct edit_spec *es,
 		struct cal_timezone *zone, ts now) {
-	struct parser_state s = { f };
-	s.start = s.end = s.due = make_simple_date(-1, -1, -1, -1, -1, -1);
+	s->start = s->end = s->due = make_simple_date(-1, -1, -1, -1, -1, -1);
 	edit_spec_init(es);
-	if (grammar(&s, es) != OK) goto error;
+	if (grammar(s, es) != OK) goto error;
 
 	/* set second to constant zero */
-	if (s.start.second == -1) s.start.second = 0;
-	if (s.end.second == -1) s.end.second = 0;
-	if (s.due.second == -1) s.due.second = 0;
+	if (s->start.second == -1) s->start.second = 0;
+	if (s->end.second == -1) s->end.second = 0;
+	if (s->due.second == -1) s->due.second = 0;
 
 	/* default date components to today */
 	struct simple_date sd_now = simple_date_from_ts(now, zone);
-	sd_default_date(&s.start, sd_now);
-	sd_default_date(&s.due, sd_now);
+	sd_default_date(&s->start, sd_now);
+	sd_default_date(&s->due, sd_now);
 
 	if (es->type == COMP_TYPE_EVENT) {
-		sd_default_date(&s.end, s.start);
+		sd_default_date(&s->end, s->start);
 
-		ts start = simple_date_to_ts(s.start, zone);
-		ts end = simple_date_to_ts(s.end, zone);
+		ts start = simple_date_to_ts(s->start, zone);
+		ts end = simple_date_to_ts(s->end, zone);
 		if (start != -1) props_set_start(&es->p, start);
 		if (end != -1) props_set_end(&es->p, end);
 	}
 	if (es->type == COMP_TYPE_TODO) {
-		ts start = simple_date_to_ts(s.start, zone);
-		ts due = simple_date_to_ts(s.due, zone);
+		ts start = simple_date_to_ts(s->start, zone);
+		ts due = simple_date_to_ts(s->due, zone);
 		if (start != -1) props_set_start(&es->p, start);
 		if (due != -1) props_set_due(&es->p, due);
 	}
@@ -468,6 +482,34 @@ error:
 	return -1;
 }
 
+int edit_spec_init_parse(struct edit_spec *es, FILE *f,
+		struct cal_timezone *zone, ts now) {
+	struct parser_state s = { f };
+	return parse_spec(&s, es, zone, now);
+}
+
+int edit_specs_init_parse(struct vec *specs, FILE *f,
+		struct cal_timezone *zone, ts now) {
+	struct parser_state s = { f, .multi = true };
+	*specs = vec_new_empty(sizeof(struct edit_spec));
+	int c;
+	do {
+		struct edit_spec es;
+		if (parse_spec(&s, &es, zone, now) != 0) {
+			edit_specs_finish(specs);
+			return -1;
+		}
+		vec_append(specs, &es);
+	} while ((c = peek(&s)) != EOF);
+	return 0;
+}
+void edit_specs_finish(struct vec *specs) {
+	for (int i = 0; i < specs->len; ++i) {
+		edit_spec_finish(vec_get(specs, i));
+	}
+	vec_free(specs);
+}
+
 struct simple_date parse_date(const char *str) {
 	FILE *f = fmemopen((void*)str, strlen(str), "r");
 	struct parser_state s = { f };
@@ -624,26 +666,21 @@ void test_editor_parser() {
 	edit_spec_init(&es);
 	es.type = COMP_TYPE_TODO;
 	test_prop(&s, "rel parent:a,child:b,sibling:c,dep:d", &es);
-	const struct vec *rels = props_get_related_to(&es.p);
-	asrt(rels->len == 4, "");
-
-	const struct prop_related_to *rel;
-
-	rel = vec_get_c(rels, 0);
-	asrt(rel->reltype == PROP_RELTYPE_PARENT, "");
-	asrt(strcmp(str_cstr(&rel->uid), "a") == 0, "");
-
-	rel = vec_get_c(rels, 1);
-	asrt(rel->reltype == PROP_RELTYPE_CHILD, "");
-	asrt(strcmp(str_cstr(&rel->uid), "b") == 0, "");
-
-	rel = vec_get_c(rels, 2);
-	asrt(rel->reltype == PROP_RELTYPE_SIBLING, "");
-	asrt(strcmp(str_cstr(&rel->uid), "c") == 0, "");
-
-	rel = vec_get_c(rels, 3);
-	asrt(rel->reltype == PROP_RELTYPE_DEPENDS_ON, "");
-	asrt(strcmp(str_cstr(&rel->uid), "d") == 0, "");
+	asrt(props_get_related_to_n(&es.p) == 4, "");
+
+	static const struct { enum prop_reltype reltype; const char *uid; }
+	rels[] = {
+		{ PROP_RELTYPE_PARENT, "a" },
+		{ PROP_RELTYPE_CHILD, "b" },
+		{ PROP_RELTYPE_SIBLING, "c" },
+		{ PROP_RELTYPE_DEPENDS_ON, "d" },
+	};
+	for (int i = 0; i < 4; ++i) {
+		enum prop_reltype reltype;
+		const char *uid = props_get_related_to_uid(&es.p, i, &reltype);
+		asrt(reltype == rels[i].reltype, "");
+		asrt(strcmp(uid, rels[i].uid) == 0, "");
+	}
 
 	edit_spec_finish(&es);
 
@@ -0,0 +1,168 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <platform_utils/log.h>
+
+#include "editor_session.h"
+#include "core.h"
+
+static void session_free(struct editor_session *s) {
+	if (s->sp) subprocess_abandon(&s->sp);
+	if (s->res == 0) edit_specs_finish(&s->specs);
+	str_free(&s->text);
+	free(s);
+}
+
+/* the blocking part, on the worker: reading what the editor wrote */
+static void session_read(struct editor_session *s) {
+	FILE *in = subprocess_get_result(&s->sp);
+	if (!in) return;
+	int c;
+	while ((c = getc(in)) != EOF) str_append_char(&s->text, c);
+	fclose(in);
+}
+
+/* on the event loop, as the date parsing may fall back to libical, which
+ * is not thread safe */
+static void session_parse(struct editor_sessions *m,
+		struct editor_session *s) {
+	if (!str_any(&s->text)) return;
+	FILE *f = fmemopen((void*)s->text.v.d, s->text.v.len, "r");
+	asrt(f, "");
+	s->res = edit_specs_init_parse(&s->specs, f, m->zone, s->now);
+	fclose(f);
+}
+
+static void *worker_main(void *env) {
+	struct editor_sessions *m = env;
+	pthread_mutex_lock(&m->mutex);
+	for (;;) {
+		while (!m->quit && m->queued.len == 0) {
+			pthread_cond_wait(&m->cond, &m->mutex);
+		}
+		if (m->quit) break;
+		struct editor_session *s =
+			*(struct editor_session **)vec_get(&m->queued, 0);
+		vec_remove(&m->queued, 0);
+		pthread_mutex_unlock(&m->mutex);
+
+		session_read(s);
+
+		pthread_mutex_lock(&m->mutex);
+		vec_append(&m->finished, &s);
+		char b = 0;
+		if (write(m->wake[1], &b, 1) < 0) {
+			/* the pipe is full, the loop is woken already */
+		}
+	}
+	pthread_mutex_unlock(&m->mutex);
+	return NULL;
+}
+
+/* runs on the event loop */
+static void wake_cb(void *env, struct pollfd pfd) {
+	struct editor_sessions *m = env;
+	char buf[64];
+	while (read(m->wake[0], buf, sizeof(buf)) > 0) { }
+
+	pthread_mutex_lock(&m->mutex);
+	struct vec finished = m->finished;
+	m->finished = vec_new_empty(sizeof(struct editor_session*));
+	pthread_mutex_unlock(&m->mutex);
+
+	for (int i = 0; i < finished.len; ++i) {
+		struct editor_session **s = vec_get(&finished, i);
+		session_parse(m, *s);
+		m->done(m->env, *s);
+		session_free(*s);
+	}
+	vec_free(&finished);
+}
+
+static void pidfd_cb(void *env, struct pollfd pfd) {
+	struct editor_sessions *m = env;
+	if (!(pfd.revents & POLLIN)) return;
+	event_loop_remove_fd(m->el, pfd.fd);
+
+	for (int i = 0; i < m->running.len; ++i) {
+		struct editor_session **s = vec_get(&m->running, i);
+		if ((*s)->sp->pidfd != pfd.fd) continue;
+		pthread_mutex_lock(&m->mutex);
+		vec_append(&m->queued, s);
+		pthread_cond_signal(&m->cond);
+		pthread_mutex_unlock(&m->mutex);
+		vec_remove(&m->running, i);
+		break;
+	}
+}
+
+void editor_sessions_init(struct editor_sessions *m, struct event_loop *el,
+		struct cal_timezone *zone, void *env,
+		void (*done)(void *env, struct editor_session *s)) {
+	*m = (struct editor_sessions){
+		.el = el,
+		.zone = zone,
+		.env = env,
+		.done = done,
+		.running = vec_new_empty(sizeof(struct editor_session*)),
+		.queued = vec_new_empty(sizeof(struct editor_session*)),
+		.finished = vec_new_empty(sizeof(struct editor_session*)),
+		.quit = false,
+	};
+	asrt(pipe2(m->wake, O_CLOEXEC | O_NONBLOCK) == 0, "pipe2");
+	pthread_mutex_init(&m->mutex, NULL);
+	pthread_cond_init(&m->cond, NULL);
+	asrt(pthread_create(&m->worker, NULL, worker_main, m) == 0,
+		"pthread_create");
+	event_loop_add_fd(el, m->wake[0], POLLIN, m, wake_cb);
+}
+
+static void free_sessions(struct vec *v) {
+	for (int i = 0; i < v->len; ++i) {
+		struct editor_session **s = vec_get(v, i);
+		session_free(*s);
+	}
+	vec_free(v);
+}
+void editor_sessions_finish(struct editor_sessions *m) {
+	pthread_mutex_lock(&m->mutex);
+	m->quit = true;
+	pthread_cond_signal(&m->cond);
+	pthread_mutex_unlock(&m->mutex);
+	pthread_join(m->worker, NULL);
+
+	event_loop_remove_fd(m->el, m->wake[0]);
+	for (int i = 0; i < m->running.len; ++i) {
+		struct editor_session **s = vec_get(&m->running, i);
+		event_loop_remove_fd(m->el, (*s)->sp->pidfd);
+	}
+	free_sessions(&m->running);
+	free_sessions(&m->queued);
+	free_sessions(&m->finished);
+
+	pthread_cond_destroy(&m->cond);
+	pthread_mutex_destroy(&m->mutex);
+	close(m->wake[0]);
+	close(m->wake[1]);
+}
+
+int editor_sessions_launch(struct editor_sessions *m, ts now,
+		const char *file, const char *argv[],
+		void (*cb)(void*, FILE*), void *ud) {
+	struct subprocess_handle *sp = subprocess_new_input(file, argv, cb, ud);
+	if (!sp) return -1;
+
+	struct editor_session *s = malloc_check(sizeof(struct editor_session));
+	*s = (struct editor_session){
+		.sp = sp,
+		.now = now,
+		.text = str_new_empty(),
+		.res = -1,
+	};
+	vec_append(&m->running, &s);
+	event_loop_add_fd(m->el, sp->pidfd, POLLIN, m, pidfd_cb);
+	pu_log_info("[editor] %d editors open\n", m->running.len);
+	return 0;
+}
@@ -0,0 +1,150 @@
+#include <stdlib.h>
+#include <string.h>
+#include "frame.h"
+#include "util.h"
+#include "core.h"
+#include "trace.h"
+
+#define FRAME_CLIP_MAX 16
+
+void frame_init(struct frame *f) {
+	f->ops = vec_new_empty(sizeof(struct frame_op));
+}
+void frame_finish(struct frame *f) {
+	frame_clear(f);
+	vec_free(&f->ops);
+}
+void frame_clear(struct frame *f) {
+	for (int i = 0; i < f->ops.len; ++i) {
+		struct frame_op *op = vec_get(&f->ops, i);
+		if (op->t == FRAME_OP_PUT && op->spec.t == SR_TEXT) {
+			free((char *)op->spec.text.s);
+		}
+	}
+	vec_clear(&f->ops);
+}
+
+void frame_put(struct frame *f, struct sr_spec spec) {
+	if (spec.t == SR_TEXT) spec.text.s = str_dup(spec.text.s);
+	vec_append(&f->ops, &(struct frame_op){
+		.t = FRAME_OP_PUT,
+		.spec = spec
+	});
+}
+void frame_clip_push(struct frame *f, const float p[4]) {
+	struct frame_op op = { .t = FRAME_OP_CLIP_PUSH };
+	memcpy(op.p, p, sizeof(op.p));
+	vec_append(&f->ops, &op);
+}
+void frame_clip_pop(struct frame *f) {
+	vec_append(&f->ops, &(struct frame_op){ .t = FRAME_OP_CLIP_POP });
+}
+void frame_present(struct frame *f) {
+	vec_append(&f->ops, &(struct frame_op){ .t = FRAME_OP_PRESENT });
+}
+void frame_defer(struct frame *f, frame_deferred_fn fn, void *env,
+		const float p[4]) {
+	struct frame_op op = { .t = FRAME_OP_DEFERRED, .fn = fn, .env = env };
+	memcpy(op.p, p, sizeof(op.p));
+	vec_append(&f->ops, &op);
+}
+
+void frame_append(struct frame *dst, struct frame *src) {
+	for (int i = 0; i < src->ops.len; ++i) {
+		vec_append(&dst->ops, vec_get(&src->ops, i));
+	}
+	/* the text of the moved ops is owned by dst now */
+	vec_clear(&src->ops);
+}
+
+/* the clip stack as seen by the rects, kept across layers */
+struct rect_clips {
+	float c[FRAME_CLIP_MAX][4];
+	int n;
+};
+
+/* rects of ops [fr, to) go in one batch, clipped by the clip stack at the
+ * time of put */
+static void frame_batch_rects(struct frame *f, int fr, int to,
+		struct rect_clips *cs, struct rect_batch *rb) {
+	for (int i = fr; i < to; ++i) {
+		struct frame_op *op = vec_get(&f->ops, i);
+		switch (op->t) {
+		case FRAME_OP_PUT:
+			if (op->spec.t != SR_RECT) break;
+			rect_batch_put(rb, op->spec.p, op->spec.argb,
+				cs->n > 0 ? cs->c[cs->n - 1] : NULL);
+			break;
+		case FRAME_OP_CLIP_PUSH: {
+			asrt(cs->n < FRAME_CLIP_MAX, "clip stack too deep");
+			float *c = cs->c[cs->n];
+			memcpy(c, op->p, sizeof(cs->c[0]));
+			if (cs->n > 0) {
+				/* intersect with the enclosing clip */
+				float *e = cs->c[cs->n - 1];
+				float x1 = c[0] + c[2], y1 = c[1] + c[3];
+				if (x1 > e[0] + e[2]) x1 = e[0] + e[2];
+				if (y1 > e[1] + e[3]) y1 = e[1] + e[3];
+				if (c[0] < e[0]) c[0] = e[0];
+				if (c[1] < e[1]) c[1] = e[1];
+				c[2] = x1 - c[0];
+				c[3] = y1 - c[1];
+			}
+			++cs->n;
+			break;
+		}
+		case FRAME_OP_CLIP_POP:
+			--cs->n;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/* the ops up to and including the next FRAME_OP_PRESENT form a layer */
+static int layer_end(struct frame *f, int fr) {
+	while (fr < f->ops.len) {
+		struct frame_op *op = vec_get(&f->ops, fr++);
+		if (op->t == FRAME_OP_PRESENT) break;
+	}
+	return fr;
+}
+
+void frame_submit(struct frame *f, struct sr *sr, struct rect_batch *rb,
+		uint32_t viewport[2], void *cl) {
+	struct rect_clips cs = { .n = 0 };
+	int to = 0;
+	for (int i = 0; i < f->ops.len; ++i) {
+		if (rb && i == to) {
+			to = layer_end(f, i);
+			struct trace_scope sc = trace_begin("rects");
+			frame_batch_rects(f, i, to, &cs, rb);
+			rect_batch_draw(rb, viewport);
+			trace_end(sc);
+		}
+		struct frame_op *op = vec_get(&f->ops, i);
+		switch (op->t) {
+		case FRAME_OP_PUT:
+			if (rb && op->spec.t == SR_RECT) break;
+			sr_put(sr, op->spec);
+			break;
+		case FRAME_OP_CLIP_PUSH:
+			sr_clip_push(sr, op->p);
+			break;
+		case FRAME_OP_CLIP_POP:
+			sr_clip_pop(sr);
+			break;
+		case FRAME_OP_PRESENT: {
+			struct trace_scope sc = trace_begin("sr_present");
+			sr_present(sr, viewport);
+			trace_end(sc);
+			break;
+		}
+		case FRAME_OP_DEFERRED:
+			op->fn(cl, op->env, op->p);
+			break;
+		}
+	}
+	frame_clear(f);
+}
@@ -0,0 +1,422 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <platform_utils/log.h>
+
+#include "journal.h"
+#include "core.h"
+#include "util.h"
+
+/*
+ * A record is "rec <n>\n", n bytes of payload and "end\n". The payload
+ * holds the specs of a batch, each starting with a "spec" line and having
+ * one field per line, strings are written as "<len>:<bytes>". A record cut
+ * short by a crash fails the framing check and is dropped as a whole.
+ */
+
+struct journal_rec {
+	struct str cal;
+	struct edit_spec es;
+	int batch; /* index of the first spec of its record */
+};
+
+static void put_bytes(FILE *f, const char *key, const char *s) {
+	fprintf(f, "%s %zu:%s\n", key, strlen(s), s);
+}
+
+static void put_spec(FILE *f, const struct edit_spec *es, const char *cal) {
+	fprintf(f, "spec\n");
+	put_bytes(f, "cal", cal);
+	fprintf(f, "method %d\n", es->method);
+	fprintf(f, "type %d\n", es->type);
+	put_bytes(f, "uid", str_cstr(&es->uid));
+	fprintf(f, "instance %lld\n", es->recurrence_id);
+	fprintf(f, "rem %u\n", es->rem._mask);
+
+	// DEP: new prop
+#define PUT_VAL(type, name, capname) { \
+		type v; \
+		if (props_get_##name(&es->p, &v)) \
+			fprintf(f, #name " %lld\n", (long long)v); \
+	}
+#define PUT_STR(type, name, capname) \
+	if (props_get_##name(&es->p)) \
+		put_bytes(f, #name, props_get_##name(&es->p));
+	PROPS_LIST_BY_VAL(PUT_VAL)
+	PROPS_LIST_STR(PUT_STR)
+#undef PUT_VAL
+#undef PUT_STR
+
+	for (int i = 0; i < props_get_categories_n(&es->p); ++i) {
+		put_bytes(f, "cat", props_get_category(&es->p, i));
+	}
+	for (int i = 0; i < props_get_related_to_n(&es->p); ++i) {
+		enum prop_reltype reltype;
+		const char *uid =
+			props_get_related_to_uid(&es->p, i, &reltype);
+		fprintf(f, "rel %d %zu:%s\n", reltype, strlen(uid), uid);
+	}
+}
+static void put_record(FILE *out, struct edit_spec *const *es,
+		const char *const *cals, int n_es) {
+	char *buf = NULL;
+	size_t n = 0;
+	FILE *f = open_memstream(&buf, &n);
+	asrt(f, "open_memstream");
+	for (int i = 0; i < n_es; ++i) put_spec(f, es[i], cals[i]);
+	fclose(f);
+
+	fprintf(out, "rec %zu\n", n);
+	fwrite(buf, 1, n, out);
+	fprintf(out, "end\n");
+	free(buf);
+}
+
+static bool get_bytes(FILE *f, struct str *out) {
+	size_t n;
+	if (fscanf(f, "%zu:", &n) != 1) return false;
+	char *buf = malloc_check(n + 1);
+	bool ok = fread(buf, 1, n, f) == n && getc(f) == '\n';
+	str_clear(out);
+	if (ok) str_append(out, buf, n);
+	free(buf);
+	return ok;
+}
+
+/* reads the fields of a spec up to the next one. returns 1 if another
+ * spec follows, 0 at the end and -1 on error */
+static int parse_spec(FILE *f, struct journal_rec *rec) {
+	struct edit_spec *es = &rec->es;
+	struct vec cats = vec_new_empty(sizeof(struct str));
+	struct vec rels = vec_new_empty(sizeof(struct prop_related_to));
+	char key[32];
+	long long v;
+	int d;
+	bool ok = true, more = false;
+
+	while (ok && fscanf(f, "%31s ", key) == 1) {
+		if (strcmp(key, "spec") == 0) {
+			more = true;
+			break;
+		} else if (strcmp(key, "cal") == 0) {
+			ok = get_bytes(f, &rec->cal);
+		} else if (strcmp(key, "method") == 0) {
+			ok = fscanf(f, "%d\n", &d) == 1;
+			es->method = d;
+		} else if (strcmp(key, "type") == 0) {
+			ok = fscanf(f, "%d\n", &d) == 1;
+			es->type = d;
+		} else if (strcmp(key, "uid") == 0) {
+			ok = get_bytes(f, &es->uid);
+		} else if (strcmp(key, "instance") == 0) {
+			ok = fscanf(f, "%lld\n", &es->recurrence_id) == 1;
+		} else if (strcmp(key, "rem") == 0) {
+			ok = fscanf(f, "%u\n", &es->rem._mask) == 1;
+		} else if (strcmp(key, "cat") == 0) {
+			struct str s = str_new_empty();
+			ok = get_bytes(f, &s);
+			vec_append(&cats, &s);
+		} else if (strcmp(key, "rel") == 0) {
+			struct prop_related_to rel;
+			rel.uid = str_new_empty();
+			ok = fscanf(f, "%d ", &d) == 1
+				&& get_bytes(f, &rel.uid);
+			rel.reltype = d;
+			vec_append(&rels, &rel);
+		}
+#define GET_VAL(type, name, capname) \
+		else if (strcmp(key, #name) == 0) { \
+			ok = fscanf(f, "%lld\n", &v) == 1; \
+			props_set_##name(&es->p, (type)v); \
+		}
+#define GET_STR(type, name, capname) \
+		else if (strcmp(key, #name) == 0) { \
+			struct str s = str_new_empty(); \
+			ok = get_bytes(f, &s); \
+			props_set_##name(&es->p, str_cstr(&s)); \
+			str_free(&s); \
+		}
+		PROPS_LIST_BY_VAL(GET_VAL)
+		PROPS_LIST_STR(GET_STR)
+#undef GET_VAL
+#undef GET_STR
+		else {
+			ok = false;
+		}
+	}
+
+	/* the props own the vectors either way */
+	props_set_categories(&es->p, cats);
+	props_set_related_to(&es->p, rels);
+	if (!ok || !str_any(&rec->cal) || !str_any(&es->uid)) return -1;
+	if (more) return 1;
+	return feof(f) ? 0 : -1;
+}
+
+static bool parse_payload(FILE *f, struct vec *recs) {
+	char key[8];
+	if (fscanf(f, "%7s ", key) != 1 || strcmp(key, "spec") != 0)
+		return false;
+	int res;
+	do {
+		struct journal_rec rec = { .cal = str_new_empty() };
+		edit_spec_init(&rec.es);
+		res = parse_spec(f, &rec);
+		vec_append(recs, &rec);
+	} while (res == 1);
+	return res == 0;
+}
+
+static void recs_truncate(struct vec *recs, int len) {
+	while (recs->len > len) {
+		struct journal_rec *r = vec_get(recs, recs->len - 1);
+		str_free(&r->cal);
+		edit_spec_finish(&r->es);
+		vec_remove(recs, recs->len - 1);
+	}
+}
+
+/* appends the specs of the next record to recs. returns 1 on success, 0
+ * at the end of the journal and -1 on a broken record */
+static int get_record(FILE *f, struct vec *recs) {
+	size_t n;
+	int c = getc(f);
+	if (c == EOF) return 0;
+	ungetc(c, f);
+	if (fscanf(f, "rec %zu", &n) != 1 || getc(f) != '\n') return -1;
+
+	char *buf = malloc_check(n + 1);
+	char end[4];
+	bool ok = n > 0 && fread(buf, 1, n, f) == n
+		&& fread(end, 1, 4, f) == 4 && memcmp(end, "end\n", 4) == 0;
+	if (ok) {
+		int len = recs->len;
+		FILE *p = fmemopen(buf, n, "r");
+		asrt(p, "fmemopen");
+		ok = parse_payload(p, recs);
+		fclose(p);
+		if (!ok) recs_truncate(recs, len);
+		for (int i = len; i < recs->len; ++i) {
+			struct journal_rec *r = vec_get(recs, i);
+			r->batch = len;
+		}
+	}
+	free(buf);
+	return ok ? 1 : -1;
+}
+
+int journal_open(struct journal *j, const char *path) {
+	j->f = fopen(path, "a+");
+	if (!j->f) return -1;
+	j->path = str_new_from_cstr(path);
+	return 0;
+}
+void journal_close(struct journal *j) {
+	fclose(j->f);
+	str_free(&j->path);
+}
+
+bool state_file_path(struct str *path, const char *name) {
+	const char *state = getenv("XDG_STATE_HOME");
+	const char *home = getenv("HOME");
+	if (state && state[0]) {
+		*path = str_new_from_cstr(state);
+	} else if (home && home[0]) {
+		*path = str_new_from_cstr(home);
+		str_append(path, "/.local/state", 13);
+	} else {
+		return false;
+	}
+	str_append(path, "/smuc", 5);
+
+	/* mkdir -p */
+	char *dir = str_dup(str_cstr(path));
+	for (char *p = dir + 1; ; ++p) {
+		if (*p != '/' && *p != '\0') continue;
+		char c = *p;
+		*p = '\0';
+		if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+			free(dir);
+			str_free(path);
+			return false;
+		}
+		if (!(*p = c)) break;
+	}
+	free(dir);
+
+	str_append(path, "/", 1);
+	str_append(path, name, strlen(name));
+	return true;
+}
+bool journal_default_path(struct str *path) {
+	return state_file_path(path, "journal");
+}
+
+int journal_append(struct journal *j, struct edit_spec *es,
+		struct calendar *cal) {
+	return journal_append_batch(j, &es, &cal, 1);
+}
+int journal_append_batch(struct journal *j, struct edit_spec **es,
+		struct calendar **cals, int n) {
+	const char **names = malloc_check(sizeof(char*) * (n + 1));
+	for (int i = 0; i < n; ++i) names[i] = str_cstr(&cals[i]->storage);
+	put_record(j->f, es, names, n);
+	free(names);
+	/* durability comes with the fsync of the next flush */
+	return fflush(j->f) == 0 ? 0 : -1;
+}
+
+bool journal_empty(struct journal *j) {
+	fflush(j->f);
+	struct stat sb;
+	return fstat(fileno(j->f), &sb) == 0 && sb.st_size == 0;
+}
+
+/* storage already has the edits that memory, freshly loaded from it, has */
+static bool replay_to_memory(struct edit_spec *es, struct calendar *cal) {
+	int idx = calendar_find_comp(cal, str_cstr(&es->uid));
+	switch (es->method) {
+	case EDIT_METHOD_CREATE:
+		if (idx != -1) return false;
+		break;
+	case EDIT_METHOD_UPDATE:
+		if (idx == -1 || edit_spec_is_identity(es, cal)) return false;
+		break;
+	case EDIT_METHOD_DELETE:
+		if (idx == -1) return false;
+		break;
+	}
+	if (!edit_spec_can_apply_to_memory(es, cal)) return false;
+	edit_spec_apply_to_memory(es, cal);
+	return true;
+}
+
+static struct calendar *find_cal(struct vec *cals, const struct str *path) {
+	for (int i = 0; i < cals->len; ++i) {
+		struct calendar *cal = vec_get(cals, i);
+		if (strcmp(str_cstr(&cal->storage), str_cstr(path)) == 0)
+			return cal;
+	}
+	return NULL;
+}
+
+/* the end of the batch starting at recs[i] */
+static int batch_end(struct vec *recs, int i) {
+	const struct journal_rec *first = vec_get(recs, i);
+	int e = i + 1;
+	while (e < recs->len) {
+		const struct journal_rec *r = vec_get(recs, e);
+		if (r->batch != first->batch) break;
+		++e;
+	}
+	return e;
+}
+
+/* replaces the journal with the batches that are still pending, each
+ * written back as one record. keep is the same within a batch */
+static int journal_rewrite(struct journal *j, struct vec *recs,
+		bool *keep) {
+	const char *path = str_cstr(&j->path);
+	struct atomic_write aw;
+	if (atomic_write_begin(&aw, path) != 0) return -1;
+	struct edit_spec **es = malloc_check(sizeof(void*) * (recs->len + 1));
+	const char **cals = malloc_check(sizeof(char*) * (recs->len + 1));
+	for (int i = 0, e; i < recs->len; i = e) {
+		e = batch_end(recs, i);
+		if (!keep[i]) continue;
+		for (int k = i; k < e; ++k) {
+			struct journal_rec *rec = vec_get(recs, k);
+			es[k - i] = &rec->es;
+			cals[k - i] = str_cstr(&rec->cal);
+		}
+		put_record(aw.f, es, cals, e - i);
+	}
+	free(es);
+	free(cals);
+	if (atomic_write_end(&aw, path, true) != 0) return -1;
+	fclose(j->f);
+	j->f = fopen(path, "a+");
+	asrt(j->f, "journal reopen");
+	return 0;
+}
+
+int journal_flush(struct journal *j, struct vec *cals, bool replay) {
+	/* the one fsync of the journal for this batch */
+	if (fflush(j->f) != 0 || fsync(fileno(j->f)) != 0) {
+		pu_log_info("[journal] warning: fsync failed\n");
+	}
+
+	struct vec recs = vec_new_empty(sizeof(struct journal_rec));
+	int res;
+	fseek(j->f, 0, SEEK_SET);
+	while ((res = get_record(j->f, &recs)) == 1) { }
+	if (res < 0) {
+		pu_log_info("[journal] dropping a broken record "
+			"and everything after it\n");
+	}
+
+	int n = recs.len, n_failed = 0, m = 0;
+	bool *keep = malloc_check(sizeof(bool) * (n + 1));
+	bool *failed = malloc_check(sizeof(bool) * (n + 1));
+	int *idx = malloc_check(sizeof(int) * (n + 1));
+	struct edit_spec **es = malloc_check(sizeof(void*) * (n + 1));
+	struct calendar **es_cals = malloc_check(sizeof(void*) * (n + 1));
+	for (int i = 0; i < n; ++i) {
+		struct journal_rec *r = vec_get(&recs, i);
+		struct calendar *cal = find_cal(cals, &r->cal);
+		keep[i] = false;
+		if (!cal) {
+			pu_log_info("[journal] no calendar %s, keeping edit\n",
+				str_cstr(&r->cal));
+			keep[i] = true;
+			++n_failed;
+		} else if (!edit_spec_can_apply_to_storage(&r->es, cal)) {
+			/* it would fail every flush, and every start */
+			pu_log_info("[journal] dropping an edit of %s that "
+				"its storage can't take\n", str_cstr(&r->cal));
+		} else if (!replay || replay_to_memory(&r->es, cal)) {
+			idx[m] = i;
+			es[m] = &r->es;
+			es_cals[m++] = cal;
+		}
+	}
+
+	n_failed += edit_specs_apply_grouped(es, es_cals, m, failed);
+	for (int k = 0; k < m; ++k) keep[idx[k]] = failed[k];
+	/* a batch is replayed as a whole, so a failed part keeps all of it */
+	for (int i = 0, e; i < n; i = e) {
+		e = batch_end(&recs, i);
+		bool any = false;
+		for (int k = i; k < e; ++k) any = any || keep[k];
+		for (int k = i; k < e; ++k) keep[k] = any;
+	}
+
+	if (n_failed > 0 || res < 0) {
+		if (journal_rewrite(j, &recs, keep) != 0) {
+			pu_log_info("[journal] warning: rewrite failed\n");
+		}
+	} else if (n > 0 || !journal_empty(j)) {
+		if (ftruncate(fileno(j->f), 0) != 0
+				|| fsync(fileno(j->f)) != 0) {
+			pu_log_info("[journal] warning: truncate failed\n");
+		}
+	}
+	/* the stream was read, it has to be repositioned before writing */
+	fseek(j->f, 0, SEEK_END);
+
+	for (int i = 0; i < n; ++i) {
+		struct journal_rec *r = vec_get(&recs, i);
+		str_free(&r->cal);
+		edit_spec_finish(&r->es);
+	}
+	vec_free(&recs);
+	free(keep);
+	free(failed);
+	free(idx);
+	free(es);
+	free(es_cals);
+	return n_failed;
+}
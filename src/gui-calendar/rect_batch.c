@@ -0,0 +1,134 @@
+#include <stddef.h>
+#include <stdio.h>
+#include "rect_batch.h"
+#include "core.h"
+
+struct rect_vert {
+	float p[2];
+	uint8_t c[4]; /* rgba */
+};
+
+static const char *vert_src =
+	"attribute vec2 a_pos;\n"
+	"attribute vec4 a_col;\n"
+	"uniform vec2 u_size;\n"
+	"varying vec4 v_col;\n"
+	"void main() {\n"
+	"	v_col = vec4(a_col.rgb * a_col.a, a_col.a);\n"
+	"	gl_Position = vec4(a_pos.x / u_size.x * 2.0 - 1.0,\n"
+	"		1.0 - a_pos.y / u_size.y * 2.0, 0.0, 1.0);\n"
+	"}\n";
+static const char *frag_src =
+	"precision mediump float;\n"
+	"varying vec4 v_col;\n"
+	"void main() {\n"
+	"	gl_FragColor = v_col;\n"
+	"}\n";
+
+static GLuint compile_shader(GLenum type, const char *src) {
+	GLuint sh = glCreateShader(type);
+	glShaderSource(sh, 1, &src, NULL);
+	glCompileShader(sh);
+	GLint ok;
+	glGetShaderiv(sh, GL_COMPILE_STATUS, &ok);
+	if (!ok) {
+		char log[512];
+		glGetShaderInfoLog(sh, sizeof(log), NULL, log);
+		fprintf(stderr, "rect_batch: shader error: %s\n", log);
+		glDeleteShader(sh);
+		return 0;
+	}
+	return sh;
+}
+
+int rect_batch_init(struct rect_batch *rb) {
+	*rb = (struct rect_batch){
+		.verts = vec_new_empty(sizeof(struct rect_vert))
+	};
+
+	GLuint vs = compile_shader(GL_VERTEX_SHADER, vert_src);
+	GLuint fs = compile_shader(GL_FRAGMENT_SHADER, frag_src);
+	if (!vs || !fs) goto err;
+
+	rb->prog = glCreateProgram();
+	glAttachShader(rb->prog, vs);
+	glAttachShader(rb->prog, fs);
+	glBindAttribLocation(rb->prog, 0, "a_pos");
+	glBindAttribLocation(rb->prog, 1, "a_col");
+	glLinkProgram(rb->prog);
+	glDeleteShader(vs);
+	glDeleteShader(fs);
+	vs = fs = 0;
+
+	GLint ok;
+	glGetProgramiv(rb->prog, GL_LINK_STATUS, &ok);
+	if (!ok) {
+		fprintf(stderr, "rect_batch: could not link program\n");
+		goto err;
+	}
+	rb->u_size = glGetUniformLocation(rb->prog, "u_size");
+	glGenBuffers(1, &rb->vbo);
+	return 0;
+err:
+	if (vs) glDeleteShader(vs);
+	if (fs) glDeleteShader(fs);
+	if (rb->prog) glDeleteProgram(rb->prog);
+	vec_free(&rb->verts);
+	return -1;
+}
+void rect_batch_finish(struct rect_batch *rb) {
+	glDeleteBuffers(1, &rb->vbo);
+	glDeleteProgram(rb->prog);
+	vec_free(&rb->verts);
+}
+
+void rect_batch_put(struct rect_batch *rb, const float p[4], uint32_t argb,
+		const float clip[4]) {
+	float x0 = p[0], y0 = p[1], x1 = p[0] + p[2], y1 = p[1] + p[3];
+	if (clip) {
+		if (x0 < clip[0]) x0 = clip[0];
+		if (y0 < clip[1]) y0 = clip[1];
+		if (x1 > clip[0] + clip[2]) x1 = clip[0] + clip[2];
+		if (y1 > clip[1] + clip[3]) y1 = clip[1] + clip[3];
+	}
+	if (x0 >= x1 || y0 >= y1) return;
+
+	struct rect_vert v = { .c = {
+		(argb >> 16) & 0xFF, (argb >> 8) & 0xFF, argb & 0xFF,
+		(argb >> 24) & 0xFF
+	} };
+	const float corners[6][2] = {
+		{ x0, y0 }, { x1, y0 }, { x0, y1 },
+		{ x0, y1 }, { x1, y0 }, { x1, y1 },
+	};
+	for (int i = 0; i < 6; ++i) {
+		v.p[0] = corners[i][0];
+		v.p[1] = corners[i][1];
+		vec_append(&rb->verts, &v);
+	}
+}
+
+void rect_batch_draw(struct rect_batch *rb, uint32_t viewport[2]) {
+	if (rb->verts.len == 0) return;
+
+	glUseProgram(rb->prog);
+	glUniform2f(rb->u_size, viewport[0], viewport[1]);
+	glBindBuffer(GL_ARRAY_BUFFER, rb->vbo);
+	glBufferData(GL_ARRAY_BUFFER,
+		(GLsizeiptr)rb->verts.len * sizeof(struct rect_vert),
+		rb->verts.d, GL_STREAM_DRAW);
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE,
+		sizeof(struct rect_vert), (void *)0);
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+		sizeof(struct rect_vert),
+		(void *)offsetof(struct rect_vert, c));
+	glDrawArrays(GL_TRIANGLES, 0, rb->verts.len);
+	glDisableVertexAttribArray(0);
+	glDisableVertexAttribArray(1);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glUseProgram(0);
+
+	vec_clear(&rb->verts);
+}
@@ -1,12 +1,18 @@
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
 #include <mgu/gl.h>
 #include <ds/matrix.h>
 #include "render.h"
+#include "frame.h"
 #include "application.h"
 #include "core.h"
 #include "util.h"
+#include "trace.h"
 #include <platform_utils/log.h>
 
 // TODO: code duplication with mgu sr.c
@@ -51,6 +57,15 @@ char* text_format(const char *fmt, ...) {
        return buf;
 }
 
+/* mgu_tex_text, traced */
+static struct mgu_texture tex_text(struct app *app,
+		struct mgu_text_opts opts) {
+	struct trace_scope sc = trace_begin("text");
+	struct mgu_texture tex = mgu_tex_text(app->text, opts);
+	trace_end(sc);
+	return tex;
+}
+
 void w_sidebar_init(struct w_sidebar *w, struct app *app) {
 	w->cal_texts = vec_new_empty(sizeof(struct mgu_texture));
 	w->filter_texts = vec_new_empty(sizeof(struct mgu_texture));
@@ -62,7 +77,7 @@ void w_sidebar_init(struct w_sidebar *w, struct app *app) {
 	for (int i = 0; i < app->cals.len; ++i) {
 		struct calendar *cal = vec_get(&app->cals, i);
 		char *str = text_format("%i: %s", i + 1, str_cstr(&cal->name));
-		struct mgu_texture tex = mgu_tex_text(app->text,
+		struct mgu_texture tex = tex_text(app,
 				(struct mgu_text_opts){
 			.str = str,
 			.s = { w->width, -1 },
@@ -74,7 +89,7 @@ void w_sidebar_init(struct w_sidebar *w, struct app *app) {
 
 	for (int i = 0; i < app->filters.len; ++i) {
 		struct filter *filter = vec_get(&app->filters, i);
-		struct mgu_texture tex = mgu_tex_text(app->text,
+		struct mgu_texture tex = tex_text(app,
 				(struct mgu_text_opts){
 			.str = str_cstr(&filter->desc),
 			.s = { w->width, -1 },
@@ -93,7 +108,7 @@ void w_sidebar_init(struct w_sidebar *w, struct app *app) {
 		str_append_char(&s, ' ');
 		str_append(&s, str_cstr(&action->label), action->label.v.len);
 
-		struct mgu_texture tex = mgu_tex_text(app->text,
+		struct mgu_texture tex = tex_text(app,
 				(struct mgu_text_opts){
 			.str = str_cstr(&s),
 			.s = { w->width, -1 },
@@ -118,8 +133,8 @@ void w_sidebar_finish(struct w_sidebar *w) {
 	}
 }
 
-static void w_sidebar_render(struct w_sidebar *w, struct app *app,
-		struct float4 b) {
+static void w_sidebar_layout(struct w_sidebar *w, struct app *app,
+		struct frame *f, struct float4 b) {
 	float h = 0;
 	float pad = 6;
 	for (int i = 0; i < app->cals.len; ++i) {
@@ -127,14 +142,14 @@ static void w_sidebar_render(struct w_sidebar *w, struct app *app,
 		struct mgu_texture *tex = vec_get(&w->cal_texts, i);
 		float height = tex->s[1];
 
-		sr_put(app->sr, (struct sr_spec){
+		frame_put(f, (struct sr_spec){
 			.t = SR_RECT,
 			.p = { b.x, b.y + h, b.w, height + pad },
 			.argb = fade_to_bg(&app->theme, cal_info->color,
 				app->theme.user_color_fade_factor)
 		});
 
-		sr_put(app->sr, (struct sr_spec){
+		frame_put(f, (struct sr_spec){
 			.t = SR_TEX,
 			.p = { b.x, b.y + h + pad / 2, b.w, height },
 			.argb = app->theme.col_c.foreground,
@@ -142,7 +157,7 @@ static void w_sidebar_render(struct w_sidebar *w, struct app *app,
 		});
 
 		h += height + pad + 1;
-		sr_put(app->sr, (struct sr_spec){
+		frame_put(f, (struct sr_spec){
 			.t = SR_RECT,
 			.p = { b.x, b.y + h - 1, b.w, 1 },
 			.argb = app->theme.col_c.separator
@@ -156,14 +171,14 @@ static void w_sidebar_render(struct w_sidebar *w, struct app *app,
 		float height = tex->s[1];
 
 		if (app->current_filter == i) {
-			sr_put(app->sr, (struct sr_spec){
+			frame_put(f, (struct sr_spec){
 				.t = SR_RECT,
 				.p = { b.x, b.y + h, b.w, height + pad },
 				.argb = app->theme.col_c.accent
 			});
 		}
 
-		sr_put(app->sr, (struct sr_spec){
+		frame_put(f, (struct sr_spec){
 			.t = SR_TEX,
 			.p = { b.x, b.y + h, b.w, height + pad },
 			.argb = app->theme.col_c.foreground,
@@ -172,7 +187,7 @@ static void w_sidebar_render(struct w_sidebar *w, struct app *app,
 		});
 
 		h += height + pad + 1;
-		sr_put(app->sr, (struct sr_spec){
+		frame_put(f, (struct sr_spec){
 			.t = SR_RECT,
 			.p = { b.x, b.y + h - 1, b.w, 1 },
 			.argb = app->theme.col_c.separator
@@ -186,7 +201,7 @@ static void w_sidebar_render(struct w_sidebar *w, struct app *app,
 
 		struct mgu_texture *tex = vec_get(&w->action_texts, i);
 
-		sr_put(app->sr, (struct sr_spec){
+		frame_put(f, (struct sr_spec){
 			.t = SR_TEX,
 			.p = { b.x, b.y + h, b.w, btn_h + pad },
 			.argb = app->theme.col_c.foreground,
@@ -201,14 +216,14 @@ static void w_sidebar_render(struct w_sidebar *w, struct app *app,
 		vec_append(&app->tap_areas, &ta);
 
 		h += btn_h + pad + 1;
-		sr_put(app->sr, (struct sr_spec){
+		frame_put(f, (struct sr_spec){
 			.t = SR_RECT,
 			.p = { b.x, b.y + h - 1, b.w, 1 },
 			.argb = app->theme.col_c.separator
 		});
 	}
 
-	sr_put(app->sr, (struct sr_spec){
+	frame_put(f, (struct sr_spec){
 		.t = SR_RECT,
 		.p = { b.x + b.w, b.y, 2, b.h },
 		.argb = app->theme.col_c.separator
@@ -289,10 +304,81 @@ struct tview_params {
 	 * view_ran.to */
 	struct ts_ran view_ran;
 };
-static void render_tobject(struct app *app,
-		struct tobject *obj, fbox b, struct tview_params p) {
+/* summary and location labels of an event, textures are made on demand */
+static void submit_event_labels(void *cl, void *env, const float p[4]) {
+	struct app *app = cl;
+	struct active_comp *ac = env;
 	int text_px = 0.18 * app->out->ppvd;
 	int text_px_small = 0.16 * app->out->ppvd;
+	float x = p[0], y = p[1], w = p[2], h = p[3];
+
+	float loc_h = 0;
+	const char *location = props_get_location(ac->ci->p);
+	if (location) {
+		struct mgu_texture *loc_tex = &ac->loc_tex;
+		if (!loc_tex->tex) {
+			*loc_tex = tex_text(app,
+					(struct mgu_text_opts){
+				.str = location,
+				.s = { w, -1 },
+				.size_px = text_px_small,
+			});
+		}
+		loc_h = mini(h / 2, loc_tex->s[1]);
+		sr_put(app->sr, (struct sr_spec){
+			.t = SR_TEX,
+			.p = { x, y + h - loc_h, w, loc_h },
+			.argb = app->theme.col_c.foreground,
+			.tex = *loc_tex
+		});
+	}
+
+	if (!ac->tex.tex) {
+		const char *summary = props_get_summary(ac->ci->p);
+		struct simple_date local_start = simple_date_from_ts(
+			ac->ci->rdp.start, app->zone);
+		struct simple_date local_end = simple_date_from_ts(
+			ac->ci->rdp.end, app->zone);
+		char *str = text_format("%02d:%02d-%02d:%02d %s",
+				local_start.hour, local_start.minute,
+				local_end.hour, local_end.minute,
+				summary);
+		ac->tex = tex_text(app, (struct mgu_text_opts){
+			.str = str,
+			.s = { w, -1 },
+			.size_px = text_px,
+		});
+		free(str);
+	}
+	sr_put(app->sr, (struct sr_spec){
+		.t = SR_TEX,
+		.p = { x, y, w, h - loc_h },
+		.argb = app->theme.col_c.foreground,
+		.tex = ac->tex
+	});
+}
+/* summary of a scheduled todo */
+static void submit_todo_label(void *cl, void *env, const float p[4]) {
+	struct app *app = cl;
+	struct active_comp *ac = env;
+	if (!ac->tex.tex) {
+		const char *summary = props_get_summary(ac->ci->p);
+		ac->tex = tex_text(app, (struct mgu_text_opts){
+			.str = summary ? summary : "",
+			.s = { p[2], -1 },
+			.size_px = 0.16 * app->out->ppvd,
+		});
+	}
+	sr_put(app->sr, (struct sr_spec){
+		.t = SR_TEX,
+		.p = { p[0], p[1], p[2], p[3] },
+		.argb = app->theme.col_c.foreground,
+		.tex = ac->tex
+	});
+}
+static void layout_tobject(struct app *app, struct frame *f,
+		struct tobject *obj, fbox b, struct tview_params p) {
+	int text_px = 0.18 * app->out->ppvd;
 
 	double x, y, w, h;
 	if (p.dir) {
@@ -321,7 +407,7 @@ static void render_tobject(struct app *app,
 	} else asrt(false, "");
 
 	/* fill base rect */
-	sr_put(app->sr, (struct sr_spec){
+	frame_put(f, (struct sr_spec){
 		.t = SR_RECT,
 		.p = { x, y, w, h },
 		.argb = color
@@ -330,66 +416,16 @@ static void render_tobject(struct app *app,
 	/* draw various labels */
 	if (draw_labels && obj->type == TOBJECT_EVENT
 			&& !obj->ac->settings.hide) {
-		float loc_h = 0;
-		const char *location =
-			props_get_location(obj->ac->ci->p);
-		if (location) {
-			struct mgu_texture *loc_tex = &obj->ac->loc_tex;
-			if (!loc_tex->tex) {
-				*loc_tex = mgu_tex_text(app->text,
-						(struct mgu_text_opts){
-					.str = location,
-					.s = { w, -1 },
-					.size_px = text_px_small,
-				});
-			}
-			loc_h = mini(h / 2, loc_tex->s[1]);
-			sr_put(app->sr, (struct sr_spec){
-				.t = SR_TEX,
-				.p = { x, y + h - loc_h, w, loc_h },
-				.argb = app->theme.col_c.foreground,
-				.tex = *loc_tex
-			});
-		}
-
-		if (!obj->ac->tex.tex) {
-			const char *summary = props_get_summary(obj->ac->ci->p);
-			struct simple_date local_start = simple_date_from_ts(
-				obj->ac->ci->rdp.start, app->zone);
-			struct simple_date local_end = simple_date_from_ts(
-				obj->ac->ci->rdp.end, app->zone);
-			char *str = text_format("%02d:%02d-%02d:%02d %s",
-					local_start.hour, local_start.minute,
-					local_end.hour, local_end.minute,
-					summary);
-			obj->ac->tex = mgu_tex_text(app->text,
-					(struct mgu_text_opts){
-				.str = str,
-				.s = { w, -1 },
-				.size_px = text_px,
-			});
-			free(str);
-		}
-		sr_put(app->sr, (struct sr_spec){
-			.t = SR_TEX,
-			.p = { x, y, w, h - loc_h },
-			.argb = app->theme.col_c.foreground,
-			.tex = obj->ac->tex
-		});
-
+		frame_defer(f, submit_event_labels, obj->ac,
+			(float[]){ x, y, w, h });
+	} else if (draw_labels && obj->type == TOBJECT_TODO) {
+		frame_defer(f, submit_todo_label, obj->ac,
+			(float[]){ x, y, w, h });
 	}
-	// if (draw_labels && obj->type == TOBJECT_TODO) {
-	// 	cairo_set_source_argb(cr, fg);
-	// 	cairo_move_to(cr, x, y);
-	// 	app->tr->p.width = w; app->tr->p.height = h;
-	// 	char *text = text_format("TODO: %s",
-	// 		props_get_summary(obj->ac->ci->p));
-	// 	text_print_free(cr, app->tr, text);
-	// }
 
 	/* draw keycode tags */
 	if (obj->type == TOBJECT_EVENT && app->keystate == KEYSTATE_SELECT) {
-		sr_put(app->sr, (struct sr_spec){
+		frame_put(f, (struct sr_spec){
 			.t = SR_TEXT,
 			.p = { x, y, w, h },
 			.argb = (color ^ 0x00FFFFFF) | 0xFF000000,
@@ -398,9 +434,16 @@ static void render_tobject(struct app *app,
 		});
 	}
 }
+
+/* a slice, and the range of its subslices in struct layout_job::sub */
+struct layout_item {
+	struct ts_ran ran;
+	struct simple_date label;
+	int sub_fr, sub_n;
+};
 struct ctx {
 	struct app *app;
-	struct slicing *s;
+	struct frame *f;
 	enum slicing_type st;
 	int level;
 	bool dir;
@@ -410,37 +453,95 @@ struct ctx {
 	struct ts_ran len_clip;
 	struct vec *tobjs;
 	bool now_shading;
-	uint32_t viewport[2];
+	bool free_busy_shading;
+	/* subslices of the slice being laid out, gathered beforehand so that
+	 * the slicing cache is not touched during layout */
+	const struct layout_item *sub;
+	int sub_n;
 };
-static void render_ran(void *env, struct ts_ran ran, struct simple_date label) {
-	struct ctx *ctx = env;
+static bool tobject_len_clipped(const struct ctx *ctx,
+		const struct tobject *obj) {
+	ts len = obj->time.to - obj->time.fr;
+	if (ctx->len_clip.fr != -1 && ctx->len_clip.fr > len) return true;
+	if (ctx->len_clip.to != -1 && ctx->len_clip.to <= len) return true;
+	return false;
+}
+static void add_scheduled_todos(struct ctx *ctx, struct ts_ran ran) {
+	const struct vec *v = &ctx->app->todo_schedule;
+	/* the first one that ends after ran.fr */
+	int lo = 0, hi = v->len;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		const struct tobject *obj = vec_get_c(v, mid);
+		if (obj->time.to <= ran.fr) lo = mid + 1;
+		else hi = mid;
+	}
+	for (int i = lo; i < v->len; ++i) {
+		const struct tobject *obj = vec_get_c(v, i);
+		if (obj->time.fr >= ran.to) break;
+		if (tobject_len_clipped(ctx, obj)) continue;
+		vec_append(ctx->tobjs, obj);
+	}
+}
+/* shades the time of app->free_busy_overlay in ran, under the events */
+static void layout_free_busy(struct ctx *ctx, struct ts_ran ran, fbox bsl) {
 	struct app *app = ctx->app;
+	if (!ctx->free_busy_shading) return;
+	if (app->free_busy_overlay == FREEBUSY_NONE) return;
+	struct vec busy = vec_new_empty(sizeof(struct ts_ran));
+	app_free_busy(app, app->free_busy_overlay, ran, &busy);
+	uint32_t col = fade_to_bg(&app->theme, app->theme.col_c.accent, 0.8f);
+	double len = ran.to - ran.fr;
+	for (int i = 0; i < busy.len; ++i) {
+		const struct ts_ran *b = vec_get_c(&busy, i);
+		double pa = (b->fr - ran.fr) / len;
+		double pl = (b->to - b->fr) / len;
+		fbox nb = bsl;
+		if (ctx->dir) nb.y += bsl.h * pa, nb.h = bsl.h * pl;
+		else nb.x += bsl.w * pa, nb.w = bsl.w * pl;
+		frame_put(ctx->f, (struct sr_spec){
+			.t = SR_RECT,
+			.p = { nb.x, nb.y, nb.w, nb.h },
+			.argb = col
+		});
+	}
+	if (busy.len > 0) frame_present(ctx->f);
+	vec_free(&busy);
+}
+/*
+ * Only reads app state, and only writes ctx->f and ctx->tobjs, so slices
+ * can be laid out in parallel.
+ */
+static void layout_ran(struct ctx *ctx, struct ts_ran ran,
+		struct simple_date label) {
+	struct app *app = ctx->app;
+	struct frame *f = ctx->f;
 	fbox btop = ctx->btop;
 	fbox bmain = ctx->bmain, bhead = ctx->bhead;
 	fbox bsl = fbox_slice(bmain, ctx->dir, ctx->view, ran);
 	fbox bhsl = fbox_slice(bhead, ctx->dir, ctx->view, ran);
 
 	if (ctx->now_shading && ts_ran_in(ran, ctx->app->now)) {
-		sr_clip_push(app->sr,
+		frame_clip_push(f,
 			(float[]){ btop.x, btop.y, btop.w, btop.h });
 
 		uint32_t bg = fade_to_bg(&app->theme,
 			app->theme.col_c.highlight, ctx->level * 0.6f);
-		sr_put(app->sr, (struct sr_spec){
+		frame_put(f, (struct sr_spec){
 			.t = SR_RECT,
 			.p = { bsl.x, bsl.y, bsl.w, bsl.h },
 			.argb = bg
 		});
 		if (ctx->level == 1) {
-			sr_put(app->sr, (struct sr_spec){
+			frame_put(f, (struct sr_spec){
 				.t = SR_RECT,
 				.p = { bhsl.x, bhsl.y, bhsl.w, bhsl.h },
 				.argb = bg
 			});
 		}
 
-		sr_present(app->sr, ctx->viewport);
-		sr_clip_pop(app->sr);
+		frame_present(f);
+		frame_clip_pop(f);
 	}
 
 	if (ctx->level > 0) {
@@ -451,16 +552,19 @@ static void render_ran(void *env, struct ts_ran ran, struct simple_date label) {
 		next_ctx.view = ran;
 		next_ctx.dir = !next_ctx.dir;
 		++next_ctx.st;
-		if (next_ctx.st <= SLICING_HOUR) {
-			slicing_iter_items(ctx->s, &next_ctx,
-				render_ran, next_ctx.st, ran);
+		next_ctx.sub = NULL;
+		next_ctx.sub_n = 0;
+		for (int i = 0; i < ctx->sub_n; ++i) {
+			layout_ran(&next_ctx, ctx->sub[i].ran,
+				ctx->sub[i].label);
 		}
 	}
 
-	sr_clip_push(app->sr, (float[]){ btop.x, btop.y, btop.w, btop.h });
-
+	frame_clip_push(f, (float[]){ btop.x, btop.y, btop.w, btop.h });
 	if ((ctx->level == 0 && ctx->st < SLICING_HOUR)
 			|| ctx->st == SLICING_DAY) {
+		layout_free_busy(ctx, ran, bsl);
+
 		/* draw overlapping objects */
 		vec_clear(ctx->tobjs);
 		struct interval_iter i_iter = interval_iter(
@@ -476,14 +580,10 @@ static void render_ran(void *env, struct ts_ran ran, struct simple_date label) {
 				.ac = ac,
 			};
 
-			ts len = obj.time.to - obj.time.fr;
-			if (ctx->len_clip.fr != -1
-					&& ctx->len_clip.fr > len) continue;
-			if (ctx->len_clip.to != -1
-					&& ctx->len_clip.to <= len) continue;
-
+			if (tobject_len_clipped(ctx, &obj)) continue;
 			vec_append(ctx->tobjs, &obj);
 		}
+		add_scheduled_todos(ctx, ran);
 		tobject_layout(ctx->tobjs, NULL);
 		double len = ran.to - ran.fr;
 		for (int i = 0; i < ctx->tobjs->len; ++i) {
@@ -509,12 +609,14 @@ static void render_ran(void *env, struct ts_ran ran, struct simple_date label) {
 				nb.w = bsl.w * pl;
 				nb.h = bsl.h / obj->max_n;
 			}
-			render_tobject(ctx->app, obj, nb, ctx->p);
+			layout_tobject(ctx->app, f, obj, nb, ctx->p);
 		}
 
-		/* draw time marker red line */
+		/* draw time marker red line, in a layer of its own so that
+		 * it is above the labels of the events */
 		ts now = ctx->app->now;
 		if (ts_ran_in(ran, now)) {
+			frame_present(f);
 			double pa = (now - ran.fr) / len;
 			fbox nb;
 			if (ctx->dir) {
@@ -528,7 +630,7 @@ static void render_ran(void *env, struct ts_ran ran, struct simple_date label) {
 				nb.w = 2;
 				nb.h = bsl.h;
 			}
-			sr_put(app->sr, (struct sr_spec){
+			frame_put(f, (struct sr_spec){
 				.t = SR_RECT,
 				.p = { nb.x, nb.y, nb.w, nb.h },
 				.argb = app->theme.col_c.highlight
@@ -539,28 +641,28 @@ static void render_ran(void *env, struct ts_ran ran, struct simple_date label) {
 	/* draw lines between slices */
 	float lw = ctx->p.sep_line;
 	if (ctx->dir) {
-		sr_put(app->sr, (struct sr_spec){
+		frame_put(f, (struct sr_spec){
 			.t = SR_RECT,
 			.p = { bsl.x - lw/2, bsl.y, lw, bsl.h },
 			.argb = app->theme.col_c.separator
 		});
 	} else {
-		sr_put(app->sr, (struct sr_spec){
+		frame_put(f, (struct sr_spec){
 			.t = SR_RECT,
 			.p = { bsl.x, bsl.y - lw/2, bsl.w, lw },
 			.argb = app->theme.col_c.separator
 		});
 	}
 
-	sr_present(app->sr, ctx->viewport);
-	sr_clip_pop(app->sr);
+	frame_present(f);
+	frame_clip_pop(f);
 
 	if (ctx->level == 1) {
-		sr_clip_push(app->sr,
+		frame_clip_push(f,
 			(float[]){ bhead.x, bhead.y, bhead.w, bhead.h });
 
 		/* draw header */
-		sr_put(app->sr, (struct sr_spec){
+		frame_put(f, (struct sr_spec){
 			.t = SR_RECT,
 			.p = { bhsl.x, bhsl.y, ctx->p.sep_line, bhsl.h },
 			.argb = app->theme.col_c.separator
@@ -572,7 +674,7 @@ static void render_ran(void *env, struct ts_ran ran, struct simple_date label) {
 			label.t[0], label.t[1]);
 		else text = text_format("%d-%d-%d",
 			label.t[0], label.t[1], label.t[2]);
-		sr_put(app->sr, (struct sr_spec){
+		frame_put(f, (struct sr_spec){
 			.t = SR_TEXT,
 			.p = { bhsl.x, bhsl.y, bhsl.w, bhsl.h },
 			.argb = app->theme.col_c.foreground,
@@ -581,64 +683,150 @@ static void render_ran(void *env, struct ts_ran ran, struct simple_date label) {
 		});
 		free(text);
 
-		sr_present(app->sr, ctx->viewport);
-		sr_clip_pop(app->sr);
+		frame_present(f);
+		frame_clip_pop(f);
+	}
+}
+
+/* struct todo_row */
+void todo_row_finish(struct todo_row *row) {
+	mgu_texture_destroy(&row->summary);
+	mgu_texture_destroy(&row->desc);
+	free(row->side_text);
+	free(row->cats_text);
+	*row = (struct todo_row){ 0 };
+}
+
+#define TODO_ROW_MIN_H 40
+#define TODO_ROW_SEP 2
+
+/* height of the row with its separator, estimated if not measured yet */
+static int todo_row_height(const struct todo_row *row) {
+	return (row->h > 0 ? row->h : TODO_ROW_MIN_H) + TODO_ROW_SEP;
+}
+
+/* due date and estimated duration, shown on the right side of the row */
+static char *todo_side_text(struct app *app, struct active_comp *ac) {
+	ts due = ac->ci->rdp.due;
+	int est;
+	bool has_est = props_get_estimated_duration(ac->ci->p, &est);
+
+	char *text = NULL;
+	if (due != -1) {
+		text = natural_date_format(app, due);
+	}
+	if (has_est) {
+		char *text_dur = format_dur(est);
+		char *text_comb = text
+			? text_format("%s\n~%s", text, text_dur)
+			: text_format("~%s", text_dur);
+		free(text);
+		free(text_dur);
+		text = text_comb;
+	}
+	return text;
+}
+
+/*
+ * Formats and measures the row, if it was not done yet for this width, and
+ * on this day (the side text is relative to the current day).
+ */
+static void todo_row_update(struct app *app, struct active_comp *ac,
+		int bw, int day) {
+	struct todo_row *row = &ac->row;
+	bool measured = row->h > 0;
+	if (measured && row->w == bw && row->day == day) return;
+
+	if (!measured || row->day != day) {
+		free(row->side_text);
+		row->side_text = todo_side_text(app, ac);
+		row->day = day;
+	}
+
+	int n_cats = props_get_categories_n(ac->ci->p);
+	if (!measured && n_cats > 0) {
+		free(row->cats_text);
+		struct str s = str_new_empty();
+		str_append_char(&s, '[');
+		for (int k = 0; k < n_cats; ++k) {
+			const char *si = props_get_category(ac->ci->p, k);
+			str_append(&s, si, strlen(si));
+			if (k < n_cats - 1) str_append_char(&s, ' ');
+		}
+		str_append_char(&s, ']');
+		row->cats_text = str_dup(str_cstr(&s));
+		str_free(&s);
+	}
+
+	if (!measured || row->w != bw) {
+		int text_px = 0.18 * app->out->ppvd;
+		const char *desc = props_get_desc(ac->ci->p);
+		const char *summary = props_get_summary(ac->ci->p);
+		const int due_w = 2 * app->out->ppvd;
+		int w = bw - due_w;
+		int n = 1 + (desc ? 1 : 0) + (row->cats_text ? 1 : 0);
+		int hpad = 5;
+
+		mgu_texture_destroy(&row->summary);
+		mgu_texture_destroy(&row->desc);
+		row->h = TODO_ROW_MIN_H;
+		if (summary) {
+			row->summary = tex_text(app,
+					(struct mgu_text_opts){
+				.str = summary,
+				.s = { w/n - 2*hpad, -1 },
+				.size_px = text_px,
+			});
+			row->h = maxi(row->h, row->summary.s[1]);
+		}
+		if (desc) {
+			row->desc = tex_text(app,
+					(struct mgu_text_opts){
+				.str = desc,
+				.s = { w/n - 2*hpad, -1 },
+				.size_px = text_px,
+			});
+			row->h = maxi(row->h, row->desc.s[1]);
+		}
+		row->w = bw;
 	}
 }
 
 /* return height */
-static int render_todo_item(struct app *app, struct active_comp *ac, box b) {
+static int layout_todo_item(struct app *app, struct frame *f,
+		struct active_comp *ac, box b, int day) {
 	int text_px = 0.18 * app->out->ppvd;
 
+	todo_row_update(app, ac, b.w, day);
+	const struct todo_row *row = &ac->row;
+	b.h = row->h;
+
 	/* prepare all the info we need */
 	ts start = ac->ci->rdp.start, due = ac->ci->rdp.due;
 	enum prop_status status;
-	int perc_c, est;
+	int perc_c;
 	bool has_start = start != -1;
 	bool has_due = due != -1;
 	bool has_status = props_get_status(ac->ci->p, &status);
 	bool has_perc_c = props_get_percent_complete(ac->ci->p, &perc_c);
-	bool has_est = props_get_estimated_duration(ac->ci->p, &est);
-	const char *desc = props_get_desc(ac->ci->p);
-	const char *summary = props_get_summary(ac->ci->p);
-	const struct vec *cats = props_get_categories(ac->ci->p);
+	bool has_desc = props_get_desc(ac->ci->p);
+	bool has_cats = row->cats_text;
 
 	bool completed = has_status && status == PROP_STATUS_COMPLETED;
 	bool inprocess = has_status && status == PROP_STATUS_INPROCESS;
 	bool overdue = !completed && has_due && due < app->now;
 	bool not_started = has_start && start > app->now;
-	bool has_cats = cats && cats->len > 0;
 	double perc = has_perc_c ? perc_c / 100.0 : 0.0;
 	int hpad = 5;
 
 	const int due_w = 2 * app->out->ppvd;
 	int w = b.w - due_w;
 	int n = 1;
-	if (desc) n += 1;
+	if (has_desc) n += 1;
 	if (has_cats) n += 1;
 
-	struct mgu_texture tex_summary = { 0 }, tex_desc = { 0 };
-
-	/* calculate height */
-	if (summary) {
-		tex_summary = mgu_tex_text(app->text, (struct mgu_text_opts){
-			.str = summary,
-			.s = { w/n - 2*hpad, -1 },
-			.size_px = text_px,
-		});
-		b.h = maxi(b.h, tex_summary.s[1]);
-	}
-	if (desc) {
-		tex_desc = mgu_tex_text(app->text, (struct mgu_text_opts){
-			.str = desc,
-			.s = { w/n - 2*hpad, -1 },
-			.size_px = text_px,
-		});
-		b.h = maxi(b.h, tex_desc.s[1]);
-	}
-
 	if (overdue) {
-		sr_put(app->sr, (struct sr_spec){
+		frame_put(f, (struct sr_spec){
 			.t = SR_RECT,
 			.p = { b.x + b.w - due_w, b.y, due_w, b.h },
 			.argb = app->theme.col_c.highlight
@@ -651,14 +839,14 @@ static int render_todo_item(struct app *app, struct active_comp *ac, box b) {
 	if (completed || inprocess) {
 		double w = b.w - due_w;
 		if (perc > 0) w *= perc;
-		sr_put(app->sr, (struct sr_spec){
+		frame_put(f, (struct sr_spec){
 			.t = SR_RECT,
 			.p = { b.x, b.y, w, b.h },
 			.argb = b_col
 		});
 	} else if (has_perc_c) {
 		double w = (b.w - due_w) * perc;
-		sr_put(app->sr, (struct sr_spec){
+		frame_put(f, (struct sr_spec){
 			.t = SR_RECT,
 			.p = { b.x, b.y, w, b.h },
 			.argb = b_col
@@ -670,77 +858,49 @@ static int render_todo_item(struct app *app, struct active_comp *ac, box b) {
 		app->theme.col_c.foreground, fade_factor);
 
 	/* draw text in the slots */
-	char *text = NULL;
-	if (has_due) {
-		free(text);
-		text = natural_date_format(app, due);
-	}
-	if (has_est) {
-		char *text_dur = format_dur(est);
-		if (text != NULL) {
-			char *text_comb =
-				text_format("%s\n~%s", text, text_dur);
-			free(text);
-			text = text_comb;
-		} else {
-			char *text_comb = text_format("~%s", text_dur);
-			text = text_comb;
-		}
-		free(text_dur);
-	}
-	if (text) {
-		sr_put(app->sr, (struct sr_spec){
+	if (row->side_text) {
+		frame_put(f, (struct sr_spec){
 			.t = SR_TEXT,
 			.p = { b.x + b.w - due_w, b.y, due_w, b.h },
 			.argb = t_col,
 			.o = SR_CENTER,
-			.text = { .px = text_px, .s = text },
+			.text = { .px = text_px, .s = row->side_text },
 		});
-		free(text);
 	}
 	if (has_cats) {
 		int i = 0;
-		struct str s = str_new_empty();
-		str_append_char(&s, '[');
-		for (int k = 0; k < cats->len; ++k) {
-			const struct str *si = vec_get_c(cats, k);
-			str_append(&s, str_cstr(si), si->v.len);
-			if (k < cats->len - 1) str_append_char(&s, ' ');
-		}
-		str_append_char(&s, ']');
-		sr_put(app->sr, (struct sr_spec){
+		frame_put(f, (struct sr_spec){
 			.t = SR_TEXT,
 			.p = { b.x + w*i/n + hpad, b.y, w/n - 2*hpad, b.h },
 			.argb = t_col,
 			.o = SR_CENTER,
-			.text = { .px = text_px, .s = str_cstr(&s) },
+			.text = { .px = text_px, .s = row->cats_text },
 		});
-		str_free(&s);
 	}
-	if (summary) {
+	if (props_get_summary(ac->ci->p)) {
 		int i = 0 + (has_cats ? 1 : 0);
-		sr_put(app->sr, (struct sr_spec){
+		frame_put(f, (struct sr_spec){
 			.t = SR_TEX,
 			.p = { b.x + w*i/n + hpad, b.y, w/n - 2*hpad, b.h },
 			.argb = t_col,
-			.o = SR_CENTER | SR_TEX_PASS_OWNERSHIP,
-			.tex = tex_summary,
+			.o = SR_CENTER,
+			.tex = row->summary,
 		});
 	}
-	if (desc) {
+	if (has_desc) {
 		int i = 1 + (has_cats ? 1 : 0);
-		sr_put(app->sr, (struct sr_spec){
+		frame_put(f, (struct sr_spec){
 			.t = SR_TEX,
 			.p = { b.x + w*i/n + hpad, b.y, w/n - 2*hpad, b.h },
 			.argb = t_col,
-			.o = SR_CENTER_V | SR_TEX_PASS_OWNERSHIP,
-			.tex = tex_desc,
+			.o = SR_CENTER_V,
+			.tex = row->desc,
 		});
 	}
 
 	/* draw slot separators */
 	for (int i = 1; i <= n; ++i) {
-		sr_put(app->sr, (struct sr_spec){
+		frame_put(f, (struct sr_spec){
 			.t = SR_RECT,
 			.p = { b.x + w*i/n, b.y, 1, b.h },
 			.argb = app->theme.col_c.separator
@@ -749,7 +909,7 @@ static int render_todo_item(struct app *app, struct active_comp *ac, box b) {
 
 	/* draw keycode tags */
 	if (app->keystate == KEYSTATE_SELECT) {
-		sr_put(app->sr, (struct sr_spec){
+		frame_put(f, (struct sr_spec){
 			.t = SR_TEXT,
 			.p = { b.x, b.y, b.w, b.h },
 			.argb = 0xFFFF00FF,
@@ -759,30 +919,210 @@ static int render_todo_item(struct app *app, struct active_comp *ac, box b) {
 	}
 
 	/* draw separator on bottom side */
-	sr_put(app->sr, (struct sr_spec){
+	frame_put(f, (struct sr_spec){
 		.t = SR_RECT,
-		.p = { b.x, b.y + b.h, b.w, 2 },
+		.p = { b.x, b.y + b.h, b.w, TODO_ROW_SEP },
 		.argb = app->theme.col_c.separator
 	});
 
-	return b.h + 2;
+	return b.h + TODO_ROW_SEP;
 }
 
-static void render_todo_list(struct app *app, box b) {
+/*
+ * Only the rows intersecting b are formatted and drawn, rows above it are
+ * skipped using their cached (or estimated) height.
+ */
+static void layout_todo_list(struct app *app, struct frame *f, box b) {
 	/* draw separator on top */
-	sr_put(app->sr, (struct sr_spec){
+	frame_put(f, (struct sr_spec){
 		.t = SR_RECT,
 		.p = { b.x, b.y, b.w, 2 },
 		.argb = app->theme.col_c.separator
 	});
 
-	int y = 0;
+	struct simple_date now = simple_date_from_ts(app->now, app->zone);
+	int day = now.year * 10000 + now.month * 100 + now.day;
+
+	int total = 0;
 	for (int i = 0; i < app->active_todos.v.len; ++i) {
 		struct active_comp *ac = vec_get(&app->active_todos.v, i);
 		if (!ac->settings.vis) continue;
-		y += render_todo_item(app, ac, (box){ b.x, b.y + y, b.w, 40 });
-		if (y > b.h) break;
+		total += todo_row_height(&ac->row);
+	}
+	app->todo_scroll = mini(app->todo_scroll, total - b.h);
+	app->todo_scroll = maxi(app->todo_scroll, 0);
+
+	frame_clip_push(f, (float[]){ b.x, b.y, b.w, b.h });
+	int y = -app->todo_scroll;
+	for (int i = 0; i < app->active_todos.v.len && y < b.h; ++i) {
+		struct active_comp *ac = vec_get(&app->active_todos.v, i);
+		if (!ac->settings.vis) continue;
+		int h = todo_row_height(&ac->row);
+		if (y + h <= 0) {
+			y += h;
+			continue;
+		}
+		y += layout_todo_item(app, f, ac,
+			(box){ b.x, b.y + y, b.w, TODO_ROW_MIN_H }, day);
+	}
+	frame_present(f);
+	frame_clip_pop(f);
+}
+
+struct layout_job {
+	struct ctx base;
+	struct vec items; /* vec<struct layout_item> */
+	struct vec sub; /* vec<struct layout_item> */
+	struct vec frames; /* vec<struct frame>, one for each item */
+	atomic_int next;
+};
+static void gather_item(void *env, struct ts_ran ran,
+		struct simple_date label) {
+	struct vec *v = env;
+	vec_append(v, &(struct layout_item){ .ran = ran, .label = label });
+}
+static void *layout_worker(void *env) {
+	struct layout_job *job = env;
+	struct vec tobjs = vec_new_empty(sizeof(struct tobject));
+	int i;
+	while ((i = atomic_fetch_add(&job->next, 1)) < job->items.len) {
+		const struct layout_item *it = vec_get(&job->items, i);
+		struct ctx ctx = job->base;
+		ctx.f = vec_get(&job->frames, i);
+		ctx.tobjs = &tobjs;
+		ctx.sub = (const struct layout_item *)job->sub.d + it->sub_fr;
+		ctx.sub_n = it->sub_n;
+		struct trace_scope sc = trace_begin("layout_slice");
+		layout_ran(&ctx, it->ran, it->label);
+		trace_end(sc);
+	}
+	vec_free(&tobjs);
+	return NULL;
+}
+static void *pool_main(void *env) {
+	struct layout_pool *p = env;
+	unsigned seen = 0;
+	pthread_mutex_lock(&p->mutex);
+	for (;;) {
+		while (!p->quit && p->gen == seen) {
+			pthread_cond_wait(&p->posted, &p->mutex);
+		}
+		if (p->quit) break;
+		seen = p->gen;
+		void *job = p->job;
+		pthread_mutex_unlock(&p->mutex);
+
+		layout_worker(job);
+
+		pthread_mutex_lock(&p->mutex);
+		if (--p->busy == 0) pthread_cond_signal(&p->done);
+	}
+	pthread_mutex_unlock(&p->mutex);
+	return NULL;
+}
+void layout_pool_init(struct layout_pool *p) {
+	*p = (struct layout_pool){ .n = 0 };
+	pthread_mutex_init(&p->mutex, NULL);
+	pthread_cond_init(&p->posted, NULL);
+	pthread_cond_init(&p->done, NULL);
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	int n = mini(LAYOUT_MAX_THREADS, maxi(ncpu, 1)) - 1;
+	while (p->n < n) {
+		if (pthread_create(&p->threads[p->n], NULL,
+				pool_main, p) != 0) {
+			break;
+		}
+		++p->n;
+	}
+}
+void layout_pool_finish(struct layout_pool *p) {
+	pthread_mutex_lock(&p->mutex);
+	p->quit = true;
+	pthread_cond_broadcast(&p->posted);
+	pthread_mutex_unlock(&p->mutex);
+	for (int i = 0; i < p->n; ++i) pthread_join(p->threads[i], NULL);
+	pthread_cond_destroy(&p->done);
+	pthread_cond_destroy(&p->posted);
+	pthread_mutex_destroy(&p->mutex);
+}
+/* the render thread works on the job too, returns once it is done */
+static void layout_pool_run(struct layout_pool *p, struct layout_job *job) {
+	if (p->n == 0 || job->items.len < 2) {
+		layout_worker(job);
+		return;
+	}
+	pthread_mutex_lock(&p->mutex);
+	p->job = job;
+	p->busy = p->n;
+	++p->gen;
+	pthread_cond_broadcast(&p->posted);
+	pthread_mutex_unlock(&p->mutex);
+
+	layout_worker(job);
+
+	pthread_mutex_lock(&p->mutex);
+	while (p->busy > 0) pthread_cond_wait(&p->done, &p->mutex);
+	pthread_mutex_unlock(&p->mutex);
+}
+/*
+ * Lays out the slices of view at base.st, each into its own frame, on the
+ * layout pool, then appends the frames to f in order.
+ */
+static void layout_slices(struct app *app, struct frame *f, struct ctx base,
+		struct ts_ran view) {
+	struct slicing *s = app->slicing;
+	struct layout_job job = {
+		.base = base,
+		.items = vec_new_empty(sizeof(struct layout_item)),
+		.sub = vec_new_empty(sizeof(struct layout_item)),
+		.frames = vec_new_empty(sizeof(struct frame)),
+	};
+	atomic_init(&job.next, 0);
+
+	/* the slicing cache is not thread safe, so walk it here */
+	struct trace_scope sc = trace_begin("slicing");
+	slicing_iter_items(s, &job.items, gather_item, base.st, view);
+	for (int i = 0; i < job.items.len; ++i) {
+		struct layout_item *it = vec_get(&job.items, i);
+		it->sub_fr = job.sub.len;
+		if (base.level > 0 && base.st + 1 <= SLICING_HOUR) {
+			slicing_iter_items(s, &job.sub, gather_item,
+				base.st + 1, it->ran);
+		}
+		it->sub_n = job.sub.len - it->sub_fr;
+
+		struct frame fi;
+		frame_init(&fi);
+		vec_append(&job.frames, &fi);
+	}
+	trace_end(sc);
+
+	/* props_get_color_val fills a cache on first use, do that here too */
+	if (job.items.len > 0) {
+		const struct layout_item *first = vec_get(&job.items, 0);
+		const struct layout_item *last =
+			vec_get(&job.items, job.items.len - 1);
+		struct interval_iter i_iter = interval_iter(
+			&app->active_events.in_view,
+			(long long int[]){ first->ran.fr, last->ran.to });
+		struct interval_node *nx;
+		while (interval_iter_next(&i_iter, &nx)) {
+			struct active_comp *ac = container_of(nx,
+				struct active_comp, node_by_view);
+			props_get_color_val(ac->ci->p);
+		}
+	}
+
+	layout_pool_run(&app->layout_pool, &job);
+
+	for (int i = 0; i < job.frames.len; ++i) {
+		struct frame *fi = vec_get(&job.frames, i);
+		frame_append(f, fi);
+		frame_finish(fi);
 	}
+	vec_free(&job.frames);
+	vec_free(&job.sub);
+	vec_free(&job.items);
 }
 
 bool render_application(void *env, struct mgu_win_surf *surf, uint64_t t) {
@@ -791,7 +1131,7 @@ bool render_application(void *env, struct mgu_win_surf *surf, uint64_t t) {
 	/* check whether we need to render */
 	int w = surf->size[0], h = surf->size[1];
 	ts now = ts_now();
-	if (app->now != now) {
+	if (!app->fixed_now && app->now != now) {
 		app->now = now;
 		app->dirty = true;
 	}
@@ -806,20 +1146,21 @@ bool render_application(void *env, struct mgu_win_surf *surf, uint64_t t) {
 	app->out = mgu_win_surf_get_output(surf);
 	asrt(app->out, "app->out NULL");
 
-	// struct stopwatch sw = sw_start();
-	static int frame_counter = 0;
-	++frame_counter;
+	render_frame(app, surf->size);
+	return true;
+}
 
-	glViewport(0, 0, w, h);
+void render_frame(struct app *app, uint32_t size[2]) {
+	int w = size[0], h = size[1];
+	app->window_width = w;
+	app->window_height = h;
 
-	/* set blending */
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	struct trace_scope sc_frame = trace_begin("frame");
 
-	float color_bg[4];
-	argb_color(color_bg, app->theme.col_c.background);
-	glClearColor(color_bg[0], color_bg[1], color_bg[2], color_bg[3]);
-	glClear(GL_COLOR_BUFFER_BIT);
+	/* layout */
+	struct trace_scope sc_layout = trace_begin("layout");
+	struct frame f;
+	frame_init(&f);
 
 	int time_strip_w = 30;
 	float sidebar_w = app->w_sidebar.width;
@@ -867,6 +1208,7 @@ bool render_application(void *env, struct mgu_win_surf *surf, uint64_t t) {
 
 		struct ts_ran bounds = slicing_get_bounds(s, st, view);
 		app_use_view(app, bounds);
+		app_update_todo_schedule(app);
 
 		struct vec tobjs = vec_new_empty(sizeof(struct tobject));
 		struct tview_params params = {
@@ -876,7 +1218,7 @@ bool render_application(void *env, struct mgu_win_surf *surf, uint64_t t) {
 		};
 		struct ctx ctx = {
 			.app = app,
-			.s = s,
+			.f = &f,
 			.st = st,
 			.level = 1,
 			.dir = true,
@@ -887,11 +1229,11 @@ bool render_application(void *env, struct mgu_win_surf *surf, uint64_t t) {
 			.view = view,
 			.tobjs = &tobjs,
 			.now_shading = true,
-			.viewport = { surf->size[0], surf->size[1] },
+			.free_busy_shading = true,
 		};
 
 		ctx.len_clip = (struct ts_ran){ -1, top_th };
-		slicing_iter_items(s, &ctx, render_ran, st, view);
+		layout_slices(app, &f, ctx, view);
 
 		ctx.len_clip = (struct ts_ran){ top_th, -1 };
 		ctx.btop = ctx.bmain = top_box;
@@ -899,7 +1241,8 @@ bool render_application(void *env, struct mgu_win_surf *surf, uint64_t t) {
 		ctx.level = 0;
 		ctx.st = SLICING_DAY;
 		ctx.now_shading = false;
-		render_ran(&ctx, view, (struct simple_date){ });
+		ctx.free_busy_shading = false;
+		layout_ran(&ctx, view, (struct simple_date){ });
 
 		vec_free(&tobjs);
 
@@ -907,7 +1250,7 @@ bool render_application(void *env, struct mgu_win_surf *surf, uint64_t t) {
 		break;
 	case VIEW_TODO:
 		app_update_projections(app);
-		render_todo_list(app,
+		layout_todo_list(app, &f,
 			(box){ sidebar_w, header_h, w-sidebar_w, h-header_h });
 		view_name = "todo";
 		break;
@@ -915,27 +1258,64 @@ bool render_application(void *env, struct mgu_win_surf *surf, uint64_t t) {
 		asrt(false, "");
 		break;
 	}
-	w_sidebar_render(&app->w_sidebar, app, (struct float4){
+	w_sidebar_layout(&app->w_sidebar, app, &f, (struct float4){
 		.a = { 0, header_h, sidebar_w, h-header_h } });
 
 	struct simple_date sd = simple_date_from_ts(app->now, app->zone);
+	char *hud = NULL;
+	if (app->show_hud) {
+		/* the numbers are for the previous frame */
+		uint64_t fr = app->hud_frame.fr, to = app->hud_frame.to;
+		hud = text_format("frame %.1fms\n"
+			"proj %.1f lay %.1f txt %.1f sub %.1f\n"
+			"live kB recur %lld inst %lld active %lld\n",
+			trace_sum("frame", fr, to) / 1e6,
+			trace_sum("projections", fr, to) / 1e6,
+			trace_sum("layout", fr, to) / 1e6,
+			trace_sum("text", fr, to) / 1e6,
+			trace_sum("submit", fr, to) / 1e6,
+			mem_stat_tag(MEM_TAG_RECUR).bytes / 1024,
+			mem_stat_tag(MEM_TAG_INST).bytes / 1024,
+			mem_stat_tag(MEM_TAG_ACTIVE).bytes / 1024);
+	}
 	char *text = text_format(
-			"%s\nframe %d\n%02d:%02d:%02d\nmode: %s",
+			"%s\n%s%02d:%02d:%02d\nmode: %s",
 			cal_timezone_get_desc(app->zone),
-			frame_counter,
+			hud ? hud : "",
 			sd.hour, sd.minute, sd.second,
 			view_name);
-	sr_put(app->sr, (struct sr_spec){
+	free(hud);
+	frame_put(&f, (struct sr_spec){
 		.t = SR_TEXT,
 		.p = { 0, 0, sidebar_w, header_h },
 		.argb = app->theme.col_c.foreground,
 		.text = { .px = 0.18 * app->out->ppvd, .s = text }
 	});
 	free(text);
+	frame_present(&f);
+	trace_end(sc_layout);
 
-	sr_present(app->sr, surf->size);
+	/* submission */
+	glViewport(0, 0, w, h);
+
+	/* set blending */
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+	float color_bg[4];
+	argb_color(color_bg, app->theme.col_c.background);
+	glClearColor(color_bg[0], color_bg[1], color_bg[2], color_bg[3]);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	struct trace_scope sc_submit = trace_begin("submit");
+	frame_submit(&f, app->sr, app->has_rects ? &app->rects : NULL,
+		size, app);
+	frame_finish(&f);
+	trace_end(sc_submit);
 
 	app->dirty = false;
-	// sw_end_print(sw, "render_application");
-	return true;
+	trace_end(sc_frame);
+	/* from the end of the last frame, to catch the projection update */
+	app->hud_frame.fr = app->hud_frame.to;
+	app->hud_frame.to = trace_now();
 }
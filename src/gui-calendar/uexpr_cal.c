@@ -62,6 +62,15 @@ static enum comp_type parse_enum_comp_type(const char *str) {
 	if (strcmp(str, "todo") == 0) return COMP_TYPE_TODO;
 	return COMP_TYPE_N;
 }
+static bool parse_enum_freebusy_mode(const char *str,
+		enum freebusy_mode *mode) {
+	if (strcmp(str, "any") == 0) *mode = FREEBUSY_ANY;
+	else if (strcmp(str, "all") == 0) *mode = FREEBUSY_ALL;
+	else if (strcmp(str, "free") == 0) *mode = FREEBUSY_FREE;
+	else if (strcmp(str, "none") == 0) *mode = FREEBUSY_NONE;
+	else return false;
+	return true;
+}
 
 #if 0
 #define TRACE() pu_log_info("[cal_uexpr] %s\n", __func__)
@@ -273,6 +282,51 @@ static struct uexpr_value fn_set_colors(void *_env, struct uexpr *e,
 
 	return void_val;
 }
+static struct uexpr_value fn_show_free_busy(void *_env, struct uexpr *e,
+		int root, struct uexpr_ctx *ctx) {
+	TRACE();
+	struct cal_uexpr_env *env = _env;
+
+	struct uexpr_ast_node np =
+		*(struct uexpr_ast_node *)vec_get(&e->ast, root);
+	if (np.args.len != 1) return error_val;
+
+	struct uexpr_value va;
+	uexpr_eval(e, *(int *)vec_get(&np.args, 0), ctx, &va);
+	enum freebusy_mode mode;
+	bool ok = va.type == UEXPR_TYPE_STRING
+		&& parse_enum_freebusy_mode(va.string_ref, &mode);
+	uexpr_value_finish(va);
+	if (!ok) return error_val;
+
+	app_cmd_show_free_busy(env->app, mode);
+
+	return void_val;
+}
+static struct uexpr_value fn_free_busy(void *_env, struct uexpr *e,
+		int root, struct uexpr_ctx *ctx) {
+	TRACE();
+	struct cal_uexpr_env *env = _env;
+
+	struct uexpr_ast_node np =
+		*(struct uexpr_ast_node *)vec_get(&e->ast, root);
+	if (np.args.len != 1) return error_val;
+
+	struct uexpr_value va;
+	uexpr_eval(e, *(int *)vec_get(&np.args, 0), ctx, &va);
+	enum freebusy_mode mode;
+	bool ok = va.type == UEXPR_TYPE_STRING
+		&& parse_enum_freebusy_mode(va.string_ref, &mode);
+	uexpr_value_finish(va);
+	if (!ok) return error_val;
+
+	/* is any of the time of the instance in the time of mode */
+	struct vec out = vec_new_empty(sizeof(struct ts_ran));
+	app_free_busy(env->app, mode, env->pi->ci->rdp.se_ran, &out);
+	bool res = out.len > 0;
+	vec_free(&out);
+	return UEXPR_BOOLEAN(res);
+}
 
 static struct fn config_fns[] = {
 	{ "add_cal", fn_add_cal },
@@ -286,6 +340,7 @@ static struct fn config_fns[] = {
 
 static struct fn action_and_config_fns[] = {
 	{ "set_colors", fn_set_colors },
+	{ "show_free_busy", fn_show_free_busy },
 	{ NULL, NULL },
 };
 
@@ -330,6 +385,19 @@ static struct uexpr_value fn_move_view_discrete(void *_env, struct uexpr *e,
 
 	return void_val;
 }
+static struct uexpr_value fn_scroll_todos(void *_env, struct uexpr *e,
+		int root, struct uexpr_ctx *ctx) {
+	TRACE();
+	struct cal_uexpr_env *env = _env;
+
+	const char *str = get_single_arg_str(e, root, ctx);
+	if (!str) return error_val;
+
+	int n = atoi(str);
+	app_cmd_scroll_todos(env->app, n);
+
+	return void_val;
+}
 static struct uexpr_value fn_view_today(void *_env, struct uexpr *e,
 		int root, struct uexpr_ctx *ctx) {
 	TRACE();
@@ -343,6 +411,58 @@ static struct uexpr_value fn_view_today(void *_env, struct uexpr *e,
 
 	return void_val;
 }
+static struct uexpr_value fn_toggle_hud(void *_env, struct uexpr *e,
+		int root, struct uexpr_ctx *ctx) {
+	TRACE();
+	struct cal_uexpr_env *env = _env;
+
+	struct uexpr_ast_node np =
+		*(struct uexpr_ast_node *)vec_get(&e->ast, root);
+	if (np.args.len != 0) return error_val;
+
+	app_cmd_toggle_hud(env->app, -1);
+
+	return void_val;
+}
+static struct uexpr_value fn_toggle_todo_schedule(void *_env, struct uexpr *e,
+		int root, struct uexpr_ctx *ctx) {
+	TRACE();
+	struct cal_uexpr_env *env = _env;
+
+	struct uexpr_ast_node np =
+		*(struct uexpr_ast_node *)vec_get(&e->ast, root);
+	if (np.args.len != 0) return error_val;
+
+	app_cmd_toggle_todo_schedule(env->app, -1);
+
+	return void_val;
+}
+static struct uexpr_value fn_dump_trace(void *_env, struct uexpr *e,
+		int root, struct uexpr_ctx *ctx) {
+	TRACE();
+	struct cal_uexpr_env *env = _env;
+
+	struct uexpr_ast_node np =
+		*(struct uexpr_ast_node *)vec_get(&e->ast, root);
+	if (np.args.len != 0) return error_val;
+
+	app_cmd_dump_trace(env->app, -1);
+
+	return void_val;
+}
+static struct uexpr_value fn_dump_memory(void *_env, struct uexpr *e,
+		int root, struct uexpr_ctx *ctx) {
+	TRACE();
+	struct cal_uexpr_env *env = _env;
+
+	struct uexpr_ast_node np =
+		*(struct uexpr_ast_node *)vec_get(&e->ast, root);
+	if (np.args.len != 0) return error_val;
+
+	app_cmd_dump_memory(env->app, -1);
+
+	return void_val;
+}
 static struct uexpr_value fn_launch_editor(void *_env, struct uexpr *e,
 		int root, struct uexpr_ctx *ctx) {
 	TRACE();
@@ -406,10 +526,20 @@ static struct uexpr_value fn_select_comp(void *_env, struct uexpr *e,
 	return void_val;
 }
 
+static struct fn filter_fns[] = {
+	{ "free_busy", fn_free_busy },
+	{ NULL, NULL },
+};
+
 static struct fn action_fns[] = {
 	{ "switch_view", fn_switch_view },
 	{ "move_view_discrete", fn_move_view_discrete },
+	{ "scroll_todos", fn_scroll_todos },
 	{ "view_today", fn_view_today },
+	{ "toggle_hud", fn_toggle_hud },
+	{ "toggle_todo_schedule", fn_toggle_todo_schedule },
+	{ "dump_trace", fn_dump_trace },
+	{ "dump_memory", fn_dump_memory },
 	{ "launch_editor", fn_launch_editor },
 	{ "select_comp", fn_select_comp },
 	{ NULL, NULL },
@@ -434,42 +564,7 @@ static bool get_ac(struct cal_uexpr_env *env, const char *key,
 		struct uexpr_value *v) {
 	struct proj_item *pi = env->pi;
 	struct comp_inst *ci = pi->ci;
-	if (strcmp(key, "ev") == 0)
-		return *v = UEXPR_BOOLEAN(ci->c->type == COMP_TYPE_EVENT),
-			true;
-	if (strcmp(key, "sum") == 0)
-		return *v = UEXPR_STRING(props_get_summary(ci->p)), true;
-	if (strcmp(key, "color") == 0)
-		return *v = UEXPR_STRING(props_get_color(ci->p)), true;
-	if (strcmp(key, "loc") == 0)
-		return *v = UEXPR_STRING(props_get_location(ci->p)), true;
-	if (strcmp(key, "desc") == 0)
-		return *v = UEXPR_STRING(props_get_desc(ci->p)), true;
-	if (strcmp(key, "st") == 0) {
-		enum prop_status status;
-		bool has_status = props_get_status(ci->p, &status);
-		*v = UEXPR_STRING(has_status ? cal_status_str(status) : "");
-		return true;
-	}
-	if (strcmp(key, "clas") == 0) {
-		enum prop_class class;
-		bool has_class = props_get_class(ci->p, &class);
-		*v = UEXPR_STRING(has_class ? cal_class_str(class) : "");
-		return true;
-	}
-	if (strcmp(key, "cats") == 0) {
-		*v = (struct uexpr_value){
-			.type = UEXPR_TYPE_LIST,
-			.list = vec_new_empty(sizeof(struct uexpr_value))
-		};
-		const struct vec *cats = props_get_categories(ci->p);
-		for (int i = 0; i < cats->len; ++i) {
-			const struct str *s = vec_get_c(cats, i);
-			struct uexpr_value vi = UEXPR_STRING(str_cstr(s));
-			vec_append(&v->list, &vi);
-		}
-		return true;
-	}
+	if (cal_filter_get_prop(ci->c->type, ci->p, key, v)) return true;
 
 	if (strcmp(key, "cal") == 0) {
 		*v = uexpr_value_copy(&((struct calendar_info *)vec_get(
@@ -509,6 +604,7 @@ bool cal_uexpr_get(void *_env, const char *key, struct uexpr_value *v) {
 	}
 	if (env->kind & CAL_UEXPR_FILTER) {
 		if (get_ac(env, key, v)) return true;
+		if (get_fns(env, filter_fns, key, v)) return true;
 	}
 	if (env->kind & CAL_UEXPR_ACTION) {
 		if (get_fns(env, action_fns, key, v)) return true;
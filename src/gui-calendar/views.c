@@ -3,6 +3,7 @@
 #include "views.h"
 #include "algo.h"
 #include "core.h"
+#include "util.h"
 
 enum hlevel { YEAR = 0, MONTH = 1, DAY = 2, HOUR = 3, N_LEVELS };
 struct item {
@@ -34,6 +35,13 @@ void slicing_destroy(struct slicing *s) {
 	}
 	free(s);
 }
+size_t slicing_footprint(const struct slicing *s) {
+	size_t n = sizeof(struct slicing);
+	for (int i = 0; i < N_LEVELS; ++i) {
+		n += vec_footprint(&s->items[i]);
+	}
+	return n;
+}
 int get_or_create(struct slicing *s, enum hlevel lev, struct ts_ran ran) {
 	struct vec *v = &s->items[lev];
 	for (int i = 0; i < v->len; ++i) {
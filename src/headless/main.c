@@ -0,0 +1,366 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <time.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <mgu/gl.h>
+#include <platform_utils/main.h>
+
+#include "application.h"
+#include "render.h"
+#include "png_image.h"
+#include "trace.h"
+#include "core.h"
+#include "util.h"
+
+/*
+ * Renders the application without a window, into an EGL pbuffer, eg. with
+ * Mesa's llvmpipe on the surfaceless platform. Every view is drawn at every
+ * size at a fixed time, the frame times are written as json lines, and the
+ * frames can be dumped to png files or compared with earlier dumps.
+ */
+
+#if !PU_MAIN_HAS_ARGS
+#error "smuc-headless needs the command line"
+#endif
+
+struct offscreen {
+	EGLDisplay dpy;
+	EGLConfig cfg;
+	EGLContext ctx;
+	EGLSurface surf;
+};
+
+static EGLDisplay get_display() {
+	const char *ext = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (ext && strstr(ext, "EGL_MESA_platform_surfaceless")) {
+		PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+				"eglGetPlatformDisplayEXT");
+		if (get_platform_display) {
+			return get_platform_display(
+				EGL_PLATFORM_SURFACELESS_MESA,
+				EGL_DEFAULT_DISPLAY, NULL);
+		}
+	}
+	return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+/* makes the surface of the new size current */
+static int offscreen_resize(struct offscreen *os, int w, int h) {
+	const EGLint attribs[] = { EGL_WIDTH, w, EGL_HEIGHT, h, EGL_NONE };
+	EGLSurface surf = eglCreatePbufferSurface(os->dpy, os->cfg, attribs);
+	if (surf == EGL_NO_SURFACE) return -1;
+	if (!eglMakeCurrent(os->dpy, surf, surf, os->ctx)) {
+		eglDestroySurface(os->dpy, surf);
+		return -1;
+	}
+	if (os->surf != EGL_NO_SURFACE) eglDestroySurface(os->dpy, os->surf);
+	os->surf = surf;
+	return 0;
+}
+
+static int offscreen_init(struct offscreen *os) {
+	*os = (struct offscreen){ .surf = EGL_NO_SURFACE };
+	os->dpy = get_display();
+	if (os->dpy == EGL_NO_DISPLAY) return -1;
+	if (!eglInitialize(os->dpy, NULL, NULL)) return -1;
+	if (!eglBindAPI(EGL_OPENGL_ES_API)) goto err;
+
+	const EGLint cfg_attribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_NONE
+	};
+	EGLint n = 0;
+	if (!eglChooseConfig(os->dpy, cfg_attribs, &os->cfg, 1, &n) || n < 1)
+		goto err;
+	const EGLint ctx_attribs[] = {
+		EGL_CONTEXT_CLIENT_VERSION, 2,
+		EGL_NONE
+	};
+	os->ctx = eglCreateContext(os->dpy, os->cfg, EGL_NO_CONTEXT,
+		ctx_attribs);
+	if (os->ctx == EGL_NO_CONTEXT) goto err;
+	if (offscreen_resize(os, 1, 1) < 0) {
+		eglDestroyContext(os->dpy, os->ctx);
+		goto err;
+	}
+	return 0;
+err:
+	eglTerminate(os->dpy);
+	return -1;
+}
+
+static void offscreen_finish(struct offscreen *os) {
+	eglMakeCurrent(os->dpy, EGL_NO_SURFACE, EGL_NO_SURFACE,
+		EGL_NO_CONTEXT);
+	eglDestroySurface(os->dpy, os->surf);
+	eglDestroyContext(os->dpy, os->ctx);
+	eglTerminate(os->dpy);
+}
+
+/* the current framebuffer, flipped so rows go from the top */
+static void read_frame(struct png_image *img, int w, int h) {
+	img->w = w;
+	img->h = h;
+	img->rgba = malloc_check((size_t)w * h * 4);
+	uint8_t *tmp = malloc_check((size_t)w * h * 4);
+	glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, tmp);
+	for (int y = 0; y < h; ++y) {
+		memcpy(img->rgba + (size_t)y * w * 4,
+			tmp + (size_t)(h - 1 - y) * w * 4, (size_t)w * 4);
+	}
+	free(tmp);
+}
+
+/* returns the number of pixels with a channel off by more than tol */
+static long compare_frame(const struct png_image *a,
+		const struct png_image *b, int tol) {
+	if (a->w != b->w || a->h != b->h) return (long)a->w * a->h;
+	long n = 0;
+	for (long i = 0; i < (long)a->w * a->h; ++i) {
+		for (int c = 0; c < 4; ++c) {
+			int d = a->rgba[4 * i + c] - b->rgba[4 * i + c];
+			if (d > tol || d < -tol) {
+				++n;
+				break;
+			}
+		}
+	}
+	return n;
+}
+
+enum hview {
+	HVIEW_WEEK,
+	HVIEW_MONTH,
+	HVIEW_YEAR,
+	HVIEW_TODO,
+	HVIEW_N
+};
+static const char *view_names[] = { "week", "month", "year", "todo" };
+
+static void use_view(struct app *app, enum hview v) {
+	ts base = ts_get_day_base(app->now, app->zone, v == HVIEW_WEEK);
+	int days[] = { 7, 31, 365, 7 };
+	app->main_view = v == HVIEW_TODO ? VIEW_TODO : VIEW_CALENDAR;
+	app->view = (struct ts_ran){ base, base };
+	ts_adjust_days(&app->view.to, app->zone, days[v]);
+	app->todo_scroll = 0;
+}
+
+struct run {
+	struct app *app;
+	struct offscreen os;
+	int frames;
+	int tol;
+	const char *label;
+	const char *out_dir, *golden_dir;
+	long bad; /* pixels that differ from the golden frames */
+};
+
+static uint64_t cpu_now() {
+	struct timespec t;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+	return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+/* the first frame of a view also updates the projections, it is reported
+ * on its own */
+static int run_view(struct run *r, enum hview v, int w, int h) {
+	if (offscreen_resize(&r->os, w, h) < 0) {
+		fprintf(stderr, "smuc-headless: can't create %dx%d surface\n",
+			w, h);
+		return -1;
+	}
+	use_view(r->app, v);
+	uint32_t size[2] = { w, h };
+	uint64_t first = 0, min = 0, max = 0, sum = 0, cpu = 0;
+	for (int i = 0; i < r->frames; ++i) {
+		r->app->dirty = true;
+		uint64_t fr = trace_now(), cpu_fr = cpu_now();
+		render_frame(r->app, size);
+		glFinish();
+		uint64_t d = trace_now() - fr;
+		if (i == 0) {
+			first = d;
+			continue;
+		}
+		cpu += cpu_now() - cpu_fr;
+		if (i == 1 || d < min) min = d;
+		if (d > max) max = d;
+		sum += d;
+	}
+	int n = r->frames - 1;
+	printf("{\"bench\":\"render\",\"label\":\"%s\",\"view\":\"%s\","
+		"\"w\":%d,\"h\":%d,\"frames\":%d,\"first_ns\":%" PRIu64
+		",\"min_ns\":%" PRIu64 ",\"mean_ns\":%" PRIu64
+		",\"max_ns\":%" PRIu64 ",\"cpu_mean_ns\":%" PRIu64 "}\n",
+		r->label, view_names[v], w, h, n, first, min,
+		n ? sum / n : 0, max, n ? cpu / n : 0);
+	fflush(stdout);
+
+	if (!r->out_dir && !r->golden_dir) return 0;
+	struct png_image img;
+	read_frame(&img, w, h);
+	char name[256], path[1024];
+	snprintf(name, sizeof(name), "%s-%dx%d.png", view_names[v], w, h);
+	int res = 0;
+	if (r->out_dir) {
+		snprintf(path, sizeof(path), "%s/%s", r->out_dir, name);
+		if (png_image_write(&img, path) < 0) {
+			fprintf(stderr, "smuc-headless: can't write %s\n",
+				path);
+			res = -1;
+		}
+	}
+	if (r->golden_dir) {
+		snprintf(path, sizeof(path), "%s/%s", r->golden_dir, name);
+		struct png_image golden;
+		long bad = (long)w * h;
+		if (png_image_read(&golden, path) == 0) {
+			bad = compare_frame(&img, &golden, r->tol);
+			png_image_finish(&golden);
+		} else {
+			fprintf(stderr, "smuc-headless: can't read %s\n",
+				path);
+		}
+		if (bad > 0) {
+			fprintf(stderr, "smuc-headless: %s: %ld pixels "
+				"differ\n", name, bad);
+		}
+		r->bad += bad;
+	}
+	png_image_finish(&img);
+	return res;
+}
+
+/* YYYY-MM-DDTHH:MM */
+static bool parse_now(const char *s, struct cal_timezone *zone, ts *out) {
+	int y, mo, d, h, mi;
+	if (sscanf(s, "%d-%d-%dT%d:%d", &y, &mo, &d, &h, &mi) != 5)
+		return false;
+	*out = simple_date_to_ts(make_simple_date(y, mo, d, h, mi, 0), zone);
+	return *out != -1;
+}
+
+static int parse_views(const char *s, bool views[HVIEW_N]) {
+	memset(views, 0, sizeof(bool) * HVIEW_N);
+	char *list = str_dup(s);
+	int res = 0;
+	for (char *t = strtok(list, ","); t; t = strtok(NULL, ",")) {
+		int v = 0;
+		while (v < HVIEW_N && strcmp(view_names[v], t) != 0) ++v;
+		if (v == HVIEW_N) res = -1;
+		else views[v] = true;
+	}
+	free(list);
+	return res;
+}
+
+void platform_main(struct platform *plat) {
+	const char *help =
+		"usage: smuc-headless [options] calendar...\n"
+		"-h: show this help\n"
+		"-n N: frames per view and size (default 10)\n"
+		"-t T: the current time, YYYY-MM-DDTHH:MM "
+			"(default 2024-03-15T12:00)\n"
+		"-s S: comma separated sizes (default 1280x720,1920x1080)\n"
+		"-v V: comma separated views of week, month, year, todo\n"
+		"      (default all)\n"
+		"-p P: pixels per visual degree (default 40)\n"
+		"-c C: config script, instead of the builtin one\n"
+		"-o O: write the last frame of each view to O as png\n"
+		"-g G: compare the last frames with the ones in G\n"
+		"-e E: allowed difference of a channel with -g (default 2)\n"
+		"-l L: label of the results\n";
+	const char *now_s = "2024-03-15T12:00";
+	const char *sizes = "1280x720,1920x1080";
+	bool views[HVIEW_N] = { true, true, true, true };
+	struct mgu_out out = { .ppvd = 40, .ppmm = 40 / 10.5 };
+	struct application_options opts = { .headless = true };
+	struct run r = { .frames = 10, .tol = 2, .label = "" };
+
+	int argc = plat->argc;
+	char **argv = plat->argv;
+	int opt;
+	while ((opt = getopt(argc, argv, "hn:t:s:v:p:c:o:g:e:l:")) != -1) {
+		switch (opt) {
+		case 'n': r.frames = atoi(optarg); break;
+		case 't': now_s = optarg; break;
+		case 's': sizes = optarg; break;
+		case 'v':
+			if (parse_views(optarg, views) < 0) {
+				fprintf(stderr, "%s", help);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'p':
+			out.ppvd = atof(optarg);
+			out.ppmm = out.ppvd / 10.5;
+			break;
+		case 'c': opts.config_file = optarg; break;
+		case 'o': r.out_dir = optarg; break;
+		case 'g': r.golden_dir = optarg; break;
+		case 'e': r.tol = atoi(optarg); break;
+		case 'l': r.label = optarg; break;
+		case 'h':
+			printf("%s", help);
+			exit(EXIT_SUCCESS);
+		default:
+			fprintf(stderr, "%s", help);
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (r.frames < 1) {
+		fprintf(stderr, "%s", help);
+		exit(EXIT_FAILURE);
+	}
+	opts.cals = argv + optind;
+	opts.cals_n = argc - optind;
+
+	if (offscreen_init(&r.os) < 0) {
+		fprintf(stderr, "smuc-headless: no EGL pbuffer with GLES2, "
+			"try EGL_PLATFORM=surfaceless\n");
+		exit(EXIT_FAILURE);
+	}
+
+	struct app app;
+	app_init(&app, opts, plat, NULL);
+	r.app = &app;
+	app.out = &out;
+	context_cb(&app, true);
+
+	ts now;
+	if (!parse_now(now_s, app.zone, &now)) {
+		fprintf(stderr, "%s", help);
+		exit(EXIT_FAILURE);
+	}
+	app_set_now(&app, now);
+
+	int res = 0;
+	char *list = str_dup(sizes);
+	for (char *t = strtok(list, ","); t && res == 0;
+			t = strtok(NULL, ",")) {
+		int w, h;
+		if (sscanf(t, "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0) {
+			fprintf(stderr, "%s", help);
+			res = -1;
+			break;
+		}
+		for (int v = 0; v < HVIEW_N && res == 0; ++v) {
+			if (views[v]) res = run_view(&r, v, w, h);
+		}
+	}
+	free(list);
+
+	context_cb(&app, false);
+	app_finish(&app);
+	offscreen_finish(&r.os);
+	if (res < 0 || r.bad > 0) exit(EXIT_FAILURE);
+}
@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "png_image.h"
+#include "core.h"
+
+static const uint8_t signature[8] = {
+	137, 'P', 'N', 'G', '\r', '\n', 26, '\n'
+};
+
+static uint32_t crc_table[256];
+static bool crc_table_done = false;
+
+static uint32_t crc_update(uint32_t crc, const uint8_t *d, size_t len) {
+	if (!crc_table_done) {
+		for (uint32_t n = 0; n < 256; ++n) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; ++k) {
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			crc_table[n] = c;
+		}
+		crc_table_done = true;
+	}
+	for (size_t i = 0; i < len; ++i) {
+		crc = crc_table[(crc ^ d[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+static uint32_t adler32(const uint8_t *d, size_t len) {
+	uint32_t a = 1, b = 0;
+	while (len > 0) {
+		/* the largest n for which b can't overflow */
+		size_t n = len < 5552 ? len : 5552;
+		len -= n;
+		while (n--) {
+			a += *d++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return (b << 16) | a;
+}
+
+static void put_u32(uint8_t *b, uint32_t v) {
+	b[0] = v >> 24, b[1] = v >> 16, b[2] = v >> 8, b[3] = v;
+}
+static uint32_t get_u32(const uint8_t *b) {
+	return (uint32_t)b[0] << 24 | (uint32_t)b[1] << 16
+		| (uint32_t)b[2] << 8 | b[3];
+}
+
+static bool write_chunk(FILE *f, const char *type, const uint8_t *data,
+		size_t len) {
+	uint8_t head[8], tail[4];
+	put_u32(head, len);
+	memcpy(head + 4, type, 4);
+	uint32_t crc = crc_update(0xFFFFFFFF, head + 4, 4);
+	crc = crc_update(crc, data, len) ^ 0xFFFFFFFF;
+	put_u32(tail, crc);
+	return fwrite(head, 1, 8, f) == 8
+		&& fwrite(data, 1, len, f) == len
+		&& fwrite(tail, 1, 4, f) == 4;
+}
+
+int png_image_write(const struct png_image *img, const char *path) {
+	/* every row starts with filter type 0 */
+	size_t row = 1 + 4 * (size_t)img->w;
+	size_t raw_len = row * img->h;
+	uint8_t *raw = malloc_check(raw_len);
+	for (int y = 0; y < img->h; ++y) {
+		raw[y * row] = 0;
+		memcpy(raw + y * row + 1, img->rgba + y * (row - 1), row - 1);
+	}
+
+	/* zlib stream of stored deflate blocks */
+	size_t blocks = raw_len / 65535 + 1;
+	size_t z_len = 2 + raw_len + 5 * blocks + 4;
+	uint8_t *z = malloc_check(z_len);
+	size_t p = 0;
+	z[p++] = 0x78;
+	z[p++] = 0x01;
+	for (size_t i = 0, left = raw_len; i < blocks; ++i) {
+		size_t n = left < 65535 ? left : 65535;
+		z[p++] = i + 1 == blocks ? 1 : 0;
+		z[p++] = n & 0xFF;
+		z[p++] = n >> 8;
+		z[p++] = ~n & 0xFF;
+		z[p++] = (~n >> 8) & 0xFF;
+		memcpy(z + p, raw + (raw_len - left), n);
+		p += n;
+		left -= n;
+	}
+	put_u32(z + p, adler32(raw, raw_len));
+	p += 4;
+	asrt(p == z_len, "png zlib length");
+	free(raw);
+
+	uint8_t ihdr[13];
+	put_u32(ihdr, img->w);
+	put_u32(ihdr + 4, img->h);
+	ihdr[8] = 8; /* bit depth */
+	ihdr[9] = 6; /* rgba */
+	ihdr[10] = ihdr[11] = ihdr[12] = 0;
+
+	FILE *f = fopen(path, "wb");
+	if (!f) {
+		free(z);
+		return -1;
+	}
+	bool ok = fwrite(signature, 1, 8, f) == 8
+		&& write_chunk(f, "IHDR", ihdr, sizeof(ihdr))
+		&& write_chunk(f, "IDAT", z, z_len)
+		&& write_chunk(f, "IEND", NULL, 0);
+	free(z);
+	if (fclose(f) != 0) ok = false;
+	return ok ? 0 : -1;
+}
+
+static uint8_t *read_file(const char *path, size_t *len) {
+	FILE *f = fopen(path, "rb");
+	if (!f) return NULL;
+	uint8_t *d = NULL;
+	if (fseek(f, 0, SEEK_END) == 0) {
+		long n = ftell(f);
+		rewind(f);
+		if (n > 0) {
+			d = malloc_check(n);
+			if (fread(d, 1, n, f) != (size_t)n) {
+				free(d);
+				d = NULL;
+			}
+			*len = n;
+		}
+	}
+	fclose(f);
+	return d;
+}
+
+/* the raw image data out of the IDAT chunks */
+static uint8_t *inflate_stored(const uint8_t *z, size_t z_len,
+		size_t raw_len) {
+	if (z_len < 2 || (z[0] & 0x0F) != 8 || (z[0] << 8 | z[1]) % 31
+			|| (z[1] & 0x20)) return NULL;
+	uint8_t *raw = malloc_check(raw_len);
+	size_t p = 2, out = 0;
+	for (bool last = false; !last;) {
+		if (p + 5 > z_len || (z[p] >> 1 & 3) != 0) goto err;
+		last = z[p] & 1;
+		size_t n = z[p + 1] | z[p + 2] << 8;
+		size_t nn = z[p + 3] | z[p + 4] << 8;
+		p += 5;
+		if ((n ^ 0xFFFF) != nn || p + n > z_len || out + n > raw_len)
+			goto err;
+		memcpy(raw + out, z + p, n);
+		p += n, out += n;
+	}
+	if (out != raw_len || p + 4 > z_len) goto err;
+	if (get_u32(z + p) != adler32(raw, raw_len)) goto err;
+	return raw;
+err:
+	free(raw);
+	return NULL;
+}
+
+int png_image_read(struct png_image *img, const char *path) {
+	size_t len = 0;
+	uint8_t *d = read_file(path, &len);
+	if (!d) return -1;
+
+	int res = -1;
+	uint8_t *z = NULL, *raw = NULL;
+	size_t z_len = 0;
+	int w = -1, h = -1;
+	if (len < 8 || memcmp(d, signature, 8) != 0) goto out;
+	for (size_t p = 8; p + 12 <= len;) {
+		size_t n = get_u32(d + p);
+		const uint8_t *type = d + p + 4, *data = d + p + 8;
+		if (n > len - p - 12) goto out;
+		if (memcmp(type, "IHDR", 4) == 0) {
+			if (n != 13 || data[8] != 8 || data[9] != 6
+					|| data[10] || data[11] || data[12])
+				goto out;
+			w = get_u32(data);
+			h = get_u32(data + 4);
+		} else if (memcmp(type, "IDAT", 4) == 0) {
+			z = realloc(z, z_len + n);
+			asrt(z, "realloc");
+			memcpy(z + z_len, data, n);
+			z_len += n;
+		} else if (memcmp(type, "IEND", 4) == 0) {
+			break;
+		}
+		p += n + 12;
+	}
+	if (w <= 0 || h <= 0 || !z) goto out;
+
+	size_t row = 1 + 4 * (size_t)w;
+	raw = inflate_stored(z, z_len, row * h);
+	if (!raw) goto out;
+	img->w = w;
+	img->h = h;
+	img->rgba = malloc_check((row - 1) * h);
+	for (int y = 0; y < h; ++y) {
+		if (raw[y * row] != 0) {
+			png_image_finish(img);
+			goto out;
+		}
+		memcpy(img->rgba + y * (row - 1), raw + y * row + 1, row - 1);
+	}
+	res = 0;
+out:
+	free(raw);
+	free(z);
+	free(d);
+	return res;
+}
+
+void png_image_finish(struct png_image *img) {
+	free(img->rgba);
+	img->rgba = NULL;
+}
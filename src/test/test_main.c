@@ -1,12 +1,19 @@
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #include <stdlib.h>
+#include <libical/ical.h>
 #include "calendar.h"
 #include "editor.h"
+#include "journal.h"
+#include "sort.h"
+#include "alarm_ledger.h"
 #include "core.h"
 #include "util.h"
 #include "algo.h"
 #include "views.h"
+#include "timer_wheel.h"
+#include "freebusy.h"
 
 static void test_todo_schedule() {
 	// 0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20
@@ -26,7 +33,29 @@ static void test_todo_schedule() {
 		asrt(G[i].fr == exp[i].fr, "");
 		asrt(G[i].to == exp[i].to, "");
 	}
+	free(G);
+
+	/* no events, todos wait for their start, no estimate is skipped */
+	struct schedule_todo T2[] = {
+		{ .start = -1, .estimated_duration = 5 },
+		{ .start = 10, .estimated_duration = 3 },
+		{ .start = -1, .estimated_duration = 0 },
+	};
+	G = todo_schedule(0, 0, NULL, 3, T2);
+	asrt(G[0].fr == 0 && G[0].to == 5, "");
+	asrt(G[1].fr == 10 && G[1].to == 13, "");
+	asrt(G[2].fr == -1 && G[2].to == -1, "");
+	free(G);
 
+	/* the first todo starts too late for the slot before the event */
+	struct ts_ran E3[] = { { 4, 20 } };
+	struct schedule_todo T3[] = {
+		{ .start = 2, .estimated_duration = 3 },
+		{ .start = -1, .estimated_duration = 1 },
+	};
+	G = todo_schedule(0, 1, E3, 2, T3);
+	asrt(G[0].fr == 20 && G[0].to == 23, "");
+	asrt(G[1].fr == 0 && G[1].to == 1, "");
 	free(G);
 }
 
@@ -183,6 +212,269 @@ static void test_editor() {
 	);
 }
 
+static void test_editor_in_place() {
+	/* a single file calendar, the untouched components must keep their
+	 * exact bytes */
+	const char *head =
+		"BEGIN:VCALENDAR\n"
+		"VERSION:2.0\n"
+		"BEGIN:VEVENT\n"
+		"UID:other\n"
+		"DTSTART:20200101T100000Z\n"
+		"DTEND:20200101T110000Z\n"
+		"X-UNKNOWN;A=b:kept as is\n"
+		"END:VEVENT\n";
+	const char *tail =
+		"BEGIN:VTODO\n"
+		"UID:last\n"
+		"END:VTODO\n"
+		"END:VCALENDAR\n";
+	struct str ics = str_new_from_cstr(head);
+	const char *ev =
+		"BEGIN:VEVENT\n"
+		"UID:uid\n"
+		"DTSTART:20200101T120000Z\n"
+		"DTEND:20200101T140000Z\n"
+		"SUMMARY:sum\n"
+		"END:VEVENT\n";
+	str_append(&ics, ev, strlen(ev));
+	str_append(&ics, tail, strlen(tail));
+	write_to_file("/tmp/test_cal_file.ics", str_cstr(&ics));
+	str_free(&ics);
+
+	struct cal_timezone *zone = cal_timezone_new("Europe/Budapest");
+	struct calendar cal;
+	calendar_init(&cal);
+	cal.storage = str_new_from_cstr("/tmp/test_cal_file.ics");
+	update_calendar_from_storage(&cal, zone);
+
+	const char *edit = "update event\nsummary `new`\nuid `uid`\n";
+	FILE *f = fmemopen((void*)edit, strlen(edit), "r");
+	struct edit_spec es;
+	asrt(edit_spec_init_parse(&es, f, zone, 0) == 0,
+		"cant parse edit spec");
+	fclose(f);
+	asrt(apply_edit_spec_to_calendar(&es, &cal) == 0,
+		"cant apply edit spec");
+	edit_spec_finish(&es);
+
+	char buf[1024];
+	f = fopen("/tmp/test_cal_file.ics", "r");
+	int n = fread(buf, 1, sizeof(buf) - 1, f);
+	fclose(f);
+	buf[n] = '\0';
+	asrt(strncmp(buf, head, strlen(head)) == 0, "head changed");
+	asrt(n > strlen(tail)
+		&& strcmp(buf + n - strlen(tail), tail) == 0, "tail changed");
+	asrt(strstr(buf, "SUMMARY:new"), "edit not written");
+	asrt(!strchr(buf, '\r'), "line endings of the file not kept");
+
+	/* the index still matches the file after the splice */
+	struct ics_file *file =
+		ics_index_get(&cal.index, "/tmp/test_cal_file.ics");
+	asrt(file && file->spans.len == 3, "index lost");
+	struct ics_span *span = vec_get(&file->spans, 2);
+	asrt(strncmp(buf + span->off, "BEGIN:VTODO", 11) == 0, "index off");
+
+	calendar_finish(&cal);
+	cal_timezone_destroy(zone);
+}
+
+static void test_editor_batch() {
+	write_to_file("/tmp/test_cal_batch.ics",
+		"BEGIN:VCALENDAR\n"
+		"VERSION:2.0\n"
+		"BEGIN:VTODO\n"
+		"UID:a\n"
+		"SUMMARY:a\n"
+		"END:VTODO\n"
+		"BEGIN:VTODO\n"
+		"UID:b\n"
+		"SUMMARY:b\n"
+		"END:VTODO\n"
+		"END:VCALENDAR\n");
+
+	struct cal_timezone *zone = cal_timezone_new("Europe/Budapest");
+	struct calendar cal;
+	calendar_init(&cal);
+	cal.storage = str_new_from_cstr("/tmp/test_cal_batch.ics");
+	update_calendar_from_storage(&cal, zone);
+
+	const char *doc =
+		"update todo\nuid `a`\nsummary `a2`\n\n"
+		"# comment\n"
+		"update todo\nuid `b`\nsummary `b2`\nest 1h\n";
+	FILE *f = fmemopen((void*)doc, strlen(doc), "r");
+	struct vec specs;
+	asrt(edit_specs_init_parse(&specs, f, zone, 0) == 0,
+		"cant parse edit specs");
+	fclose(f);
+	asrt(specs.len == 2, "spec count");
+
+	struct edit_spec *es[2] = { vec_get(&specs, 0), vec_get(&specs, 1) };
+	struct calendar *cals[2] = { &cal, &cal };
+
+	/* a component may only be edited once per batch */
+	struct edit_spec *dup[2] = { es[0], es[0] };
+	asrt(!edit_specs_can_apply_to_memory(dup, cals, 2), "duplicate");
+
+	/* nor may a batch create in a single file calendar */
+	const char *bad = "create todo\nuid `c`\nsummary `c`\n";
+	f = fmemopen((void*)bad, strlen(bad), "r");
+	struct edit_spec create;
+	asrt(edit_spec_init_parse(&create, f, zone, 0) == 0,
+		"cant parse edit spec");
+	fclose(f);
+	struct edit_spec *mixed[2] = { es[0], &create };
+	asrt(!edit_specs_can_apply_to_storage(mixed, cals, 2), "create");
+	asrt(apply_edit_specs_to_calendars(mixed, cals, 2) != 0, "applied");
+	bool failed[2];
+	asrt(edit_specs_apply_grouped(mixed, cals, 2, failed) == 1
+		&& failed[1], "create not failed");
+	asrt(calendar_find_comp(&cal, "c") == -1, "create in memory");
+	edit_spec_finish(&create);
+
+	asrt(apply_edit_specs_to_calendars(es, cals, 2) == 0,
+		"cant apply edit specs");
+	edit_specs_finish(&specs);
+
+	struct comp *a = calendar_get_comp(&cal, calendar_find_comp(&cal, "a"));
+	struct comp *b = calendar_get_comp(&cal, calendar_find_comp(&cal, "b"));
+	asrt(strcmp(props_get_summary(&a->p), "a2") == 0, "summary a");
+	asrt(strcmp(props_get_summary(&b->p), "b2") == 0, "summary b");
+
+	char buf[1024];
+	f = fopen("/tmp/test_cal_batch.ics", "r");
+	int n = fread(buf, 1, sizeof(buf) - 1, f);
+	fclose(f);
+	buf[n] = '\0';
+	asrt(strstr(buf, "SUMMARY:a2") && strstr(buf, "SUMMARY:b2"),
+		"batch not written");
+
+	calendar_finish(&cal);
+	cal_timezone_destroy(zone);
+}
+
+static void test_journal() {
+	write_to_file("/tmp/test_cal_journal.ics",
+		"BEGIN:VCALENDAR\n"
+		"VERSION:2.0\n"
+		"BEGIN:VEVENT\n"
+		"UID:uid\n"
+		"DTSTART:20200101T120000Z\n"
+		"DTEND:20200101T140000Z\n"
+		"SUMMARY:sum\n"
+		"END:VEVENT\n"
+		"END:VCALENDAR\n");
+	unlink("/tmp/test_journal");
+
+	struct cal_timezone *zone = cal_timezone_new("Europe/Budapest");
+	struct vec cals = vec_new_empty(sizeof(struct calendar));
+	struct calendar *cal = vec_get(&cals, vec_append(&cals,
+		&(struct calendar){ 0 }));
+	calendar_init(cal);
+	cal->storage = str_new_from_cstr("/tmp/test_cal_journal.ics");
+	update_calendar_from_storage(cal, zone);
+
+	/* two edits journaled, but never flushed, as after a crash */
+	struct journal j;
+	asrt(journal_open(&j, "/tmp/test_journal") == 0, "journal open");
+	const char *edits[] = {
+		"update event\nsummary `new`\nuid `uid`\n",
+		"update event\nlocation `here`\nuid `uid`\n",
+	};
+	for (int i = 0; i < 2; ++i) {
+		FILE *f = fmemopen((void*)edits[i], strlen(edits[i]), "r");
+		struct edit_spec es;
+		asrt(edit_spec_init_parse(&es, f, zone, 0) == 0,
+			"cant parse edit spec");
+		fclose(f);
+		asrt(journal_append(&j, &es, cal) == 0, "journal append");
+		edit_spec_finish(&es);
+	}
+	journal_close(&j);
+	asrt(journal_open(&j, "/tmp/test_journal") == 0, "journal reopen");
+	asrt(!journal_empty(&j), "journal lost");
+
+	/* the replay brings both memory and storage up to date */
+	asrt(journal_flush(&j, &cals, true) == 0, "journal flush");
+	asrt(journal_empty(&j), "journal not emptied");
+	journal_close(&j);
+
+	int idx = calendar_find_comp(cal, "uid");
+	asrt(idx != -1, "comp lost");
+	struct comp *c = calendar_get_comp(cal, idx);
+	asrt(strcmp(props_get_summary(&c->p), "new") == 0, "summary");
+	asrt(strcmp(props_get_location(&c->p), "here") == 0, "location");
+
+	char buf[1024];
+	FILE *f = fopen("/tmp/test_cal_journal.ics", "r");
+	int n = fread(buf, 1, sizeof(buf) - 1, f);
+	fclose(f);
+	buf[n] = '\0';
+	asrt(strstr(buf, "SUMMARY:new"), "summary not written");
+	asrt(strstr(buf, "LOCATION:here"), "location not written");
+
+	/* a create can't go to a single file calendar. one journaled by an
+	 * older version is dropped on replay, not retried forever */
+	const char *create = "create event\nsummary `x`\nuid `new`\n"
+		"start 2020-01-02 10:00\nend 2020-01-02 11:00\n";
+	f = fmemopen((void*)create, strlen(create), "r");
+	struct edit_spec es;
+	asrt(edit_spec_init_parse(&es, f, zone, 0) == 0,
+		"cant parse edit spec");
+	fclose(f);
+	asrt(!edit_spec_can_apply_to_storage(&es, cal), "create allowed");
+	asrt(journal_open(&j, "/tmp/test_journal") == 0, "journal open");
+	asrt(journal_append(&j, &es, cal) == 0, "journal append");
+	journal_close(&j);
+	edit_spec_finish(&es);
+	asrt(journal_open(&j, "/tmp/test_journal") == 0, "journal reopen");
+	asrt(journal_flush(&j, &cals, true) == 0, "journal flush");
+	asrt(journal_empty(&j), "bad edit kept");
+	journal_close(&j);
+	asrt(calendar_find_comp(cal, "new") == -1, "bad edit replayed");
+
+	/* one part of a batch fails, as its calendar is gone. the whole
+	 * batch stays, still as one record */
+	struct calendar gone;
+	calendar_init(&gone);
+	gone.storage = str_new_from_cstr("/tmp/test_cal_journal_gone.ics");
+	struct edit_spec batch[2];
+	for (int i = 0; i < 2; ++i) {
+		f = fmemopen((void*)edits[i], strlen(edits[i]), "r");
+		asrt(edit_spec_init_parse(&batch[i], f, zone, 0) == 0,
+			"cant parse edit spec");
+		fclose(f);
+	}
+	asrt(journal_open(&j, "/tmp/test_journal") == 0, "journal open");
+	asrt(journal_append_batch(&j,
+		(struct edit_spec*[]){ &batch[0], &batch[1] },
+		(struct calendar*[]){ cal, &gone }, 2) == 0,
+		"journal append");
+	asrt(journal_flush(&j, &cals, false) == 1, "journal flush");
+	journal_close(&j);
+	for (int i = 0; i < 2; ++i) edit_spec_finish(&batch[i]);
+	calendar_finish(&gone);
+
+	f = fopen("/tmp/test_journal", "r");
+	n = fread(buf, 1, sizeof(buf) - 1, f);
+	fclose(f);
+	buf[n] = '\0';
+	int n_rec = 0, n_spec = 0;
+	for (char *l = buf; l; l = strchr(l, '\n')) {
+		if (*l == '\n') ++l;
+		if (strncmp(l, "rec ", 4) == 0) ++n_rec;
+		if (strncmp(l, "spec\n", 5) == 0) ++n_spec;
+	}
+	asrt(n_rec == 1 && n_spec == 2, "batch split or dropped");
+	unlink("/tmp/test_journal");
+
+	calendar_finish(cal);
+	vec_free(&cals);
+	cal_timezone_destroy(zone);
+}
+
 extern int slicing_test_get_total_len(struct slicing *s);
 static void vec_ts_ran_asrt(struct vec *v, struct ts_ran *a, int n) {
 	asrt(v->len == n, "");
@@ -239,10 +531,759 @@ static void test_slicing() {
 	cal_timezone_destroy(zone);
 }
 
+static int test_datetime_ical_offset(icaltimezone *impl, ts t) {
+	icaltimetype tt = icaltime_from_timet_with_zone((time_t)t, 0, impl);
+	return (int)(icaltime_as_timet(tt) - t);
+}
+static void test_datetime_asrt_from_ts(icaltimezone *impl,
+		struct cal_timezone *zone, ts t) {
+	icaltimetype tt = icaltime_from_timet_with_zone((time_t)t, 0, impl);
+	struct simple_date exp = make_simple_date(tt.year, tt.month, tt.day,
+		tt.hour, tt.minute, tt.second);
+	asrt(simple_date_eq(simple_date_from_ts(t, zone), exp),
+		"simple_date_from_ts differs from libical");
+}
+static void test_datetime_asrt_to_ts(icaltimezone *impl,
+		struct cal_timezone *zone, ts wall) {
+	icaltimetype tt = icaltime_from_timet_with_zone((time_t)wall, 0,
+		icaltimezone_get_utc_timezone());
+	tt.zone = NULL;
+	struct simple_date sd = make_simple_date(tt.year, tt.month, tt.day,
+		tt.hour, tt.minute, tt.second);
+	asrt(simple_date_to_ts(sd, zone) ==
+		(ts)icaltime_as_timet_with_zone(tt, impl),
+		"simple_date_to_ts differs from libical");
+}
+static void test_datetime_zone(icaltimezone *impl) {
+	struct cal_timezone *zone =
+		cal_timezone_new(icaltimezone_get_location(impl));
+
+	/* 2015-01-01 to 2035-01-01, looking for transitions weekly */
+	const ts week = 7 * 24 * 3600;
+	for (ts t = 1420070400; t < 2051222400; t += week) {
+		test_datetime_asrt_from_ts(impl, zone, t);
+		int off = test_datetime_ical_offset(impl, t);
+		if (off == test_datetime_ical_offset(impl, t + week)) continue;
+
+		ts lo = t, hi = t + week;
+		while (hi - lo > 1) {
+			ts mid = lo + (hi - lo) / 2;
+			if (test_datetime_ical_offset(impl, mid) == off) {
+				lo = mid;
+			} else {
+				hi = mid;
+			}
+		}
+		for (ts d = -7200; d <= 7200; d += 1800) {
+			test_datetime_asrt_from_ts(impl, zone, hi + d);
+			test_datetime_asrt_to_ts(impl, zone, hi + off + d);
+		}
+		test_datetime_asrt_from_ts(impl, zone, hi - 1);
+	}
+
+	cal_timezone_destroy(zone);
+}
+static void test_datetime() {
+	icalarray *zones = icaltimezone_get_builtin_timezones();
+	for (size_t i = 0; i < zones->num_elements; ++i) {
+		test_datetime_zone(icalarray_element_at(zones, i));
+	}
+
+	struct simple_date sd = make_simple_date(2020, 0, 0, 25, 61, 59);
+	simple_date_normalize(&sd);
+	asrt(simple_date_eq(sd, make_simple_date(2019, 12, 1, 2, 1, 59)), "");
+}
+
+static void test_recurrence_collect(void *cl, ts t) {
+	vec_append(cl, &t);
+}
+/* expands the rule of an event in Europe/Budapest until 2050, and checks
+ * it against libical's iterator */
+static void test_recurrence_do(const char *dtstart, const char *rrule) {
+	icaltimezone *impl =
+		icaltimezone_get_builtin_timezone("Europe/Budapest");
+	char *ics = NULL;
+	size_t ics_len = 0;
+	FILE *f = open_memstream(&ics, &ics_len);
+	asrt(f, "");
+	fprintf(f, "BEGIN:VCALENDAR\nVERSION:2.0\nPRODID:test\n%s"
+		"BEGIN:VEVENT\nUID:recur\nSUMMARY:recur\n"
+		"DTSTART;TZID=Europe/Budapest:%s\n"
+		"DURATION:PT1H\nRRULE:%s\nEND:VEVENT\nEND:VCALENDAR\n",
+		icalcomponent_as_ical_string(
+			icaltimezone_get_component(impl)),
+		dtstart, rrule);
+	fclose(f);
+
+	f = fmemopen(ics, ics_len, "r");
+	asrt(f, "");
+	struct comp c;
+	asrt(comp_init_from_ics(&c, f) == 0 && c.recur, "recurring comp");
+	fclose(f);
+	const ts to = 2524608000; /* 2050-01-01 */
+	struct vec act = vec_new_empty(sizeof(ts));
+	recurrence_expand(c.recur, to, test_recurrence_collect, &act);
+
+	icalcomponent *root = icalparser_parse_string(ics);
+	icalcomponent *ic =
+		icalcomponent_get_first_component(root, ICAL_VEVENT_COMPONENT);
+	icalproperty *p =
+		icalcomponent_get_first_property(ic, ICAL_RRULE_PROPERTY);
+	icalrecur_iterator *itr = icalrecur_iterator_new(
+		icalproperty_get_rrule(p), icalcomponent_get_dtstart(ic));
+	int n = 0;
+	for (icaltimetype tt = icalrecur_iterator_next(itr);
+			!icaltime_is_null_time(tt);
+			tt = icalrecur_iterator_next(itr)) {
+		ts t = icaltime_as_timet_with_zone(tt,
+			icaltime_get_timezone(tt));
+		if (t > to) break;
+		asrt(n < act.len && *(ts*)vec_get(&act, n) == t,
+			"recurrence differs from libical");
+		++n;
+	}
+	asrt(n == act.len, "recurrence differs from libical");
+
+	icalrecur_iterator_free(itr);
+	icalcomponent_free(root);
+	vec_free(&act);
+	comp_finish(&c);
+	free(ics);
+}
+static void test_recurrence() {
+	test_recurrence_do("20240101T090000", "FREQ=DAILY");
+	test_recurrence_do("20240329T023000", "FREQ=DAILY;INTERVAL=3");
+	test_recurrence_do("20240102T100000",
+		"FREQ=WEEKLY;BYDAY=TU,TH;COUNT=50");
+	test_recurrence_do("20240101T100000",
+		"FREQ=WEEKLY;INTERVAL=2;WKST=SU;BYDAY=MO,SA,SU");
+	test_recurrence_do("20240131T180000", "FREQ=MONTHLY");
+	test_recurrence_do("20240109T180000", "FREQ=MONTHLY;BYDAY=2TU,-1FR");
+	test_recurrence_do("20240101T080000",
+		"FREQ=MONTHLY;BYMONTHDAY=1,15,-1;UNTIL=20301231T230000Z");
+	test_recurrence_do("19600229T000000", "FREQ=YEARLY");
+	test_recurrence_do("20240104T070000",
+		"FREQ=DAILY;BYDAY=MO,TU,WE,TH,FR;COUNT=300");
+	/* these are left to libical */
+	test_recurrence_do("20240101T090000",
+		"FREQ=MONTHLY;BYDAY=MO,TU,WE,TH,FR;BYSETPOS=-1");
+	test_recurrence_do("20240101T090000", "FREQ=WEEKLY;BYDAY=TU");
+}
+
+static void test_props() {
+	struct props a = props_empty, b = props_empty, c = props_empty;
+	props_set_color(&a, "red");
+	props_set_summary(&a, "meeting");
+	struct vec cats = vec_new_empty(sizeof(struct str));
+	struct str cat = str_new_from_cstr("work");
+	vec_append(&cats, &cat);
+	props_set_categories(&a, cats);
+
+	/* the union shares the strings and lists of a */
+	props_union(&b, &a);
+	asrt(props_get_summary(&b) == props_get_summary(&a), "props share");
+	asrt(props_get_categories_n(&b) == 1, "props categories");
+	asrt(strcmp(props_get_category(&b, 0), "work") == 0, "");
+	struct props_mask pm = props_get_mask(&a);
+	asrt(props_equal(&a, &b, &pm), "props equal");
+
+	/* equal colors are interned */
+	props_set_color(&c, "red");
+	asrt(props_get_color(&c) == props_get_color(&a), "props intern");
+	props_set_summary(&c, "other");
+	asrt(!props_equal(&a, &c, &pm), "props not equal");
+	props_set_summary(&c, "");
+	asrt(!props_get_summary(&c), "props empty string");
+
+	props_finish(&a);
+	asrt(strcmp(props_get_summary(&b), "meeting") == 0, "props ref");
+	props_finish(&b);
+	props_finish(&c);
+}
+
+extern void active_events_test_pan(const struct ts_ran *evs, int n,
+	const struct ts_ran *views, int m, bool *in_view);
+static void test_in_view() {
+	/* zero length events, events on the edges of the views, and ones
+	 * that span several views */
+	struct ts_ran evs[] = {
+		{ 100, 100 }, { 200, 200 }, { 150, 150 }, { 100, 200 },
+		{ 50, 100 }, { 200, 250 }, { 0, 1000 }, { 99, 101 },
+		{ 199, 201 }, { 300, 400 }, { 250, 250 }, { 400, 500 },
+	};
+	enum { N = sizeof(evs) / sizeof(evs[0]) };
+	struct ts_ran views[] = {
+		{ 100, 200 }, /* ties at both edges */
+		{ 150, 250 }, { 200, 300 }, { 100, 200 },
+		{ 5000, 6000 }, /* everything leaves */
+		{ -1000, 5000 }, /* everything comes back */
+		{ 250, 250 }, { 100, 100 }, { 100, 200 },
+	};
+	enum { M = sizeof(views) / sizeof(views[0]) };
+	bool in_view[M * N];
+	active_events_test_pan(evs, N, views, M, in_view);
+	for (int j = 0; j < M; ++j) {
+		long long int v[2] = { views[j].fr, views[j].to };
+		for (int i = 0; i < N; ++i) {
+			long long int e[2] = { evs[i].fr, evs[i].to };
+			asrt(in_view[j * N + i] == interval_overlap(e, v),
+				"in view differs from overlap");
+		}
+	}
+
+	/* many random events and pans against the brute force */
+	enum { RN = 500, RM = 60 };
+	static struct ts_ran revs[RN], rviews[RM];
+	static bool rin[RM * RN];
+	uint32_t seed = 7;
+	for (int i = 0; i < RN; ++i) {
+		seed = seed * 1103515245 + 12345;
+		ts fr = seed % 2000;
+		seed = seed * 1103515245 + 12345;
+		revs[i] = (struct ts_ran){ fr, fr + seed % 4 * (seed % 60) };
+	}
+	for (int j = 0; j < RM; ++j) {
+		seed = seed * 1103515245 + 12345;
+		ts fr = seed % 2000 - 100;
+		seed = seed * 1103515245 + 12345;
+		rviews[j] = (struct ts_ran){ fr, fr + seed % 400 };
+	}
+	active_events_test_pan(revs, RN, rviews, RM, rin);
+	for (int j = 0; j < RM; ++j) {
+		long long int v[2] = { rviews[j].fr, rviews[j].to };
+		for (int i = 0; i < RN; ++i) {
+			long long int e[2] = { revs[i].fr, revs[i].to };
+			asrt(rin[j * RN + i] == interval_overlap(e, v),
+				"in view differs from overlap");
+		}
+	}
+}
+
+struct test_sort_item {
+	int key;
+	int i; /* position in the input */
+};
+#define TEST_SORT_LT(a, b) ((a)->key < (b)->key)
+SORT_DEFINE(test_sort_unstable, struct test_sort_item, TEST_SORT_LT)
+SORT_DEFINE_STABLE(test_sort_stable, struct test_sort_item, TEST_SORT_LT)
+/* by key, then by position: the stable order */
+static int test_sort_cmp(const void *pa, const void *pb) {
+	const struct test_sort_item *a = pa, *b = pb;
+	if (a->key != b->key) return a->key < b->key ? -1 : 1;
+	return (a->i > b->i) - (a->i < b->i);
+}
+static void test_sort() {
+	const int sizes[] = { 0, 1, 2, 3, SORT_INSERTION_MAX - 1,
+		SORT_INSERTION_MAX, SORT_INSERTION_MAX + 1,
+		2 * SORT_INSERTION_MAX, 2 * SORT_INSERTION_MAX + 1,
+		100, 1000, 5000 };
+	/* random, duplicate heavy, all equal, sorted, reversed */
+	enum { PATTERNS = 5, MAX_N = 5000 };
+	static struct test_sort_item in[MAX_N], a[MAX_N], b[MAX_N];
+	uint32_t seed = 3;
+	for (int si = 0; si < sizeof(sizes) / sizeof(sizes[0]); ++si) {
+		int n = sizes[si];
+		for (int pat = 0; pat < PATTERNS; ++pat) {
+			for (int i = 0; i < n; ++i) {
+				seed = seed * 1103515245 + 12345;
+				int r = seed >> 8;
+				int keys[PATTERNS] = { r, r % 3, 7, i, n - i };
+				in[i] = (struct test_sort_item){ keys[pat], i };
+			}
+			memcpy(b, in, sizeof(*in) * n);
+			qsort(b, n, sizeof(*b), test_sort_cmp);
+
+			memcpy(a, in, sizeof(*in) * n);
+			test_sort_unstable(a, n);
+			for (int i = 0; i < n; ++i) {
+				asrt(a[i].key == b[i].key, "sort differs");
+			}
+
+			memcpy(a, in, sizeof(*in) * n);
+			test_sort_stable(a, n);
+			for (int i = 0; i < n; ++i) {
+				asrt(a[i].key == b[i].key && a[i].i == b[i].i,
+					"stable sort differs");
+			}
+		}
+	}
+}
+
+/* the comparison the todo list was sorted with before todo_key */
+static bool test_todo_priority_cmp(ts now, const struct comp_inst *a,
+		const struct comp_inst *b) {
+	bool a_started = a->rdp.start == -1 || a->rdp.start <= now;
+	bool b_started = b->rdp.start == -1 || b->rdp.start <= now;
+
+	enum prop_status status;
+	bool a_inprocess = false, b_inprocess = false;
+	if (props_get_status(a->p, &status))
+		a_inprocess = status == PROP_STATUS_INPROCESS;
+	if (props_get_status(b->p, &status))
+		b_inprocess = status == PROP_STATUS_INPROCESS;
+
+	int ed;
+	const int sh = 60 * 10; // 10m
+	bool a_short = false, b_short = false;
+	if (props_get_estimated_duration(a->p, &ed)) a_short = ed <= sh;
+	if (props_get_estimated_duration(b->p, &ed)) b_short = ed <= sh;
+
+	ts a_due = a->rdp.due;
+	ts b_due = b->rdp.due;
+	bool a_has_due = a_due != -1;
+	bool b_has_due = b_due != -1;
+
+	if (a_inprocess != b_inprocess) {
+		return a_inprocess;
+	} else if (a_started != b_started) {
+		return a_started;
+	} else if (a_short != b_short) {
+		return a_short;
+	} else if (a_has_due || b_has_due) {
+		if (!a_has_due) return false;
+		else if (!b_has_due) return true;
+		return a_due < b_due;
+	}
+	return false;
+}
+extern uint64_t active_todos_test_key(ts now, const struct comp_inst *ci);
+static void test_todo_key() {
+	enum { N = 300 };
+	static struct props ps[N];
+	static struct comp_inst cis[N];
+	static uint64_t keys[N];
+	const ts now = 1700000000;
+	const enum prop_status statuses[] = { PROP_STATUS_NEEDSACTION,
+		PROP_STATUS_INPROCESS, PROP_STATUS_COMPLETED };
+	const int durations[] = { 60, 600, 601, 3600 };
+	uint32_t seed = 11;
+	for (int i = 0; i < N; ++i) {
+		ps[i] = props_empty;
+		seed = seed * 1103515245 + 12345;
+		if (seed % 4 > 0) {
+			props_set_status(&ps[i], statuses[seed % 3]);
+		}
+		seed = seed * 1103515245 + 12345;
+		if (seed % 5 > 0) {
+			props_set_estimated_duration(&ps[i],
+				durations[seed % 4]);
+		}
+		/* few distinct dates, so that there are many ties */
+		seed = seed * 1103515245 + 12345;
+		ts start = seed % 3 == 0 ? -1
+			: now + ((ts)(seed >> 8) % 5 - 2) * 3600;
+		seed = seed * 1103515245 + 12345;
+		ts due = seed % 4 == 0 ? -1
+			: now + ((ts)(seed >> 8) % 7 - 3) * 86400;
+		cis[i] = (struct comp_inst){
+			.p = &ps[i],
+			.rdp = { .start = start, .end = -1, .due = due },
+			.recurrence_id = -1,
+		};
+		keys[i] = active_todos_test_key(now, &cis[i]);
+	}
+	for (int i = 0; i < N; ++i) {
+		for (int j = 0; j < N; ++j) {
+			asrt(test_todo_priority_cmp(now, &cis[i], &cis[j])
+				== (keys[i] < keys[j]),
+				"todo_key differs from the comparison");
+		}
+	}
+	for (int i = 0; i < N; ++i) props_finish(&ps[i]);
+}
+
+static void test_alarms_fired(void *cl, struct timer_wheel_node *n) {
+	vec_append(cl, &n);
+}
+static void test_alarms_inst(void *env, ts recurrence_id,
+		struct recur_dep_props rdp, struct props *p) {
+	vec_append(env, &rdp);
+}
+extern bool alarm_comps_test_want(const struct comp *c);
+static void test_alarms_want() {
+	struct comp c;
+	comp_init(&c, str_new_from_cstr("want"), COMP_TYPE_TODO);
+	asrt(alarm_comps_test_want(&c), "todo without status");
+	props_set_status(&c.p, PROP_STATUS_NEEDSACTION);
+	asrt(alarm_comps_test_want(&c), "todo needs action");
+	props_set_status(&c.p, PROP_STATUS_COMPLETED);
+	asrt(!alarm_comps_test_want(&c), "todo completed");
+	props_set_status(&c.p, PROP_STATUS_CANCELLED);
+	asrt(!alarm_comps_test_want(&c), "todo cancelled");
+	comp_finish(&c);
+
+	comp_init(&c, str_new_from_cstr("want"), COMP_TYPE_EVENT);
+	props_set_status(&c.p, PROP_STATUS_CONFIRMED);
+	asrt(alarm_comps_test_want(&c), "event confirmed");
+	props_set_status(&c.p, PROP_STATUS_CANCELLED);
+	asrt(!alarm_comps_test_want(&c), "event cancelled");
+	/* an instance may not be cancelled */
+	struct comp_recur_inst cri = {
+		.recurrence_id = 1704099600,
+		.p = props_empty,
+	};
+	props_set_status(&cri.p, PROP_STATUS_CONFIRMED);
+	vec_append(&c.recur_insts, &cri);
+	asrt(alarm_comps_test_want(&c), "event with an instance");
+	comp_finish(&c);
+}
+static void test_alarms() {
+	const char *ics =
+		"BEGIN:VCALENDAR\n"
+		"VERSION:2.0\n"
+		"PRODID:test\n"
+		"BEGIN:VEVENT\n"
+		"UID:alarms\n"
+		"DTSTART:20240101T090000Z\n"
+		"DTEND:20240101T100000Z\n"
+		"SUMMARY:meeting\n"
+		"BEGIN:VALARM\n"
+		"ACTION:DISPLAY\n"
+		"TRIGGER:-PT15M\n"
+		"END:VALARM\n"
+		"BEGIN:VALARM\n"
+		"ACTION:DISPLAY\n"
+		"TRIGGER;RELATED=END:PT0S\n"
+		"REPEAT:2\n"
+		"DURATION:PT5M\n"
+		"END:VALARM\n"
+		"BEGIN:VALARM\n"
+		"ACTION:DISPLAY\n"
+		"TRIGGER;VALUE=DATE-TIME:20231231T120000Z\n"
+		"END:VALARM\n"
+		"END:VEVENT\n"
+		"END:VCALENDAR\n";
+	FILE *f = fmemopen((void*)ics, strlen(ics), "r");
+	asrt(f, "");
+	struct comp c;
+	asrt(comp_init_from_ics(&c, f) == 0, "alarms parse");
+	fclose(f);
+	ts start = 1704099600; /* 2024-01-01 09:00Z */
+	struct recur_dep_props rdp = {
+		.start = start, .end = start + 3600, .due = -1 };
+	/* the same instance a day later */
+	struct recur_dep_props next = {
+		.start = start + 86400, .end = start + 90000, .due = -1 };
+	asrt(c.alarms.len == 3, "alarms count");
+	struct comp_alarm *a = vec_get(&c.alarms, 0);
+	asrt(comp_alarm_time(a, &rdp, 0) == start - 900, "alarm relative");
+	asrt(comp_alarm_time(a, &next, 0) == start + 85500, "alarm next");
+	a = vec_get(&c.alarms, 1);
+	asrt(a->repeat == 2, "alarm repeat");
+	asrt(comp_alarm_time(a, &rdp, 2) == start + 3600 + 600, "alarm end");
+	a = vec_get(&c.alarms, 2);
+	asrt(comp_alarm_time(a, &next, 0) == start - 75600, "alarm absolute");
+	comp_finish(&c);
+
+	/* each instance of a recurring comp goes off before its own start */
+	const char *daily =
+		"BEGIN:VCALENDAR\n"
+		"VERSION:2.0\n"
+		"PRODID:test\n"
+		"BEGIN:VEVENT\n"
+		"UID:daily\n"
+		"DTSTART:20240101T090000Z\n"
+		"DTEND:20240101T100000Z\n"
+		"RRULE:FREQ=DAILY;COUNT=3\n"
+		"BEGIN:VALARM\n"
+		"ACTION:DISPLAY\n"
+		"TRIGGER:-PT15M\n"
+		"END:VALARM\n"
+		"END:VEVENT\n"
+		"END:VCALENDAR\n";
+	f = fmemopen((void*)daily, strlen(daily), "r");
+	asrt(f, "");
+	asrt(comp_init_from_ics(&c, f) == 0, "alarms parse");
+	fclose(f);
+	struct vec insts = vec_new_empty(sizeof(struct recur_dep_props));
+	comp_recur_expand(&c, start + 10 * 86400, test_alarms_inst, &insts);
+	asrt(insts.len == 3, "alarm instances");
+	a = vec_get(&c.alarms, 0);
+	for (int i = 0; i < insts.len; ++i) {
+		struct recur_dep_props *r = vec_get(&insts, i);
+		asrt(r->start == start + i * 86400, "alarm instance start");
+		asrt(comp_alarm_time(a, r, 0) == r->start - 900,
+			"alarm of instance");
+	}
+	vec_free(&insts);
+	comp_finish(&c);
+
+	/* the wheel against a sorted list, over long and short distances */
+	enum { N = 2000 };
+	static struct timer_wheel w;
+	static struct timer_wheel_node nodes[N];
+	timer_wheel_init(&w, start);
+	uint32_t seed = 1;
+	for (int i = 0; i < N; ++i) {
+		seed = seed * 1103515245 + 12345;
+		ts d = i % 2 ? seed % 4000 : seed % (400 * 86400);
+		nodes[i].t = start + 1 + d;
+		asrt(timer_wheel_add(&w, &nodes[i]), "wheel add");
+	}
+	for (int i = 0; i < N; i += 3) timer_wheel_remove(&w, &nodes[i]);
+	asrt(w.n == N - (N + 2) / 3, "wheel remove");
+	ts last = start, to = start;
+	while (w.n > 0) {
+		ts next = timer_wheel_next(&w);
+		asrt(next > w.now, "wheel next");
+		int n = w.n;
+		seed = seed * 1103515245 + 12345;
+		to = next + seed % 3 * 1000;
+		struct vec fired =
+			vec_new_empty(sizeof(struct timer_wheel_node *));
+		timer_wheel_advance(&w, to, test_alarms_fired, &fired);
+		for (int i = 0; i < fired.len; ++i) {
+			struct timer_wheel_node **x = vec_get(&fired, i);
+			asrt((*x)->t >= last && (*x)->t <= to, "wheel order");
+			last = (*x)->t;
+		}
+		asrt(n - fired.len == w.n, "wheel count");
+		vec_free(&fired);
+		for (int i = 0; i < N; ++i) {
+			asrt(timer_wheel_contains(&nodes[i])
+				== (i % 3 && nodes[i].t > to), "wheel pending");
+		}
+	}
+}
+
+static void test_alarm_ledger() {
+	const char *path = "/tmp/test_alarm_ledger";
+	unlink(path);
+	struct alarm_ledger l;
+	asrt(alarm_ledger_open(&l, path) == 0, "ledger open");
+	asrt(l.mark == -1, "ledger empty");
+	uint64_t h = alarm_ledger_hash("0 -1 0 0 uid");
+	alarm_ledger_append(&l, h, 200);
+	alarm_ledger_mark(&l, 100);
+	alarm_ledger_close(&l);
+
+	/* delivered after the mark, then cut short by a crash */
+	FILE *f = fopen(path, "ab");
+	asrt(f && fwrite("torn", 1, 4, f) == 4, "");
+	fclose(f);
+	asrt(alarm_ledger_open(&l, path) == 0, "ledger reopen");
+	asrt(l.mark == 100, "ledger mark");
+	asrt(alarm_ledger_delivered(&l, h, 200), "ledger delivered");
+	asrt(!alarm_ledger_delivered(&l, h, 201), "ledger not delivered");
+	asrt(alarm_ledger_delivered(&l, h + 1, 100), "ledger marked");
+
+	/* grows only until it is rewritten */
+	for (int i = 0; i < 10000; ++i) alarm_ledger_mark(&l, 300 + i);
+	asrt(l.n < 5000 && l.delivered.len == 0, "ledger compact");
+	alarm_ledger_close(&l);
+	asrt(alarm_ledger_open(&l, path) == 0, "ledger reopen");
+	asrt(l.mark == 10299, "ledger compact mark");
+	alarm_ledger_close(&l);
+}
+
+static void test_inst_index_cb(void *cl, struct comp_inst *ci) {
+	vec_append(cl, &ci);
+}
+static void test_inst_index() {
+	struct inst_index ix;
+	inst_index_init(&ix);
+	int N = 500;
+	srand(3);
+	for (int i = 0; i < N; ++i) {
+		/* in two batches, the second merged into the first */
+		if (i == N / 2) inst_index_build(&ix);
+		struct comp_inst *ci =
+			malloc_tagged(MEM_TAG_INST, sizeof(struct comp_inst));
+		ci->rdp.start = rand() % 1000;
+		ci->rdp.end = ci->rdp.start + rand() % (i % 7 ? 20 : 400);
+		inst_index_add(&ix, ci);
+	}
+	inst_index_build(&ix);
+	for (int i = 1; i < N; ++i) {
+		asrt(ix.start[i - 1] <= ix.start[i], "inst index order");
+	}
+	struct vec res = vec_new_empty(sizeof(struct comp_inst *));
+	for (int q = 0; q < 200; ++q) {
+		struct ts_ran ran = { rand() % 1200 - 100, 0 };
+		ran.to = ran.fr + rand() % 100;
+		vec_clear(&res);
+		inst_index_query(&ix, ran, &test_inst_index_cb, &res);
+		int exp = 0;
+		for (int i = 0; i < N; ++i) {
+			exp += ix.ci[i]->rdp.start < ran.to
+				&& ix.ci[i]->rdp.end > ran.fr;
+		}
+		asrt(res.len == exp, "inst index query");
+		for (int i = 0; i < res.len; ++i) {
+			struct comp_inst **ci = vec_get(&res, i);
+			asrt((*ci)->rdp.start < ran.to
+				&& (*ci)->rdp.end > ran.fr, "inst index hit");
+		}
+	}
+	vec_free(&res);
+	inst_index_finish(&ix);
+}
+
+static void test_expand_parallel_cmp(struct calendar *a, struct calendar *b,
+		enum comp_type type) {
+	struct inst_index *x = &a->cis[type], *y = &b->cis[type];
+	asrt(x->n == y->n && a->cis_n[type] == b->cis_n[type],
+		"parallel expansion count");
+	for (int i = 0; i < x->n; ++i) {
+		struct comp_inst *p = x->ci[i], *q = y->ci[i];
+		asrt(p->comp_idx == q->comp_idx
+			&& p->recurrence_id == q->recurrence_id
+			&& p->rdp.start == q->rdp.start
+			&& p->rdp.end == q->rdp.end
+			&& p->rdp.due == q->rdp.due,
+			"parallel expansion differs");
+	}
+}
+static void test_expand_parallel() {
+	const char *rules[] = {
+		"", "RRULE:FREQ=DAILY\n", "RRULE:FREQ=WEEKLY;BYDAY=TU,TH\n",
+		"RRULE:FREQ=MONTHLY;BYDAY=MO,TU,WE,TH,FR;BYSETPOS=-1\n",
+		"RRULE:FREQ=DAILY;COUNT=5\n",
+	};
+	struct str ics = str_new_from_cstr(
+		"BEGIN:VCALENDAR\nVERSION:2.0\nPRODID:test\n");
+	char buf[512];
+	for (int i = 0; i < 300; ++i) {
+		const char *kind = i % 4 ? "VEVENT" : "VTODO";
+		const char *end = i % 4 ? "DTEND" : "DUE";
+		int n = snprintf(buf, sizeof(buf),
+			"BEGIN:%s\nUID:u%d\n"
+			"DTSTART:202401%02dT%02d0000Z\n"
+			"%s:202401%02dT%02d3000Z\n%sEND:%s\n",
+			kind, i, 1 + i % 28, i % 24, end, 1 + i % 28, i % 24,
+			rules[i % 5], kind);
+		str_append(&ics, buf, n);
+	}
+	str_append(&ics, "END:VCALENDAR\n", 14);
+	write_to_file("/tmp/test_expand.ics", str_cstr(&ics));
+	str_free(&ics);
+
+	struct cal_timezone *zone = cal_timezone_new("Europe/Budapest");
+	struct calendar seq;
+	calendar_init(&seq);
+	seq.storage = str_new_from_cstr("/tmp/test_expand.ics");
+	update_calendar_from_storage(&seq, zone);
+	struct vec cals = vec_new_empty(sizeof(struct calendar));
+	for (int j = 0; j < 2; ++j) {
+		struct calendar *cal = vec_get(&cals,
+			vec_append(&cals, &(struct calendar){ 0 }));
+		calendar_init(cal);
+		cal->storage = str_new_from_cstr("/tmp/test_expand.ics");
+		update_calendar_from_storage(cal, zone);
+	}
+
+	/* and again further on, from where the first one stopped */
+	const ts to[] = { 1735689600, 1893456000 }; /* 2025, 2030 */
+	for (int k = 0; k < 2; ++k) {
+		for (int t = 0; t < COMP_TYPE_N; ++t) {
+			calendar_expand_instances_to(&seq, t, to[k]);
+			calendars_expand_instances_to(&cals, t, to[k], 4);
+			for (int j = 0; j < 2; ++j) {
+				test_expand_parallel_cmp(&seq,
+					vec_get(&cals, j), t);
+			}
+		}
+	}
+	asrt(seq.cis_n[COMP_TYPE_EVENT] > 1000, "parallel expansion empty");
+
+	for (int j = 0; j < 2; ++j) calendar_finish(vec_get(&cals, j));
+	vec_free(&cals);
+	calendar_finish(&seq);
+	cal_timezone_destroy(zone);
+}
+
+/* the number of the lists busy at t */
+static int test_freebusy_count(const struct ts_ran *ivs, const int *owner,
+		int n, int lists, ts t) {
+	int c = 0;
+	for (int l = 0; l < lists; ++l) {
+		for (int i = 0; i < n; ++i) {
+			if (owner[i] == l && ivs[i].fr <= t && t < ivs[i].to) {
+				++c;
+				break;
+			}
+		}
+	}
+	return c;
+}
+static void test_freebusy() {
+	enum { L = 3, N = 120 };
+	struct ts_ran ivs[N];
+	int owner[N];
+	struct busy_list bls[L];
+	for (int l = 0; l < L; ++l) busy_list_init(&bls[l]);
+	srand(5);
+	/* in two batches, the second merged into the first */
+	for (int b = 0; b < 2; ++b) {
+		for (int l = 0; l < L; ++l) {
+			struct ts_ran batch[N / L / 2];
+			ts fr = 0;
+			for (int i = 0; i < N / L / 2; ++i) {
+				fr += rand() % 20;
+				batch[i] = (struct ts_ran){
+					fr, fr + rand() % 25 };
+				int k = (b * L + l) * (N / L / 2) + i;
+				ivs[k] = batch[i];
+				owner[k] = l;
+			}
+			busy_list_add(&bls[l], batch, N / L / 2);
+		}
+	}
+	for (int l = 0; l < L; ++l) {
+		for (int i = 1; i < bls[l].v.len; ++i) {
+			struct ts_ran *a = vec_get(&bls[l].v, i - 1);
+			struct ts_ran *b = vec_get(&bls[l].v, i);
+			asrt(a->fr < a->to && a->to < b->fr, "busy list form");
+		}
+	}
+
+	struct vec out = vec_new_empty(sizeof(struct ts_ran));
+	enum freebusy_mode modes[] = {
+		FREEBUSY_ANY, FREEBUSY_ALL, FREEBUSY_FREE };
+	for (int q = 0; q < 50; ++q) {
+		struct ts_ran r = { rand() % 700 - 50, 0 };
+		r.to = r.fr + rand() % 300;
+		for (int m = 0; m < 3; ++m) {
+			vec_clear(&out);
+			freebusy_query(bls, L, modes[m], r, &out);
+			int k = 0;
+			for (ts t = r.fr; t < r.to; ++t) {
+				int c = test_freebusy_count(ivs, owner,
+					N, L, t);
+				bool exp = modes[m] == FREEBUSY_ANY ? c > 0
+					: modes[m] == FREEBUSY_ALL ? c == L
+					: c == 0;
+				while (k < out.len && ((struct ts_ran *)
+						vec_get(&out, k))->to <= t) ++k;
+				bool act = k < out.len && ((struct ts_ran *)
+					vec_get(&out, k))->fr <= t;
+				asrt(exp == act, "freebusy query");
+			}
+		}
+	}
+	vec_free(&out);
+	for (int l = 0; l < L; ++l) busy_list_finish(&bls[l]);
+}
+
 int main() {
 	test_todo_schedule();
 	test_lookup_color();
 	test_editor_parser();
 	test_editor();
+	test_editor_in_place();
+	test_editor_batch();
+	test_journal();
 	test_slicing();
+	test_datetime();
+	test_recurrence();
+	test_props();
+	test_alarms();
+	test_alarms_want();
+	test_alarm_ledger();
+	test_inst_index();
+	test_in_view();
+	test_todo_key();
+	test_sort();
+	test_expand_parallel();
+	test_freebusy();
 }
@@ -1,58 +1,375 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <libical/ical.h>
 
-#include "util.h"
-#include "datetime.h"
-#include "editor.h"
-#include "calendar.h"
+#include "core.h"
 
-/* gen <due> <start> <incr> <n> <summary> <out dir> */
-int main(int argc, char **argv) {
-	if (argc < 7) return 1;
-	struct simple_date due = parse_date(argv[1]);
-	struct simple_date start = parse_date(argv[2]);
-	if (start.year == -1) start.year = due.year;
-	if (start.month == -1) start.month = due.month;
-	if (start.day == -1) start.day = due.day;
-	due.second = start.second = 0;
-	if (due.year < 0) return 1;
-	int incr = atoi(argv[3]);
-	int n = atoi(argv[4]);
-	const char *summary = argv[5];
-	const char *out_dir = argv[6];
-
-	struct cal_timezone *zone  = cal_timezone_new("Europe/Budapest");
+/*
+ * Synthetic calendar data for the benchmarks. The output only depends on
+ * the options, so two runs with the same seed produce the same files.
+ */
+
+#define GEN_ZONES_MAX 16
+#define GEN_OCCUR_MAX 3 /* overridden or excluded instances per comp */
+
+struct gen {
+	int events, todos;
+	int recur_pct, override_pct, exdate_pct;
+	const char *zones[GEN_ZONES_MAX];
+	int zones_n;
+	uint32_t rng;
+	int span_days;
+	int base_y, base_m, base_d;
+	bool single;
+	const char *out;
+
+	FILE *f; /* the single file, or the file of the current comp */
+	int n; /* comps written so far, for the uids */
+};
+
+static uint32_t rnd(struct gen *g) {
+	/* xorshift32, so the data doesn't depend on the libc */
+	uint32_t x = g->rng;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return g->rng = x;
+}
+static int rnd_in(struct gen *g, int fr, int to) {
+	return fr + (int)(rnd(g) % (uint32_t)(to - fr));
+}
+static bool rnd_pct(struct gen *g, int pct) {
+	return rnd_in(g, 0, 100) < pct;
+}
+
+static const char *categories[] = {
+	"work", "home", "sport", "family", "errands", "study", "travel",
+};
+#define CATEGORIES_N (int)(sizeof(categories) / sizeof(categories[0]))
+
+static const char *rules[] = {
+	"FREQ=DAILY;COUNT=%d",
+	"FREQ=DAILY;INTERVAL=%d",
+	"FREQ=WEEKLY;INTERVAL=%d;UNTIL=%s",
+	"FREQ=WEEKLY;BYDAY=MO,WE,FR",
+	"FREQ=MONTHLY;BYMONTHDAY=%d",
+	"FREQ=YEARLY",
+};
+#define RULES_N (int)(sizeof(rules) / sizeof(rules[0]))
+
+static bool is_utc(const char *zone) {
+	return strcmp(zone, "UTC") == 0;
+}
+static icaltimezone *get_zone(const char *zone) {
+	if (is_utc(zone)) return icaltimezone_get_utc_timezone();
+	return icaltimezone_get_builtin_timezone(zone);
+}
+
+/* buf must be at least 17 long */
+static void fmt_local(char *buf, struct icaltimetype tt) {
+	snprintf(buf, 17, "%04d%02d%02dT%02d%02d%02d",
+		tt.year, tt.month, tt.day, tt.hour, tt.minute, tt.second);
+}
+static void fmt_utc(char *buf, time_t t) {
+	struct tm tm;
+	gmtime_r(&t, &tm);
+	strftime(buf, 17, "%Y%m%dT%H%M%SZ", &tm);
+}
+static void print_time(struct gen *g, const char *key, const char *zone,
+		struct icaltimetype tt) {
+	char buf[17];
+	fmt_local(buf, tt);
+	if (is_utc(zone)) fprintf(g->f, "%s:%sZ\n", key, buf);
+	else fprintf(g->f, "%s;TZID=%s:%s\n", key, zone, buf);
+}
+
+static void print_vtimezone(struct gen *g, const char *zone) {
+	if (is_utc(zone)) return;
+	icalcomponent *c = icaltimezone_get_component(get_zone(zone));
+	fputs(icalcomponent_as_ical_string(c), g->f);
+}
 
+static void begin_file(struct gen *g, const char *uid, const char *zone) {
+	if (g->single) return;
 	char path[1024];
-	for (int i = 0; i < n; i += incr) {
-		ts due_base = simple_date_to_ts(due, zone);
-		ts start_base = simple_date_to_ts(start, zone);
-		ts_adjust_days(&due_base, zone, i);
-		ts_adjust_days(&start_base, zone, i);
-		icaltimetype tdue = icaltime_from_timet_with_zone(
-			(time_t)due_base, 0, icaltimezone_get_utc_timezone());
-		icaltimetype tstart = icaltime_from_timet_with_zone(
-			(time_t)start_base, 0, icaltimezone_get_utc_timezone());
-
-		char uid_buf[64];
-		generate_uid(uid_buf);
-		icalcomponent *calendar =
-			icalcomponent_vanew(ICAL_VCALENDAR_COMPONENT,
-			icalproperty_new_version("2.0"),
-			icalproperty_new_prodid("gen"),
-			icalcomponent_vanew(
-				ICAL_VTODO_COMPONENT,
-				icalproperty_new_uid(uid_buf),
-				icalproperty_new_summary(summary),
-				icalproperty_new_dtstart(tstart),
-				icalproperty_new_due(tdue),
-				NULL),
-			NULL);
-
-		snprintf(path, 1024, "%s/%s.ics", out_dir, uid_buf);
-		char *result = icalcomponent_as_ical_string(calendar);
-		FILE *f = fopen(path, "w");
-		fputs(result, f);
-		fclose(f);
-		icalcomponent_free(calendar);
+	snprintf(path, sizeof(path), "%s/%s.ics", g->out, uid);
+	g->f = fopen(path, "w");
+	asrt(g->f, "can't open output file");
+	fprintf(g->f, "BEGIN:VCALENDAR\nVERSION:2.0\nPRODID:smuc-gen\n");
+	print_vtimezone(g, zone);
+}
+static void end_file(struct gen *g) {
+	if (g->single) return;
+	fprintf(g->f, "END:VCALENDAR\n");
+	fclose(g->f);
+}
+
+static struct icaltimetype random_start(struct gen *g, const char *zone) {
+	struct icaltimetype tt = icaltime_null_time();
+	tt.year = g->base_y;
+	tt.month = g->base_m;
+	tt.day = g->base_d;
+	tt.hour = rnd_in(g, 7, 21);
+	tt.minute = 15 * rnd_in(g, 0, 4);
+	tt.zone = get_zone(zone);
+	icaltime_adjust(&tt, rnd_in(g, 0, g->span_days), 0, 0, 0);
+	return tt;
+}
+
+/* the first n instances of rrule, as utc */
+static int occurrences(const char *rrule, struct icaltimetype start,
+		const char *zone, time_t *out, int n) {
+	struct icalrecurrencetype r = icalrecurrencetype_from_string(rrule);
+	icalrecur_iterator *it = icalrecur_iterator_new(r, start);
+	if (!it) return 0;
+	int k = 0;
+	while (k < n) {
+		struct icaltimetype tt = icalrecur_iterator_next(it);
+		if (icaltime_is_null_time(tt)) break;
+		out[k++] = icaltime_as_timet_with_zone(tt, get_zone(zone));
+	}
+	icalrecur_iterator_free(it);
+	return k;
+}
+
+static void random_rrule(struct gen *g, char *buf, size_t len) {
+	int rule = rnd_in(g, 0, RULES_N);
+	switch (rule) {
+	case 0:
+		snprintf(buf, len, rules[rule], rnd_in(g, 5, 60));
+		break;
+	case 1:
+		snprintf(buf, len, rules[rule], rnd_in(g, 2, 5));
+		break;
+	case 2: {
+		struct icaltimetype until = icaltime_null_time();
+		until.year = g->base_y;
+		until.month = g->base_m;
+		until.day = g->base_d;
+		icaltime_adjust(&until, g->span_days, 0, 0, 0);
+		char until_s[18];
+		fmt_local(until_s, until);
+		strcat(until_s, "Z");
+		snprintf(buf, len, rules[rule], rnd_in(g, 1, 3), until_s);
+		break;
+	}
+	case 4:
+		snprintf(buf, len, rules[rule], rnd_in(g, 1, 29));
+		break;
+	default:
+		snprintf(buf, len, "%s", rules[rule]);
+		break;
+	}
+}
+
+static void print_common(struct gen *g, const char *uid) {
+	fprintf(g->f, "UID:%s\nDTSTAMP:20240101T000000Z\n", uid);
+	fprintf(g->f, "SUMMARY:%s %d\n",
+		categories[rnd_in(g, 0, CATEGORIES_N)], g->n);
+	if (rnd_pct(g, 30)) {
+		fprintf(g->f, "CATEGORIES:%s\n",
+			categories[rnd_in(g, 0, CATEGORIES_N)]);
+	}
+	if (rnd_pct(g, 10)) fprintf(g->f, "CLASS:PRIVATE\n");
+	if (rnd_pct(g, 20)) fprintf(g->f, "LOCATION:room %d\n", g->n % 50);
+}
+
+/* overrides are moved an hour later, exdates are dropped. the two never
+ * pick the same instance */
+static void print_exdates(struct gen *g, const time_t *occ, int occ_n) {
+	for (int i = 1; i < occ_n; i += 2) {
+		char buf[17];
+		fmt_utc(buf, occ[i]);
+		fprintf(g->f, "EXDATE:%s\n", buf);
+	}
+}
+static void print_overrides(struct gen *g, const char *kind,
+		const char *uid, const char *zone, const time_t *occ,
+		int occ_n, int dur_min) {
+	for (int i = 0; i < occ_n; i += 2) {
+		char buf[17];
+		fmt_utc(buf, occ[i]);
+		struct icaltimetype st = icaltime_from_timet_with_zone(
+			occ[i] + 3600, 0, get_zone(zone));
+		struct icaltimetype en = st;
+		icaltime_adjust(&en, 0, 0, dur_min, 0);
+
+		fprintf(g->f, "BEGIN:%s\n", kind);
+		fprintf(g->f, "UID:%s\nDTSTAMP:20240101T000000Z\n", uid);
+		fprintf(g->f, "RECURRENCE-ID:%s\n", buf);
+		print_time(g, "DTSTART", zone, st);
+		print_time(g, strcmp(kind, "VTODO") == 0 ? "DUE" : "DTEND",
+			zone, en);
+		fprintf(g->f, "SUMMARY:moved %d\n", g->n);
+		fprintf(g->f, "END:%s\n", kind);
+	}
+}
+
+static void gen_comp(struct gen *g, bool todo) {
+	const char *kind = todo ? "VTODO" : "VEVENT";
+	const char *zone = g->zones[rnd_in(g, 0, g->zones_n)];
+	char uid[64];
+	snprintf(uid, sizeof(uid), "gen-%d-%s", g->n, todo ? "todo" : "event");
+
+	struct icaltimetype st = random_start(g, zone);
+	int dur_min = 15 * rnd_in(g, 1, 17);
+	struct icaltimetype en = st;
+	icaltime_adjust(&en, 0, 0, dur_min, 0);
+
+	/* todos without a start can't recur */
+	bool has_start = !todo || rnd_pct(g, 60);
+	bool recur = has_start && rnd_pct(g, g->recur_pct);
+	char rrule[128];
+	time_t occ[2 * GEN_OCCUR_MAX];
+	int occ_n = 0;
+	bool overrides = false, exdates = false;
+	if (recur) {
+		random_rrule(g, rrule, sizeof(rrule));
+		overrides = rnd_pct(g, g->override_pct);
+		exdates = rnd_pct(g, g->exdate_pct);
+		if (overrides || exdates) {
+			occ_n = occurrences(rrule, st, zone, occ,
+				rnd_in(g, 1, 2 * GEN_OCCUR_MAX + 1));
+		}
+	}
+
+	begin_file(g, uid, zone);
+	fprintf(g->f, "BEGIN:%s\n", kind);
+	print_common(g, uid);
+	if (has_start) print_time(g, "DTSTART", zone, st);
+	if (todo) {
+		print_time(g, "DUE", zone, en);
+		fprintf(g->f, "ESTIMATED-DURATION:PT%dM\n", dur_min);
+		int r = rnd_in(g, 0, 10);
+		if (r < 2) {
+			fprintf(g->f, "STATUS:COMPLETED\n");
+			fprintf(g->f, "PERCENT-COMPLETE:100\n");
+		} else if (r < 4) {
+			fprintf(g->f, "STATUS:IN-PROCESS\n");
+			fprintf(g->f, "PERCENT-COMPLETE:%d\n",
+				rnd_in(g, 1, 100));
+		} else {
+			fprintf(g->f, "STATUS:NEEDS-ACTION\n");
+		}
+	} else {
+		print_time(g, "DTEND", zone, en);
+		int r = rnd_in(g, 0, 10);
+		if (r < 1) fprintf(g->f, "STATUS:CANCELLED\n");
+		else if (r < 3) fprintf(g->f, "STATUS:TENTATIVE\n");
+		else fprintf(g->f, "STATUS:CONFIRMED\n");
+	}
+	if (recur) fprintf(g->f, "RRULE:%s\n", rrule);
+	if (exdates) print_exdates(g, occ, occ_n);
+	fprintf(g->f, "END:%s\n", kind);
+	if (overrides) {
+		print_overrides(g, kind, uid, zone, occ, occ_n, dur_min);
+	}
+	end_file(g);
+	++g->n;
+}
+
+static int parse_zones(struct gen *g, char *list) {
+	g->zones_n = 0;
+	for (char *z = strtok(list, ","); z; z = strtok(NULL, ",")) {
+		if (g->zones_n == GEN_ZONES_MAX) return -1;
+		if (!get_zone(z)) {
+			fprintf(stderr, "unknown time zone %s\n", z);
+			return -1;
+		}
+		g->zones[g->zones_n++] = z;
+	}
+	return g->zones_n > 0 ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+	const char *help =
+		"usage: smuc-gen [options] out\n"
+		"-h: show this help\n"
+		"-e N: number of events (default 1000)\n"
+		"-t N: number of todos (default 200)\n"
+		"-r P: percent of recurring components (default 20)\n"
+		"-o P: percent of recurring ones with overrides (default 10)\n"
+		"-x P: percent of recurring ones with EXDATEs (default 10)\n"
+		"-z Z: comma separated time zones, UTC or Olson names\n"
+		"      (default UTC,Europe/Budapest,America/New_York,"
+		"Asia/Tokyo)\n"
+		"-s S: random seed (default 1)\n"
+		"-b B: first day, YYYY-MM-DD (default 2024-01-01)\n"
+		"-d D: number of days the components start in (default 365)\n"
+		"-1: write one .ics file to out, instead of a directory\n"
+		"    with one file per component\n";
+	char default_zones[] =
+		"UTC,Europe/Budapest,America/New_York,Asia/Tokyo";
+	struct gen g = {
+		.events = 1000, .todos = 200,
+		.recur_pct = 20, .override_pct = 10, .exdate_pct = 10,
+		.rng = 1,
+		.span_days = 365,
+		.base_y = 2024, .base_m = 1, .base_d = 1,
+	};
+	char *zones = default_zones;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "he:t:r:o:x:z:s:b:d:1")) != -1) {
+		switch (opt) {
+		case 'e': g.events = atoi(optarg); break;
+		case 't': g.todos = atoi(optarg); break;
+		case 'r': g.recur_pct = atoi(optarg); break;
+		case 'o': g.override_pct = atoi(optarg); break;
+		case 'x': g.exdate_pct = atoi(optarg); break;
+		case 'z': zones = optarg; break;
+		case 's': g.rng = (uint32_t)strtoul(optarg, NULL, 10); break;
+		case 'b':
+			if (sscanf(optarg, "%d-%d-%d",
+					&g.base_y, &g.base_m, &g.base_d) != 3) {
+				fprintf(stderr, "%s", help);
+				return 1;
+			}
+			break;
+		case 'd': g.span_days = atoi(optarg); break;
+		case '1': g.single = true; break;
+		case 'h':
+			printf("%s", help);
+			return 0;
+		default:
+			fprintf(stderr, "%s", help);
+			return 1;
+		}
+	}
+	if (optind != argc - 1 || g.span_days <= 0 || parse_zones(&g, zones)) {
+		fprintf(stderr, "%s", help);
+		return 1;
+	}
+	if (g.rng == 0) g.rng = 1; /* xorshift is stuck at 0 */
+	g.out = argv[optind];
+
+	if (g.single) {
+		g.f = fopen(g.out, "w");
+		if (!g.f) {
+			perror("smuc-gen: fopen");
+			return 1;
+		}
+		fprintf(g.f, "BEGIN:VCALENDAR\nVERSION:2.0\nPRODID:smuc-gen\n");
+		for (int i = 0; i < g.zones_n; ++i) {
+			print_vtimezone(&g, g.zones[i]);
+		}
+	} else if (mkdir(g.out, 0755) != 0 && access(g.out, W_OK) != 0) {
+		perror("smuc-gen: mkdir");
+		return 1;
+	}
+
+	for (int i = 0; i < g.events; ++i) gen_comp(&g, false);
+	for (int i = 0; i < g.todos; ++i) gen_comp(&g, true);
+
+	if (g.single) {
+		fprintf(g.f, "END:VCALENDAR\n");
+		fclose(g.f);
 	}
+	return 0;
 }